@@ -26,6 +26,8 @@ namespace Kernel
 		BAN::ErrorOr<uint8_t> reserve_gsi(uint32_t gsi);
 
 		void initialize_timer();
+		// arms the one-shot lapic timer of current processor
+		void set_timer_deadline_ns(uint64_t ns);
 
 	private:
 		uint32_t read_from_local_apic(ptrdiff_t);
@@ -16,6 +16,9 @@ namespace Kernel
 		uint32_t width() const { return m_width; }
 		uint32_t height() const { return m_height; }
 
+		// video memory can be handed to userspace as is
+		bool supports_direct_mapping() const;
+
 		uint32_t get_pixel(uint32_t x, uint32_t y) const;
 		void set_pixel(uint32_t x, uint32_t y, uint32_t rgb);
 		void fill(uint32_t rgb);
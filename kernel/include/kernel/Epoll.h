@@ -9,6 +9,35 @@
 namespace Kernel
 {
 
+	class Epoll;
+
+	// registration of an inode in epoll, inode may be added through multiple fds
+	struct EpollItem
+	{
+		EpollItem(Epoll* epoll, BAN::RefPtr<Inode> inode)
+			: epoll(epoll)
+			, inode(BAN::move(inode))
+		{}
+
+		Epoll* const epoll;
+		const BAN::RefPtr<Inode> inode;
+
+		// protected by epoll's mutex
+		BAN::HashMap<int, epoll_event> events;
+		bool exclusive { false };
+
+		// protected by inode's epoll lock
+		EpollItem* inode_next { nullptr };
+		EpollItem* inode_prev { nullptr };
+
+		// protected by epoll's ready lock
+		EpollItem* ready_next { nullptr };
+		EpollItem* ready_prev { nullptr };
+		uint32_t ready_events { 0 };
+		uint32_t listen_mask { 0 };
+		bool in_ready_list { false };
+	};
+
 	class Epoll final : public Inode
 	{
 	public:
@@ -18,7 +47,8 @@ namespace Kernel
 		BAN::ErrorOr<void> ctl(int op, int fd, BAN::RefPtr<Inode> inode, epoll_event event);
 		BAN::ErrorOr<size_t> wait(BAN::Span<epoll_event> events, uint64_t waketime_ns);
 
-		void notify(BAN::RefPtr<Inode> inode, uint32_t event);
+		// returns true if an exclusive registration woke up a waiting thread
+		bool notify(EpollItem*, uint32_t event);
 
 	private:
 		Epoll();
@@ -33,54 +63,20 @@ namespace Kernel
 		BAN::ErrorOr<void> sync_inode(SyncType) override { return {}; }
 		BAN::ErrorOr<void> sync_data() override { return {}; }
 
-	private:
-		struct ListenEventList
-		{
-			ListenEventList() = default;
-
-			ListenEventList(const ListenEventList&) = delete;
-			ListenEventList& operator=(const ListenEventList&) = delete;
-
-			ListenEventList(ListenEventList&& other)
-				: events(BAN::move(other.events))
-			{}
-			ListenEventList& operator=(ListenEventList&& other)
-			{
-				events = BAN::move(other.events);
-				return *this;
-			}
-
-			BAN::HashMap<int, epoll_event> events;
-
-			bool has_fd(int fd) const
-			{
-				return events.contains(fd);
-			}
-
-			bool empty() const
-			{
-				return events.empty();
-			}
-
-			BAN::ErrorOr<void> add_fd(int fd, epoll_event event)
-			{
-				TRY(events.insert(fd, event));
-				return {};
-			}
-
-			void remove_fd(int fd)
-			{
-				events.remove(fd);
-			}
-		};
+		// these require holding m_ready_lock
+		void add_to_ready_list(EpollItem*, uint32_t events);
+		void remove_from_ready_list(EpollItem*);
+
+		void update_listen_mask(EpollItem*);
 
 	private:
 		Mutex m_mutex;
 		ThreadBlocker m_thread_blocker;
 		SpinLock m_ready_lock;
-		BAN::HashMap<BAN::RefPtr<Inode>, uint32_t> m_ready_events;
-		BAN::HashMap<BAN::RefPtr<Inode>, uint32_t> m_processing_events;
-		BAN::HashMap<BAN::RefPtr<Inode>, ListenEventList> m_listening_events;
+		EpollItem* m_ready_head { nullptr };
+		EpollItem* m_ready_tail { nullptr };
+		size_t m_ready_count { 0 };
+		BAN::HashMap<Inode*, EpollItem*> m_items;
 	};
 
 }
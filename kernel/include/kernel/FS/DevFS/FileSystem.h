@@ -3,6 +3,7 @@
 #include <BAN/Vector.h>
 #include <kernel/Device/Device.h>
 #include <kernel/FS/TmpFS/FileSystem.h>
+#include <kernel/Lock/LockGuard.h>
 #include <kernel/Lock/Mutex.h>
 #include <kernel/ThreadBlocker.h>
 
@@ -22,6 +23,14 @@ namespace Kernel
 
 		void add_inode(BAN::StringView path, BAN::RefPtr<TmpInode>);
 
+		template<typename F>
+		void for_each_device(F callback) const
+		{
+			LockGuard _(m_device_lock);
+			for (const auto& device : m_devices)
+				callback(device);
+		}
+
 		void initiate_disk_cache_drop();
 		void initiate_sync(bool should_block);
 
@@ -14,11 +14,13 @@
 #include <dirent.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 
 namespace Kernel
 {
 
+	struct EpollItem;
 	class FileBackedRegion;
 	class FileSystem;
 	struct SharedFileData;
@@ -130,6 +132,7 @@ namespace Kernel
 		BAN::ErrorOr<void> listen(int backlog);
 		BAN::ErrorOr<size_t> sendmsg(const msghdr& message, int flags);
 		BAN::ErrorOr<size_t> recvmsg(msghdr& message, int flags);
+		BAN::ErrorOr<size_t> sendfile(Inode& source, off_t offset, size_t count, int flags);
 		BAN::ErrorOr<void> getsockname(sockaddr* address, socklen_t* address_len);
 		BAN::ErrorOr<void> getpeername(sockaddr* address, socklen_t* address_len);
 		BAN::ErrorOr<void> getsockopt(int level, int option, void* value, socklen_t* value_len);
@@ -138,6 +141,8 @@ namespace Kernel
 		// General API
 		BAN::ErrorOr<size_t> read(off_t, BAN::ByteSpan buffer);
 		BAN::ErrorOr<size_t> write(off_t, BAN::ConstByteSpan buffer);
+		BAN::ErrorOr<size_t> readv(off_t, BAN::Span<const iovec>);
+		BAN::ErrorOr<size_t> writev(off_t, BAN::Span<const iovec>);
 		BAN::ErrorOr<void> truncate(size_t);
 		BAN::ErrorOr<void> chmod(mode_t);
 		BAN::ErrorOr<void> chown(uid_t, gid_t);
@@ -152,8 +157,8 @@ namespace Kernel
 
 		BAN::ErrorOr<long> ioctl(int request, void* arg);
 
-		BAN::ErrorOr<void> add_epoll(class Epoll*);
-		void del_epoll(class Epoll*);
+		void add_epoll(EpollItem*);
+		void del_epoll(EpollItem*);
 		void epoll_notify(uint32_t event);
 
 		virtual void on_close(int status_flags) { (void)status_flags; }
@@ -183,6 +188,7 @@ namespace Kernel
 		virtual BAN::ErrorOr<void> bind_impl(const sockaddr*, socklen_t)							{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<size_t> recvmsg_impl(msghdr&, int)										{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<size_t> sendmsg_impl(const msghdr&, int)								{ return BAN::Error::from_errno(ENOTSUP); }
+		virtual BAN::ErrorOr<size_t> sendfile_impl(Inode&, off_t, size_t, int)						{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> getsockname_impl(sockaddr*, socklen_t*)							{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> getpeername_impl(sockaddr*, socklen_t*)							{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<void> getsockopt_impl(int, int, void*, socklen_t*)						{ return BAN::Error::from_errno(ENOTSUP); }
@@ -191,6 +197,9 @@ namespace Kernel
 		// General API
 		virtual BAN::ErrorOr<size_t> read_impl(off_t, BAN::ByteSpan)		{ return BAN::Error::from_errno(ENOTSUP); }
 		virtual BAN::ErrorOr<size_t> write_impl(off_t, BAN::ConstByteSpan)	{ return BAN::Error::from_errno(ENOTSUP); }
+		// default implementations call read_impl/write_impl for each buffer
+		virtual BAN::ErrorOr<size_t> readv_impl(off_t, BAN::Span<const iovec>);
+		virtual BAN::ErrorOr<size_t> writev_impl(off_t, BAN::Span<const iovec>);
 		virtual BAN::ErrorOr<void> truncate_impl(size_t)					{ return BAN::Error::from_errno(ENOTSUP); }
 
 		// Select/Non blocking API
@@ -227,7 +236,8 @@ namespace Kernel
 		BAN::WeakPtr<SharedFileData> m_shared_region;
 
 		SpinLock m_epoll_lock;
-		BAN::LinkedList<class Epoll*> m_epolls;
+		EpollItem* m_epoll_head { nullptr };
+		EpollItem* m_epoll_tail { nullptr };
 
 		friend class Epoll;
 		friend class FileBackedRegion;
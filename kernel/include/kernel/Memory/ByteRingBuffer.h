@@ -23,6 +23,19 @@ namespace Kernel
 			m_size += data.size();
 		}
 
+		// contiguous free space after the last byte, commit_free_space() makes written bytes part of the buffer
+		BAN::ByteSpan get_free_space()
+		{
+			uint8_t* buffer_head = reinterpret_cast<uint8_t*>(m_vaddr) + (m_tail + m_size) % m_capacity;
+			return { buffer_head, free() };
+		}
+
+		void commit_free_space(size_t size)
+		{
+			ASSERT(size <= free());
+			m_size += size;
+		}
+
 		void pop(size_t size)
 		{
 			ASSERT(size <= m_size);
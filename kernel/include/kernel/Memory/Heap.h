@@ -33,6 +33,9 @@ namespace Kernel
 		Heap() = default;
 		void initialize_impl();
 
+		size_t take_free_pages_locked(paddr_t* pages, size_t count);
+		void release_pages_locked(const paddr_t* pages, size_t count);
+
 	private:
 		BAN::Vector<PhysicalRange>	m_physical_ranges;
 		mutable SpinLock			m_lock;
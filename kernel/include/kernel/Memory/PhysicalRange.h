@@ -7,8 +7,15 @@
 namespace Kernel
 {
 
+	// Buddy allocator over a contiguous range of physical memory. Free blocks
+	// are kept in per order lists linked through the free pages themselves
+	// and a per order bitmap stored at the start of the range tells which
+	// blocks are currently free.
 	class PhysicalRange
 	{
+	public:
+		static constexpr size_t max_order = 10;
+
 	public:
 		PhysicalRange(paddr_t, uint64_t);
 
@@ -28,9 +35,31 @@ namespace Kernel
 		size_t free_pages() const { return m_free_pages; }
 
 	private:
-		const paddr_t m_paddr { 0 };
-		const size_t m_page_count { 0 };
+		static constexpr size_t invalid_index = static_cast<size_t>(-1);
+
+		paddr_t index_to_paddr(size_t index) const { return m_base + static_cast<paddr_t>(index) * PAGE_SIZE; }
+		size_t paddr_to_index(paddr_t paddr) const { return (paddr - m_base) / PAGE_SIZE; }
+
+		bool is_block_free(size_t index, size_t order) const;
+		void set_block_free(size_t index, size_t order, bool free);
+
+		void push_free_block(size_t index, size_t order);
+		void remove_free_block(size_t index, size_t order);
+
+		size_t allocate_block(size_t order);
+		void free_block(size_t index, size_t order);
+		void free_index_range(size_t index, size_t count);
+
+		size_t allocate_max_order_run(size_t block_count);
+
+	private:
+		paddr_t m_paddr { 0 };
+		paddr_t m_base { 0 };
+		size_t m_page_count { 0 };
+		size_t m_index_count { 0 };
 		size_t m_free_pages { 0 };
+		size_t m_bitmap_offsets[max_order + 1] {};
+		paddr_t m_free_lists[max_order + 1] {};
 	};
 
 }
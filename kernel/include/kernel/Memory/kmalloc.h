@@ -2,7 +2,19 @@
 
 #include <stddef.h>
 
+struct kmalloc_size_class_info
+{
+	size_t object_size;
+	size_t slab_count;
+	size_t total_objects;
+	size_t used_objects;
+	size_t cached_objects;
+};
+
 void kmalloc_initialize();
 
 void* kmalloc(size_t);
 void kfree(void*);
+
+size_t kmalloc_size_class_count();
+kmalloc_size_class_info kmalloc_get_size_class_info(size_t size_class);
@@ -29,6 +29,7 @@ namespace Kernel
 		REG_TDLEN	= 0x3808,
 		REG_TDH		= 0x3810,
 		REG_TDT		= 0x3818,
+		REG_RXCSUM	= 0x5000,
 		REG_MTA		= 0x5200,
 	};
 
@@ -167,6 +168,27 @@ namespace Kernel
 		RCTL_BSIZE_16384	= (0b01 << 16) | RCTL_BSEX,
 	};
 
+	enum E1000_RXCSUM : uint32_t
+	{
+		RXCSUM_IPOFL	= 1 << 8,
+		RXCSUM_TUOFL	= 1 << 9,
+	};
+
+	enum E1000_RX_STATUS : uint8_t
+	{
+		RX_STATUS_DD	= 1 << 0,
+		RX_STATUS_EOP	= 1 << 1,
+		RX_STATUS_IXSM	= 1 << 2,
+		RX_STATUS_TCPCS	= 1 << 5,
+		RX_STATUS_IPCS	= 1 << 6,
+	};
+
+	enum E1000_RX_ERRORS : uint8_t
+	{
+		RX_ERRORS_TCPE	= 1 << 5,
+		RX_ERRORS_IPE	= 1 << 6,
+	};
+
 	enum E1000_CMD : uint8_t
 	{
 		CMD_EOP		= 1 << 0,
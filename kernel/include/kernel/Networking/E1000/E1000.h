@@ -30,6 +30,8 @@ namespace Kernel
 
 		size_t payload_mtu() const override { return E1000_RX_BUFFER_SIZE - sizeof(EthernetHeader); }
 
+		uint32_t capabilities() const override { return TxChecksum | RxChecksum; }
+
 		void handle_irq() final override;
 
 	protected:
@@ -62,6 +64,9 @@ namespace Kernel
 		BAN::ErrorOr<void> enable_interrupt();
 
 		void receive_thread();
+		void poll_rx();
+		size_t process_rx_batch(size_t budget);
+		void set_interrupt_throttle(uint32_t itr);
 
 	protected:
 		PCI::Device&					m_pci_device;
@@ -79,6 +84,11 @@ namespace Kernel
 
 		SpinLock m_rx_lock;
 		ThreadBlocker m_rx_blocker;
+		bool m_rx_pending { true };
+
+		uint32_t m_rx_current { 0 };
+		uint32_t m_rx_interrupts { 0 };
+		uint32_t m_itr { 0 };
 
 		bool m_thread_should_die { false };
 		BAN::Atomic<bool> m_thread_is_dead { true };
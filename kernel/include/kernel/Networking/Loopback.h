@@ -21,6 +21,8 @@ namespace Kernel
 
 		size_t payload_mtu() const override { return buffer_size - sizeof(EthernetHeader); }
 
+		uint32_t capabilities() const override { return TxChecksum | RxChecksum; }
+
 	protected:
 		LoopbackInterface()
 			: NetworkInterface(Type::Loopback)
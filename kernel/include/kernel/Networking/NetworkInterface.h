@@ -4,6 +4,7 @@
 #include <BAN/Errors.h>
 #include <BAN/IPv4.h>
 #include <BAN/MAC.h>
+#include <BAN/Optional.h>
 #include <kernel/Device/Device.h>
 
 namespace Kernel
@@ -35,6 +36,15 @@ namespace Kernel
 			Loopback,
 		};
 
+		enum Capability : uint32_t
+		{
+			// interface completes tcp and udp checksums of outgoing ipv4 packets,
+			// stack leaves the pseudo header checksum in the checksum field
+			TxChecksum = 1u << 0,
+			// interface validates ipv4, tcp and udp checksums of incoming packets
+			RxChecksum = 1u << 1,
+		};
+
 	public:
 		NetworkInterface(Type);
 		virtual ~NetworkInterface() {}
@@ -57,6 +67,8 @@ namespace Kernel
 
 		virtual size_t payload_mtu() const = 0;
 
+		virtual uint32_t capabilities() const { return 0; }
+
 		virtual BAN::StringView name() const override { return m_name; }
 
 		BAN::ErrorOr<void> send_bytes(BAN::MACAddress destination, EtherType protocol, BAN::ConstByteSpan payload)
@@ -65,6 +77,17 @@ namespace Kernel
 		}
 		virtual BAN::ErrorOr<void> send_bytes(BAN::MACAddress destination, EtherType protocol, BAN::Span<const BAN::ConstByteSpan> payload) = 0;
 
+	protected:
+		struct TxChecksumInfo
+		{
+			uint8_t protocol;
+			uint16_t start;
+			uint16_t offset;
+		};
+
+		// location of the tcp or udp checksum within an ethernet frame that has to be completed by the interface
+		static BAN::Optional<TxChecksumInfo> get_tx_checksum_info(BAN::ConstByteSpan frame);
+
 	private:
 		BAN::ErrorOr<long> ioctl_impl(int, void*) override;
 
@@ -39,4 +39,7 @@ namespace Kernel
 	uint16_t calculate_internet_checksum(BAN::ConstByteSpan buffer);
 	uint16_t calculate_internet_checksum(BAN::Span<const BAN::ConstByteSpan> buffers);
 
+	// uncomplemented sum, used to seed checksum fields that are completed by the network interface
+	uint16_t calculate_partial_internet_checksum(BAN::ConstByteSpan buffer);
+
 }
@@ -24,6 +24,8 @@ namespace Kernel
 		RTL8169_IO_9346CR = 0x50,
 		RTL8169_IO_PHYSts = 0x6C,
 		RTL8169_IO_RMS    = 0xDA,
+		RTL8169_IO_CPlusCmd = 0xE0,
+		RTL8169_IO_IntrMitigate = 0xE2,
 		RTL8169_IO_RDSAR  = 0xE4,
 		RTL8169_IO_MTPS   = 0xEC,
 	};
@@ -120,6 +122,11 @@ namespace Kernel
 		RTL8169_PHYSts_TxFlow  = 1u << 6,
 	};
 
+	enum RTL8169_CPlusCmd : uint16_t
+	{
+		RTL8169_CPlusCmd_RxChkSum = 1u << 5,
+	};
+
 	enum RTL8169_RMS : uint16_t
 	{
 		// 8192 - 1
@@ -141,6 +148,19 @@ namespace Kernel
 
 	enum RTL8169DescriptorCommand : uint32_t
 	{
+		// tx checksum offload, original 8169 descriptor layout
+		RTL8169_DESC_CMD_TCPCS = 1u << 16,
+		RTL8169_DESC_CMD_UDPCS = 1u << 17,
+		RTL8169_DESC_CMD_IPCS  = 1u << 18,
+
+		// rx checksum status
+		RTL8169_DESC_CMD_TCPF  = 1u << 14,
+		RTL8169_DESC_CMD_UDPF  = 1u << 15,
+		RTL8169_DESC_CMD_IPF   = 1u << 16,
+		RTL8169_DESC_CMD_PID_MASK = 0b11u << 17,
+		RTL8169_DESC_CMD_PID_TCP  = 0b01u << 17,
+		RTL8169_DESC_CMD_PID_UDP  = 0b10u << 17,
+
 		RTL8169_DESC_CMD_LGSEN = 1u << 27,
 		RTL8169_DESC_CMD_LS    = 1u << 28,
 		RTL8169_DESC_CMD_FS    = 1u << 29,
@@ -22,6 +22,8 @@ namespace Kernel
 
 		virtual size_t payload_mtu() const override { return 7436 - sizeof(EthernetHeader); }
 
+		virtual uint32_t capabilities() const override;
+
 		virtual void handle_irq() override;
 
 	protected:
@@ -50,6 +52,8 @@ namespace Kernel
 		BAN::ErrorOr<void> enable_interrupt();
 
 		void receive_thread();
+		void poll_rx();
+		size_t process_rx_batch(size_t budget);
 
 	protected:
 		PCI::Device&					m_pci_device;
@@ -69,10 +73,13 @@ namespace Kernel
 		bool m_thread_should_die { false };
 		BAN::Atomic<bool> m_thread_is_dead { true };
 		ThreadBlocker m_thread_blocker;
+		bool m_rx_pending { true };
 
 		uint32_t m_rx_current { 0 };
 		size_t m_tx_current { 0 };
 
+		bool m_tx_checksum_offload { false };
+
 		BAN::MACAddress	m_mac_address {};
 		BAN::Atomic<bool> m_link_up { false };
 
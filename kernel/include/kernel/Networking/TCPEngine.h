@@ -0,0 +1,93 @@
+#pragma once
+
+#include <BAN/Array.h>
+#include <BAN/Atomic.h>
+#include <BAN/UniqPtr.h>
+#include <BAN/Vector.h>
+#include <kernel/Lock/Mutex.h>
+#include <kernel/Thread.h>
+#include <kernel/ThreadBlocker.h>
+
+namespace Kernel
+{
+
+	class TCPSocket;
+
+	// engine bookkeeping embedded in every TCPSocket
+	struct TCPEngineNode
+	{
+		uint8_t worker_index { 0 };
+
+		// protected by worker's mutex
+		bool registered { false };
+		bool queued { false };
+		TCPSocket* queue_next { nullptr };
+
+		// only touched by the worker thread
+		bool timer_armed { false };
+		uint16_t timer_slot { 0 };
+		uint64_t timer_ms { 0 };
+		TCPSocket* timer_prev { nullptr };
+		TCPSocket* timer_next { nullptr };
+	};
+
+	// Runs TCP socket work on one kernel thread per processor instead of a
+	// thread per socket. Every socket is owned by a single worker. Work is
+	// queued with schedule() and timers (retransmit, delayed ACK, TIME-WAIT)
+	// are kept in a per worker hashed timer wheel.
+	class TCPEngine
+	{
+		BAN_NON_COPYABLE(TCPEngine);
+		BAN_NON_MOVABLE(TCPEngine);
+
+	public:
+		static BAN::ErrorOr<void> initialize();
+		static TCPEngine& get();
+
+		// engine keeps a reference to the socket until its connection is closed
+		void add_socket(TCPSocket&);
+
+		// run socket's work on its worker as soon as possible
+		void schedule(TCPSocket&);
+
+	private:
+		static constexpr uint64_t s_timer_tick_ms = 10;
+		static constexpr size_t   s_timer_slots   = 256;
+
+		struct Worker
+		{
+			Thread* thread { nullptr };
+			uint8_t processor_index { 0 };
+
+			Mutex mutex;
+			ThreadBlocker thread_blocker;
+			TCPSocket* queue_head { nullptr };
+			TCPSocket* queue_tail { nullptr };
+
+			// start of the first tick that has not been processed
+			uint64_t wheel_time_ms { 0 };
+			size_t armed_timers { 0 };
+			// no armed timer expires before this, worker sleeps until it
+			uint64_t next_timer_ms { UINT64_MAX };
+			BAN::Array<TCPSocket*, s_timer_slots> timer_wheel { nullptr };
+		};
+
+	private:
+		TCPEngine() = default;
+
+		void worker_task(Worker&);
+		void process_socket(Worker&, TCPSocket&);
+
+		void advance_timers(Worker&, uint64_t current_ms);
+		void update_next_timer(Worker&);
+		void arm_timer(Worker&, TCPSocket&, uint64_t wake_time_ms);
+		void disarm_timer(Worker&, TCPSocket&);
+
+	private:
+		BAN::Vector<BAN::UniqPtr<Worker>> m_workers;
+		BAN::Atomic<size_t> m_next_worker { 0 };
+
+		friend class BAN::UniqPtr<TCPEngine>;
+	};
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <BAN/Array.h>
 #include <BAN/HashMap.h>
 #include <BAN/Endianness.h>
 #include <BAN/Queue.h>
@@ -7,6 +8,7 @@
 #include <kernel/Memory/ByteRingBuffer.h>
 #include <kernel/Networking/NetworkInterface.h>
 #include <kernel/Networking/NetworkSocket.h>
+#include <kernel/Networking/TCPEngine.h>
 #include <kernel/Thread.h>
 #include <kernel/ThreadBlocker.h>
 
@@ -41,19 +43,23 @@ namespace Kernel
 	};
 	static_assert(sizeof(TCPHeader) == 20);
 
-	class TCPSocket final : public NetworkSocket
+	// range of sequence numbers [start, end)
+	struct TCPSackBlock
 	{
-	public:
-		static constexpr size_t m_tcp_options_bytes = 8;
+		uint32_t start { 0 };
+		uint32_t end   { 0 };
+	};
 
+	class TCPSocket final : public NetworkSocket
+	{
 	public:
 		static BAN::ErrorOr<BAN::RefPtr<TCPSocket>> create(NetworkLayer&, const Info&);
 		~TCPSocket();
 
 		NetworkProtocol protocol() const override { return NetworkProtocol::TCP; }
 
-		size_t protocol_header_size() const override { return sizeof(TCPHeader) + m_tcp_options_bytes; }
-		void get_protocol_header(BAN::ByteSpan header, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader) override;
+		size_t protocol_header_size() const override { return sizeof(TCPHeader) + tcp_options_size(); }
+		void get_protocol_header(BAN::ByteSpan header, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader, bool checksum_offload) override;
 
 	protected:
 		BAN::ErrorOr<long> accept_impl(sockaddr*, socklen_t*, int) override;
@@ -62,6 +68,7 @@ namespace Kernel
 		BAN::ErrorOr<void> bind_impl(const sockaddr*, socklen_t) override;
 		BAN::ErrorOr<size_t> recvmsg_impl(msghdr& message, int flags) override;
 		BAN::ErrorOr<size_t> sendmsg_impl(const msghdr& message, int flags) override;
+		BAN::ErrorOr<size_t> sendfile_impl(Inode& source, off_t offset, size_t count, int flags) override;
 		BAN::ErrorOr<void> getpeername_impl(sockaddr*, socklen_t*) override;
 		BAN::ErrorOr<void> getsockopt_impl(int, int, void*, socklen_t*) override;
 		BAN::ErrorOr<void> setsockopt_impl(int, int, const void*, socklen_t) override;
@@ -75,6 +82,8 @@ namespace Kernel
 		bool has_error_impl() const override { return false; }
 		bool has_hungup_impl() const override;
 
+		void on_close(int) override;
+
 	private:
 		enum class State
 		{
@@ -99,6 +108,28 @@ namespace Kernel
 
 			uint8_t  scale_shift    { 0 }; // window scale
 			BAN::UniqPtr<ByteRingBuffer> buffer;
+
+			// out of order data is stored in the free space after buffered data,
+			// these are the received ranges sorted by sequence number
+			BAN::Array<TCPSackBlock, 4> ooo_blocks;
+			size_t   ooo_block_count { 0 };
+			uint32_t ooo_recent_seq  { 0 }; // sequence number in most recently updated block
+
+			// buffer is grown to twice the data consumed per round trip, disabled by SO_RCVBUF
+			bool     autotune        { true };
+			bool     rtt_measuring   { false };
+			uint32_t rtt_seq         { 0 }; // edge of the advertised window when measurement started
+			uint64_t rtt_start_ms    { 0 };
+			uint32_t rtt_ms          { 0 }; // round trip time estimate, 0 if not measured yet
+			uint32_t space_seq       { 0 }; // start_seq at the start of current measurement
+			uint64_t space_start_ms  { 0 };
+		};
+
+		enum class CongestionState
+		{
+			Open,
+			Recovery, // fast recovery after duplicate ACKs
+			Loss,     // slow start after retransmission timeout
 		};
 
 		struct SendWindowInfo
@@ -112,13 +143,41 @@ namespace Kernel
 			uint32_t current_seq     { 0 }; // sequence number of next send
 			uint32_t current_ack     { 0 }; // sequence number aknowledged by connection
 
-			uint64_t last_send_ms    { 0 }; // last send time, used for retransmission timeout
+			uint32_t max_seq         { 0 }; // highest sequence number sent so far
 
 			bool     has_ghost_byte  { false };
 			bool     had_zero_window { false };
 
 			uint32_t sent_size       { 0 }; // number of bytes in this buffer that have been sent
 			BAN::UniqPtr<ByteRingBuffer> buffer;
+			bool     space_reserved  { false }; // sendfile is filling free space without holding the mutex
+
+			// retransmission timer, https://www.rfc-editor.org/rfc/rfc6298
+			uint64_t rto_start_ms    { 0 }; // start of the current retransmission timer
+			uint32_t rto_ms          { 0 };
+			uint32_t srtt_us         { 0 }; // smoothed round trip time, 0 if not measured yet
+			uint32_t rttvar_us       { 0 }; // round trip time variation
+			uint8_t  rto_backoff     { 0 }; // consecutive retransmission timeouts
+			bool     rtt_timing      { false };
+			uint32_t rtt_seq         { 0 }; // sample is taken when this is acknowledged
+			uint64_t rtt_start_ns    { 0 };
+
+			// NewReno congestion control, https://www.rfc-editor.org/rfc/rfc5681 and rfc6582
+			CongestionState cc_state { CongestionState::Open };
+			uint32_t cwnd            { 0 }; // congestion window
+			uint32_t ssthresh        { 0xFFFFFFFF };
+			uint32_t recover_seq     { 0 }; // recovery ends when this is acknowledged
+			uint32_t dup_acks        { 0 };
+			uint32_t retransmit_seq  { 0 }; // lost segments below this have already been retransmitted in recovery
+			uint32_t retransmit_pending { 0 }; // number of lost segments to retransmit
+			uint32_t total_retransmits { 0 };
+
+			// ranges acknowledged with SACK above current_ack, sorted by sequence number
+			BAN::Array<TCPSackBlock, 4> sack_blocks;
+			size_t   sack_block_count { 0 };
+
+			// buffer is grown to twice the usable window, disabled by SO_SNDBUF
+			bool     autotune        { true };
 		};
 
 		struct ConnectionInfo
@@ -126,6 +185,7 @@ namespace Kernel
 			sockaddr_storage	address;
 			socklen_t			address_len;
 			bool				has_window_scale;
+			bool				has_sack;
 		};
 
 		struct PendingConnection
@@ -153,7 +213,30 @@ namespace Kernel
 
 	private:
 		TCPSocket(NetworkLayer&, const Info&);
-		void process_task();
+
+		// called by the TCP engine, returns time when this should be called again
+		// or an empty optional if the connection is closed
+		BAN::Optional<uint64_t> process_work();
+
+		size_t tcp_options_size() const;
+		uint16_t interface_mss(const sockaddr*, socklen_t);
+
+		BAN::ErrorOr<void> resize_recv_buffer(size_t capacity);
+		BAN::ErrorOr<void> resize_send_buffer(size_t capacity);
+		void autotune_recv_buffer();
+		void autotune_send_buffer();
+
+		void handle_ack(const TCPHeader&, size_t payload_size, uint16_t old_window_size);
+		void update_rto(uint32_t rtt_us);
+		void on_retransmission_timeout();
+		BAN::ErrorOr<void> send_segment(size_t offset, size_t size);
+		bool send_new_data();
+		void retransmit_lost_segments();
+
+		bool store_out_of_order_data(uint32_t seq_number, BAN::ConstByteSpan payload);
+		bool merge_out_of_order_data();
+
+		BAN::ErrorOr<void> get_tcp_info(void* value, socklen_t* value_len);
 
 		void start_close_sequence();
 		void set_connection_as_closed();
@@ -170,7 +253,10 @@ namespace Kernel
 
 		size_t m_last_sent_window_size { 0 };
 
-		Thread* m_thread { nullptr };
+		TCPEngineNode m_engine_node;
+		bool m_connection_closed { false };
+		// a file descriptor was closed, check for the last reference soon
+		bool m_close_pending { false };
 
 		// TODO: actually support these
 		bool m_keep_alive { false };
@@ -181,6 +267,10 @@ namespace Kernel
 
 		uint64_t m_time_wait_start_ms { 0 };
 
+		// received segments that have not been acknowledged yet
+		uint8_t m_unacked_segments { 0 };
+		uint64_t m_delayed_ack_ms { 0 };
+
 		mutable Mutex m_mutex;
 		ThreadBlocker m_thread_blocker;
 
@@ -197,6 +287,7 @@ namespace Kernel
 		BAN::HashMap<ListenKey, BAN::RefPtr<TCPSocket>, ListenKeyHash> m_listen_children;
 
 		friend class BAN::RefPtr<TCPSocket>;
+		friend class TCPEngine;
 	};
 
 }
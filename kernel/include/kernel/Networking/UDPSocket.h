@@ -28,7 +28,7 @@ namespace Kernel
 		NetworkProtocol protocol() const override { return NetworkProtocol::UDP; }
 
 		size_t protocol_header_size() const override { return sizeof(UDPHeader); }
-		void get_protocol_header(BAN::ByteSpan header, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader) override;
+		void get_protocol_header(BAN::ByteSpan header, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader, bool checksum_offload) override;
 
 	protected:
 		void receive_packet(BAN::ConstByteSpan, const sockaddr* sender, socklen_t sender_len) override;
@@ -52,12 +52,17 @@ namespace Kernel
 
 		BAN::ErrorOr<size_t> read(int fd, BAN::ByteSpan);
 		BAN::ErrorOr<size_t> write(int fd, BAN::ConstByteSpan);
+		BAN::ErrorOr<size_t> readv(int fd, BAN::Span<const iovec>);
+		BAN::ErrorOr<size_t> writev(int fd, BAN::Span<const iovec>);
 
 		BAN::ErrorOr<size_t> read_dir_entries(int fd, struct dirent* list, size_t list_len);
 
 		BAN::ErrorOr<size_t> recvmsg(int socket, msghdr& message, int flags);
 		BAN::ErrorOr<size_t> sendmsg(int socket, const msghdr& message, int flags);
 
+		// if offset is null, file offset of in_fd is used and updated
+		BAN::ErrorOr<size_t> sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
 		int get_max_open_fd() const;
 
 		BAN::ErrorOr<VirtualFileSystem::File> file_of(int) const;
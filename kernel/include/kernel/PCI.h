@@ -4,6 +4,7 @@
 #include <BAN/Vector.h>
 #include <kernel/ACPI/AML/Node.h>
 #include <kernel/Memory/Types.h>
+#include <kernel/ProcessorID.h>
 #include <kernel/Storage/StorageController.h>
 
 #include <sys/types.h>
@@ -98,7 +99,7 @@ namespace Kernel::PCI
 
 		uint8_t get_interrupt(uint8_t index) const;
 		BAN::ErrorOr<void> reserve_interrupts(uint8_t count);
-		void enable_interrupt(uint8_t index, Interruptable&);
+		void enable_interrupt(uint8_t index, Interruptable&, ProcessorID target = PROCESSOR_NONE);
 
 		InterruptMechanism interrupt_mechanism() const { return m_interrupt_mechanism; }
 
@@ -175,6 +176,7 @@ namespace Kernel::PCI
 		void write_config_byte(uint8_t bus, uint8_t dev, uint8_t func, uint8_t offset, uint8_t value);
 
 		BAN::Optional<uint8_t> reserve_msi();
+		void release_msi(uint8_t irq);
 
 	private:
 		struct PCIeInfo
@@ -119,6 +119,11 @@ namespace Kernel
 		BAN::ErrorOr<long> sys_pread(int fd, void* buffer, size_t count, off_t offset);
 		BAN::ErrorOr<long> sys_pwrite(int fd, const void* buffer, size_t count, off_t offset);
 
+		BAN::ErrorOr<long> sys_readv(int fd, const iovec* iov, int iovcnt);
+		BAN::ErrorOr<long> sys_writev(int fd, const iovec* iov, int iovcnt);
+		BAN::ErrorOr<long> sys_preadv(int fd, const iovec* iov, int iovcnt, off_t offset);
+		BAN::ErrorOr<long> sys_pwritev(int fd, const iovec* iov, int iovcnt, off_t offset);
+
 		BAN::ErrorOr<long> sys_fchmodat(int fd, const char* path, mode_t mode, int flag);
 		BAN::ErrorOr<long> sys_fchownat(int fd, const char* path, uid_t uid, gid_t gid, int flag);
 		BAN::ErrorOr<long> sys_utimensat(int fd, const char* path, const struct timespec times[2], int flag);
@@ -136,6 +141,7 @@ namespace Kernel
 		BAN::ErrorOr<long> sys_listen(int socket, int backlog);
 		BAN::ErrorOr<long> sys_recvmsg(int socket, msghdr* message, int flags);
 		BAN::ErrorOr<long> sys_sendmsg(int socket, const msghdr* message, int flags);
+		BAN::ErrorOr<long> sys_sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
 
 		BAN::ErrorOr<long> sys_ioctl(int fildes, int request, void* arg);
 
@@ -219,6 +225,11 @@ namespace Kernel
 
 		BAN::ErrorOr<long> sys_clock_gettime(clockid_t, timespec*);
 
+		BAN::ErrorOr<long> sys_getpriority(int which, id_t who);
+		BAN::ErrorOr<long> sys_setpriority(int which, id_t who, int value);
+		BAN::ErrorOr<long> sys_sched_getaffinity(pid_t tid, size_t cpusetsize, cpu_set_t* mask);
+		BAN::ErrorOr<long> sys_sched_setaffinity(pid_t tid, size_t cpusetsize, const cpu_set_t* mask);
+
 		BAN::ErrorOr<long> sys_load_keymap(const char* path);
 
 		BAN::ErrorOr<long> sys_banos_install(const char* object);
@@ -227,6 +238,8 @@ namespace Kernel
 
 		static Process& current() { return Thread::current().process(); }
 
+		int nice() const { return m_nice; }
+
 		vaddr_t shared_page_vaddr() const { return m_shared_page_vaddr; }
 
 		PageTable& page_table() { return m_page_table ? *m_page_table : PageTable::kernel(); }
@@ -251,6 +264,7 @@ namespace Kernel
 
 		// ONLY CALLED BY TIMER INTERRUPT
 		static void update_alarm_queue();
+		static uint64_t next_alarm_wake_time_ns();
 
 		const VirtualFileSystem::File& working_directory() const { return m_working_directory; }
 		const VirtualFileSystem::File& root_file() const { return m_root_file; }
@@ -287,6 +301,8 @@ namespace Kernel
 		BAN::ErrorOr<VirtualFileSystem::File> find_relative_parent(int fd, const char* path) const;
 
 		BAN::ErrorOr<MemoryRegion*> validate_and_pin_pointer_access(const void*, size_t, bool needs_write);
+		// copies iovec array to kernel memory and pins all of its buffers, regions must be unpinned by caller
+		BAN::ErrorOr<void> read_and_pin_iovec(const iovec* user_iov, int iovcnt, bool needs_write, BAN::Vector<iovec>& iov, BAN::Vector<MemoryRegion*>& regions);
 
 		uint64_t signal_pending_mask() const
 		{
@@ -341,6 +357,7 @@ namespace Kernel
 		mutable Mutex m_process_lock;
 
 		BAN::Atomic<bool> m_stopped { false };
+		BAN::Atomic<int8_t> m_nice { 0 };
 		ThreadBlocker m_stop_blocker;
 
 		VirtualFileSystem::File m_working_directory;
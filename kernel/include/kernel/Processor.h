@@ -43,6 +43,8 @@ namespace Kernel
 				FlushTLB,
 				NewThread,
 				UnblockThread,
+				StealThread,
+				RearmTimer,
 				UpdateTSC,
 				StackTrace,
 			};
@@ -53,6 +55,8 @@ namespace Kernel
 				TLBEntry flush_tlb;
 				SchedulerQueue::Node* new_thread;
 				SchedulerQueue::Node* unblock_thread;
+				// index of the idle processor asking for work
+				uint8_t steal_thread;
 				bool dummy;
 			};
 		};
@@ -23,18 +23,46 @@ namespace Kernel
 
 	public:
 		void add_thread_to_back(Node*);
-		void add_thread_with_wake_time(Node*);
+		void add_thread_with_vruntime(Node*);
 		template<typename F>
 		Node* remove_with_condition(F callback);
 		void remove_node(Node*);
 		Node* front();
+		Node* back();
 		Node* pop_front();
 
 		bool empty() const { return m_head == nullptr; }
+		size_t size() const { return m_size; }
+
+	private:
+		void insert_before(Node* next, Node*);
 
 	private:
 		Node* m_head { nullptr };
 		Node* m_tail { nullptr };
+		size_t m_size { 0 };
+	};
+
+	// threads with a wake time, ordered by it. pairing heap gives
+	// O(1) insert and amortized O(log n) removal without allocations
+	class SchedulerSleepQueue
+	{
+	public:
+		using Node = SchedulerQueueNode;
+
+	public:
+		void add_thread(Node*);
+		void remove_node(Node*);
+		Node* front() { return m_root; }
+
+		bool empty() const { return m_root == nullptr; }
+
+	private:
+		static Node* meld(Node*, Node*);
+		static Node* merge_pairs(Node*);
+
+	private:
+		Node* m_root { nullptr };
 	};
 
 	class Scheduler
@@ -58,10 +86,14 @@ namespace Kernel
 		BAN::ErrorOr<void> initialize();
 
 		void reschedule(YieldRegisters*);
-		void reschedule_if_idle();
+		// called at the end of interrupts, switches away from idle or a preempted thread
+		void reschedule_if_needed();
 
 		void timer_interrupt();
 
+		// programs the one-shot timer for the next event on this processor
+		void update_timer_deadline();
+
 		static BAN::ErrorOr<void> bind_thread_to_processor(Thread*, ProcessorID);
 		// if thread is already bound, this will never fail
 		BAN::ErrorOr<void> add_thread(Thread*);
@@ -69,6 +101,9 @@ namespace Kernel
 		void block_current_thread(ThreadBlocker* thread_blocker, uint64_t wake_time_ns, BaseMutex* mutex);
 		void unblock_thread(Thread*);
 
+		// another processor is idle and asks for a runnable thread
+		bool handle_steal_request(uint8_t requester_index);
+
 		Thread& current_thread();
 		Thread& idle_thread();
 
@@ -82,11 +117,26 @@ namespace Kernel
 		void update_most_loaded_node_queue(SchedulerQueue::Node*, SchedulerQueue* target_queue);
 		void remove_node_from_most_loaded(SchedulerQueue::Node*);
 
+		void add_blocked_thread(SchedulerQueue::Node*);
+		void remove_blocked_thread(SchedulerQueue::Node*);
 		void wake_up_sleeping_threads();
 
+		void update_current_runtime(uint64_t current_ns);
+		void update_min_vruntime();
+		uint64_t current_time_slice_ns() const;
+		void add_runnable_thread(SchedulerQueue::Node*, bool is_wakeup);
+		void update_runnable_count();
+
+		bool should_switch_thread(uint64_t current_ns);
+
+		void try_steal_thread(uint64_t current_ns);
+		void push_to_idle_processor();
+		void migrate_thread(SchedulerQueue::Node*, SchedulerQueue&, ProcessorID);
+
 		void do_load_balancing();
 
-		class ProcessorID find_least_loaded_processor() const;
+		// returns PROCESSOR_NONE if thread's affinity does not allow any processor
+		ProcessorID find_least_loaded_processor(const SchedulerQueue::Node*) const;
 
 		void add_thread(SchedulerQueue::Node*);
 		void unblock_thread(SchedulerQueue::Node*);
@@ -94,6 +144,7 @@ namespace Kernel
 	private:
 		SchedulerQueue m_run_queue;
 		SchedulerQueue m_block_queue;
+		SchedulerSleepQueue m_sleep_queue;
 		SchedulerQueue::Node* m_current { nullptr };
 
 		uint32_t m_thread_count { 0 };
@@ -101,8 +152,15 @@ namespace Kernel
 		InterruptStack* m_interrupt_stack { nullptr };
 		InterruptRegisters* m_interrupt_registers { nullptr };
 
-		uint64_t m_next_reschedule_ns { 0 };
+		uint64_t m_slice_start_ns { 0 };
+		uint64_t m_min_vruntime_ns { 0 };
+		bool m_should_preempt { false };
+
+		bool m_is_tickless { false };
+		uint64_t m_timer_deadline_ns { 0 };
+
 		uint64_t m_last_load_balance_ns { 0 };
+		uint64_t m_last_steal_request_ns { 0 };
 
 		struct ThreadInfo
 		{
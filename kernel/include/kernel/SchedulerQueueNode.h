@@ -22,6 +22,12 @@ namespace Kernel
 
 		uint64_t wake_time_ns { static_cast<uint64_t>(-1) };
 
+		// pairing heap links for sleeping threads, sleep_prev is parent for the first child
+		SchedulerQueueNode* sleep_child   { nullptr };
+		SchedulerQueueNode* sleep_sibling { nullptr };
+		SchedulerQueueNode* sleep_prev    { nullptr };
+		bool in_sleep_queue { false };
+
 		BAN::Atomic<ThreadBlocker*> blocker { nullptr };
 		SchedulerQueueNode* block_chain_prev { nullptr };
 		SchedulerQueueNode* block_chain_next { nullptr };
@@ -31,6 +37,10 @@ namespace Kernel
 
 		uint64_t last_start_ns { 0 };
 		uint64_t time_used_ns  { 0 };
+
+		// weighted run time, run queue is ordered by this
+		// NOTE: relative to the owning scheduler's minimum vruntime while being migrated
+		uint64_t vruntime_ns   { 0 };
 	};
 
 }
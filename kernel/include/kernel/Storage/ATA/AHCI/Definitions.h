@@ -12,6 +12,7 @@
 #define FIS_TYPE_SET_DEVIVE_BITS	0xA1
 
 #define SATA_CAP_SUPPORTS64	(1 << 31)
+#define SATA_CAP_SUPPORTS_NCQ	(1 << 30)
 
 #define SATA_GHC_AHCI_ENABLE		(1 << 31)
 #define SATA_GHC_INTERRUPT_ENABLE	(1 << 1)
@@ -29,6 +30,12 @@
 #define HBA_PxCMD_FR	0x4000
 #define HBA_PxCMD_CR	0x8000
 
+#define HBA_PxIS_TFES	(1 << 30)	// Task file error
+#define HBA_PxIS_HBFS	(1 << 29)	// Host bus fatal error
+#define HBA_PxIS_HBDS	(1 << 28)	// Host bus data error
+#define HBA_PxIS_IFS	(1 << 27)	// Interface fatal error
+#define HBA_PxIS_ERROR_MASK	(HBA_PxIS_TFES | HBA_PxIS_HBFS | HBA_PxIS_HBDS | HBA_PxIS_IFS)
+
 namespace Kernel
 {
 
@@ -26,25 +26,43 @@ namespace Kernel
 
 		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) override;
 		virtual BAN::ErrorOr<void> write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan) override;
-		BAN::ErrorOr<void> send_command_and_block(uint64_t lba, uint64_t sector_count, Command command);
 
-		BAN::Optional<uint32_t> find_free_command_slot();
+		// Splits the transfer over as many command slots as are available and
+		// waits for all of them. For writes buffer is only read from.
+		BAN::ErrorOr<void> send_commands_and_block(uint64_t lba, uint64_t sector_count, Command command, uint8_t* buffer);
+		void issue_command(uint32_t command_slot, uint64_t lba, uint64_t sector_count, Command command);
+
+		uint32_t reserve_command_slot();
+		BAN::Optional<uint32_t> try_reserve_command_slot();
+		void release_command_slot(uint32_t command_slot);
+		void* command_slot_buffer(uint32_t command_slot) const;
 
 		void handle_irq();
+		void restart_port();
 
 		BAN::ErrorOr<void> block_until_command_completed(uint32_t command_slot);
 
 	private:
-		Mutex m_mutex;
+		static constexpr size_t s_slot_buffer_size = PAGE_SIZE;
 
 		BAN::RefPtr<AHCIController> m_controller;
 		volatile HBAPortMemorySpace* const m_port;
 
 		BAN::UniqPtr<DMARegion> m_dma_region;
-		// Intermediate read/write buffer
+		// Intermediate read/write buffer, s_slot_buffer_size bytes per command slot
 		// TODO: can we read straight to user buffer?
 		BAN::UniqPtr<DMARegion> m_data_dma_region;
 
+		bool m_use_ncq { false };
+		uint32_t m_queue_depth { 1 };
+
+		SpinLock m_slot_lock;
+		uint32_t m_reserved_slots { 0 };
+		uint32_t m_issued_slots { 0 };
+		uint32_t m_failed_slots { 0 };
+		ThreadBlocker m_slot_blockers[32];
+		ThreadBlocker m_free_slot_blocker;
+
 		friend class AHCIController;
 	};
 
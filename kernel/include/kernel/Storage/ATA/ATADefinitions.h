@@ -40,6 +40,8 @@
 #define ATA_COMMAND_WRITE_SECTORS	0x30
 #define ATA_COMMAND_WRITE_DMA		0xCA
 #define ATA_COMMAND_WRITE_DMA_EXT	0x35
+#define ATA_COMMAND_READ_FPDMA_QUEUED	0x60
+#define ATA_COMMAND_WRITE_FPDMA_QUEUED	0x61
 #define ATA_COMMAND_IDENTIFY_PACKET	0xA1
 #define ATA_COMMAND_CACHE_FLUSH		0xE7
 #define ATA_COMMAND_IDENTIFY		0xEC
@@ -48,6 +50,8 @@
 #define ATA_IDENTIFY_MODEL			27
 #define ATA_IDENTIFY_CAPABILITIES	49
 #define ATA_IDENTIFY_LBA_COUNT		60
+#define ATA_IDENTIFY_QUEUE_DEPTH	75
+#define ATA_IDENTIFY_SATA_CAPABILITIES	76
 #define ATA_IDENTIFY_COMMAND_SET	82
 #define ATA_IDENTIFY_LBA_COUNT_EXT	100
 #define ATA_IDENTIFY_SECTOR_INFO	106
@@ -57,3 +61,5 @@
 
 #define ATA_CAPABILITIES_LBA (1 << 9)
 #define ATA_CAPABILITIES_DMA (1 << 8)
+
+#define ATA_SATA_CAPABILITIES_NCQ (1 << 8)
@@ -2,6 +2,7 @@
 
 #include <BAN/Array.h>
 #include <BAN/ByteSpan.h>
+#include <BAN/HashMap.h>
 #include <BAN/Vector.h>
 #include <kernel/Lock/RWLock.h>
 #include <kernel/Memory/Types.h>
@@ -13,12 +14,26 @@ namespace Kernel
 
 	class DiskCache
 	{
+	public:
+		struct Stats
+		{
+			size_t pages;
+			size_t dirty_pages;
+			size_t hits;
+			size_t misses;
+			size_t evictions;
+		};
+
 	public:
 		DiskCache(size_t sector_size, StorageDevice&);
 		~DiskCache();
 
-		bool read_from_cache(uint64_t sector, BAN::ByteSpan);
-		BAN::ErrorOr<void> write_to_cache(uint64_t sector, BAN::ConstByteSpan, bool dirty);
+		// Copies cached sectors of [sector, sector + sector_count) to buffer.
+		// Returns bitmask of the sectors found, so sector_count must be at most 64.
+		uint64_t read_from_cache(uint64_t sector, size_t sector_count, BAN::ByteSpan);
+		BAN::ErrorOr<void> write_to_cache(uint64_t sector, size_t sector_count, BAN::ConstByteSpan, bool dirty);
+		// Same as write_to_cache but leaves already cached sectors untouched
+		BAN::ErrorOr<void> fill_cache(uint64_t sector, size_t sector_count, BAN::ConstByteSpan);
 
 		BAN::ErrorOr<void> sync();
 		BAN::ErrorOr<void> sync(uint64_t sector, size_t sector_count);
@@ -26,10 +41,7 @@ namespace Kernel
 		size_t release_pages(size_t);
 		void release_all_pages();
 
-	private:
-		BAN::ErrorOr<void> sync_cache_index(size_t index);
-
-		size_t find_sector_cache_index(uint64_t sector) const;
+		Stats stats() const;
 
 	private:
 		struct PageCache
@@ -39,16 +51,46 @@ namespace Kernel
 			uint8_t sector_mask { 0 };
 			uint8_t dirty_mask { 0 };
 			bool syncing { false };
+
+			// set on every access, cleared when the page gets a second chance in reclaim
+			BAN::Atomic<bool> referenced { false };
+
+			// reclaim list, ordered from oldest to newest
+			PageCache* prev { nullptr };
+			PageCache* next { nullptr };
 		};
 
 	private:
-		RWLock m_rw_lock;
+		static constexpr size_t max_sync_pages = 16;
+
+		BAN::ErrorOr<void> write_to_cache_impl(uint64_t sector, size_t sector_count, BAN::ConstByteSpan, bool dirty, bool overwrite);
+
+		BAN::ErrorOr<void> sync_pages(BAN::Vector<uint64_t>& first_sectors);
+		BAN::ErrorOr<void> sync_page_run(uint64_t first_sector, size_t page_count);
+
+		uint64_t page_first_sector(uint64_t sector) const { return sector - sector % (PAGE_SIZE / m_sector_size); }
+
+		PageCache* find_page(uint64_t first_sector) const;
+		BAN::ErrorOr<PageCache*> find_or_create_page(uint64_t first_sector);
+		void remove_page(PageCache*);
+
+		void reclaim_list_append(PageCache*);
+		void reclaim_list_remove(PageCache*);
+
+	private:
+		mutable RWLock m_rw_lock;
 		Mutex m_sync_mutex;
 
 		const size_t m_sector_size;
 		StorageDevice& m_device;
-		BAN::Vector<PageCache> m_cache;
-		BAN::Array<uint8_t, PAGE_SIZE> m_sync_cache;
+		BAN::HashMap<uint64_t, PageCache*> m_cache;
+		PageCache* m_reclaim_head { nullptr };
+		PageCache* m_reclaim_tail { nullptr };
+		BAN::Vector<uint8_t> m_sync_buffer;
+
+		BAN::Atomic<size_t> m_hits { 0 };
+		BAN::Atomic<size_t> m_misses { 0 };
+		BAN::Atomic<size_t> m_evictions { 0 };
 	};
 
 }
@@ -18,7 +18,9 @@ namespace Kernel
 	public:
 		static BAN::ErrorOr<BAN::RefPtr<StorageController>> create(PCI::Device&);
 
-		NVMeQueue& io_queue() { return *m_io_queue; }
+		// returns the io queue assigned to current processor
+		NVMeQueue& io_queue();
+		size_t max_transfer_bytes() const { return m_max_transfer_bytes; }
 
 		virtual BAN::StringView name() const override { return m_name; }
 
@@ -37,7 +39,8 @@ namespace Kernel
 
 		BAN::ErrorOr<void> wait_until_ready(bool expected_value);
 		BAN::ErrorOr<void> create_admin_queue();
-		BAN::ErrorOr<void> create_io_queue();
+		BAN::ErrorOr<uint32_t> request_io_queue_count(uint32_t count);
+		BAN::ErrorOr<void> create_io_queue(uint16_t qid, ProcessorID target);
 
 	private:
 		PCI::Device& m_pci_device;
@@ -45,7 +48,8 @@ namespace Kernel
 		volatile NVMe::ControllerRegisters* m_controller_registers;
 
 		BAN::UniqPtr<NVMeQueue> m_admin_queue;
-		BAN::UniqPtr<NVMeQueue> m_io_queue;
+		BAN::Vector<BAN::UniqPtr<NVMeQueue>> m_io_queues;
+		size_t m_max_transfer_bytes { 0 };
 
 		BAN::Vector<BAN::RefPtr<NVMeNamespace>> m_namespaces;
 
@@ -105,7 +105,10 @@ namespace Kernel::NVMe
 
 	struct CompletionQueueEntry
 	{
-		uint32_t dontcare[3];
+		uint32_t dw0;
+		uint32_t dw1;
+		uint16_t sqhd;
+		uint16_t sqid;
 		uint16_t cid;
 		uint16_t sts;
 	} __attribute__((packed));
@@ -237,6 +240,7 @@ namespace Kernel::NVMe
 		OPC_ADMIN_CREATE_SQ = 0x01,
 		OPC_ADMIN_CREATE_CQ = 0x05,
 		OPC_ADMIN_IDENTIFY = 0x06,
+		OPC_ADMIN_SET_FEATURES = 0x09,
 		OPC_IO_WRITE = 0x01,
 		OPC_IO_READ = 0x02,
 	};
@@ -248,6 +252,11 @@ namespace Kernel::NVMe
 		CNS_INDENTIFY_ACTIVE_NAMESPACES = 0x02,
 	};
 
+	enum FID : uint8_t
+	{
+		FID_NUMBER_OF_QUEUES = 0x07,
+	};
+
 	struct NamespaceIdentify
 	{
 		uint64_t nsze;
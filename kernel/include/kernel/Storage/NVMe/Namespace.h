@@ -27,7 +27,6 @@ namespace Kernel
 
 	private:
 		NVMeController& m_controller;
-		BAN::UniqPtr<DMARegion> m_dma_region;
 
 		const uint32_t m_nsid;
 		const uint32_t m_block_size;
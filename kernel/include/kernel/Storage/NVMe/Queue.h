@@ -15,7 +15,16 @@ namespace Kernel
 	public:
 		NVMeQueue(BAN::UniqPtr<Kernel::DMARegion>&& cq, BAN::UniqPtr<Kernel::DMARegion>&& sq, volatile NVMe::DoorbellRegisters& db, uint32_t qdepth);
 
-		uint16_t submit_command(NVMe::SubmissionQueueEntry& sqe);
+		uint16_t submit_command(NVMe::SubmissionQueueEntry& sqe, uint32_t* result = nullptr);
+
+		BAN::ErrorOr<void> initialize_bounce_buffers(size_t count, size_t pages);
+		size_t bounce_buffer_size() const { return m_bounce_buffer_pages * PAGE_SIZE; }
+
+		// blocks until a bounce buffer is available
+		size_t reserve_bounce_buffer();
+		void release_bounce_buffer(size_t index);
+		void* bounce_buffer(size_t index) const;
+		NVMe::DataPtr data_pointer(size_t index, size_t bytes) const;
 
 		virtual void handle_irq() final override;
 
@@ -36,6 +45,15 @@ namespace Kernel
 		BAN::Atomic<size_t> m_used_mask			{ 0 };
 		BAN::Atomic<size_t> m_done_mask			{ 0 };
 		volatile uint16_t   m_status_codes[64]	{ };
+		volatile uint32_t   m_results[64]		{ };
+
+		BAN::UniqPtr<Kernel::DMARegion> m_bounce_buffers;
+		BAN::UniqPtr<Kernel::DMARegion> m_prp_lists;
+		size_t                          m_bounce_buffer_pages { 0 };
+		size_t                          m_bounce_buffer_count { 0 };
+		size_t                          m_bounce_used_mask    { 0 };
+		SpinLock                        m_bounce_lock;
+		ThreadBlocker                   m_bounce_blocker;
 
 		static constexpr size_t m_mask_bits = sizeof(size_t) * 8;
 	};
@@ -38,6 +38,14 @@ namespace Kernel
 
 		size_t drop_disk_cache();
 		BAN::ErrorOr<void> sync_disk_cache();
+		BAN::Optional<DiskCache::Stats> disk_cache_stats() const;
+
+	private:
+		BAN::ErrorOr<void> read_sectors_cached(uint64_t lba, size_t sector_count, BAN::ByteSpan);
+
+		void update_readahead(uint64_t lba, size_t sector_count);
+		void do_readahead(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer);
+		static void readahead_thread(void*);
 
 	protected:
 		virtual BAN::ErrorOr<void> read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan) = 0;
@@ -56,6 +64,11 @@ namespace Kernel
 		BAN::Optional<DiskCache>			m_disk_cache;
 		BAN::Vector<BAN::RefPtr<Partition>>	m_partitions;
 
+		SpinLock							m_readahead_lock;
+		uint64_t							m_sequential_next_lba { 0 };
+		uint64_t							m_readahead_end_lba { 0 };
+		size_t								m_readahead_pages { 0 };
+
 		friend class DiskCache;
 	};
 
@@ -10,6 +10,7 @@
 
 #include <LibELF/AuxiliaryVector.h>
 
+#include <sched.h>
 #include <signal.h>
 #include <sys/types.h>
 
@@ -122,6 +123,15 @@ namespace Kernel
 
 		bool is_userspace() const { return m_is_userspace; }
 
+		// userspace threads use their process' nice value
+		int nice() const;
+		void set_nice(int nice) { m_nice = BAN::Math::clamp(nice, -20, 19); }
+
+		// affinity is a mask of processor indices the thread may run on
+		bool can_run_on_processor(uint8_t processor_index) const;
+		void get_affinity(cpu_set_t&) const;
+		void set_affinity(const cpu_set_t&);
+
 		uint64_t cpu_time_ns() const;
 		void set_cpu_time_start();
 		void set_cpu_time_stop();
@@ -186,6 +196,8 @@ namespace Kernel
 		vaddr_t                    m_gsbase               { 0 };
 
 		SchedulerQueue::Node*      m_scheduler_node       { nullptr };
+		BAN::Atomic<int8_t>        m_nice                 { 0 };
+		unsigned long              m_affinity[CPU_SETSIZE / (8 * sizeof(unsigned long))];
 
 		YieldRegisters             m_yield_registers      { };
 
@@ -14,6 +14,8 @@ namespace Kernel
 		void block_with_timeout_ns(uint64_t timeout_ns, BaseMutex*);
 		void block_with_wake_time_ns(uint64_t wake_time_ns, BaseMutex*);
 		void unblock();
+		// returns false if there were no blocked threads
+		bool unblock_one();
 
 		void block_with_timeout_ms(uint64_t timeout_ms, BaseMutex* mutex)
 		{
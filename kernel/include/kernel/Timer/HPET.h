@@ -22,6 +22,8 @@ namespace Kernel
 		virtual bool pre_scheduler_sleep_needs_lock() const override { return false; }
 		virtual void pre_scheduler_sleep_ns(uint64_t) override;
 
+		virtual uint32_t reduce_tick_rate() override;
+
 		virtual void handle_irq() override;
 
 	private:
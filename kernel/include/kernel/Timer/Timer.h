@@ -20,6 +20,10 @@ namespace Kernel
 		virtual bool pre_scheduler_sleep_needs_lock() const = 0;
 		virtual void pre_scheduler_sleep_ns(uint64_t) = 0;
 
+		// called when scheduler no longer depends on this timer's interrupts,
+		// returns the new tick interval in milliseconds
+		virtual uint32_t reduce_tick_rate() { return 1; }
+
 	protected:
 		bool should_invoke_scheduler() const { return m_should_invoke_scheduler; }
 
@@ -47,7 +51,7 @@ namespace Kernel
 		void sleep_ms(uint64_t ms) const { ASSERT(!BAN::Math::will_multiplication_overflow<uint64_t>(ms, 1'000'000)); return sleep_ns(ms * 1'000'000); }
 		void sleep_ns(uint64_t ns) const;
 
-		void dont_invoke_scheduler() { m_timer->m_should_invoke_scheduler = false; }
+		void dont_invoke_scheduler();
 
 		void update_tsc() const;
 		uint64_t ns_since_boot_no_tsc() const;
@@ -67,6 +71,7 @@ namespace Kernel
 		BAN::UniqPtr<Timer> m_timer;
 		bool m_has_invariant_tsc { false };
 		mutable uint32_t m_timer_ticks { 0 };
+		uint32_t m_ticks_per_tsc_update { 100 };
 	};
 
 }
@@ -437,8 +437,21 @@ namespace Kernel
 
 		dprintln("CPU {}: lapic timer frequency: {} Hz", Kernel::Processor::current_id(), m_lapic_timer_frequency_hz);
 
-		write_to_local_apic(LAPIC_TIMER_LVT,         TimerModePeriodic | IRQ_TIMER);
-		write_to_local_apic(LAPIC_TIMER_INITIAL_REG, m_lapic_timer_frequency_hz / 2 / 100);
+		// scheduler rearms the timer for its next deadline on every interrupt
+		write_to_local_apic(LAPIC_TIMER_LVT,         TimerModeOneShot | IRQ_TIMER);
+		set_timer_deadline_ns(10'000'000);
+	}
+
+	void APIC::set_timer_deadline_ns(uint64_t ns)
+	{
+		ASSERT(Kernel::Processor::get_interrupt_state() == InterruptState::Disabled);
+
+		// timer counts at half of the bus frequency
+		const uint64_t ticks_per_s = m_lapic_timer_frequency_hz / 2;
+		const uint64_t max_ns = static_cast<uint64_t>(0xFFFFFFFF) * 1'000'000'000 / ticks_per_s;
+		const uint64_t ticks = BAN::Math::min(ns, max_ns) * ticks_per_s / 1'000'000'000;
+
+		write_to_local_apic(LAPIC_TIMER_INITIAL_REG, BAN::Math::clamp<uint64_t>(ticks, 1, 0xFFFFFFFF));
 	}
 
 	uint32_t APIC::read_from_local_apic(ptrdiff_t offset)
@@ -94,6 +94,11 @@ namespace Kernel
 		return {};
 	}
 
+	bool FramebufferDevice::supports_direct_mapping() const
+	{
+		return m_bpp == BANAN_FB_BPP && (m_video_memory_paddr % PAGE_SIZE) == 0;
+	}
+
 	BAN::ErrorOr<size_t> FramebufferDevice::read_impl(off_t offset, BAN::ByteSpan buffer)
 	{
 		// Reading from negative offset will fill buffer with framebuffer info
@@ -105,6 +110,8 @@ namespace Kernel
 			auto& fb_info = buffer.as<framebuffer_info_t>();
 			fb_info.width = m_width;
 			fb_info.height = m_height;
+			fb_info.pitch = m_pitch;
+			fb_info.flags = supports_direct_mapping() ? FB_FLAG_DIRECT_MAP : 0;
 
 			return sizeof(framebuffer_info_t);
 		}
@@ -271,9 +278,9 @@ namespace Kernel
 	class FramebufferMemoryRegion : public MemoryRegion
 	{
 	public:
-		static BAN::ErrorOr<BAN::UniqPtr<FramebufferMemoryRegion>> create(PageTable& page_table, size_t size, AddressRange address_range, MemoryRegion::Type region_type, PageTable::flags_t page_flags, int status_flags, BAN::RefPtr<FramebufferDevice> framebuffer)
+		static BAN::ErrorOr<BAN::UniqPtr<FramebufferMemoryRegion>> create(PageTable& page_table, size_t size, AddressRange address_range, MemoryRegion::Type region_type, PageTable::flags_t page_flags, int status_flags, BAN::RefPtr<FramebufferDevice> framebuffer, bool direct)
 		{
-			auto* region_ptr = new FramebufferMemoryRegion(page_table, size, region_type, page_flags, status_flags, framebuffer);
+			auto* region_ptr = new FramebufferMemoryRegion(page_table, size, region_type, page_flags, status_flags, framebuffer, direct);
 			if (region_ptr == nullptr)
 				return BAN::Error::from_errno(ENOMEM);
 			auto region = BAN::UniqPtr<FramebufferMemoryRegion>::adopt(region_ptr);
@@ -285,6 +292,7 @@ namespace Kernel
 
 		~FramebufferMemoryRegion()
 		{
+			// NOTE: this also restores shadow buffer contents after direct mapping
 			m_framebuffer->sync_pixels_full();
 		}
 
@@ -292,6 +300,8 @@ namespace Kernel
 		{
 			if (flags != MS_SYNC)
 				return BAN::Error::from_errno(ENOTSUP);
+			if (m_direct)
+				return {};
 			if (vaddr % (BANAN_FB_BPP / 8))
 				return BAN::Error::from_errno(EINVAL);
 
@@ -313,7 +323,7 @@ namespace Kernel
 
 		BAN::ErrorOr<BAN::UniqPtr<MemoryRegion>> clone(PageTable& new_page_table) override
 		{
-			auto* region_ptr = new FramebufferMemoryRegion(new_page_table, m_size, m_type, m_flags, m_status_flags, m_framebuffer);
+			auto* region_ptr = new FramebufferMemoryRegion(new_page_table, m_size, m_type, m_flags, m_status_flags, m_framebuffer, m_direct);
 			if (region_ptr == nullptr)
 				return BAN::Error::from_errno(ENOMEM);
 			auto region = BAN::UniqPtr<FramebufferMemoryRegion>::adopt(region_ptr);
@@ -342,6 +352,13 @@ namespace Kernel
 			if (m_page_table.physical_address_of(vaddr))
 				return false;
 
+			if (m_direct)
+			{
+				const paddr_t paddr = m_framebuffer->m_video_memory_paddr + (vaddr - m_vaddr);
+				m_page_table.map_page_at(paddr, vaddr, m_flags, PageTable::WriteCombining);
+				return true;
+			}
+
 			paddr_t paddr = PageTable::kernel().physical_address_of(m_framebuffer->m_video_buffer->vaddr() + (vaddr - m_vaddr));
 			m_page_table.map_page_at(paddr, vaddr, m_flags);
 
@@ -349,9 +366,10 @@ namespace Kernel
 		}
 
 	private:
-		FramebufferMemoryRegion(PageTable& page_table, size_t size, MemoryRegion::Type region_type, PageTable::flags_t page_flags, int status_flags, BAN::RefPtr<FramebufferDevice> framebuffer)
+		FramebufferMemoryRegion(PageTable& page_table, size_t size, MemoryRegion::Type region_type, PageTable::flags_t page_flags, int status_flags, BAN::RefPtr<FramebufferDevice> framebuffer, bool direct)
 			: MemoryRegion(page_table, size, region_type, page_flags, status_flags)
 			, m_framebuffer(framebuffer)
+			, m_direct(direct)
 		{ }
 
 		void do_msync(uint32_t first_pixel, uint32_t pixel_count)
@@ -361,18 +379,35 @@ namespace Kernel
 
 	private:
 		BAN::RefPtr<FramebufferDevice> m_framebuffer;
+
+		// maps video memory instead of the shadow buffer
+		const bool m_direct;
 	};
 
 	BAN::ErrorOr<BAN::UniqPtr<MemoryRegion>> FramebufferDevice::mmap_region(PageTable& page_table, off_t offset, size_t len, AddressRange address_range, MemoryRegion::Type region_type, PageTable::flags_t page_flags, int status_flags)
 	{
-		if (offset != 0)
-			return BAN::Error::from_errno(EINVAL);
-		if (len > m_video_buffer->size())
-			return BAN::Error::from_errno(EINVAL);
 		if (region_type != MemoryRegion::Type::SHARED)
 			return BAN::Error::from_errno(EINVAL);
 
-		auto region = TRY(FramebufferMemoryRegion::create(page_table, len, address_range, region_type, page_flags, status_flags, this));
+		bool direct = false;
+		switch (offset)
+		{
+			case 0:
+				if (len > m_video_buffer->size())
+					return BAN::Error::from_errno(EINVAL);
+				break;
+			case BANAN_FB_DIRECT_OFFSET:
+				if (!supports_direct_mapping())
+					return BAN::Error::from_errno(ENOTSUP);
+				if (len > range_page_count(m_video_memory_paddr, m_height * m_pitch) * PAGE_SIZE)
+					return BAN::Error::from_errno(EINVAL);
+				direct = true;
+				break;
+			default:
+				return BAN::Error::from_errno(EINVAL);
+		}
+
+		auto region = TRY(FramebufferMemoryRegion::create(page_table, len, address_range, region_type, page_flags, status_flags, this, direct));
 		return BAN::UniqPtr<MemoryRegion>(BAN::move(region));
 	}
 
@@ -34,78 +34,170 @@ namespace Kernel
 
 	Epoll::~Epoll()
 	{
-		for (auto& [inode, _] : m_listening_events)
-			inode->del_epoll(this);
+		for (auto& [_, item] : m_items)
+		{
+			item->inode->del_epoll(item);
+			delete item;
+		}
+	}
+
+	void Epoll::add_to_ready_list(EpollItem* item, uint32_t events)
+	{
+		ASSERT(m_ready_lock.current_processor_has_lock());
+
+		item->ready_events |= events;
+		if (item->in_ready_list)
+			return;
+
+		item->ready_next = nullptr;
+		item->ready_prev = m_ready_tail;
+		if (m_ready_tail)
+			m_ready_tail->ready_next = item;
+		else
+			m_ready_head = item;
+		m_ready_tail = item;
+
+		item->in_ready_list = true;
+		m_ready_count++;
+	}
+
+	void Epoll::remove_from_ready_list(EpollItem* item)
+	{
+		ASSERT(m_ready_lock.current_processor_has_lock());
+
+		item->ready_events = 0;
+		if (!item->in_ready_list)
+			return;
+
+		if (item->ready_prev)
+			item->ready_prev->ready_next = item->ready_next;
+		else
+			m_ready_head = item->ready_next;
+		if (item->ready_next)
+			item->ready_next->ready_prev = item->ready_prev;
+		else
+			m_ready_tail = item->ready_prev;
+
+		item->ready_next = nullptr;
+		item->ready_prev = nullptr;
+
+		item->in_ready_list = false;
+		m_ready_count--;
+	}
+
+	void Epoll::update_listen_mask(EpollItem* item)
+	{
+		ASSERT(m_mutex.is_locked_by_current_thread());
+		ASSERT(m_ready_lock.current_processor_has_lock());
+
+		uint32_t listen_mask = 0;
+		for (const auto& [_, event] : item->events)
+			listen_mask |= event.events;
+		item->listen_mask = listen_mask & ~(EPOLLET | EPOLLONESHOT);
 	}
 
 	BAN::ErrorOr<void> Epoll::ctl(int op, int fd, BAN::RefPtr<Inode> inode, epoll_event event)
 	{
 		LockGuard _(m_mutex);
 
-		auto it = m_listening_events.find(inode);
+		auto it = m_items.find(inode.ptr());
+		auto* item = (it != m_items.end()) ? it->value : nullptr;
 
 		switch (op)
 		{
 			case EPOLL_CTL_ADD:
 			{
-				bool contains_inode = (it != m_listening_events.end());
-				if (!contains_inode)
-					it = TRY(m_listening_events.emplace(inode));
-				if (it->value.has_fd(fd))
-					return BAN::Error::from_errno(EEXIST);
+				const bool exclusive = (event.events & EPOLLEXCLUSIVE);
+				if (exclusive && (event.events & ~(EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET | EPOLLEXCLUSIVE)))
+					return BAN::Error::from_errno(EINVAL);
+				if (exclusive && inode->is_epoll())
+					return BAN::Error::from_errno(EINVAL);
 
+				if (item != nullptr)
 				{
-					SpinLockGuard _(m_ready_lock);
-					TRY(m_ready_events.reserve(m_listening_events.size()));
+					if (item->events.contains(fd))
+						return BAN::Error::from_errno(EEXIST);
+					// all fds of an inode share one registration
+					if (item->exclusive != exclusive)
+						return BAN::Error::from_errno(EINVAL);
 				}
-				TRY(m_processing_events.reserve(m_listening_events.size()));
 
-				if (!contains_inode)
-					TRY(inode->add_epoll(this));
-				TRY(it->value.add_fd(fd, event));
+				event.events = (event.events & ~EPOLLEXCLUSIVE) | EPOLLERR | EPOLLHUP;
+
+				if (item != nullptr)
+					TRY(item->events.insert(fd, event));
+				else
+				{
+					TRY(m_items.reserve(m_items.size() + 1));
+
+					item = new EpollItem(this, inode);
+					if (item == nullptr)
+						return BAN::Error::from_errno(ENOMEM);
+					item->exclusive = exclusive;
+
+					if (auto ret = item->events.insert(fd, event); ret.is_error())
+					{
+						delete item;
+						return ret.release_error();
+					}
+
+					MUST(m_items.insert(inode.ptr(), item));
+					inode->add_epoll(item);
+				}
 
 				SpinLockGuard _(m_ready_lock);
-				auto ready_it = m_ready_events.find(inode);
-				if (ready_it == m_ready_events.end())
-					ready_it = MUST(m_ready_events.insert(inode, 0));
-				ready_it->value |= event.events | EPOLLHUP | EPOLLERR;
-				m_thread_blocker.unblock();
+				update_listen_mask(item);
+				add_to_ready_list(item, item->listen_mask);
+				m_thread_blocker.unblock_one();
 
 				return {};
 			}
 			case EPOLL_CTL_MOD:
 			{
-				if (it == m_listening_events.end())
+				if (item == nullptr)
 					return BAN::Error::from_errno(ENOENT);
-				if (!it->value.has_fd(fd))
+				auto event_it = item->events.find(fd);
+				if (event_it == item->events.end())
 					return BAN::Error::from_errno(ENOENT);
+				if (item->exclusive || (event.events & EPOLLEXCLUSIVE))
+					return BAN::Error::from_errno(EINVAL);
 
-				it->value.events[fd] = event;
+				event.events |= EPOLLERR | EPOLLHUP;
+				event_it->value = event;
 
 				SpinLockGuard _(m_ready_lock);
-				auto ready_it = m_ready_events.find(inode);
-				if (ready_it == m_ready_events.end())
-					ready_it = MUST(m_ready_events.insert(inode, 0));
-				ready_it->value |= event.events | EPOLLHUP | EPOLLERR;
-				m_thread_blocker.unblock();
+				update_listen_mask(item);
+				add_to_ready_list(item, item->listen_mask);
+				m_thread_blocker.unblock_one();
 
 				return {};
 			}
 			case EPOLL_CTL_DEL:
 			{
-				if (it == m_listening_events.end())
+				if (item == nullptr)
 					return BAN::Error::from_errno(ENOENT);
-				if (!it->value.has_fd(fd))
+				if (!item->events.contains(fd))
 					return BAN::Error::from_errno(ENOENT);
-				it->value.remove_fd(fd);
-				if (it->value.empty())
+				item->events.remove(fd);
+
+				if (!item->events.empty())
+				{
+					SpinLockGuard _(m_ready_lock);
+					update_listen_mask(item);
+					return {};
+				}
+
+				// after this no one can notify the item anymore
+				inode->del_epoll(item);
+				m_items.remove(it);
+
 				{
-					inode->del_epoll(this);
-					m_listening_events.remove(it);
-					m_processing_events.remove(inode);
 					SpinLockGuard _(m_ready_lock);
-					m_ready_events.remove(inode);
+					remove_from_ready_list(item);
 				}
+
+				delete item;
+
 				return {};
 			}
 		}
@@ -125,54 +217,30 @@ namespace Kernel
 			{
 				LockGuard _(m_mutex);
 
+				// level triggered items get requeued at the end of the list,
+				// only go through the items that were ready when we started
+				size_t items_left;
 				{
 					SpinLockGuard _(m_ready_lock);
-
-					while (!m_ready_events.empty())
-					{
-						auto [inode, events] = *m_ready_events.begin();
-						m_ready_events.remove(m_ready_events.begin());
-
-						ASSERT(events);
-
-						if (auto it = m_processing_events.find(inode); it != m_processing_events.end())
-							it->value |= events;
-						else
-							MUST(m_processing_events.insert(inode, events));
-					}
+					items_left = m_ready_count;
 				}
 
-				for (auto it = m_processing_events.begin(); it != m_processing_events.end() && event_count < event_span.size();)
+				for (; items_left && event_count < event_span.size(); items_left--)
 				{
-					auto& [inode, events] = *it;
-
-#define REMOVE_IT() \
-					({ \
-						m_processing_events.remove(it); \
-						if (event_count > 0) \
-							break; \
-						it = m_processing_events.begin(); \
-						continue; \
-					})
-
-					auto listen_it = m_listening_events.find(inode);
-					if (listen_it == m_listening_events.end())
-						REMOVE_IT();
-					auto& listen = listen_it->value;
+					EpollItem* item;
+					uint32_t events;
 
 					{
-						uint32_t listen_mask = EPOLLHUP | EPOLLERR;
-						for (const auto& [_, events] : listen.events)
-							listen_mask |= events.events;
-						events &= listen_mask;
+						SpinLockGuard _(m_ready_lock);
+						if ((item = m_ready_head) == nullptr)
+							break;
+						events = item->ready_events & item->listen_mask;
+						remove_from_ready_list(item);
 					}
 
-					if (events == 0)
-						REMOVE_IT();
-
 					{
 #define CHECK_EVENT_BIT(mask, func) \
-						if ((events & mask) && !inode->func()) \
+						if ((events & mask) && !item->inode->func()) \
 							events &= ~mask;
 						CHECK_EVENT_BIT(EPOLLIN, can_read);
 						CHECK_EVENT_BIT(EPOLLOUT, can_write);
@@ -182,32 +250,45 @@ namespace Kernel
 					}
 
 					if (events == 0)
-						REMOVE_IT();
+						continue;
 
-#undef REMOVE_IT
+					uint32_t requeue_events = 0;
+					bool disabled_events = false;
 
-					for (auto& [_, listen_event] : listen.events)
+					for (auto& [_, listen_event] : item->events)
 					{
-						if (event_count >= event_span.size())
-							break;
-
-						const auto new_events = (listen_event.events | EPOLLHUP | EPOLLERR) & events;
+						const uint32_t new_events = listen_event.events & events;
 						if (new_events == 0)
 							continue;
 
+						if (event_count >= event_span.size())
+						{
+							requeue_events |= new_events;
+							continue;
+						}
+
 						event_span[event_count++] = {
 							.events = new_events,
 							.data = listen_event.data,
 						};
 
 						if (listen_event.events & EPOLLONESHOT)
-							listen_event.events = 0;
-						// this doesn't work with multiple of the same inode
-						if (listen_event.events & EPOLLET)
-							events &= ~new_events;
+						{
+							listen_event.events &= EPOLLET | EPOLLONESHOT;
+							disabled_events = true;
+						}
+						else if (!(listen_event.events & EPOLLET))
+							requeue_events |= new_events;
 					}
 
-					it++;
+					if (requeue_events || disabled_events)
+					{
+						SpinLockGuard _(m_ready_lock);
+						if (disabled_events)
+							update_listen_mask(item);
+						if (requeue_events)
+							add_to_ready_list(item, requeue_events);
+					}
 				}
 			}
 
@@ -219,28 +300,41 @@ namespace Kernel
 				break;
 
 			SpinLockGuard guard(m_ready_lock);
-			if (!m_ready_events.empty())
+			if (m_ready_head != nullptr)
 				continue;
 
 			SpinLockGuardAsMutex smutex(guard);
-			TRY(Thread::current().block_or_eintr_or_waketime_ns(m_thread_blocker, waketime_ns, false, &smutex));
+			if (auto ret = Thread::current().block_or_eintr_or_waketime_ns(m_thread_blocker, waketime_ns, false, &smutex); ret.is_error())
+			{
+				if (m_ready_head != nullptr)
+					m_thread_blocker.unblock_one();
+				return ret.release_error();
+			}
 		}
 
+		// wakeups are delivered to a single waiter, hand them
+		// over to the next one if there are events left
+		SpinLockGuard _(m_ready_lock);
+		if (m_ready_head != nullptr)
+			m_thread_blocker.unblock_one();
+
 		return event_count;
 	}
 
-	void Epoll::notify(BAN::RefPtr<Inode> inode, uint32_t event)
+	bool Epoll::notify(EpollItem* item, uint32_t event)
 	{
 		ASSERT(event);
 
 		SpinLockGuard _(m_ready_lock);
 
-		if (auto it = m_ready_events.find(inode); it != m_ready_events.end())
-			it->value |= event;
-		else
-			MUST(m_ready_events.insert(inode, event));
+		event &= item->listen_mask;
+		if (event == 0)
+			return false;
+
+		add_to_ready_list(item, event);
 
-		m_thread_blocker.unblock();
+		const bool woke_thread = m_thread_blocker.unblock_one();
+		return item->exclusive && woke_thread;
 	}
 
 }
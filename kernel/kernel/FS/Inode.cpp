@@ -192,6 +192,13 @@ namespace Kernel
 		return sendmsg_impl(message, flags);
 	}
 
+	BAN::ErrorOr<size_t> Inode::sendfile(Inode& source, off_t offset, size_t count, int flags)
+	{
+		if (!mode().ifsock())
+			return BAN::Error::from_errno(ENOTSOCK);
+		return sendfile_impl(source, offset, count, flags);
+	}
+
 	BAN::ErrorOr<void> Inode::getsockname(sockaddr* address, socklen_t* address_len)
 	{
 		if (!mode().ifsock())
@@ -236,6 +243,74 @@ namespace Kernel
 		return write_impl(offset, buffer);
 	}
 
+	BAN::ErrorOr<size_t> Inode::readv(off_t offset, BAN::Span<const iovec> iov)
+	{
+		if (mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		return readv_impl(offset, iov);
+	}
+
+	BAN::ErrorOr<size_t> Inode::writev(off_t offset, BAN::Span<const iovec> iov)
+	{
+		if (mode().ifdir())
+			return BAN::Error::from_errno(EISDIR);
+		if (auto* fs = filesystem(); fs && (fs->flag() & ST_RDONLY))
+			return BAN::Error::from_errno(EROFS);
+		return writev_impl(offset, iov);
+	}
+
+	BAN::ErrorOr<size_t> Inode::readv_impl(off_t offset, BAN::Span<const iovec> iov)
+	{
+		size_t nread = 0;
+		for (size_t i = 0; i < iov.size(); i++)
+		{
+			if (iov[i].iov_len == 0)
+				continue;
+			// don't block after something has already been read
+			if (nread > 0 && !can_read_impl())
+				break;
+
+			auto ret = read_impl(offset + nread, { static_cast<uint8_t*>(iov[i].iov_base), iov[i].iov_len });
+			if (ret.is_error())
+			{
+				if (nread > 0)
+					break;
+				return ret.release_error();
+			}
+
+			nread += ret.value();
+			if (ret.value() < iov[i].iov_len)
+				break;
+		}
+		return nread;
+	}
+
+	BAN::ErrorOr<size_t> Inode::writev_impl(off_t offset, BAN::Span<const iovec> iov)
+	{
+		size_t nwrite = 0;
+		for (size_t i = 0; i < iov.size(); i++)
+		{
+			if (iov[i].iov_len == 0)
+				continue;
+			// don't block after something has already been written
+			if (nwrite > 0 && !can_write_impl())
+				break;
+
+			auto ret = write_impl(offset + nwrite, { static_cast<const uint8_t*>(iov[i].iov_base), iov[i].iov_len });
+			if (ret.is_error())
+			{
+				if (nwrite > 0)
+					break;
+				return ret.release_error();
+			}
+
+			nwrite += ret.value();
+			if (ret.value() < iov[i].iov_len)
+				break;
+		}
+		return nwrite;
+	}
+
 	BAN::ErrorOr<void> Inode::truncate(size_t size)
 	{
 		if (mode().ifdir())
@@ -336,30 +411,57 @@ namespace Kernel
 		}
 	}
 
-	BAN::ErrorOr<void> Inode::add_epoll(class Epoll* epoll)
+	void Inode::add_epoll(EpollItem* item)
 	{
 		SpinLockGuard _(m_epoll_lock);
-		TRY(m_epolls.push_back(epoll));
-		return {};
+
+		ASSERT(item->inode_next == nullptr && item->inode_prev == nullptr);
+
+		// exclusive registrations are kept at the back, so every
+		// non-exclusive registration gets notified before them
+		if (!item->exclusive)
+		{
+			item->inode_next = m_epoll_head;
+			if (m_epoll_head)
+				m_epoll_head->inode_prev = item;
+			else
+				m_epoll_tail = item;
+			m_epoll_head = item;
+		}
+		else
+		{
+			item->inode_prev = m_epoll_tail;
+			if (m_epoll_tail)
+				m_epoll_tail->inode_next = item;
+			else
+				m_epoll_head = item;
+			m_epoll_tail = item;
+		}
 	}
 
-	void Inode::del_epoll(class Epoll* epoll)
+	void Inode::del_epoll(EpollItem* item)
 	{
 		SpinLockGuard _(m_epoll_lock);
-		for (auto it = m_epolls.begin(); it != m_epolls.end(); it++)
-		{
-			if (*it != epoll)
-				continue;
-			m_epolls.remove(it);
-			break;
-		}
+
+		if (item->inode_prev)
+			item->inode_prev->inode_next = item->inode_next;
+		else
+			m_epoll_head = item->inode_next;
+		if (item->inode_next)
+			item->inode_next->inode_prev = item->inode_prev;
+		else
+			m_epoll_tail = item->inode_prev;
+
+		item->inode_next = nullptr;
+		item->inode_prev = nullptr;
 	}
 
 	void Inode::epoll_notify(uint32_t event)
 	{
 		SpinLockGuard _(m_epoll_lock);
-		for (auto* epoll : m_epolls)
-			epoll->notify(this, event);
+		for (auto* item = m_epoll_head; item; item = item->inode_next)
+			if (item->epoll->notify(item, event) && item->exclusive)
+				break;
 	}
 
 }
@@ -1,6 +1,9 @@
 #include <kernel/BootInfo.h>
+#include <kernel/FS/DevFS/FileSystem.h>
 #include <kernel/FS/ProcFS/FileSystem.h>
 #include <kernel/FS/ProcFS/Inode.h>
+#include <kernel/Memory/kmalloc.h>
+#include <kernel/Storage/StorageDevice.h>
 
 namespace Kernel
 {
@@ -36,6 +39,75 @@ namespace Kernel
 		));
 		MUST(static_cast<TmpDirectoryInode*>(s_instance->root_inode().ptr())->link_inode(*meminfo_inode, "meminfo"_sv));
 
+		auto kmalloc_inode = MUST(ProcROInode::create_new(
+			[](off_t offset, BAN::ByteSpan buffer, void*) -> BAN::ErrorOr<size_t>
+			{
+				ASSERT(offset >= 0);
+
+				BAN::String string;
+				for (size_t i = 0; i < kmalloc_size_class_count(); i++)
+				{
+					const auto info = kmalloc_get_size_class_info(i);
+					TRY(string.append(TRY(BAN::String::formatted("{} {} {} {} {}\n",
+						info.object_size,
+						info.slab_count,
+						info.total_objects,
+						info.used_objects,
+						info.cached_objects
+					))));
+				}
+
+				if (static_cast<size_t>(offset) >= string.size())
+					return 0;
+
+				const size_t bytes = BAN::Math::min<size_t>(string.size() - offset, buffer.size());
+				memcpy(buffer.data(), string.data() + offset, bytes);
+				return bytes;
+			},
+			*s_instance, nullptr, 0444, 0, 0
+		));
+		MUST(static_cast<TmpDirectoryInode*>(s_instance->root_inode().ptr())->link_inode(*kmalloc_inode, "kmalloc"_sv));
+
+		auto diskcache_inode = MUST(ProcROInode::create_new(
+			[](off_t offset, BAN::ByteSpan buffer, void*) -> BAN::ErrorOr<size_t>
+			{
+				ASSERT(offset >= 0);
+
+				BAN::Vector<BAN::RefPtr<StorageDevice>> storage_devices;
+				BAN::ErrorOr<void> result {};
+				DevFileSystem::get().for_each_device([&](const BAN::RefPtr<Device>& device) {
+					if (device->is_storage_device() && !result.is_error())
+						result = storage_devices.push_back(static_cast<StorageDevice*>(device.ptr()));
+				});
+				TRY(result);
+
+				BAN::String string;
+				for (const auto& device : storage_devices)
+				{
+					const auto stats = device->disk_cache_stats();
+					if (!stats.has_value())
+						continue;
+					TRY(string.append(TRY(BAN::String::formatted("{} {} {} {} {} {}\n",
+						device->name(),
+						stats->pages,
+						stats->dirty_pages,
+						stats->hits,
+						stats->misses,
+						stats->evictions
+					))));
+				}
+
+				if (static_cast<size_t>(offset) >= string.size())
+					return 0;
+
+				const size_t bytes = BAN::Math::min<size_t>(string.size() - offset, buffer.size());
+				memcpy(buffer.data(), string.data() + offset, bytes);
+				return bytes;
+			},
+			*s_instance, nullptr, 0444, 0, 0
+		));
+		MUST(static_cast<TmpDirectoryInode*>(s_instance->root_inode().ptr())->link_inode(*diskcache_inode, "diskcache"_sv));
+
 		auto cmdline_inode = MUST(TmpFileInode::create_new(*s_instance, 0444, 0, 0));
 		MUST(cmdline_inode->write(0, { reinterpret_cast<const uint8_t*>(g_boot_info.command_line.data()), g_boot_info.command_line.size() }));
 		MUST(static_cast<TmpDirectoryInode*>(s_instance->root_inode().ptr())->link_inode(*cmdline_inode, "cmdline"_sv));
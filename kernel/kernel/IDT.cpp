@@ -414,7 +414,7 @@ namespace Kernel
 		ASSERT(InterruptController::get().is_in_service(IRQ_IPI - IRQ_VECTOR_BASE));
 		InterruptController::get().eoi(IRQ_IPI - IRQ_VECTOR_BASE);
 		Processor::handle_ipi();
-		Processor::scheduler().reschedule_if_idle();
+		Processor::scheduler().reschedule_if_needed();
 	}
 
 	extern "C" void cpp_timer_handler()
@@ -457,7 +457,7 @@ namespace Kernel
 		else
 			dprintln("no handler for irq 0x{2H}", irq);
 
-		Processor::scheduler().reschedule_if_idle();
+		Processor::scheduler().reschedule_if_needed();
 
 		ASSERT(Thread::current().state() != Thread::State::Terminated);
 	}
@@ -60,6 +60,55 @@ namespace Kernel
 
 	static Heap* s_instance = nullptr;
 
+	// Single pages are handed out from per processor caches, that get
+	// refilled from and drained to the buddy allocators in batches.
+	static constexpr size_t s_page_cache_size  = 32;
+	static constexpr size_t s_page_cache_batch = s_page_cache_size / 2;
+
+	// Cache locks are only contended when another processor steals pages.
+	// Lock order is cache lock before heap lock.
+	struct PageCache
+	{
+		SpinLock lock;
+		size_t count { 0 };
+		paddr_t pages[s_page_cache_size];
+	};
+
+	static BAN::Array<PageCache, 0xFF> s_page_caches;
+
+	// NOTE: must be called with interrupts disabled
+	static PageCache* current_page_cache()
+	{
+		// processor indices are not assigned before processors are initialized
+		if (Processor::count() == 0)
+			return nullptr;
+		const auto index = Processor::current_index();
+		if (index >= Processor::count())
+			return nullptr;
+		return &s_page_caches[index];
+	}
+
+	static size_t cached_page_count()
+	{
+		size_t result = 0;
+		for (size_t i = 0; i < Processor::count(); i++)
+			result += BAN::atomic_load(s_page_caches[i].count, BAN::MemoryOrder::memory_order_relaxed);
+		return result;
+	}
+
+	// other processors may still hold free pages in their caches
+	static paddr_t steal_cached_page()
+	{
+		for (size_t i = 0; i < Processor::count(); i++)
+		{
+			auto& cache = s_page_caches[i];
+			SpinLockGuard _(cache.lock);
+			if (cache.count > 0)
+				return cache.pages[--cache.count];
+		}
+		return 0;
+	}
+
 	void Heap::initialize()
 	{
 		ASSERT(s_instance == nullptr);
@@ -177,22 +226,96 @@ namespace Kernel
 			dprintln("Released {}.{3} MiB of RAM from boot modules", kibi_bytes / 1024, kibi_bytes % 1024);
 	}
 
-	paddr_t Heap::take_free_page()
+	size_t Heap::take_free_pages_locked(paddr_t* pages, size_t count)
 	{
-		SpinLockGuard _(m_lock);
+		ASSERT(m_lock.current_processor_has_lock());
+
+		size_t taken = 0;
 		for (auto& range : m_physical_ranges)
-			if (range.free_pages() >= 1)
-				return range.reserve_page();
-		return 0;
+			while (taken < count && range.free_pages() >= 1)
+				pages[taken++] = range.reserve_page();
+		return taken;
+	}
+
+	void Heap::release_pages_locked(const paddr_t* pages, size_t count)
+	{
+		ASSERT(m_lock.current_processor_has_lock());
+
+		for (size_t i = 0; i < count; i++)
+		{
+			bool released = false;
+			for (auto& range : m_physical_ranges)
+			{
+				if (!range.contains(pages[i]))
+					continue;
+				range.release_page(pages[i]);
+				released = true;
+				break;
+			}
+
+			if (!released)
+				panic("tried to free invalid paddr {16H}", pages[i]);
+		}
+	}
+
+	paddr_t Heap::take_free_page()
+	{
+		const auto state = Processor::get_interrupt_state();
+		Processor::set_interrupt_state(InterruptState::Disabled);
+
+		paddr_t result = 0;
+		if (auto* cache = current_page_cache(); cache == nullptr)
+		{
+			SpinLockGuard _(m_lock);
+			take_free_pages_locked(&result, 1);
+		}
+		else
+		{
+			SpinLockGuard _(cache->lock);
+
+			if (cache->count == 0)
+			{
+				SpinLockGuard _(m_lock);
+				cache->count = take_free_pages_locked(cache->pages, s_page_cache_batch);
+			}
+
+			if (cache->count > 0)
+				result = cache->pages[--cache->count];
+		}
+
+		if (result == 0)
+			result = steal_cached_page();
+
+		Processor::set_interrupt_state(state);
+
+		return result;
 	}
 
 	void Heap::release_page(paddr_t paddr)
 	{
-		SpinLockGuard _(m_lock);
-		for (auto& range : m_physical_ranges)
-			if (range.contains(paddr))
-				return range.release_page(paddr);
-		panic("tried to free invalid paddr {16H}", paddr);
+		const auto state = Processor::get_interrupt_state();
+		Processor::set_interrupt_state(InterruptState::Disabled);
+
+		if (auto* cache = current_page_cache(); cache == nullptr)
+		{
+			SpinLockGuard _(m_lock);
+			release_pages_locked(&paddr, 1);
+		}
+		else
+		{
+			SpinLockGuard _(cache->lock);
+
+			if (cache->count == s_page_cache_size)
+			{
+				SpinLockGuard _(m_lock);
+				release_pages_locked(cache->pages + cache->count - s_page_cache_batch, s_page_cache_batch);
+				cache->count -= s_page_cache_batch;
+			}
+
+			cache->pages[cache->count++] = paddr;
+		}
+
+		Processor::set_interrupt_state(state);
 	}
 
 	paddr_t Heap::take_free_contiguous_pages(size_t pages)
@@ -220,7 +343,7 @@ namespace Kernel
 		size_t result = 0;
 		for (const auto& range : m_physical_ranges)
 			result += range.used_pages();
-		return result;
+		return result - cached_page_count();
 	}
 
 	size_t Heap::free_pages() const
@@ -229,7 +352,7 @@ namespace Kernel
 		size_t result = 0;
 		for (const auto& range : m_physical_ranges)
 			result += range.free_pages();
-		return result;
+		return result + cached_page_count();
 	}
 
 }
@@ -1,6 +1,5 @@
 #include <BAN/Assert.h>
 #include <BAN/Math.h>
-#include <BAN/Optional.h>
 
 #include <kernel/Memory/PageTable.h>
 #include <kernel/Memory/PhysicalRange.h>
@@ -10,15 +9,34 @@ namespace Kernel
 
 	static constexpr size_t bits_per_page = PAGE_SIZE * 8;
 
+	// stored at the beginning of every free block
+	struct FreeBlock
+	{
+		paddr_t next;
+		paddr_t prev;
+	};
+
 	PhysicalRange::PhysicalRange(paddr_t paddr, uint64_t size)
 		: m_paddr(paddr)
 		, m_page_count(size / PAGE_SIZE)
-		, m_free_pages(m_page_count)
 	{
 		ASSERT(paddr % PAGE_SIZE == 0);
 		ASSERT(size % PAGE_SIZE == 0);
 
-		const size_t bitmap_page_count = BAN::Math::div_round_up<size_t>(m_page_count, bits_per_page);
+		// align buddy indices to the largest block size, so blocks are also physically aligned
+		constexpr paddr_t base_alignment = static_cast<paddr_t>(PAGE_SIZE) << max_order;
+		m_base = m_paddr - m_paddr % base_alignment;
+		m_index_count = paddr_to_index(m_paddr) + m_page_count;
+
+		size_t bitmap_bits = 0;
+		for (size_t order = 0; order <= max_order; order++)
+		{
+			m_bitmap_offsets[order] = bitmap_bits;
+			bitmap_bits += m_index_count >> order;
+		}
+
+		const size_t bitmap_page_count = BAN::Math::div_round_up<size_t>(bitmap_bits, bits_per_page);
+		ASSERT(bitmap_page_count < m_page_count);
 		for (size_t i = 0; i < bitmap_page_count; i++)
 		{
 			PageTable::with_per_cpu_fast_page(paddr + i * PAGE_SIZE, [](void* addr) {
@@ -26,127 +44,241 @@ namespace Kernel
 			});
 		}
 
-		ASSERT(reserve_contiguous_pages(bitmap_page_count) == m_paddr);
+		m_free_pages = 0;
+		free_index_range(paddr_to_index(m_paddr) + bitmap_page_count, m_page_count - bitmap_page_count);
 	}
 
-	paddr_t PhysicalRange::reserve_page()
+	bool PhysicalRange::is_block_free(size_t index, size_t order) const
 	{
-		ASSERT(free_pages() > 0);
+		ASSERT(order <= max_order);
+		ASSERT(index % (1u << order) == 0);
 
-		const size_t bitmap_page_count = BAN::Math::div_round_up<size_t>(m_page_count, bits_per_page);
+		const size_t block = index >> order;
+		if (block >= (m_index_count >> order))
+			return false;
 
-		for (size_t i = 0; i < bitmap_page_count; i++)
+		const size_t bit_index = m_bitmap_offsets[order] + block;
+
+		bool result;
+		PageTable::with_per_cpu_fast_page(m_paddr + bit_index / bits_per_page * PAGE_SIZE, [&result, bit_index](void* addr) {
+			const size_t bit = bit_index % bits_per_page;
+			result = static_cast<const uint8_t*>(addr)[bit / 8] & (1u << (bit % 8));
+		});
+		return result;
+	}
+
+	void PhysicalRange::set_block_free(size_t index, size_t order, bool free)
+	{
+		ASSERT(order <= max_order);
+		ASSERT(index % (1u << order) == 0);
+		ASSERT((index >> order) < (m_index_count >> order));
+
+		const size_t bit_index = m_bitmap_offsets[order] + (index >> order);
+
+		PageTable::with_per_cpu_fast_page(m_paddr + bit_index / bits_per_page * PAGE_SIZE, [bit_index, free](void* addr) {
+			const size_t bit = bit_index % bits_per_page;
+			uint8_t& byte = static_cast<uint8_t*>(addr)[bit / 8];
+			if (free)
+				byte |= 1u << (bit % 8);
+			else
+				byte &= ~(1u << (bit % 8));
+		});
+	}
+
+	void PhysicalRange::push_free_block(size_t index, size_t order)
+	{
+		const paddr_t paddr = index_to_paddr(index);
+		const paddr_t next = m_free_lists[order];
+
+		PageTable::with_per_cpu_fast_page(paddr, [next](void* addr) {
+			*static_cast<FreeBlock*>(addr) = { .next = next, .prev = 0 };
+		});
+
+		if (next)
 		{
-			BAN::Optional<size_t> page_matched_bit;
-
-			const paddr_t current_paddr = m_paddr + i * PAGE_SIZE;
-			PageTable::with_per_cpu_fast_page(current_paddr, [&page_matched_bit](void* addr) {
-				for (size_t j = 0; j < PAGE_SIZE / sizeof(size_t); j++)
-				{
-					static_assert(sizeof(size_t) == sizeof(long));
-					auto& current = static_cast<size_t*>(addr)[j];
-					if (current == BAN::numeric_limits<size_t>::max())
-						continue;
-					const int ctz = __builtin_ctzl(~current);
-					current |= static_cast<size_t>(1) << ctz;
-					page_matched_bit = j * sizeof(size_t) * 8 + ctz;
-					return;
-				}
+			PageTable::with_per_cpu_fast_page(next, [paddr](void* addr) {
+				static_cast<FreeBlock*>(addr)->prev = paddr;
 			});
+		}
 
-			if (page_matched_bit.has_value())
-			{
-				m_free_pages--;
+		m_free_lists[order] = paddr;
+		set_block_free(index, order, true);
+	}
 
-				const size_t matched_bit = (i * bits_per_page) + page_matched_bit.value();
-				ASSERT(matched_bit < m_page_count);
-				return m_paddr + matched_bit * PAGE_SIZE;
-			}
+	void PhysicalRange::remove_free_block(size_t index, size_t order)
+	{
+		const paddr_t paddr = index_to_paddr(index);
+
+		FreeBlock block;
+		PageTable::with_per_cpu_fast_page(paddr, [&block](void* addr) {
+			block = *static_cast<FreeBlock*>(addr);
+		});
+
+		if (block.prev)
+		{
+			PageTable::with_per_cpu_fast_page(block.prev, [&block](void* addr) {
+				static_cast<FreeBlock*>(addr)->next = block.next;
+			});
+		}
+		else
+		{
+			ASSERT(m_free_lists[order] == paddr);
+			m_free_lists[order] = block.next;
+		}
+
+		if (block.next)
+		{
+			PageTable::with_per_cpu_fast_page(block.next, [&block](void* addr) {
+				static_cast<FreeBlock*>(addr)->prev = block.prev;
+			});
 		}
 
-		ASSERT_NOT_REACHED();
+		set_block_free(index, order, false);
 	}
 
-	void PhysicalRange::release_page(paddr_t paddr)
+	size_t PhysicalRange::allocate_block(size_t order)
 	{
-		ASSERT(paddr % PAGE_SIZE == 0);
-		ASSERT(paddr >= m_paddr);
-		ASSERT(paddr <  m_paddr + m_page_count * PAGE_SIZE);
+		ASSERT(order <= max_order);
 
-		const size_t paddr_index = (paddr - m_paddr) / PAGE_SIZE;
+		size_t current_order = order;
+		while (current_order <= max_order && m_free_lists[current_order] == 0)
+			current_order++;
+		if (current_order > max_order)
+			return invalid_index;
 
-		PageTable::with_per_cpu_fast_page(m_paddr + paddr_index / bits_per_page * PAGE_SIZE, [paddr_index] (void* addr) {
-			const size_t bitmap_bit = paddr_index % bits_per_page;
-			const size_t byte       = bitmap_bit / 8;
-			const size_t bit        = bitmap_bit % 8;
+		const size_t index = paddr_to_index(m_free_lists[current_order]);
+		remove_free_block(index, current_order);
 
-			uint8_t& bitmap_byte = static_cast<uint8_t*>(addr)[byte];
-			ASSERT(bitmap_byte & (1u << bit));
-			bitmap_byte &= ~(1u << bit);
-		});
+		// split the block and give back the upper halves
+		while (current_order > order)
+		{
+			current_order--;
+			push_free_block(index + (static_cast<size_t>(1) << current_order), current_order);
+		}
 
-		m_free_pages++;
+		m_free_pages -= static_cast<size_t>(1) << order;
+		return index;
 	}
 
-	paddr_t PhysicalRange::reserve_contiguous_pages(size_t pages)
+	void PhysicalRange::free_block(size_t index, size_t order)
 	{
-		ASSERT(pages > 0);
-		ASSERT(pages <= free_pages());
+		m_free_pages += static_cast<size_t>(1) << order;
+
+		// merge with free buddies as far as possible
+		while (order < max_order)
+		{
+			const size_t buddy = index ^ (static_cast<size_t>(1) << order);
+			if (!is_block_free(buddy, order))
+				break;
+			remove_free_block(buddy, order);
+			index &= ~(static_cast<size_t>(1) << order);
+			order++;
+		}
 
-		const auto bitmap_is_set =
-			[this](size_t buffer_bit) -> bool
+		push_free_block(index, order);
+	}
+
+	void PhysicalRange::free_index_range(size_t index, size_t count)
+	{
+		// split the range into largest possible aligned blocks
+		while (count > 0)
+		{
+			size_t order = 0;
+			while (order < max_order)
 			{
-				const size_t page_index = buffer_bit / bits_per_page;
-				const size_t bit_index  = buffer_bit % bits_per_page;
-				const size_t byte = bit_index / 8;
-				const size_t bit  = bit_index % 8;
+				const size_t next_size = static_cast<size_t>(1) << (order + 1);
+				if (index % next_size || next_size > count)
+					break;
+				order++;
+			}
 
-				uint8_t current;
-				PageTable::with_per_cpu_fast_page(m_paddr + page_index * PAGE_SIZE, [&current, byte](void* addr) {
-					current = static_cast<uint8_t*>(addr)[byte];
-				});
+			free_block(index, order);
+			index += static_cast<size_t>(1) << order;
+			count -= static_cast<size_t>(1) << order;
+		}
+	}
 
-				return current & (1u << bit);
-			};
+	size_t PhysicalRange::allocate_max_order_run(size_t block_count)
+	{
+		constexpr size_t block_size = static_cast<size_t>(1) << max_order;
 
-		const auto bitmap_set_bit =
-			[this](size_t buffer_bit) -> void
-			{
-				const size_t page_index = buffer_bit / bits_per_page;
-				const size_t bit_index  = buffer_bit % bits_per_page;
-				const size_t byte = bit_index / 8;
-				const size_t bit  = bit_index % 8;
-				PageTable::with_per_cpu_fast_page(m_paddr + page_index * PAGE_SIZE, [byte, bit](void* addr) {
-					uint8_t& current = static_cast<uint8_t*>(addr)[byte];
-					current |= 1u << bit;
-				});
-			};
-
-		// FIXME: optimize this :)
-		for (size_t i = 0; i <= m_page_count - pages; i++)
+		const size_t total_blocks = m_index_count >> max_order;
+		for (size_t first = 0; first + block_count <= total_blocks; first++)
 		{
-			bool all_unset = true;
-			for (size_t j = 0; j < pages && all_unset; j++)
-				if (bitmap_is_set(i + j))
-					all_unset = false;
-			if (!all_unset)
+			size_t count = 0;
+			while (count < block_count && is_block_free((first + count) * block_size, max_order))
+				count++;
+			if (count < block_count)
+			{
+				first += count;
 				continue;
-			for (size_t j = 0; j < pages; j++)
-				bitmap_set_bit(i + j);
+			}
+
+			for (size_t i = 0; i < block_count; i++)
+				remove_free_block((first + i) * block_size, max_order);
+			m_free_pages -= block_count * block_size;
+			return first * block_size;
+		}
+
+		return invalid_index;
+	}
+
+	paddr_t PhysicalRange::reserve_page()
+	{
+		ASSERT(free_pages() > 0);
+
+		const size_t index = allocate_block(0);
+		ASSERT(index != invalid_index);
+		return index_to_paddr(index);
+	}
+
+	void PhysicalRange::release_page(paddr_t paddr)
+	{
+		ASSERT(paddr % PAGE_SIZE == 0);
+		ASSERT(contains(paddr));
+
+		const size_t index = paddr_to_index(paddr);
+		ASSERT(!is_block_free(index, 0));
+		free_block(index, 0);
+	}
+
+	paddr_t PhysicalRange::reserve_contiguous_pages(size_t pages)
+	{
+		ASSERT(pages > 0);
+		ASSERT(pages <= free_pages());
+
+		size_t index;
+		size_t allocated;
 
-			m_free_pages -= pages;
-			return m_paddr + i * PAGE_SIZE;
+		if (pages <= (static_cast<size_t>(1) << max_order))
+		{
+			const size_t order = BAN::Math::ilog2(BAN::Math::round_up_to_power_of_two(pages));
+			index = allocate_block(order);
+			allocated = static_cast<size_t>(1) << order;
 		}
+		else
+		{
+			const size_t block_count = BAN::Math::div_round_up<size_t>(pages, static_cast<size_t>(1) << max_order);
+			index = allocate_max_order_run(block_count);
+			allocated = block_count << max_order;
+		}
+
+		if (index == invalid_index)
+			return 0;
 
-		return 0;
+		// return the unneeded tail of the allocation
+		if (allocated > pages)
+			free_index_range(index + pages, allocated - pages);
+
+		return index_to_paddr(index);
 	}
 
 	void PhysicalRange::release_contiguous_pages(paddr_t paddr, size_t pages)
 	{
 		ASSERT(pages > 0);
-		// FIXME: optimize this :)
-		for (size_t i = 0; i < pages; i++)
-			release_page(paddr + i * PAGE_SIZE);
+		ASSERT(paddr % PAGE_SIZE == 0);
+		ASSERT(contains(paddr) && contains(paddr + (pages - 1) * PAGE_SIZE));
+		free_index_range(paddr_to_index(paddr), pages);
 	}
 
 }
@@ -2,6 +2,8 @@
 #include <kernel/Memory/kmalloc.h>
 #include <kernel/Memory/PageTable.h>
 
+#include <BAN/String.h>
+
 static constexpr size_t s_allocator_chunk_size { 64 };
 static constexpr size_t s_allocator_align      { alignof(max_align_t) };
 
@@ -15,19 +17,34 @@ alignas(s_allocator_align) static uint8_t s_default_allocator_memory[s_allocator
 // NOTE: 128 KiB + 127 * 16 MiB ~= 2 GiB
 //       This is should be more than enough for kmalloc :^)
 
+// Small allocations are served from size class slabs through per processor
+// magazines, so the common path does not touch any global lock. All slabs
+// live in a single reserved virtual range, which allows finding the owning
+// slab of a pointer with simple arithmetic.
+static constexpr size_t s_slab_size        { 4 * PAGE_SIZE };
+static constexpr size_t s_slab_header_size { 64 };
+static constexpr size_t s_slab_region_size { 64 * 1024 * 1024 };
+static constexpr size_t s_magazine_size    { 32 };
+
+static constexpr size_t s_size_classes[] { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+static constexpr size_t s_size_class_count { sizeof(s_size_classes) / sizeof(*s_size_classes) };
+
 struct BitmapAllocator
 {
 	struct Header
 	{
-		size_t chunks { 0 };
-		uint8_t padding[s_allocator_align - sizeof(chunks)];
+		uint32_t chunks { 0 };
+		uint32_t allocator_index { 0 };
+		uint8_t padding[s_allocator_align - sizeof(chunks) - sizeof(allocator_index)];
 	};
 
-	uint32_t bitmap_chunks { 0 };
-	uint32_t total_chunks  { 0 };
-	uint32_t free_chunks   { 0 };
-	uint32_t allocations   { 0 };
-	uint8_t* base          { nullptr };
+	uint32_t bitmap_chunks   { 0 };
+	uint32_t total_chunks    { 0 };
+	uint32_t free_chunks     { 0 };
+	uint32_t allocations     { 0 };
+	uint32_t first_free_hint { 0 };
+	uint32_t index           { 0 };
+	uint8_t* base            { nullptr };
 
 	static size_t needed_chunks(size_t size)
 	{
@@ -175,7 +192,7 @@ struct BitmapAllocator
 		if (needed_chunks > free_chunks)
 			return nullptr;
 
-		for (size_t i = find_unset_bit(0); i <= total_chunks - needed_chunks; i = find_unset_bit(i))
+		for (size_t i = find_unset_bit(first_free_hint); i <= total_chunks - needed_chunks; i = find_unset_bit(i))
 		{
 			if (const size_t count = count_unset_bits(i, needed_chunks); count < needed_chunks)
 			{
@@ -186,8 +203,12 @@ struct BitmapAllocator
 			for (size_t j = 0; j < needed_chunks; j++)
 				set_bit(i + j, true);
 
+			if (i == first_free_hint)
+				first_free_hint = find_unset_bit(i + needed_chunks);
+
 			auto& header = header_from_chunk(i);
 			header.chunks = needed_chunks;
+			header.allocator_index = index;
 
 			free_chunks -= header.chunks;
 			allocations++;
@@ -208,24 +229,368 @@ struct BitmapAllocator
 		for (size_t i = 0; i < header.chunks; i++)
 			set_bit(first_chunk + i, false);
 
+		if (first_chunk < first_free_hint)
+			first_free_hint = first_chunk;
+
 		free_chunks += header.chunks;
 		allocations--;
 	}
 };
 
+struct Slab
+{
+	Slab* next;
+	Slab* prev;
+	void* free_list;
+	uint32_t size_class;
+	uint32_t used_objects;
+	uint32_t total_objects;
+
+	static Slab* from_ptr(void* ptr);
+
+	void initialize(uint32_t size_class)
+	{
+		const size_t object_size = s_size_classes[size_class];
+
+		this->next          = nullptr;
+		this->prev          = nullptr;
+		this->free_list     = nullptr;
+		this->size_class    = size_class;
+		this->used_objects  = 0;
+		this->total_objects = (s_slab_size - s_slab_header_size) / object_size;
+
+		uint8_t* objects = reinterpret_cast<uint8_t*>(this) + s_slab_header_size;
+		for (size_t i = total_objects; i > 0; i--)
+		{
+			void* object = objects + (i - 1) * object_size;
+			*static_cast<void**>(object) = free_list;
+			free_list = object;
+		}
+	}
+
+	void* allocate()
+	{
+		ASSERT(free_list);
+		void* object = free_list;
+		free_list = *static_cast<void**>(object);
+		used_objects++;
+		return object;
+	}
+
+	void free(void* ptr)
+	{
+		ASSERT(used_objects > 0);
+		*static_cast<void**>(ptr) = free_list;
+		free_list = ptr;
+		used_objects--;
+	}
+};
+static_assert(sizeof(Slab) <= s_slab_header_size);
+
+struct SlabCache
+{
+	Kernel::SpinLock lock;
+	Slab* partial_slabs     { nullptr };
+	size_t slab_count       { 0 };
+	size_t used_objects     { 0 };
+	size_t total_objects    { 0 };
+
+	void link_partial(Slab* slab)
+	{
+		slab->prev = nullptr;
+		slab->next = partial_slabs;
+		if (partial_slabs)
+			partial_slabs->prev = slab;
+		partial_slabs = slab;
+	}
+
+	void unlink_partial(Slab* slab)
+	{
+		if (slab->prev)
+			slab->prev->next = slab->next;
+		else
+			partial_slabs = slab->next;
+		if (slab->next)
+			slab->next->prev = slab->prev;
+		slab->next = nullptr;
+		slab->prev = nullptr;
+	}
+};
+
+struct Magazine
+{
+	uint32_t count { 0 };
+	void* objects[s_magazine_size];
+};
+
+struct ProcessorCache
+{
+	Magazine magazines[s_size_class_count];
+};
+
 static uint8_t s_allocator_storage[s_max_allocator_count * sizeof(BitmapAllocator)];
 static BitmapAllocator* s_allocators[s_max_allocator_count] {};
 
 static Kernel::SpinLock s_kmalloc_lock;
 
+static SlabCache s_slab_caches[s_size_class_count];
+static ProcessorCache* s_processor_caches[0xFF] {};
+
+static Kernel::SpinLock s_slab_region_lock;
+static uint8_t* s_slab_region      { nullptr };
+static size_t   s_slab_region_used { 0 };
+static Slab*    s_free_slabs       { nullptr };
+
+static void* kmalloc_bitmap(size_t size);
+
 void kmalloc_initialize()
 {
 	auto& allocator = reinterpret_cast<BitmapAllocator*>(s_allocator_storage)[0];
 	new (&allocator) BitmapAllocator();
 	allocator.initialize_default();
+	allocator.index = 0;
 	s_allocators[0] = &allocator;
 }
 
+Slab* Slab::from_ptr(void* ptr)
+{
+	const size_t offset = static_cast<uint8_t*>(ptr) - s_slab_region;
+	return reinterpret_cast<Slab*>(s_slab_region + offset / s_slab_size * s_slab_size);
+}
+
+static bool is_slab_pointer(void* ptr)
+{
+	return s_slab_region && ptr >= s_slab_region && ptr < s_slab_region + s_slab_region_used;
+}
+
+static size_t size_class_of(size_t size)
+{
+	for (size_t i = 0; i < s_size_class_count; i++)
+		if (size <= s_size_classes[i])
+			return i;
+	return s_size_class_count;
+}
+
+static bool slabs_available()
+{
+	// NOTE: slab memory is allocated from the physical heap and mapped to kernel
+	//       page table. Processor count gets initialized only after both of these
+	//       and processor local storage are usable
+	return Kernel::Processor::count() > 0;
+}
+
+static Slab* allocate_slab()
+{
+	using namespace Kernel;
+
+	SpinLockGuard _(s_slab_region_lock);
+
+	if (s_free_slabs)
+	{
+		Slab* slab = s_free_slabs;
+		s_free_slabs = slab->next;
+		return slab;
+	}
+
+	if (s_slab_region == nullptr)
+	{
+		const vaddr_t vaddr = PageTable::kernel().reserve_free_contiguous_pages(s_slab_region_size / PAGE_SIZE, KERNEL_OFFSET);
+		if (vaddr == 0)
+			return nullptr;
+		s_slab_region = reinterpret_cast<uint8_t*>(vaddr);
+	}
+
+	if (s_slab_region_used + s_slab_size > s_slab_region_size)
+		return nullptr;
+
+	const vaddr_t vaddr = reinterpret_cast<vaddr_t>(s_slab_region + s_slab_region_used);
+	for (size_t i = 0; i < s_slab_size / PAGE_SIZE; i++)
+	{
+		const paddr_t paddr = Heap::get().take_free_page();
+		if (paddr == 0)
+		{
+			for (size_t j = 0; j < i; j++)
+			{
+				Heap::get().release_page(PageTable::kernel().physical_address_of(vaddr + j * PAGE_SIZE));
+				PageTable::kernel().unmap_page(vaddr + j * PAGE_SIZE);
+				PageTable::kernel().reserve_page(vaddr + j * PAGE_SIZE);
+			}
+			return nullptr;
+		}
+
+		PageTable::kernel().map_page_at(paddr, vaddr + i * PAGE_SIZE, PageTable::ReadWrite | PageTable::Present);
+	}
+
+	s_slab_region_used += s_slab_size;
+
+	return reinterpret_cast<Slab*>(vaddr);
+}
+
+static void release_slab(Slab* slab)
+{
+	Kernel::SpinLockGuard _(s_slab_region_lock);
+	slab->next = s_free_slabs;
+	s_free_slabs = slab;
+}
+
+// moves at most `count` objects from slabs to `objects`
+static size_t slab_cache_take(size_t size_class, void** objects, size_t count)
+{
+	auto& cache = s_slab_caches[size_class];
+
+	Kernel::SpinLockGuard _(cache.lock);
+
+	size_t taken = 0;
+	while (taken < count)
+	{
+		Slab* slab = cache.partial_slabs;
+		if (slab == nullptr)
+		{
+			if ((slab = allocate_slab()) == nullptr)
+				break;
+			slab->initialize(size_class);
+			cache.link_partial(slab);
+			cache.slab_count++;
+			cache.total_objects += slab->total_objects;
+		}
+
+		while (taken < count && slab->free_list)
+			objects[taken++] = slab->allocate();
+
+		if (slab->free_list == nullptr)
+			cache.unlink_partial(slab);
+	}
+
+	cache.used_objects += taken;
+
+	return taken;
+}
+
+// returns `count` objects from `objects` back to their slabs
+static void slab_cache_give(size_t size_class, void** objects, size_t count)
+{
+	auto& cache = s_slab_caches[size_class];
+
+	Kernel::SpinLockGuard _(cache.lock);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Slab* slab = Slab::from_ptr(objects[i]);
+		ASSERT(slab->size_class == size_class);
+
+		if (slab->free_list == nullptr)
+			cache.link_partial(slab);
+		slab->free(objects[i]);
+
+		// keep one empty slab around, give the rest to other size classes
+		if (slab->used_objects == 0 && (slab->prev || slab->next))
+		{
+			cache.unlink_partial(slab);
+			cache.slab_count--;
+			cache.total_objects -= slab->total_objects;
+			release_slab(slab);
+		}
+	}
+
+	cache.used_objects -= count;
+}
+
+// NOTE: must be called with interrupts disabled
+static ProcessorCache* current_processor_cache()
+{
+	const auto index = Kernel::Processor::current_index();
+	if (index >= Kernel::Processor::count())
+		return nullptr;
+
+	if (s_processor_caches[index] == nullptr)
+	{
+		auto* processor_cache = static_cast<ProcessorCache*>(kmalloc_bitmap(sizeof(ProcessorCache)));
+		if (processor_cache == nullptr)
+			return nullptr;
+		new (processor_cache) ProcessorCache();
+		s_processor_caches[index] = processor_cache;
+	}
+
+	return s_processor_caches[index];
+}
+
+static void* kmalloc_slab(size_t size_class)
+{
+	using namespace Kernel;
+
+	const auto state = Processor::get_interrupt_state();
+	Processor::set_interrupt_state(InterruptState::Disabled);
+
+	void* result = nullptr;
+	if (auto* processor_cache = current_processor_cache(); processor_cache == nullptr)
+		slab_cache_take(size_class, &result, 1);
+	else
+	{
+		auto& magazine = processor_cache->magazines[size_class];
+		if (magazine.count == 0)
+			magazine.count = slab_cache_take(size_class, magazine.objects, s_magazine_size / 2);
+		if (magazine.count > 0)
+			result = magazine.objects[--magazine.count];
+	}
+
+	Processor::set_interrupt_state(state);
+
+	return result;
+}
+
+static void kfree_slab(void* ptr)
+{
+	using namespace Kernel;
+
+	const size_t size_class = Slab::from_ptr(ptr)->size_class;
+	ASSERT(size_class < s_size_class_count);
+
+	const auto state = Processor::get_interrupt_state();
+	Processor::set_interrupt_state(InterruptState::Disabled);
+
+	if (auto* processor_cache = current_processor_cache(); processor_cache == nullptr)
+		slab_cache_give(size_class, &ptr, 1);
+	else
+	{
+		auto& magazine = processor_cache->magazines[size_class];
+		if (magazine.count == s_magazine_size)
+		{
+			constexpr size_t flush_count = s_magazine_size / 2;
+			slab_cache_give(size_class, magazine.objects + magazine.count - flush_count, flush_count);
+			magazine.count -= flush_count;
+		}
+		magazine.objects[magazine.count++] = ptr;
+	}
+
+	Processor::set_interrupt_state(state);
+}
+
+size_t kmalloc_size_class_count()
+{
+	return s_size_class_count;
+}
+
+kmalloc_size_class_info kmalloc_get_size_class_info(size_t size_class)
+{
+	ASSERT(size_class < s_size_class_count);
+
+	size_t cached_objects = 0;
+	for (size_t i = 0; i < Kernel::Processor::count(); i++)
+		if (const auto* processor_cache = s_processor_caches[i])
+			cached_objects += BAN::atomic_load(processor_cache->magazines[size_class].count, BAN::MemoryOrder::memory_order_relaxed);
+
+	auto& cache = s_slab_caches[size_class];
+
+	Kernel::SpinLockGuard _(cache.lock);
+	return kmalloc_size_class_info {
+		.object_size    = s_size_classes[size_class],
+		.slab_count     = cache.slab_count,
+		.total_objects  = cache.total_objects,
+		.used_objects   = cache.used_objects - BAN::Math::min(cache.used_objects, cached_objects),
+		.cached_objects = cached_objects,
+	};
+}
+
 static void kmalloc_dump_info()
 {
 	ASSERT(s_kmalloc_lock.current_processor_has_lock());
@@ -238,9 +603,27 @@ static void kmalloc_dump_info()
 		dwarnln("    free size:   {}", s_allocators[i]->free_chunks  * s_allocator_chunk_size);
 		dwarnln("    allocations: {}", s_allocators[i]->allocations);
 	}
+
+	for (size_t i = 0; i < s_size_class_count; i++)
+	{
+		auto& cache = s_slab_caches[i];
+		if (cache.slab_count == 0)
+			continue;
+		dwarnln("  size class {}", s_size_classes[i]);
+		dwarnln("    slabs:   {}", cache.slab_count);
+		dwarnln("    objects: {}/{}", cache.used_objects, cache.total_objects);
+	}
 }
 
 void* kmalloc(size_t size)
+{
+	if (const size_t size_class = size_class_of(size); size_class < s_size_class_count && slabs_available())
+		if (void* result = kmalloc_slab(size_class))
+			return result;
+	return kmalloc_bitmap(size);
+}
+
+static void* kmalloc_bitmap(size_t size)
 {
 	const size_t needed_chunks = BitmapAllocator::needed_chunks(size);
 
@@ -263,6 +646,7 @@ void* kmalloc(size_t size)
 			break;
 		}
 
+		new_allocator.index = i;
 		s_allocators[i] = &new_allocator;
 
 		if (void* result = new_allocator.allocate(needed_chunks))
@@ -282,11 +666,15 @@ void kfree(void* ptr)
 	if (ptr == nullptr)
 		return;
 
+	if (is_slab_pointer(ptr))
+		return kfree_slab(ptr);
+
 	Kernel::SpinLockGuard _(s_kmalloc_lock);
 
-	for (size_t i = 0; i < s_max_allocator_count && s_allocators[i]; i++)
-		if (s_allocators[i]->contains(ptr))
-			return s_allocators[i]->free(ptr);
+	const auto& header = *reinterpret_cast<BitmapAllocator::Header*>(static_cast<uint8_t*>(ptr) - sizeof(BitmapAllocator::Header));
+	ASSERT(header.allocator_index < s_max_allocator_count);
 
-	ASSERT_NOT_REACHED();
+	auto* allocator = s_allocators[header.allocator_index];
+	ASSERT(allocator && allocator->contains(ptr));
+	allocator->free(ptr);
 }
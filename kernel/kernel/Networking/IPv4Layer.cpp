@@ -43,6 +43,21 @@ namespace Kernel
 		return header;
 	}
 
+	static bool is_transport_checksum_valid(const IPv4Header& ipv4_header, BAN::ConstByteSpan ipv4_data)
+	{
+		const PseudoHeader pseudo_header {
+			.src_ipv4 = ipv4_header.src_address,
+			.dst_ipv4 = ipv4_header.dst_address,
+			.protocol = ipv4_header.protocol,
+			.length = ipv4_data.size(),
+		};
+		const BAN::ConstByteSpan buffers[] {
+			BAN::ConstByteSpan::from(pseudo_header),
+			ipv4_data,
+		};
+		return calculate_internet_checksum({ buffers, sizeof(buffers) / sizeof(*buffers) }) == 0;
+	}
+
 	void IPv4Layer::unbind_socket(uint16_t port)
 	{
 		SpinLockGuard _(m_bound_socket_lock);
@@ -223,11 +238,12 @@ namespace Kernel
 			.length = socket.protocol_header_size() + payload.size()
 		};
 
-		uint8_t protocol_header_buffer[32];
+		uint8_t protocol_header_buffer[64];
 		ASSERT(socket.protocol_header_size() < sizeof(protocol_header_buffer));
 
 		auto protocol_header = BAN::ByteSpan::from(protocol_header_buffer).slice(0, socket.protocol_header_size());
-		socket.get_protocol_header(protocol_header, payload, dst_port, pseudo_header);
+		const bool checksum_offload = interface->capabilities() & NetworkInterface::TxChecksum;
+		socket.get_protocol_header(protocol_header, payload, dst_port, pseudo_header, checksum_offload);
 
 		BAN::ConstByteSpan buffers[] {
 			BAN::ConstByteSpan::from(ipv4_header),
@@ -240,7 +256,7 @@ namespace Kernel
 		return payload.size();
 	}
 
-	BAN::ErrorOr<void> IPv4Layer::handle_ipv4_packet(NetworkInterface& interface, BAN::ConstByteSpan packet)
+	BAN::ErrorOr<void> IPv4Layer::handle_ipv4_packet(NetworkInterface& interface, BAN::ConstByteSpan packet, bool checksum_verified)
 	{
 		if (packet.size() < sizeof(IPv4Header))
 		{
@@ -249,7 +265,7 @@ namespace Kernel
 		}
 
 		auto& ipv4_header = packet.as<const IPv4Header>();
-		if (calculate_internet_checksum(BAN::ConstByteSpan::from(ipv4_header)) != 0)
+		if (!checksum_verified && calculate_internet_checksum(BAN::ConstByteSpan::from(ipv4_header)) != 0)
 		{
 			dwarnln_if(DEBUG_IPV4, "IPv4 packet checksum failed");
 			return {};
@@ -336,6 +352,12 @@ namespace Kernel
 					return {};
 				}
 				auto& udp_header = ipv4_data.as<const UDPHeader>();
+				// zero checksum means the sender did not calculate one
+				if (!checksum_verified && udp_header.checksum != 0 && !is_transport_checksum_valid(ipv4_header, ipv4_data))
+				{
+					dwarnln_if(DEBUG_IPV4, "UDP checksum failed");
+					return {};
+				}
 				dst_port = udp_header.dst_port;
 				src_port = udp_header.src_port;
 				break;
@@ -348,6 +370,16 @@ namespace Kernel
 					return {};
 				}
 				auto& tcp_header = ipv4_data.as<const TCPHeader>();
+				if (tcp_header.data_offset * sizeof(uint32_t) < sizeof(TCPHeader) || tcp_header.data_offset * sizeof(uint32_t) > ipv4_data.size())
+				{
+					dwarnln_if(DEBUG_IPV4, "Invalid TCP data offset");
+					return {};
+				}
+				if (!checksum_verified && !is_transport_checksum_valid(ipv4_header, ipv4_data))
+				{
+					dwarnln_if(DEBUG_IPV4, "TCP checksum failed");
+					return {};
+				}
 				dst_port = tcp_header.dst_port;
 				src_port = tcp_header.src_port;
 				break;
@@ -109,10 +109,11 @@ namespace Kernel
 
 				m_buffer_lock.unlock();
 
+				// packets never leave memory, checksums are not needed
 				NetworkManager::get().on_receive(*this, {
 					descriptor.addr,
 					descriptor.size,
-				});
+				}, true);
 
 				m_buffer_lock.lock();
 
@@ -1,7 +1,10 @@
 #include <BAN/Endianness.h>
 #include <kernel/Device/DeviceNumbers.h>
 #include <kernel/FS/DevFS/FileSystem.h>
+#include <kernel/Networking/IPv4Layer.h>
 #include <kernel/Networking/NetworkInterface.h>
+#include <kernel/Networking/TCPSocket.h>
+#include <kernel/Networking/UDPSocket.h>
 
 #include <netinet/in.h>
 #include <net/if.h>
@@ -45,6 +48,39 @@ namespace Kernel
 		}
 	}
 
+	BAN::Optional<NetworkInterface::TxChecksumInfo> NetworkInterface::get_tx_checksum_info(BAN::ConstByteSpan frame)
+	{
+		if (frame.size() < sizeof(EthernetHeader) + sizeof(IPv4Header))
+			return {};
+		if (frame.as<const EthernetHeader>().ether_type != EtherType::IPv4)
+			return {};
+
+		const auto& ipv4_header = frame.slice(sizeof(EthernetHeader)).as<const IPv4Header>();
+		const uint16_t start = sizeof(EthernetHeader) + (ipv4_header.version_IHL & 0x0F) * 4;
+
+		uint16_t offset;
+		switch (ipv4_header.protocol)
+		{
+			case NetworkProtocol::TCP:
+				offset = start + offsetof(TCPHeader, checksum);
+				break;
+			case NetworkProtocol::UDP:
+				offset = start + offsetof(UDPHeader, checksum);
+				break;
+			default:
+				return {};
+		}
+
+		if (offset + sizeof(uint16_t) > frame.size())
+			return {};
+
+		return TxChecksumInfo {
+			.protocol = ipv4_header.protocol,
+			.start = start,
+			.offset = offset,
+		};
+	}
+
 	BAN::ErrorOr<long> NetworkInterface::ioctl_impl(int request, void* arg)
 	{
 		if (arg == nullptr)
@@ -1,37 +1,88 @@
 #include <kernel/Networking/NetworkLayer.h>
 
+#include <string.h>
+
 namespace Kernel
 {
 
-	uint16_t calculate_internet_checksum(BAN::ConstByteSpan buffer)
+	// kernel is built without simd registers, so sum 32 bit words into a 64 bit
+	// accumulator and fold the carries only once at the end
+	static uint64_t sum_buffer(const uint8_t* data, size_t size)
 	{
-		return calculate_internet_checksum({ &buffer, 1 });
+		uint64_t sum = 0;
+
+		for (; size >= 16; data += 16, size -= 16)
+		{
+			uint32_t words[4];
+			memcpy(words, data, sizeof(words));
+			sum += words[0];
+			sum += words[1];
+			sum += words[2];
+			sum += words[3];
+		}
+
+		for (; size >= 4; data += 4, size -= 4)
+		{
+			uint32_t word;
+			memcpy(&word, data, sizeof(word));
+			sum += word;
+		}
+
+		if (size >= 2)
+		{
+			uint16_t word;
+			memcpy(&word, data, sizeof(word));
+			sum += word;
+			data += 2;
+			size -= 2;
+		}
+
+		if (size)
+			sum += data[0];
+
+		return sum;
 	}
 
-	uint16_t calculate_internet_checksum(BAN::Span<const BAN::ConstByteSpan> buffers)
+	static uint16_t fold_sum(uint64_t sum)
 	{
-		uint32_t checksum = 0;
+		while (sum >> 16)
+			sum = (sum & 0xFFFF) + (sum >> 16);
+		return sum;
+	}
 
-		for (size_t i = 0; i < buffers.size(); i++)
+	static uint16_t sum_buffers(BAN::Span<const BAN::ConstByteSpan> buffers)
+	{
+		uint64_t checksum = 0;
+		size_t offset = 0;
+
+		for (const auto& buffer : buffers)
 		{
-			auto buffer = buffers[i];
-
-			const uint16_t* buffer_u16 = reinterpret_cast<const uint16_t*>(buffer.data());
-			for (size_t j = 0; j < buffer.size() / 2; j++)
-				checksum += buffer_u16[j];
-
-			if (buffer.size() % 2)
-			{
-				// NOTE: we only allow last buffer to be odd-length
-				ASSERT(i == buffers.size() - 1);
-				checksum += buffer[buffer.size() - 1];
-			}
+			uint16_t buffer_sum = fold_sum(sum_buffer(buffer.data(), buffer.size()));
+
+			// buffer starting at an odd offset has its bytes in swapped positions within the 16 bit words
+			if (offset % 2)
+				buffer_sum = (buffer_sum << 8) | (buffer_sum >> 8);
+
+			checksum += buffer_sum;
+			offset += buffer.size();
 		}
 
-		while (checksum >> 16)
-			checksum = (checksum & 0xFFFF) + (checksum >> 16);
+		return fold_sum(checksum);
+	}
 
-		return BAN::host_to_network_endian<uint16_t>(~checksum);
+	uint16_t calculate_internet_checksum(BAN::ConstByteSpan buffer)
+	{
+		return calculate_internet_checksum({ &buffer, 1 });
+	}
+
+	uint16_t calculate_internet_checksum(BAN::Span<const BAN::ConstByteSpan> buffers)
+	{
+		return BAN::host_to_network_endian<uint16_t>(~sum_buffers(buffers));
+	}
+
+	uint16_t calculate_partial_internet_checksum(BAN::ConstByteSpan buffer)
+	{
+		return BAN::host_to_network_endian<uint16_t>(sum_buffers({ &buffer, 1 }));
 	}
 
 }
@@ -7,6 +7,7 @@
 #include <kernel/Networking/Loopback.h>
 #include <kernel/Networking/NetworkManager.h>
 #include <kernel/Networking/RTL8169/RTL8169.h>
+#include <kernel/Networking/TCPEngine.h>
 #include <kernel/Networking/TCPSocket.h>
 #include <kernel/Networking/UDPSocket.h>
 #include <kernel/Networking/UNIX/Socket.h>
@@ -22,6 +23,7 @@ namespace Kernel
 		auto manager = TRY(BAN::UniqPtr<NetworkManager>::create());
 		TRY(manager->add_interface(TRY(LoopbackInterface::create())));
 		manager->m_ipv4_layer = TRY(IPv4Layer::create());
+		TRY(TCPEngine::initialize());
 		s_instance = BAN::move(manager);
 		return {};
 	}
@@ -148,7 +150,7 @@ namespace Kernel
 		return {};
 	}
 
-	void NetworkManager::on_receive(NetworkInterface& interface, BAN::ConstByteSpan packet)
+	void NetworkManager::on_receive(NetworkInterface& interface, BAN::ConstByteSpan packet, bool checksum_verified)
 	{
 		if (packet.size() < sizeof(EthernetHeader))
 			return;
@@ -163,7 +165,7 @@ namespace Kernel
 					dwarnln("ARP: {}", ret.error());
 				break;
 			case EtherType::IPv4:
-				if (auto ret = m_ipv4_layer->handle_ipv4_packet(interface, packet_data); ret.is_error())
+				if (auto ret = m_ipv4_layer->handle_ipv4_packet(interface, packet_data, checksum_verified); ret.is_error())
 					dwarnln("IPv4; {}", ret.error());
 				break;
 			default:
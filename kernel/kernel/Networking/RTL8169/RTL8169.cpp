@@ -1,5 +1,6 @@
 #include <kernel/Lock/SpinLockAsMutex.h>
 #include <kernel/Networking/NetworkManager.h>
+#include <kernel/Networking/NetworkSocket.h>
 #include <kernel/Networking/RTL8169/Definitions.h>
 #include <kernel/Networking/RTL8169/RTL8169.h>
 #include <kernel/Timer/Timer.h>
@@ -10,6 +11,22 @@ namespace Kernel
 	// each buffer is 7440 bytes + padding = 8192
 	constexpr size_t s_buffer_size = 8192;
 
+	// maximum number of packets processed before other threads are allowed to run
+	static constexpr size_t s_rx_budget = 64;
+
+	static constexpr uint16_t s_rx_interrupts =
+		RTL8169_IR_ROK
+		| RTL8169_IR_RER
+		| RTL8169_IR_RDU
+		| RTL8169_IR_FVOW;
+
+	static constexpr uint16_t s_interrupts =
+		s_rx_interrupts
+		| RTL8169_IR_TOK
+		| RTL8169_IR_TER
+		| RTL8169_IR_LinkChg
+		| RTL8169_IR_TDU;
+
 	bool RTL8169::probe(PCI::Device& pci_device)
 	{
 		if (pci_device.vendor_id() != 0x10ec)
@@ -74,6 +91,8 @@ namespace Kernel
 		auto* thread = TRY(Thread::create_kernel([](void* rtl8169_ptr) {
 			static_cast<RTL8169*>(rtl8169_ptr)->receive_thread();
 		}, this));
+		// keep packet processing responsive under cpu load
+		thread->set_nice(-10);
 		if (auto ret = Processor::scheduler().add_thread(thread); ret.is_error())
 		{
 			delete thread;
@@ -139,6 +158,9 @@ namespace Kernel
 		// configure max rx packet size
 		m_io_bar_region->write16(RTL8169_IO_RMS, RTL8169_RMS_MAX);
 
+		// report rx checksum status in descriptors
+		m_io_bar_region->write16(RTL8169_IO_CPlusCmd, m_io_bar_region->read16(RTL8169_IO_CPlusCmd) | RTL8169_CPlusCmd_RxChkSum);
+
 		return {};
 	}
 
@@ -172,6 +194,10 @@ namespace Kernel
 		// configure max tx packet size
 		m_io_bar_region->write8(RTL8169_IO_MTPS, RTL8169_MTPS_MAX);
 
+		// checksum bits of tx descriptors moved and differ between revisions of 8168 and newer chips,
+		// only use the original 8169 layout
+		m_tx_checksum_offload = (m_pci_device.device_id() == 0x8169);
+
 		return {};
 	}
 
@@ -180,21 +206,23 @@ namespace Kernel
 		TRY(m_pci_device.reserve_interrupts(1));
 		m_pci_device.enable_interrupt(0, *this);
 
-		m_io_bar_region->write16(RTL8169_IO_IMR,
-			RTL8169_IR_ROK
-			| RTL8169_IR_RER
-			| RTL8169_IR_TOK
-			| RTL8169_IR_TER
-			| RTL8169_IR_RDU
-			| RTL8169_IR_LinkChg
-			| RTL8169_IR_FVOW
-			| RTL8169_IR_TDU
-		);
+		// interrupt mitigation, bits 15:12 tx timer, 11:8 tx packets, 7:4 rx timer, 3:0 rx packets
+		m_io_bar_region->write16(RTL8169_IO_IntrMitigate, 0x5151);
+
+		m_io_bar_region->write16(RTL8169_IO_IMR, s_interrupts);
 		m_io_bar_region->write16(RTL8169_IO_ISR, 0xFFFF);
 
 		return {};
 	}
 
+	uint32_t RTL8169::capabilities() const
+	{
+		uint32_t result = RxChecksum;
+		if (m_tx_checksum_offload)
+			result |= TxChecksum;
+		return result;
+	}
+
 	int RTL8169::link_speed()
 	{
 		if (!link_up())
@@ -243,8 +271,26 @@ namespace Kernel
 			packet_size += buffer.size();
 		}
 
+		uint32_t command = RTL8169_DESC_CMD_OWN | RTL8169_DESC_CMD_LS | RTL8169_DESC_CMD_FS;
+
+		if (m_tx_checksum_offload)
+		{
+			if (auto checksum_info = get_tx_checksum_info({ tx_buffer, packet_size }); checksum_info.has_value())
+			{
+				// hardware padding of short frames can corrupt offloaded checksums
+				if (packet_size < 60)
+				{
+					memset(tx_buffer + packet_size, 0, 60 - packet_size);
+					packet_size = 60;
+				}
+
+				command |= RTL8169_DESC_CMD_IPCS;
+				command |= (checksum_info->protocol == NetworkProtocol::TCP) ? RTL8169_DESC_CMD_TCPCS : RTL8169_DESC_CMD_UDPCS;
+			}
+		}
+
 		// give packet ownership to NIC
-		uint32_t command = packet_size | RTL8169_DESC_CMD_OWN | RTL8169_DESC_CMD_LS | RTL8169_DESC_CMD_FS;
+		command |= packet_size;
 		if (tx_current >= m_tx_descriptor_count - 1)
 			command |= RTL8169_DESC_CMD_EOR;
 		descriptor.command = command;
@@ -255,45 +301,87 @@ namespace Kernel
 		return {};
 	}
 
-	void RTL8169::receive_thread()
+	size_t RTL8169::process_rx_batch(size_t budget)
 	{
-		SpinLockGuard _(m_lock);
+		auto* descriptors = reinterpret_cast<volatile RTL8169Descriptor*>(m_rx_descriptor_region->vaddr());
+
+		size_t processed = 0;
+		for (; processed < budget; processed++)
+		{
+			auto& descriptor = descriptors[m_rx_current];
+			if (descriptor.command & RTL8169_DESC_CMD_OWN)
+				break;
+
+			// packet buffer can only hold single packet, so we should not receive any multi-descriptor packets
+			ASSERT((descriptor.command & RTL8169_DESC_CMD_LS) && (descriptor.command & RTL8169_DESC_CMD_FS));
+
+			const uint16_t packet_length = descriptor.command & 0x3FFF;
+			if (packet_length > s_buffer_size)
+				dwarnln("Got {} bytes to {} byte buffer", packet_length, s_buffer_size);
+			else if (descriptor.command & (1u << 21))
+				; // descriptor has an error
+			else
+			{
+				// failed checksums are left for the stack to reject
+				const uint32_t checksum_status = descriptor.command & (RTL8169_DESC_CMD_PID_MASK | RTL8169_DESC_CMD_IPF | RTL8169_DESC_CMD_UDPF | RTL8169_DESC_CMD_TCPF);
+				const bool checksum_verified = (checksum_status == RTL8169_DESC_CMD_PID_TCP || checksum_status == RTL8169_DESC_CMD_PID_UDP);
+
+				NetworkManager::get().on_receive(*this, BAN::ConstByteSpan {
+					reinterpret_cast<const uint8_t*>(m_rx_buffer_region->vaddr() + m_rx_current * s_buffer_size),
+					packet_length
+				}, checksum_verified);
+			}
+
+			m_rx_current = (m_rx_current + 1) % m_rx_descriptor_count;
+
+			descriptor.command = descriptor.command | RTL8169_DESC_CMD_OWN;
+		}
+
+		return processed;
+	}
+
+	void RTL8169::poll_rx()
+	{
+		// receive interrupts are masked while polling, see handle_irq()
 
 		while (!m_thread_should_die)
 		{
-			for (;;)
+			// budget exhausted, keep polling but let other threads run first
+			if (process_rx_batch(s_rx_budget) == s_rx_budget)
 			{
-				auto& descriptor = reinterpret_cast<volatile RTL8169Descriptor*>(m_rx_descriptor_region->vaddr())[m_rx_current];
-				if (descriptor.command & RTL8169_DESC_CMD_OWN)
-					break;
-
-				// packet buffer can only hold single packet, so we should not receive any multi-descriptor packets
-				ASSERT((descriptor.command & RTL8169_DESC_CMD_LS) && (descriptor.command & RTL8169_DESC_CMD_FS));
-
-				const uint16_t packet_length = descriptor.command & 0x3FFF;
-				if (packet_length > s_buffer_size)
-					dwarnln("Got {} bytes to {} byte buffer", packet_length, s_buffer_size);
-				else if (descriptor.command & (1u << 21))
-					; // descriptor has an error
-				else
-				{
-					m_lock.unlock(InterruptState::Enabled);
+				Processor::yield();
+				continue;
+			}
 
-					NetworkManager::get().on_receive(*this, BAN::ConstByteSpan {
-						reinterpret_cast<const uint8_t*>(m_rx_buffer_region->vaddr() + m_rx_current * s_buffer_size),
-						packet_length
-					});
+			m_io_bar_region->write16(RTL8169_IO_IMR, s_interrupts);
 
-					m_lock.lock();
-				}
+			// packet may have arrived before interrupts were enabled
+			auto& descriptor = reinterpret_cast<volatile RTL8169Descriptor*>(m_rx_descriptor_region->vaddr())[m_rx_current];
+			if (descriptor.command & RTL8169_DESC_CMD_OWN)
+				break;
 
-				m_rx_current = (m_rx_current + 1) % m_rx_descriptor_count;
+			m_io_bar_region->write16(RTL8169_IO_IMR, s_interrupts & ~s_rx_interrupts);
+		}
+	}
 
-				descriptor.command = descriptor.command | RTL8169_DESC_CMD_OWN;
+	void RTL8169::receive_thread()
+	{
+		SpinLockGuard _(m_lock);
+
+		while (!m_thread_should_die)
+		{
+			if (!m_rx_pending)
+			{
+				SpinLockAsMutex smutex(m_lock, InterruptState::Enabled);
+				m_thread_blocker.block_indefinite(&smutex);
+				continue;
 			}
 
-			SpinLockAsMutex smutex(m_lock, InterruptState::Enabled);
-			m_thread_blocker.block_indefinite(&smutex);
+			m_rx_pending = false;
+
+			m_lock.unlock(InterruptState::Enabled);
+			poll_rx();
+			m_lock.lock();
 		}
 
 		m_thread_is_dead = true;
@@ -310,7 +398,16 @@ namespace Kernel
 			dprintln("link status -> {}", m_link_up.load());
 		}
 
-		if (interrupt_status & (RTL8169_IR_TOK | RTL8169_IR_ROK))
+		if (interrupt_status & s_rx_interrupts)
+		{
+			// mask receive interrupts until the receive thread has emptied the ring
+			m_io_bar_region->write16(RTL8169_IO_IMR, s_interrupts & ~s_rx_interrupts);
+
+			SpinLockGuard _(m_lock);
+			m_rx_pending = true;
+			m_thread_blocker.unblock();
+		}
+		else if (interrupt_status & RTL8169_IR_TOK)
 		{
 			SpinLockGuard _(m_lock);
 			m_thread_blocker.unblock();
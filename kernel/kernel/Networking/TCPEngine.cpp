@@ -0,0 +1,276 @@
+#include <kernel/Lock/LockGuard.h>
+#include <kernel/Networking/TCPEngine.h>
+#include <kernel/Networking/TCPSocket.h>
+#include <kernel/Processor.h>
+#include <kernel/Timer/Timer.h>
+
+namespace Kernel
+{
+
+	static BAN::UniqPtr<TCPEngine> s_instance;
+
+	BAN::ErrorOr<void> TCPEngine::initialize()
+	{
+		ASSERT(!s_instance);
+
+		auto engine = TRY(BAN::UniqPtr<TCPEngine>::create());
+
+		const size_t worker_count = BAN::Math::max<size_t>(Processor::count(), 1);
+		TRY(engine->m_workers.reserve(worker_count));
+
+		const uint64_t current_ms = SystemTimer::get().ms_since_boot();
+		for (size_t i = 0; i < worker_count; i++)
+		{
+			auto worker = TRY(BAN::UniqPtr<Worker>::create());
+			worker->processor_index = i;
+			worker->wheel_time_ms = current_ms - current_ms % s_timer_tick_ms;
+			TRY(engine->m_workers.push_back(BAN::move(worker)));
+		}
+
+		for (auto& worker : engine->m_workers)
+		{
+			worker->thread = TRY(Thread::create_kernel(
+				[](void* worker_ptr)
+				{
+					TCPEngine::get().worker_task(*static_cast<Worker*>(worker_ptr));
+				}, worker.ptr()
+			));
+
+			if (Processor::count() > 0)
+			{
+				cpu_set_t affinity;
+				CPU_ZERO(&affinity);
+				CPU_SET(worker->processor_index, &affinity);
+				worker->thread->set_affinity(affinity);
+			}
+
+			if (auto ret = Processor::scheduler().add_thread(worker->thread); ret.is_error())
+			{
+				delete worker->thread;
+				return ret.release_error();
+			}
+		}
+
+		s_instance = BAN::move(engine);
+
+		dprintln("TCP engine initialized with {} workers", worker_count);
+
+		return {};
+	}
+
+	TCPEngine& TCPEngine::get()
+	{
+		ASSERT(s_instance);
+		return *s_instance;
+	}
+
+	void TCPEngine::add_socket(TCPSocket& socket)
+	{
+		// prefer the worker of the processor creating the socket
+		size_t worker_index = Processor::current_index();
+		if (worker_index >= m_workers.size())
+			worker_index = m_next_worker++ % m_workers.size();
+
+		auto& node = socket.m_engine_node;
+		ASSERT(!node.registered);
+		node.worker_index = worker_index;
+
+		socket.ref();
+
+		{
+			auto& worker = *m_workers[worker_index];
+			LockGuard _(worker.mutex);
+			node.registered = true;
+		}
+
+		schedule(socket);
+	}
+
+	void TCPEngine::schedule(TCPSocket& socket)
+	{
+		auto& node = socket.m_engine_node;
+		auto& worker = *m_workers[node.worker_index];
+
+		LockGuard _(worker.mutex);
+
+		if (!node.registered || node.queued)
+			return;
+
+		node.queued = true;
+		node.queue_next = nullptr;
+		if (worker.queue_tail)
+			worker.queue_tail->m_engine_node.queue_next = &socket;
+		else
+			worker.queue_head = &socket;
+		worker.queue_tail = &socket;
+
+		worker.thread_blocker.unblock();
+	}
+
+	void TCPEngine::worker_task(Worker& worker)
+	{
+		for (;;)
+		{
+			advance_timers(worker, SystemTimer::get().ms_since_boot());
+
+			TCPSocket* socket = nullptr;
+
+			{
+				LockGuard _(worker.mutex);
+
+				if (worker.queue_head == nullptr)
+				{
+					if (worker.armed_timers)
+					{
+						// slot of a tick is processed once the tick has passed
+						const uint64_t timer_ms = BAN::Math::max(worker.next_timer_ms, worker.wheel_time_ms);
+						worker.thread_blocker.block_with_wake_time_ms(timer_ms - timer_ms % s_timer_tick_ms + s_timer_tick_ms, &worker.mutex);
+					}
+					else
+					{
+						worker.thread_blocker.block_indefinite(&worker.mutex);
+					}
+					continue;
+				}
+
+				socket = worker.queue_head;
+				worker.queue_head = socket->m_engine_node.queue_next;
+				if (worker.queue_head == nullptr)
+					worker.queue_tail = nullptr;
+				socket->m_engine_node.queue_next = nullptr;
+				socket->m_engine_node.queued = false;
+			}
+
+			// socket was unregistered while it was queued, this was the last engine reference to it
+			if (!socket->m_engine_node.registered)
+			{
+				socket->unref();
+				continue;
+			}
+
+			process_socket(worker, *socket);
+		}
+	}
+
+	void TCPEngine::process_socket(Worker& worker, TCPSocket& socket)
+	{
+		const auto wake_time_ms = socket.process_work();
+		if (wake_time_ms.has_value())
+			return arm_timer(worker, socket, wake_time_ms.value());
+
+		// connection is closed, drop the engine's reference
+
+		disarm_timer(worker, socket);
+
+		{
+			LockGuard _(worker.mutex);
+			socket.m_engine_node.registered = false;
+			if (socket.m_engine_node.queued)
+				return;
+		}
+
+		socket.unref();
+	}
+
+	void TCPEngine::advance_timers(Worker& worker, uint64_t current_ms)
+	{
+		const uint64_t current_tick_ms = current_ms - current_ms % s_timer_tick_ms;
+
+		// nothing can expire before the earliest armed timer
+		if (worker.armed_timers == 0 || current_ms < worker.next_timer_ms)
+		{
+			worker.wheel_time_ms = BAN::Math::max(worker.wheel_time_ms, current_tick_ms);
+			return;
+		}
+
+		// every slot has to be walked at most once, even if the worker was not run for a long time
+		for (size_t i = 0; i < s_timer_slots && worker.wheel_time_ms < current_tick_ms; i++)
+		{
+			const size_t slot = (worker.wheel_time_ms / s_timer_tick_ms) % s_timer_slots;
+
+			for (auto* socket = worker.timer_wheel[slot]; socket;)
+			{
+				auto* next = socket->m_engine_node.timer_next;
+				if (socket->m_engine_node.timer_ms <= current_ms)
+				{
+					disarm_timer(worker, *socket);
+					schedule(*socket);
+				}
+				socket = next;
+			}
+
+			worker.wheel_time_ms += s_timer_tick_ms;
+		}
+
+		if (worker.wheel_time_ms < current_tick_ms)
+			worker.wheel_time_ms = current_tick_ms;
+
+		update_next_timer(worker);
+	}
+
+	void TCPEngine::update_next_timer(Worker& worker)
+	{
+		worker.next_timer_ms = UINT64_MAX;
+		if (worker.armed_timers == 0)
+			return;
+
+		// start of the first non-empty slot is a lower bound for every timer in the wheel,
+		// timers that are rounds ahead only cause an extra wake up
+		for (size_t i = 0; i < s_timer_slots; i++)
+		{
+			const uint64_t slot_time_ms = worker.wheel_time_ms + i * s_timer_tick_ms;
+			if (worker.timer_wheel[(slot_time_ms / s_timer_tick_ms) % s_timer_slots] == nullptr)
+				continue;
+			worker.next_timer_ms = slot_time_ms;
+			return;
+		}
+
+		ASSERT_NOT_REACHED();
+	}
+
+	void TCPEngine::arm_timer(Worker& worker, TCPSocket& socket, uint64_t wake_time_ms)
+	{
+		disarm_timer(worker, socket);
+
+		// timers can't be placed on ticks that have already been processed
+		const uint64_t slot_time_ms = BAN::Math::max(wake_time_ms, worker.wheel_time_ms);
+		const size_t slot = (slot_time_ms / s_timer_tick_ms) % s_timer_slots;
+
+		auto& node = socket.m_engine_node;
+		node.timer_armed = true;
+		node.timer_slot = slot;
+		node.timer_ms = wake_time_ms;
+		node.timer_prev = nullptr;
+		node.timer_next = worker.timer_wheel[slot];
+		if (node.timer_next)
+			node.timer_next->m_engine_node.timer_prev = &socket;
+		worker.timer_wheel[slot] = &socket;
+
+		worker.armed_timers++;
+		worker.next_timer_ms = BAN::Math::min(worker.next_timer_ms, wake_time_ms);
+	}
+
+	void TCPEngine::disarm_timer(Worker& worker, TCPSocket& socket)
+	{
+		auto& node = socket.m_engine_node;
+		if (!node.timer_armed)
+			return;
+
+		if (node.timer_prev)
+			node.timer_prev->m_engine_node.timer_next = node.timer_next;
+		else
+		{
+			ASSERT(worker.timer_wheel[node.timer_slot] == &socket);
+			worker.timer_wheel[node.timer_slot] = node.timer_next;
+		}
+		if (node.timer_next)
+			node.timer_next->m_engine_node.timer_prev = node.timer_prev;
+
+		node.timer_armed = false;
+		node.timer_prev = nullptr;
+		node.timer_next = nullptr;
+
+		worker.armed_timers--;
+	}
+
+}
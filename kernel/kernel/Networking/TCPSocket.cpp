@@ -20,17 +20,63 @@ namespace Kernel
 		NOP					= 0x01,
 		MaximumSeqmentSize	= 0x02,
 		WindowScale			= 0x03,
+		SackPermitted		= 0x04,
+		Sack				= 0x05,
 	};
 
 	static constexpr size_t s_recv_window_buffer_size = 16 * PAGE_SIZE;
 	static constexpr size_t s_send_window_buffer_size = 16 * PAGE_SIZE;
 
-	// allows upto 1 MiB windows
-	static constexpr uint8_t s_window_shift = 4;
+	// limits for SO_RCVBUF, SO_SNDBUF and autotuning
+	static constexpr size_t s_min_window_buffer_size = 2 * PAGE_SIZE;
+	static constexpr size_t s_max_window_buffer_size = 4 * 1024 * 1024;
+
+	// allows upto 4 MiB windows
+	static constexpr uint8_t s_window_shift = 6;
+	static_assert((size_t)0xFFFF << s_window_shift >= s_max_window_buffer_size - PAGE_SIZE);
 
 	// https://www.rfc-editor.org/rfc/rfc1122   4.2.2.6
 	static constexpr uint16_t s_default_mss = 536;
 
+	// https://www.rfc-editor.org/rfc/rfc1122   4.2.3.2
+	static constexpr uint64_t s_delayed_ack_ms = 40;
+
+	static constexpr uint64_t s_time_wait_ms = 30'000;
+
+	// https://www.rfc-editor.org/rfc/rfc6298
+	// NOTE: minimum is 200 ms instead of the recommended 1 second, same as other stacks
+	static constexpr uint32_t s_initial_rto_ms = 1000;
+	static constexpr uint32_t s_min_rto_ms = 200;
+	static constexpr uint32_t s_max_rto_ms = 60'000;
+	static constexpr uint32_t s_rto_granularity_us = 10'000;
+
+	// https://www.rfc-editor.org/rfc/rfc5681   3.2
+	static constexpr uint32_t s_dup_ack_threshold = 3;
+
+	// largest window possible with window scaling
+	static constexpr uint32_t s_max_cwnd = 0xFFFF << 14;
+
+	// SYN options: MSS, window scale and SACK permitted padded with NOPs
+	static constexpr size_t s_syn_options_bytes = 12;
+
+	// https://www.rfc-editor.org/rfc/rfc2018   3
+	static constexpr size_t s_max_sent_sack_blocks = 3;
+
+	// sequence numbers wrap around, compare them modulo 2^32
+	// https://www.rfc-editor.org/rfc/rfc9293#section-3.4
+	static constexpr bool seq_lt(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+	static constexpr bool seq_le(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) <= 0; }
+	static constexpr bool seq_gt(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) > 0; }
+	static constexpr bool seq_ge(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) >= 0; }
+	static constexpr uint32_t seq_min(uint32_t a, uint32_t b) { return seq_lt(a, b) ? a : b; }
+	static constexpr uint32_t seq_max(uint32_t a, uint32_t b) { return seq_gt(a, b) ? a : b; }
+
+	// https://www.rfc-editor.org/rfc/rfc6928
+	static uint32_t initial_congestion_window(uint32_t mss)
+	{
+		return BAN::Math::min<uint32_t>(10 * mss, BAN::Math::max<uint32_t>(2 * mss, 14600));
+	}
+
 	BAN::ErrorOr<BAN::RefPtr<TCPSocket>> TCPSocket::create(NetworkLayer& network_layer, const Info& info)
 	{
 		auto socket = TRY(BAN::RefPtr<TCPSocket>::create(network_layer, info));
@@ -38,15 +84,7 @@ namespace Kernel
 		socket->m_recv_window.buffer = TRY(ByteRingBuffer::create(s_recv_window_buffer_size));
 		socket->m_recv_window.scale_shift = s_window_shift;
 		socket->m_send_window.buffer = TRY(ByteRingBuffer::create(s_send_window_buffer_size));
-		socket->m_thread = TRY(Thread::create_kernel(
-			[](void* socket_ptr)
-			{
-				reinterpret_cast<TCPSocket*>(socket_ptr)->process_task();
-			}, socket.ptr()
-		));
-		TRY(Processor::scheduler().add_thread(socket->m_thread));
-		// hack to keep socket alive until its process starts
-		socket->ref();
+		TCPEngine::get().add_socket(*socket);
 		return socket;
 	}
 
@@ -55,12 +93,13 @@ namespace Kernel
 	{
 		m_send_window.start_seq = Random::get_u32() & 0x7FFFFFFF;
 		m_send_window.current_seq = m_send_window.start_seq;
+		m_send_window.rto_ms = s_initial_rto_ms;
 	}
 
 	TCPSocket::~TCPSocket()
 	{
 		ASSERT(!is_bound());
-		ASSERT(m_thread == nullptr);
+		ASSERT(!m_engine_node.registered);
 		dprintln_if(DEBUG_TCP, "Socket destroyed");
 	}
 
@@ -97,13 +136,29 @@ namespace Kernel
 		return_inode->m_connection_info.emplace(connection.target);
 		return_inode->m_recv_window.start_seq = connection.target_start_seq;
 		return_inode->m_send_window.scale_shift = connection.window_scale;
-		return_inode->m_send_window.mss = connection.maximum_seqment_size;
+		return_inode->m_send_window.mss = BAN::Math::min(connection.maximum_seqment_size, return_inode->interface_mss(reinterpret_cast<const sockaddr*>(&connection.target.address), connection.target.address_len));
+		return_inode->m_send_window.cwnd = initial_congestion_window(return_inode->m_send_window.mss);
+		if (!m_recv_window.autotune)
+		{
+			if (auto ret = return_inode->resize_recv_buffer(m_recv_window.buffer->capacity()); ret.is_error())
+				dwarnln("could not resize receive buffer: {}", ret.error());
+			return_inode->m_recv_window.autotune = false;
+			return_inode->m_last_sent_window_size = return_inode->m_recv_window.buffer->capacity();
+		}
+		if (!m_send_window.autotune)
+		{
+			if (auto ret = return_inode->resize_send_buffer(m_send_window.buffer->capacity()); ret.is_error())
+				dwarnln("could not resize send buffer: {}", ret.error());
+			return_inode->m_send_window.autotune = false;
+		}
 		return_inode->m_next_flags = SYN | ACK;
 		return_inode->m_next_state = State::SynReceived;
 		if (!return_inode->m_connection_info->has_window_scale)
 			return_inode->m_recv_window.scale_shift = 0;
 		return_inode->m_mutex.unlock();
 
+		TCPEngine::get().schedule(*return_inode);
+
 		TRY(m_listen_children.emplace(listen_key, return_inode));
 
 		const uint64_t wake_time_ms = SystemTimer::get().ms_since_boot() + 5000;
@@ -151,13 +206,14 @@ namespace Kernel
 		if (!is_bound())
 			TRY(m_network_layer.bind_socket_with_target(this, address, address_len));
 
-		m_connection_info.emplace(sockaddr_storage {}, address_len, true);
+		m_connection_info.emplace(sockaddr_storage {}, address_len, true, true);
 		memcpy(&m_connection_info->address, address, address_len);
 
 		m_next_flags = SYN;
 		if (m_network_layer.sendto(*this, {}, address, address_len).is_error())
 		{
 			set_connection_as_closed();
+			TCPEngine::get().schedule(*this);
 			return BAN::Error::from_errno(ECONNREFUSED);
 		}
 
@@ -239,6 +295,7 @@ namespace Kernel
 		{
 			m_recv_window.buffer->pop(total_recv);
 			m_recv_window.start_seq += total_recv;
+			autotune_recv_buffer();
 		}
 
 		const size_t update_window_threshold = m_recv_window.buffer->capacity() / 8;
@@ -252,7 +309,7 @@ namespace Kernel
 		if (should_update_window_size || m_should_send_zero_window)
 		{
 			m_should_send_window_update = true;
-			m_thread_blocker.unblock();
+			TCPEngine::get().schedule(*this);
 		}
 
 		return total_recv;
@@ -274,7 +331,7 @@ namespace Kernel
 		if (!m_has_connected)
 			return BAN::Error::from_errno(ENOTCONN);
 
-		while (m_send_window.buffer->full())
+		while (m_send_window.buffer->full() || m_send_window.space_reserved)
 		{
 			if (m_state != State::Established)
 				return return_with_maybe_zero();
@@ -294,11 +351,57 @@ namespace Kernel
 			total_sent += nsend;
 		}
 
-		m_thread_blocker.unblock();
+		TCPEngine::get().schedule(*this);
 
 		return total_sent;
 	}
 
+	BAN::ErrorOr<size_t> TCPSocket::sendfile_impl(Inode& source, off_t offset, size_t count, int flags)
+	{
+		if (flags & ~(MSG_NOSIGNAL | MSG_DONTWAIT))
+		{
+			dwarnln("TODO: sendfile with flags 0x{H}", flags);
+			return BAN::Error::from_errno(ENOTSUP);
+		}
+
+		LockGuard _(m_mutex);
+
+		if (!m_has_connected)
+			return BAN::Error::from_errno(ENOTCONN);
+
+		while (m_send_window.buffer->full() || m_send_window.space_reserved)
+		{
+			if (m_state != State::Established)
+				return return_with_maybe_zero();
+			if (flags & MSG_DONTWAIT)
+				return BAN::Error::from_errno(EAGAIN);
+			TRY(Thread::current().block_or_eintr_indefinite(m_thread_blocker, &m_mutex));
+		}
+
+		// read straight into the send buffer, ring buffer is mapped twice so free space is contiguous.
+		// file read may block for a long time, so it is done without holding the socket's mutex.
+		// reserved free space is not written to by other senders and the buffer is not resized
+		auto free_space = m_send_window.buffer->get_free_space();
+		free_space = free_space.slice(0, BAN::Math::min(count, free_space.size()));
+
+		m_send_window.space_reserved = true;
+		m_mutex.unlock();
+		auto nread_or_error = source.read(offset, free_space);
+		m_mutex.lock();
+		m_send_window.space_reserved = false;
+		m_thread_blocker.unblock();
+
+		if (nread_or_error.is_error())
+			return nread_or_error.release_error();
+		const size_t nread = nread_or_error.value();
+		m_send_window.buffer->commit_free_space(nread);
+
+		if (nread > 0)
+			TCPEngine::get().schedule(*this);
+
+		return nread;
+	}
+
 	BAN::ErrorOr<void> TCPSocket::getpeername_impl(sockaddr* address, socklen_t* address_len)
 	{
 		LockGuard _(m_mutex);
@@ -315,6 +418,9 @@ namespace Kernel
 	{
 		LockGuard _(m_mutex);
 
+		if (level == IPPROTO_TCP && option == TCP_INFO)
+			return get_tcp_info(value, value_len);
+
 		int result;
 
 		switch (level)
@@ -329,7 +435,7 @@ namespace Kernel
 						result = 0;
 						break;
 					case SO_SNDBUF:
-						result = m_send_window.scaled_size();
+						result = m_send_window.buffer->capacity();
 						break;
 					case SO_RCVBUF:
 						result = m_recv_window.buffer->capacity();
@@ -345,6 +451,9 @@ namespace Kernel
 					case TCP_NODELAY:
 						result = m_no_delay;
 						break;
+					case TCP_MAXSEG:
+						result = m_send_window.mss ? m_send_window.mss : s_default_mss;
+						break;
 					default:
 						dwarnln("getsockopt(IPPROTO_TCP, {})", option);
 						return BAN::Error::from_errno(ENOPROTOOPT);
@@ -376,6 +485,44 @@ namespace Kernel
 							return BAN::Error::from_errno(EINVAL);
 						m_keep_alive = *static_cast<const int*>(value);
 						break;
+					case SO_RCVBUF:
+					{
+						if (value_len != sizeof(int))
+							return BAN::Error::from_errno(EINVAL);
+						const int new_rcvbuf = *static_cast<const int*>(value);
+						if (new_rcvbuf < 0)
+							return BAN::Error::from_errno(EINVAL);
+						// advertised window can't be shrunk once it has been sent
+						const bool has_advertised = (m_state != State::Closed && m_state != State::Listen);
+						if (!has_advertised || static_cast<size_t>(new_rcvbuf) > m_recv_window.buffer->capacity())
+						{
+							TRY(resize_recv_buffer(new_rcvbuf));
+							if (!has_advertised)
+								m_last_sent_window_size = m_recv_window.buffer->capacity();
+							else
+							{
+								m_should_send_window_update = true;
+								TCPEngine::get().schedule(*this);
+							}
+						}
+						m_recv_window.autotune = false;
+						break;
+					}
+					case SO_SNDBUF:
+					{
+						if (value_len != sizeof(int))
+							return BAN::Error::from_errno(EINVAL);
+						const int new_sndbuf = *static_cast<const int*>(value);
+						if (new_sndbuf < 0)
+							return BAN::Error::from_errno(EINVAL);
+						while (m_send_window.space_reserved)
+							TRY(Thread::current().block_or_eintr_indefinite(m_thread_blocker, &m_mutex));
+						TRY(resize_send_buffer(new_sndbuf));
+						m_send_window.autotune = false;
+						epoll_notify(EPOLLOUT);
+						m_thread_blocker.unblock();
+						break;
+					}
 					default:
 						dwarnln("setsockopt(SOL_SOCKET, {})", option);
 						return BAN::Error::from_errno(ENOPROTOOPT);
@@ -485,36 +632,131 @@ namespace Kernel
 			header.options[Off + 1] = 0x03;
 			header.options[Off + 2] = value;
 		}
+		else if constexpr(Op == TCPOption::SackPermitted)
+		{
+			header.options[Off + 0] = Op;
+			header.options[Off + 1] = 0x02;
+		}
+	}
+
+	static void write_u32_network_endian(uint8_t* dst, uint32_t value)
+	{
+		dst[0] = value >> 24;
+		dst[1] = value >> 16;
+		dst[2] = value >>  8;
+		dst[3] = value;
+	}
+
+	static uint32_t read_u32_network_endian(const uint8_t* src)
+	{
+		return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
 	}
 
 	struct ParsedTCPOptions
 	{
 		BAN::Optional<uint16_t> maximum_seqment_size;
 		BAN::Optional<uint8_t> window_scale;
+		bool sack_permitted { false };
+		BAN::Array<TCPSackBlock, 4> sack_blocks;
+		size_t sack_block_count { 0 };
 	};
 	static ParsedTCPOptions parse_tcp_options(const TCPHeader& header)
 	{
 		ParsedTCPOptions result;
 
-		for (size_t i = 0; i < header.data_offset * sizeof(uint32_t) - sizeof(TCPHeader) - 1; i++)
+		if (header.data_offset * sizeof(uint32_t) < sizeof(TCPHeader))
+			return result;
+
+		const size_t options_size = header.data_offset * sizeof(uint32_t) - sizeof(TCPHeader);
+		for (size_t i = 0; i + 1 < options_size;)
 		{
 			if (header.options[i] == TCPOption::End)
 				break;
 			if (header.options[i] == TCPOption::NOP)
+			{
+				i++;
 				continue;
-			if (header.options[i] == TCPOption::MaximumSeqmentSize)
-				result.maximum_seqment_size = BAN::network_endian_to_host(*reinterpret_cast<const uint16_t*>(&header.options[i + 2]));
-			if (header.options[i] == TCPOption::WindowScale)
-				result.window_scale = header.options[i + 2];
-			if (header.options[i + 1] == 0)
+			}
+
+			const size_t length = header.options[i + 1];
+			if (length < 2 || i + length > options_size)
 				break;
-			i += header.options[i + 1] - 1;
+
+			switch (header.options[i])
+			{
+				case TCPOption::MaximumSeqmentSize:
+					if (length == 4)
+						result.maximum_seqment_size = BAN::network_endian_to_host(*reinterpret_cast<const uint16_t*>(&header.options[i + 2]));
+					break;
+				case TCPOption::WindowScale:
+					if (length == 3)
+						result.window_scale = header.options[i + 2];
+					break;
+				case TCPOption::SackPermitted:
+					result.sack_permitted = true;
+					break;
+				case TCPOption::Sack:
+					for (size_t j = 2; j + 8 <= length && result.sack_block_count < result.sack_blocks.size(); j += 8)
+					{
+						result.sack_blocks[result.sack_block_count++] = {
+							.start = read_u32_network_endian(&header.options[i + j + 0]),
+							.end   = read_u32_network_endian(&header.options[i + j + 4]),
+						};
+					}
+					break;
+			}
+
+			i += length;
 		}
 
 		return result;
 	}
 
-	void TCPSocket::get_protocol_header(BAN::ByteSpan header_buffer, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader pseudo_header)
+	// Adds [block.start, block.end) to sorted blocks merging it with overlapping or adjacent
+	// blocks. Returns false if there was no space for the new block.
+	template<size_t N>
+	static bool add_sack_block(BAN::Array<TCPSackBlock, N>& blocks, size_t& block_count, TCPSackBlock block)
+	{
+		for (size_t i = 0; i < block_count;)
+		{
+			if (seq_lt(blocks[i].end, block.start) || seq_gt(blocks[i].start, block.end))
+			{
+				i++;
+				continue;
+			}
+
+			block.start = seq_min(block.start, blocks[i].start);
+			block.end   = seq_max(block.end,   blocks[i].end);
+
+			for (size_t j = i + 1; j < block_count; j++)
+				blocks[j - 1] = blocks[j];
+			block_count--;
+		}
+
+		if (block_count >= N)
+			return false;
+
+		size_t index = 0;
+		while (index < block_count && seq_lt(blocks[index].start, block.start))
+			index++;
+		for (size_t i = block_count; i > index; i--)
+			blocks[i] = blocks[i - 1];
+		blocks[index] = block;
+		block_count++;
+
+		return true;
+	}
+
+	size_t TCPSocket::tcp_options_size() const
+	{
+		if (m_state == State::Closed || m_state == State::SynReceived)
+			return s_syn_options_bytes;
+		if (m_connection_info.has_value() && m_connection_info->has_sack && m_recv_window.ooo_block_count > 0)
+			return 4 + 8 * BAN::Math::min(m_recv_window.ooo_block_count, s_max_sent_sack_blocks);
+		return 0;
+	}
+
+	void TCPSocket::get_protocol_header(BAN::ByteSpan header_buffer, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader pseudo_header, bool checksum_offload)
 	{
 		ASSERT(m_next_flags);
 		ASSERT(m_mutex.locker() == Thread::current().tid());
@@ -522,24 +764,37 @@ namespace Kernel
 
 		m_last_sent_window_size = m_should_send_zero_window ? 0 : m_recv_window.buffer->free();
 
+		// receiver round trip time is the time it takes for the sender to fill the advertised window
+		if (m_recv_window.autotune && !m_recv_window.rtt_measuring && m_last_sent_window_size > 0 && m_state == State::Established)
+		{
+			m_recv_window.rtt_measuring = true;
+			m_recv_window.rtt_seq = m_recv_window.start_seq + m_recv_window.buffer->size() + m_last_sent_window_size;
+			m_recv_window.rtt_start_ms = SystemTimer::get().ms_since_boot();
+		}
+
+		const size_t options_size = tcp_options_size();
+
 		auto& header = header_buffer.as<TCPHeader>();
 		header = {
 			.src_port = bound_port(),
 			.dst_port = dst_port,
 			.seq_number = m_send_window.current_seq + m_send_window.has_ghost_byte,
 			.ack_number = m_recv_window.start_seq + m_recv_window.buffer->size() + m_recv_window.has_ghost_byte,
-			.data_offset = (sizeof(TCPHeader) + m_tcp_options_bytes) / sizeof(uint32_t),
+			.data_offset = static_cast<uint8_t>((sizeof(TCPHeader) + options_size) / sizeof(uint32_t)),
 			.flags = m_next_flags,
 			.window_size = BAN::Math::min<size_t>(0xFFFF, m_last_sent_window_size >> m_recv_window.scale_shift),
 			.checksum = 0,
 			.urgent_pointer = 0,
 		};
-		memset(header.options, 0, m_tcp_options_bytes);
+		memset(header.options, TCPOption::NOP, options_size);
 
 		if (header.flags & FIN)
 			m_send_window.has_ghost_byte = true;
 		m_next_flags = 0;
 
+		// every segment acknowledges everything received so far
+		m_unacked_segments = 0;
+
 		if (m_state == State::Closed || m_state == State::SynReceived)
 		{
 			const sockaddr_in target {
@@ -548,24 +803,52 @@ namespace Kernel
 				.sin_addr = { .s_addr = pseudo_header.dst_ipv4.raw },
 				.sin_zero = {},
 			};
-			auto interface = MUST(this->interface(reinterpret_cast<const sockaddr*>(&target), sizeof(target)));
-
-			add_tcp_header_option<0, TCPOption::MaximumSeqmentSize>(header, interface->payload_mtu() - m_network_layer.header_size() - protocol_header_size());
+			add_tcp_header_option<0, TCPOption::MaximumSeqmentSize>(header, interface_mss(reinterpret_cast<const sockaddr*>(&target), sizeof(target)));
 
 			if (m_connection_info->has_window_scale)
-				add_tcp_header_option<4, TCPOption::WindowScale>(header, m_recv_window.scale_shift);
+				add_tcp_header_option<5, TCPOption::WindowScale>(header, m_recv_window.scale_shift);
+			if (m_connection_info->has_sack)
+				add_tcp_header_option<10, TCPOption::SackPermitted>(header, 0);
 			header.window_size = BAN::Math::min<size_t>(0xFFFF, m_recv_window.buffer->capacity());
 
 			m_send_window.start_seq++;
 			m_send_window.current_seq = m_send_window.start_seq;
+			m_send_window.current_ack = m_send_window.start_seq;
+			m_send_window.max_seq = m_send_window.start_seq;
+		}
+		else if (options_size > 0)
+		{
+			// report out of order data, block with the latest segment has to be first
+			const auto& recv_window = m_recv_window;
+			const size_t block_count = (options_size - 4) / 8;
+
+			size_t first = 0;
+			for (size_t i = 0; i < recv_window.ooo_block_count; i++)
+				if (seq_le(recv_window.ooo_blocks[i].start, recv_window.ooo_recent_seq) && seq_lt(recv_window.ooo_recent_seq, recv_window.ooo_blocks[i].end))
+					first = i;
+
+			header.options[2] = TCPOption::Sack;
+			header.options[3] = 2 + 8 * block_count;
+			for (size_t i = 0, written = 0; written < block_count; i++)
+			{
+				const size_t index = (i == 0) ? first : (i <= first ? i - 1 : i);
+				write_u32_network_endian(&header.options[4 + 8 * written + 0], recv_window.ooo_blocks[index].start);
+				write_u32_network_endian(&header.options[4 + 8 * written + 4], recv_window.ooo_blocks[index].end);
+				written++;
+			}
 		}
 
-		const BAN::ConstByteSpan buffers[] {
-			BAN::ConstByteSpan::from(pseudo_header),
-			header_buffer,
-			payload,
-		};
-		header.checksum = calculate_internet_checksum({ buffers, sizeof(buffers) / sizeof(*buffers) });
+		if (checksum_offload)
+			header.checksum = calculate_partial_internet_checksum(BAN::ConstByteSpan::from(pseudo_header));
+		else
+		{
+			const BAN::ConstByteSpan buffers[] {
+				BAN::ConstByteSpan::from(pseudo_header),
+				header_buffer,
+				payload,
+			};
+			header.checksum = calculate_internet_checksum({ buffers, sizeof(buffers) / sizeof(*buffers) });
+		}
 
 		dprintln_if(DEBUG_TCP, "sending {} {8b}", (uint8_t)m_state, header.flags);
 		dprintln_if(DEBUG_TCP, "  ack {}", (uint32_t)header.ack_number);
@@ -588,42 +871,6 @@ namespace Kernel
 				return socket->receive_packet(buffer, sender, sender_len);
 		}
 
-		{
-			uint16_t checksum = 0;
-
-			if (sender->sa_family == AF_INET)
-			{
-				auto interface_or_error = interface(sender, sender_len);
-				if (interface_or_error.is_error())
-					return;
-				auto interface = interface_or_error.release_value();
-
-				auto& addr_in = *reinterpret_cast<const sockaddr_in*>(sender);
-				const PseudoHeader pseudo_header {
-					.src_ipv4 = BAN::IPv4Address(addr_in.sin_addr.s_addr),
-					.dst_ipv4 = interface->get_ipv4_address(),
-					.protocol = NetworkProtocol::TCP,
-					.length = buffer.size(),
-				};
-				const BAN::ConstByteSpan buffers[] {
-					BAN::ConstByteSpan::from(pseudo_header),
-					buffer
-				};
-				checksum = calculate_internet_checksum({ buffers, sizeof(buffers) / sizeof(*buffers) });
-			}
-			else
-			{
-				dwarnln("No tcp checksum validation for socket family {}", sender->sa_family);
-				return;
-			}
-
-			if (checksum != 0)
-			{
-				dprintln("Checksum does not match");
-				return;
-			}
-		}
-
 		LockGuard _(m_mutex);
 
 		const bool hungup_before = has_hungup_impl();
@@ -634,6 +881,7 @@ namespace Kernel
 		dprintln_if(DEBUG_TCP, "  ack {}", (uint32_t)header.ack_number);
 		dprintln_if(DEBUG_TCP, "  seq {}", (uint32_t)header.seq_number);
 
+		const uint16_t old_window_size = m_send_window.non_scaled_size;
 		m_send_window.non_scaled_size = header.window_size;
 		if (m_send_window.scaled_size() == 0)
 			m_send_window.had_zero_window = true;
@@ -655,7 +903,10 @@ namespace Kernel
 				}
 
 				auto options = parse_tcp_options(header);
-				m_send_window.mss = options.maximum_seqment_size.value_or(s_default_mss);
+				m_send_window.mss = BAN::Math::min(
+					options.maximum_seqment_size.value_or(s_default_mss),
+					interface_mss(reinterpret_cast<const sockaddr*>(&m_connection_info->address), m_connection_info->address_len)
+				);
 				if (options.window_scale.has_value())
 					m_send_window.scale_shift = *options.window_scale;
 				else
@@ -663,9 +914,12 @@ namespace Kernel
 					m_recv_window.scale_shift = 0;
 					m_connection_info->has_window_scale = false;
 				}
+				if (!options.sack_permitted)
+					m_connection_info->has_sack = false;
 
 				m_send_window.start_seq = m_send_window.current_seq;
 				m_send_window.current_ack = m_send_window.current_seq;
+				m_send_window.cwnd = initial_congestion_window(m_send_window.mss);
 
 				m_recv_window.start_seq = header.seq_number + 1;
 
@@ -692,6 +946,7 @@ namespace Kernel
 					memcpy(&connection_info.address, sender, sender_len);
 					connection_info.address_len = sender_len;
 					connection_info.has_window_scale = options.window_scale.has_value();
+					connection_info.has_sack = options.sack_permitted;
 					MUST(m_pending_connections.emplace(
 						connection_info,
 						header.seq_number + 1,
@@ -750,6 +1005,7 @@ namespace Kernel
 				if (!(header.flags & ACK))
 					break;
 				m_state = State::TimeWait;
+				m_time_wait_start_ms = SystemTimer::get().ms_since_boot();
 				break;
 			case State::TimeWait:
 				check_payload = true;
@@ -758,19 +1014,28 @@ namespace Kernel
 
 		const uint32_t expected_seq = m_recv_window.start_seq + m_recv_window.buffer->size() + m_recv_window.has_ghost_byte;
 
-		if (header.seq_number > expected_seq)
+		auto payload = buffer.slice(header.data_offset * sizeof(uint32_t));
+
+		if (check_payload && (header.flags & ACK))
+			handle_ack(header, payload.size(), old_window_size);
+
+		if (check_payload && seq_gt(header.seq_number, expected_seq))
+		{
 			dprintln_if(DEBUG_TCP, "Missing packets");
+
+			// store the segment and send duplicate ACK immediately
+			if (store_out_of_order_data(header.seq_number, payload) && m_next_flags == 0)
+			{
+				m_next_flags = ACK;
+				m_next_state = m_state;
+			}
+		}
 		else if (check_payload)
 		{
 			if (header.flags & FIN)
 				m_recv_window.has_ghost_byte = true;
 
-			if (header.ack_number > m_send_window.current_ack)
-				m_send_window.current_ack = header.ack_number;
-
-			auto payload = buffer.slice(header.data_offset * sizeof(uint32_t));
-
-			if (header.seq_number < expected_seq)
+			if (seq_lt(header.seq_number, expected_seq))
 			{
 				const uint32_t already_received_bytes = expected_seq - header.seq_number;
 				if (already_received_bytes <= payload.size())
@@ -781,11 +1046,26 @@ namespace Kernel
 
 			const bool can_receive_new_data = (payload.size() > 0 && !m_recv_window.buffer->full());
 
+			bool filled_hole = false;
+
 			if (can_receive_new_data)
 			{
 				const size_t nrecv = BAN::Math::min(payload.size(), m_recv_window.buffer->free());
 				m_recv_window.buffer->push(payload.slice(0, nrecv));
 
+				filled_hole = merge_out_of_order_data();
+
+				auto& recv_window = m_recv_window;
+				if (recv_window.rtt_measuring && seq_ge(recv_window.start_seq + recv_window.buffer->size(), recv_window.rtt_seq))
+				{
+					const uint32_t rtt_ms = BAN::Math::max<uint64_t>(SystemTimer::get().ms_since_boot() - recv_window.rtt_start_ms, 1);
+					if (recv_window.rtt_ms == 0 || rtt_ms < recv_window.rtt_ms)
+						recv_window.rtt_ms = rtt_ms;
+					else
+						recv_window.rtt_ms = (7 * recv_window.rtt_ms + rtt_ms) / 8;
+					recv_window.rtt_measuring = false;
+				}
+
 				epoll_notify(EPOLLIN);
 
 				dprintln_if(DEBUG_TCP, "Received {} bytes", nrecv);
@@ -794,10 +1074,25 @@ namespace Kernel
 			// make sure zero window is reported
 			if (m_last_sent_window_size > 0 && m_recv_window.buffer->full())
 				m_should_send_zero_window = true;
+			else if (filled_hole)
+			{
+				// https://www.rfc-editor.org/rfc/rfc5681   4.2
+				if (m_next_flags == 0)
+				{
+					m_next_flags = ACK;
+					m_next_state = m_state;
+				}
+			}
 			else if (can_receive_new_data)
 			{
-				m_next_flags = ACK;
-				m_next_state = m_state;
+				// delay the ACK, but acknowledge at least every second segment
+				if (m_unacked_segments++ == 0)
+					m_delayed_ack_ms = SystemTimer::get().ms_since_boot() + s_delayed_ack_ms;
+				if (m_unacked_segments >= 2 && m_next_flags == 0)
+				{
+					m_next_flags = ACK;
+					m_next_state = m_state;
+				}
 			}
 		}
 
@@ -805,6 +1100,17 @@ namespace Kernel
 			epoll_notify(EPOLLHUP);
 
 		m_thread_blocker.unblock();
+
+		TCPEngine::get().schedule(*this);
+	}
+
+	void TCPSocket::on_close(int)
+	{
+		// closing file descriptor still holds its reference here, so the
+		// worker might not see the socket closed yet. it rechecks shortly
+		LockGuard _(m_mutex);
+		m_close_pending = true;
+		TCPEngine::get().schedule(*this);
 	}
 
 	void TCPSocket::set_connection_as_closed()
@@ -822,7 +1128,7 @@ namespace Kernel
 			dprintln_if(DEBUG_TCP, "Socket unbound");
 		}
 
-		m_thread = nullptr;
+		m_connection_closed = true;
 	}
 
 	void TCPSocket::remove_listen_child(BAN::RefPtr<TCPSocket> socket)
@@ -842,42 +1148,587 @@ namespace Kernel
 		m_listen_children.remove(it);
 	}
 
-	void TCPSocket::process_task()
+	uint16_t TCPSocket::interface_mss(const sockaddr* target, socklen_t target_len)
+	{
+		auto interface_or_error = interface(target, target_len);
+		if (interface_or_error.is_error())
+			return s_default_mss;
+		const size_t mtu = interface_or_error.value()->payload_mtu();
+		if (mtu <= m_network_layer.header_size() + sizeof(TCPHeader) + s_default_mss)
+			return s_default_mss;
+		return BAN::Math::min<size_t>(0xFFFF, mtu - m_network_layer.header_size() - sizeof(TCPHeader));
+	}
+
+	static size_t clamp_window_buffer_size(size_t size)
+	{
+		size = BAN::Math::clamp(size, s_min_window_buffer_size, s_max_window_buffer_size);
+		return BAN::Math::div_round_up<size_t>(size, PAGE_SIZE) * PAGE_SIZE;
+	}
+
+	// Replaces buffer with a new one of given capacity. Buffered data and
+	// `free_bytes_to_keep` bytes of the free space after it are copied over.
+	static BAN::ErrorOr<void> resize_ring_buffer(BAN::UniqPtr<ByteRingBuffer>& buffer, size_t capacity, size_t free_bytes_to_keep)
 	{
-		// FIXME: this should be dynamic
-		static constexpr uint32_t retransmit_timeout_ms = 1000;
+		ASSERT(buffer->size() + free_bytes_to_keep <= capacity);
 
-		BAN::RefPtr<TCPSocket> keep_alive { this };
+		auto new_buffer = TRY(ByteRingBuffer::create(capacity));
+		new_buffer->push(buffer->get_data());
+		if (free_bytes_to_keep > 0)
+			memcpy(new_buffer->get_free_space().data(), buffer->get_free_space().data(), free_bytes_to_keep);
+
+		buffer = BAN::move(new_buffer);
+		return {};
+	}
+
+	BAN::ErrorOr<void> TCPSocket::resize_recv_buffer(size_t capacity)
+	{
+		auto& recv_window = m_recv_window;
+
+		capacity = clamp_window_buffer_size(BAN::Math::max(capacity, recv_window.buffer->size()));
+		if (capacity == recv_window.buffer->capacity())
+			return {};
+
+		// out of order data that does not fit in the new buffer is dropped
+		const uint32_t recv_end_seq = recv_window.start_seq + recv_window.buffer->size();
+		const size_t new_free = capacity - recv_window.buffer->size();
+
+		auto ooo_blocks = recv_window.ooo_blocks;
+		size_t ooo_block_count = 0;
+		size_t ooo_bytes = 0;
+		for (size_t i = 0; i < recv_window.ooo_block_count; i++)
+		{
+			auto block = ooo_blocks[i];
+			if (block.start - recv_end_seq >= new_free)
+				break;
+			block.end = seq_min(block.end, recv_end_seq + new_free);
+			ooo_blocks[ooo_block_count++] = block;
+			ooo_bytes = block.end - recv_end_seq;
+		}
+
+		TRY(resize_ring_buffer(recv_window.buffer, capacity, ooo_bytes));
+		recv_window.ooo_blocks = ooo_blocks;
+		recv_window.ooo_block_count = ooo_block_count;
+
+		dprintln_if(DEBUG_TCP, "Receive buffer resized to {} bytes", capacity);
+
+		return {};
+	}
+
+	BAN::ErrorOr<void> TCPSocket::resize_send_buffer(size_t capacity)
+	{
+		auto& send_window = m_send_window;
 
-		// socket's creation did a manual ref(), let's undo it here
-		this->unref();
+		capacity = clamp_window_buffer_size(BAN::Math::max(capacity, send_window.buffer->size()));
+		if (capacity == send_window.buffer->capacity())
+			return {};
+
+		TRY(resize_ring_buffer(send_window.buffer, capacity, 0));
+
+		dprintln_if(DEBUG_TCP, "Send buffer resized to {} bytes", capacity);
+
+		return {};
+	}
+
+	void TCPSocket::autotune_recv_buffer()
+	{
+		// dynamic right sizing, buffer should hold twice the data application reads in one round trip
+
+		auto& recv_window = m_recv_window;
+		if (!recv_window.autotune || recv_window.rtt_ms == 0)
+			return;
+
+		const uint64_t current_ms = SystemTimer::get().ms_since_boot();
+		if (recv_window.space_start_ms == 0)
+		{
+			recv_window.space_seq = recv_window.start_seq;
+			recv_window.space_start_ms = current_ms;
+			return;
+		}
+
+		if (current_ms < recv_window.space_start_ms + recv_window.rtt_ms)
+			return;
+
+		const size_t consumed = recv_window.start_seq - recv_window.space_seq;
+		recv_window.space_seq = recv_window.start_seq;
+		recv_window.space_start_ms = current_ms;
+
+		const size_t capacity = recv_window.buffer->capacity();
+		const size_t max_capacity = BAN::Math::min(s_max_window_buffer_size, (size_t)0xFFFF << recv_window.scale_shift);
+		if (2 * consumed <= capacity || capacity >= max_capacity)
+			return;
+
+		if (auto ret = resize_recv_buffer(BAN::Math::min(max_capacity, BAN::Math::max(2 * consumed, 2 * capacity))); ret.is_error())
+			dwarnln("could not grow receive buffer: {}", ret.error());
+	}
+
+	void TCPSocket::autotune_send_buffer()
+	{
+		// buffer should hold twice the usable window so sending does not stall while waiting for ACKs
+
+		auto& send_window = m_send_window;
+		if (!send_window.autotune || send_window.space_reserved)
+			return;
+
+		const size_t usable_window = BAN::Math::min(send_window.cwnd, send_window.scaled_size());
+		const size_t capacity = send_window.buffer->capacity();
+		if (2 * usable_window <= capacity || capacity >= s_max_window_buffer_size)
+			return;
+
+		if (auto ret = resize_send_buffer(BAN::Math::max(2 * usable_window, 2 * capacity)); ret.is_error())
+			dwarnln("could not grow send buffer: {}", ret.error());
+	}
+
+	void TCPSocket::handle_ack(const TCPHeader& header, size_t payload_size, uint16_t old_window_size)
+	{
+		auto& send_window = m_send_window;
+
+		const uint32_t ack_number = header.ack_number;
+
+		if (seq_gt(ack_number, send_window.current_ack))
+		{
+			const uint32_t acked_bytes = ack_number - send_window.current_ack;
+			send_window.current_ack = ack_number;
+
+			// Karn's algorithm, retransmitted segments are never timed
+			if (send_window.rtt_timing && seq_ge(ack_number, send_window.rtt_seq))
+			{
+				send_window.rtt_timing = false;
+				const uint64_t rtt_us = (SystemTimer::get().ns_since_boot() - send_window.rtt_start_ns) / 1000;
+				update_rto(BAN::Math::min<uint64_t>(rtt_us, s_max_rto_ms * 1000));
+			}
+
+			send_window.dup_acks = 0;
+			send_window.rto_backoff = 0;
+			send_window.rto_start_ms = SystemTimer::get().ms_since_boot();
+
+			switch (send_window.cc_state)
+			{
+				case CongestionState::Recovery:
+					if (seq_ge(ack_number, send_window.recover_seq))
+					{
+						// full acknowledgement, deflate the window
+						send_window.cwnd = send_window.ssthresh;
+						send_window.cc_state = CongestionState::Open;
+						break;
+					}
+					// partial acknowledgement, https://www.rfc-editor.org/rfc/rfc6582   3.2 (5)
+					send_window.cwnd -= BAN::Math::min(send_window.cwnd, acked_bytes);
+					if (acked_bytes >= send_window.mss)
+						send_window.cwnd += send_window.mss;
+					send_window.cwnd = BAN::Math::max(send_window.cwnd, send_window.mss);
+					send_window.retransmit_pending++;
+					break;
+				case CongestionState::Loss:
+					if (seq_ge(ack_number, send_window.recover_seq))
+						send_window.cc_state = CongestionState::Open;
+					[[fallthrough]];
+				case CongestionState::Open:
+					if (send_window.cwnd < send_window.ssthresh)
+						send_window.cwnd += BAN::Math::min(acked_bytes, send_window.mss);
+					else
+						send_window.cwnd += BAN::Math::max<uint32_t>(1, (uint64_t)send_window.mss * send_window.mss / send_window.cwnd);
+					send_window.cwnd = BAN::Math::min(send_window.cwnd, s_max_cwnd);
+					break;
+			}
+
+			// SACK information below cumulative acknowledgement is no longer needed
+			size_t sack_block_count = 0;
+			for (size_t i = 0; i < send_window.sack_block_count; i++)
+			{
+				auto block = send_window.sack_blocks[i];
+				if (seq_le(block.end, ack_number))
+					continue;
+				block.start = seq_max(block.start, ack_number);
+				send_window.sack_blocks[sack_block_count++] = block;
+			}
+			send_window.sack_block_count = sack_block_count;
+		}
+		else if (ack_number == send_window.current_ack && seq_gt(send_window.max_seq, ack_number) && payload_size == 0 && !(header.flags & (SYN | FIN)) && header.window_size == old_window_size)
+		{
+			// https://www.rfc-editor.org/rfc/rfc5681   3.2
+			send_window.dup_acks++;
+
+			if (send_window.cc_state == CongestionState::Recovery)
+			{
+				send_window.cwnd += send_window.mss;
+				send_window.retransmit_pending++;
+			}
+			else if (send_window.cc_state == CongestionState::Open && send_window.dup_acks == s_dup_ack_threshold && seq_ge(ack_number, send_window.recover_seq))
+			{
+				const uint32_t bytes_in_flight = send_window.max_seq - ack_number;
+				send_window.ssthresh = BAN::Math::max(bytes_in_flight / 2, 2 * send_window.mss);
+				send_window.cwnd = send_window.ssthresh + 3 * send_window.mss;
+				send_window.recover_seq = send_window.max_seq;
+				send_window.retransmit_seq = ack_number;
+				send_window.retransmit_pending++;
+				send_window.cc_state = CongestionState::Recovery;
+				dprintln_if(DEBUG_TCP, "Fast retransmit");
+			}
+		}
+
+		if (m_connection_info->has_sack && header.data_offset * sizeof(uint32_t) > sizeof(TCPHeader))
+		{
+			const auto options = parse_tcp_options(header);
+			for (size_t i = 0; i < options.sack_block_count; i++)
+			{
+				auto block = options.sack_blocks[i];
+				if (seq_ge(block.start, block.end) || seq_le(block.end, send_window.current_ack) || seq_gt(block.end, send_window.max_seq))
+					continue;
+				block.start = seq_max(block.start, send_window.current_ack);
+				add_sack_block(send_window.sack_blocks, send_window.sack_block_count, block);
+			}
+		}
+	}
+
+	void TCPSocket::update_rto(uint32_t rtt_us)
+	{
+		// https://www.rfc-editor.org/rfc/rfc6298   2
+
+		auto& send_window = m_send_window;
+
+		rtt_us = BAN::Math::max<uint32_t>(rtt_us, 1);
+
+		if (send_window.srtt_us == 0)
+		{
+			send_window.srtt_us = rtt_us;
+			send_window.rttvar_us = rtt_us / 2;
+		}
+		else
+		{
+			const uint32_t delta = (send_window.srtt_us > rtt_us) ? send_window.srtt_us - rtt_us : rtt_us - send_window.srtt_us;
+			send_window.rttvar_us = (3 * send_window.rttvar_us + delta) / 4;
+			send_window.srtt_us = (7 * send_window.srtt_us + rtt_us) / 8;
+		}
+
+		const uint64_t rto_us = send_window.srtt_us + BAN::Math::max<uint64_t>(s_rto_granularity_us, 4 * send_window.rttvar_us);
+		send_window.rto_ms = BAN::Math::clamp<uint64_t>(BAN::Math::div_round_up<uint64_t>(rto_us, 1000), s_min_rto_ms, s_max_rto_ms);
+	}
+
+	void TCPSocket::on_retransmission_timeout()
+	{
+		auto& send_window = m_send_window;
+
+		// https://www.rfc-editor.org/rfc/rfc5681   3.1 (4)
+		if (send_window.cc_state != CongestionState::Loss)
+		{
+			const uint32_t bytes_in_flight = send_window.max_seq - send_window.current_ack;
+			send_window.ssthresh = BAN::Math::max(bytes_in_flight / 2, 2 * send_window.mss);
+		}
+		send_window.cwnd = send_window.mss;
+		send_window.cc_state = CongestionState::Loss;
+		send_window.recover_seq = send_window.max_seq;
+		send_window.dup_acks = 0;
+		send_window.retransmit_pending = 0;
+
+		// receiver is allowed to discard SACKed data, https://www.rfc-editor.org/rfc/rfc2018   8
+		send_window.sack_block_count = 0;
+
+		// https://www.rfc-editor.org/rfc/rfc6298   5.5
+		send_window.rtt_timing = false;
+		send_window.rto_ms = BAN::Math::min(send_window.rto_ms * 2, s_max_rto_ms);
+		if (send_window.rto_backoff < 0xFF)
+			send_window.rto_backoff++;
+
+		// everything unacknowledged is sent again
+		send_window.sent_size = 0;
+		send_window.current_seq = send_window.start_seq;
+	}
+
+	BAN::ErrorOr<void> TCPSocket::send_segment(size_t offset, size_t size)
+	{
+		ASSERT(m_connection_info.has_value());
+		auto* target_address = reinterpret_cast<const sockaddr*>(&m_connection_info->address);
+		auto target_address_len = m_connection_info->address_len;
+
+		auto& send_window = m_send_window;
+
+		auto message = send_window.buffer->get_data().slice(offset, size);
+
+		send_window.current_seq = send_window.start_seq + offset;
+
+		m_next_flags = ACK;
+		if (auto ret = m_network_layer.sendto(*this, message, target_address, target_address_len); ret.is_error())
+		{
+			m_next_flags = 0;
+			return ret.release_error();
+		}
+
+		const uint32_t end_seq = send_window.start_seq + offset + size;
+
+		if (seq_lt(send_window.current_seq, send_window.max_seq))
+		{
+			send_window.total_retransmits++;
+			send_window.rtt_timing = false;
+		}
+		else if (!send_window.rtt_timing)
+		{
+			send_window.rtt_timing = true;
+			send_window.rtt_seq = end_seq;
+			send_window.rtt_start_ns = SystemTimer::get().ns_since_boot();
+		}
+
+		send_window.current_seq = end_seq;
+		if (seq_gt(end_seq, send_window.max_seq))
+			send_window.max_seq = end_seq;
+
+		return {};
+	}
+
+	bool TCPSocket::send_new_data()
+	{
+		auto& send_window = m_send_window;
+
+		const size_t send_limit = BAN::Math::min(send_window.scaled_size(), send_window.cwnd);
+		const size_t send_end = BAN::Math::min(send_window.buffer->size(), send_limit);
+		if (send_end <= send_window.sent_size)
+			return false;
+
+		if (send_window.sent_size == 0)
+			send_window.rto_start_ms = SystemTimer::get().ms_since_boot();
+
+		const size_t options_size = tcp_options_size();
+		const size_t max_payload = BAN::Math::max<size_t>(send_window.mss, options_size + 1) - options_size;
+
+		bool has_sent = false;
+		while (send_window.sent_size < send_end)
+		{
+			const size_t to_send = BAN::Math::min(send_end - send_window.sent_size, max_payload);
+			if (auto ret = send_segment(send_window.sent_size, to_send); ret.is_error())
+			{
+				dwarnln("{}", ret.error());
+				break;
+			}
+
+			dprintln_if(DEBUG_TCP, "Sent {} bytes", to_send);
+
+			send_window.sent_size += to_send;
+			has_sent = true;
+		}
+
+		return has_sent;
+	}
+
+	void TCPSocket::retransmit_lost_segments()
+	{
+		auto& send_window = m_send_window;
+
+		const size_t options_size = tcp_options_size();
+		const size_t max_payload = BAN::Math::max<size_t>(send_window.mss, options_size + 1) - options_size;
+
+		const uint32_t send_end_seq = send_window.start_seq + send_window.sent_size;
+
+		uint32_t seq = seq_max(send_window.retransmit_seq, send_window.start_seq);
+		for (; send_window.retransmit_pending > 0; send_window.retransmit_pending--)
+		{
+			// Without SACK only the first unacknowledged segment is known to be lost.
+			// Otherwise every hole below the highest SACKed byte is considered lost.
+			uint32_t hole_end_seq = send_end_seq;
+			if (send_window.sack_block_count == 0)
+			{
+				if (seq != send_window.start_seq)
+					break;
+			}
+			else
+			{
+				for (size_t i = 0; i < send_window.sack_block_count; i++)
+				{
+					const auto& block = send_window.sack_blocks[i];
+					if (seq_le(block.end, seq))
+						continue;
+					if (seq_le(block.start, seq))
+					{
+						seq = block.end;
+						continue;
+					}
+					hole_end_seq = block.start;
+					break;
+				}
+				if (hole_end_seq == send_end_seq)
+					break;
+			}
+
+			if (seq_ge(seq, send_end_seq))
+				break;
+
+			const size_t to_send = BAN::Math::min<size_t>(hole_end_seq - seq, max_payload);
+			if (auto ret = send_segment(seq - send_window.start_seq, to_send); ret.is_error())
+			{
+				dwarnln("{}", ret.error());
+				break;
+			}
+
+			dprintln_if(DEBUG_TCP, "Retransmitted {} bytes", to_send);
+
+			seq += to_send;
+			send_window.retransmit_seq = seq;
+		}
+
+		send_window.retransmit_pending = 0;
+		send_window.current_seq = send_end_seq;
+	}
+
+	bool TCPSocket::store_out_of_order_data(uint32_t seq_number, BAN::ConstByteSpan payload)
+	{
+		auto& recv_window = m_recv_window;
+
+		if (recv_window.has_ghost_byte || payload.empty())
+			return false;
+
+		const uint32_t recv_end_seq = recv_window.start_seq + recv_window.buffer->size();
+		ASSERT(seq_gt(seq_number, recv_end_seq));
+
+		auto free_space = recv_window.buffer->get_free_space();
+
+		const size_t offset = seq_number - recv_end_seq;
+		if (offset >= free_space.size())
+			return false;
+
+		const size_t nstore = BAN::Math::min(payload.size(), free_space.size() - offset);
+		memcpy(free_space.data() + offset, payload.data(), nstore);
+
+		if (!add_sack_block(recv_window.ooo_blocks, recv_window.ooo_block_count, { seq_number, static_cast<uint32_t>(seq_number + nstore) }))
+			return false;
+		recv_window.ooo_recent_seq = seq_number;
+
+		dprintln_if(DEBUG_TCP, "Stored {} out of order bytes", nstore);
+
+		return true;
+	}
+
+	bool TCPSocket::merge_out_of_order_data()
+	{
+		auto& recv_window = m_recv_window;
+
+		bool merged = false;
+		while (recv_window.ooo_block_count > 0)
+		{
+			const uint32_t recv_end_seq = recv_window.start_seq + recv_window.buffer->size();
+
+			const auto block = recv_window.ooo_blocks[0];
+			if (seq_gt(block.start, recv_end_seq))
+				break;
+
+			// out of order data is already in place after the buffered data
+			if (seq_gt(block.end, recv_end_seq))
+				recv_window.buffer->commit_free_space(block.end - recv_end_seq);
+
+			for (size_t i = 1; i < recv_window.ooo_block_count; i++)
+				recv_window.ooo_blocks[i - 1] = recv_window.ooo_blocks[i];
+			recv_window.ooo_block_count--;
+
+			merged = true;
+		}
+
+		return merged;
+	}
+
+	BAN::ErrorOr<void> TCPSocket::get_tcp_info(void* value, socklen_t* value_len)
+	{
+		ASSERT(m_mutex.locker() == Thread::current().tid());
+
+		const auto& send_window = m_send_window;
+
+		tcp_info info {};
+
+		switch (m_state)
+		{
+			case State::Closed:      info.tcpi_state = TCP_CLOSE;       break;
+			case State::Listen:      info.tcpi_state = TCP_LISTEN;      break;
+			case State::SynSent:     info.tcpi_state = TCP_SYN_SENT;    break;
+			case State::SynReceived: info.tcpi_state = TCP_SYN_RECV;    break;
+			case State::Established: info.tcpi_state = TCP_ESTABLISHED; break;
+			case State::FinWait1:    info.tcpi_state = TCP_FIN_WAIT1;   break;
+			case State::FinWait2:    info.tcpi_state = TCP_FIN_WAIT2;   break;
+			case State::CloseWait:   info.tcpi_state = TCP_CLOSE_WAIT;  break;
+			case State::Closing:     info.tcpi_state = TCP_CLOSING;     break;
+			case State::LastAck:     info.tcpi_state = TCP_LAST_ACK;    break;
+			case State::TimeWait:    info.tcpi_state = TCP_TIME_WAIT;   break;
+		}
+
+		switch (send_window.cc_state)
+		{
+			case CongestionState::Open:     info.tcpi_ca_state = TCP_CA_Open;     break;
+			case CongestionState::Recovery: info.tcpi_ca_state = TCP_CA_Recovery; break;
+			case CongestionState::Loss:     info.tcpi_ca_state = TCP_CA_Loss;     break;
+		}
+
+		info.tcpi_retransmits = send_window.rto_backoff;
+		info.tcpi_backoff = send_window.rto_backoff;
+		if (m_connection_info.has_value())
+		{
+			if (m_connection_info->has_window_scale)
+				info.tcpi_options |= TCPI_OPT_WSCALE;
+			if (m_connection_info->has_sack)
+				info.tcpi_options |= TCPI_OPT_SACK;
+		}
+		info.tcpi_snd_wscale = send_window.scale_shift;
+		info.tcpi_rcv_wscale = m_recv_window.scale_shift;
+
+		info.tcpi_rto = send_window.rto_ms * 1000;
+		info.tcpi_snd_mss = send_window.mss;
+
+		// like linux, segment counts are reported instead of bytes
+		const uint32_t mss = BAN::Math::max<uint32_t>(send_window.mss, 1);
+		info.tcpi_unacked = BAN::Math::div_round_up<uint32_t>(send_window.max_seq - send_window.current_ack, mss);
+
+		uint32_t sacked = 0;
+		for (size_t i = 0; i < send_window.sack_block_count; i++)
+			sacked += send_window.sack_blocks[i].end - send_window.sack_blocks[i].start;
+		info.tcpi_sacked = BAN::Math::div_round_up<uint32_t>(sacked, mss);
+
+		info.tcpi_rtt = send_window.srtt_us;
+		info.tcpi_rttvar = send_window.rttvar_us;
+		info.tcpi_snd_ssthresh = send_window.ssthresh / mss;
+		info.tcpi_snd_cwnd = send_window.cwnd / mss;
+		info.tcpi_total_retrans = send_window.total_retransmits;
+
+		const size_t len = BAN::Math::min<size_t>(sizeof(info), *value_len);
+		memcpy(value, &info, len);
+		*value_len = len;
+
+		return {};
+	}
+
+	BAN::Optional<uint64_t> TCPSocket::process_work()
+	{
+		// closing is noticed through on_close(), this is only a fallback
+		static constexpr uint64_t idle_interval_ms = 10'000;
+		// delay before checking again after a file descriptor was closed
+		static constexpr uint64_t close_recheck_ms = 10;
 
 		LockGuard _(m_mutex);
 
-		while (m_thread)
+		for (;;)
 		{
+			if (m_connection_closed)
+			{
+				m_thread_blocker.unblock();
+				return {};
+			}
+
 			const uint64_t current_ms = SystemTimer::get().ms_since_boot();
 
 			switch (m_state)
 			{
 				case State::TimeWait:
-					if (current_ms < m_time_wait_start_ms + 30'000)
+					if (current_ms < m_time_wait_start_ms + s_time_wait_ms)
 						break;
 					// TimeWait timeout
 					set_connection_as_closed();
 					continue;
+				case State::Closed:
 				case State::Listen:
 					if (ref_count() > 1)
 						break;
-					// Listen socket closed
-					//    ref_count = keep_alieve
+					// Unconnected or listen socket closed
+					//    ref_count = engine
 					set_connection_as_closed();
 					continue;
 				case State::Established:
 					if (ref_count() > static_cast<uint32_t>(1 + !!m_listen_parent))
 						break;
 					// Connected socket closed
-					//    ref_count = keep_alive + listen's hashmap
+					//    ref_count = engine + listen's hashmap
 					m_next_flags = FIN | ACK;
 					m_next_state = State::FinWait1;
 					break;
@@ -893,6 +1744,8 @@ namespace Kernel
 				if (auto ret = m_network_layer.sendto(*this, {}, target_address, target_address_len); ret.is_error())
 					dwarnln("{}", ret.error());
 				const bool hungup_before = has_hungup_impl();
+				if (m_state != State::TimeWait && m_next_state == State::TimeWait)
+					m_time_wait_start_ms = current_ms;
 				m_state = m_next_state;
 				if (m_state == State::Established)
 					m_has_connected = true;
@@ -901,15 +1754,17 @@ namespace Kernel
 				continue;
 			}
 
-			if (m_send_window.current_ack - m_send_window.has_ghost_byte > m_send_window.start_seq)
+			if (seq_gt(m_send_window.current_ack - m_send_window.has_ghost_byte, m_send_window.start_seq))
 			{
 				const uint32_t acknowledged_bytes = m_send_window.current_ack - m_send_window.start_seq - m_send_window.has_ghost_byte;
 				ASSERT(acknowledged_bytes <= m_send_window.buffer->size());
 
 				m_send_window.start_seq += acknowledged_bytes;
-				m_send_window.sent_size -= acknowledged_bytes;
+				m_send_window.sent_size -= BAN::Math::min(m_send_window.sent_size, acknowledged_bytes);
 				m_send_window.buffer->pop(acknowledged_bytes);
 
+				autotune_send_buffer();
+
 				epoll_notify(EPOLLOUT);
 
 				dprintln_if(DEBUG_TCP, "Target acknowledged {} bytes", acknowledged_bytes);
@@ -917,52 +1772,24 @@ namespace Kernel
 				continue;
 			}
 
-			const bool should_retransmit = m_send_window.had_zero_window || (m_send_window.sent_size > 0 && current_ms >= m_send_window.last_send_ms + retransmit_timeout_ms);
-
-			const bool can_send_new_data = (m_send_window.buffer->size() > m_send_window.sent_size && m_send_window.sent_size < m_send_window.scaled_size());
+			if (m_send_window.sent_size > 0 && current_ms >= m_send_window.rto_start_ms + m_send_window.rto_ms)
+			{
+				dprintln_if(DEBUG_TCP, "Retransmission timeout");
+				on_retransmission_timeout();
+			}
 
-			if (m_send_window.scaled_size() > 0 && (should_retransmit || can_send_new_data))
+			if (m_send_window.had_zero_window && m_send_window.scaled_size() > 0)
 			{
+				// window was closed, send everything again
 				m_send_window.had_zero_window = false;
+				m_send_window.sent_size = 0;
+			}
 
-				ASSERT(m_connection_info.has_value());
-				auto* target_address = reinterpret_cast<const sockaddr*>(&m_connection_info->address);
-				auto target_address_len = m_connection_info->address_len;
-
-				const size_t send_offset = should_retransmit ? 0 : m_send_window.sent_size;
-
-				const size_t total_send = BAN::Math::min<size_t>(
-					m_send_window.buffer->size() - send_offset,
-					m_send_window.scaled_size() - send_offset
-				);
-
-				m_send_window.current_seq = m_send_window.start_seq + send_offset;
-
-				for (size_t i = 0; i < total_send;)
-				{
-					const size_t to_send = BAN::Math::min<size_t>(total_send - i, m_send_window.mss);
-
-					auto message = m_send_window.buffer->get_data().slice(send_offset + i, to_send);
-
-					m_next_flags = ACK;
-					if (auto ret = m_network_layer.sendto(*this, message, target_address, target_address_len); ret.is_error())
-					{
-						dwarnln("{}", ret.error());
-						break;
-					}
-
-					dprintln_if(DEBUG_TCP, "Sent {} bytes", to_send);
-
-					i += to_send;
-					m_send_window.current_seq += to_send;
-					if (send_offset + i > m_send_window.sent_size)
-						m_send_window.sent_size = send_offset + i;
-				}
-
-				m_send_window.last_send_ms = current_ms;
+			if (m_send_window.retransmit_pending > 0)
+				retransmit_lost_segments();
 
+			if (send_new_data())
 				continue;
-			}
 
 			if (m_last_sent_window_size == 0)
 				m_should_send_zero_window = false;
@@ -988,11 +1815,30 @@ namespace Kernel
 				}
 			}
 
+			if (m_unacked_segments > 0 && current_ms >= m_delayed_ack_ms)
+			{
+				m_unacked_segments = 0;
+				m_next_flags = ACK;
+				m_next_state = m_state;
+				continue;
+			}
+
 			m_thread_blocker.unblock();
-			m_thread_blocker.block_with_wake_time_ms(current_ms + retransmit_timeout_ms, &m_mutex);
-		}
 
-		m_thread_blocker.unblock();
+			uint64_t wake_time_ms = current_ms + idle_interval_ms;
+			if (m_send_window.sent_size > 0)
+				wake_time_ms = BAN::Math::min<uint64_t>(wake_time_ms, m_send_window.rto_start_ms + m_send_window.rto_ms);
+			if (m_unacked_segments > 0)
+				wake_time_ms = BAN::Math::min(wake_time_ms, m_delayed_ack_ms);
+			if (m_state == State::TimeWait)
+				wake_time_ms = BAN::Math::min(wake_time_ms, m_time_wait_start_ms + s_time_wait_ms);
+			if (m_close_pending)
+			{
+				m_close_pending = false;
+				wake_time_ms = BAN::Math::min(wake_time_ms, current_ms + close_recheck_ms);
+			}
+			return wake_time_ms;
+		}
 	}
 
 }
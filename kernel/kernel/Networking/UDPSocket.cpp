@@ -35,7 +35,7 @@ namespace Kernel
 		m_address_len = 0;
 	}
 
-	void UDPSocket::get_protocol_header(BAN::ByteSpan header_buffer, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader pseudo_header)
+	void UDPSocket::get_protocol_header(BAN::ByteSpan header_buffer, BAN::ConstByteSpan payload, uint16_t dst_port, PseudoHeader pseudo_header, bool checksum_offload)
 	{
 		ASSERT(header_buffer.size() == protocol_header_size());
 
@@ -47,6 +47,12 @@ namespace Kernel
 			.checksum = 0,
 		};
 
+		if (checksum_offload)
+		{
+			header.checksum = calculate_partial_internet_checksum(BAN::ConstByteSpan::from(pseudo_header));
+			return;
+		}
+
 		const BAN::ConstByteSpan buffers[] {
 			BAN::ConstByteSpan::from(pseudo_header),
 			header_buffer,
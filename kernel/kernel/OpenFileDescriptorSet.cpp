@@ -665,6 +665,24 @@ namespace Kernel
 	}
 
 	BAN::ErrorOr<size_t> OpenFileDescriptorSet::read(int fd, BAN::ByteSpan buffer)
+	{
+		const iovec iov {
+			.iov_base = buffer.data(),
+			.iov_len = buffer.size(),
+		};
+		return readv(fd, { &iov, 1 });
+	}
+
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::write(int fd, BAN::ConstByteSpan buffer)
+	{
+		const iovec iov {
+			.iov_base = const_cast<uint8_t*>(buffer.data()),
+			.iov_len = buffer.size(),
+		};
+		return writev(fd, { &iov, 1 });
+	}
+
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::readv(int fd, BAN::Span<const iovec> iov)
 	{
 		BAN::RefPtr<Inode> inode;
 		bool is_nonblock;
@@ -683,16 +701,11 @@ namespace Kernel
 
 		if (inode->mode().ifsock())
 		{
-			iovec iov {
-				.iov_base = buffer.data(),
-				.iov_len = buffer.size(),
-			};
-
 			msghdr message {
 				.msg_name = nullptr,
 				.msg_namelen = 0,
-				.msg_iov = &iov,
-				.msg_iovlen = 1,
+				.msg_iov = const_cast<iovec*>(iov.data()),
+				.msg_iovlen = static_cast<int>(iov.size()),
 				.msg_control = nullptr,
 				.msg_controllen = 0,
 				.msg_flags = 0,
@@ -708,7 +721,7 @@ namespace Kernel
 			// FIXME: race condition, pass flags to read
 			if (is_nonblock && !inode->can_read())
 				return BAN::Error::from_errno(EAGAIN);
-			nread = TRY(inode->read(offset, buffer));
+			nread = TRY(inode->readv(offset, iov));
 		}
 
 		LockGuard _(m_mutex);
@@ -718,7 +731,7 @@ namespace Kernel
 		return nread;
 	}
 
-	BAN::ErrorOr<size_t> OpenFileDescriptorSet::write(int fd, BAN::ConstByteSpan buffer)
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::writev(int fd, BAN::Span<const iovec> iov)
 	{
 		BAN::RefPtr<Inode> inode;
 		bool is_nonblock;
@@ -737,16 +750,11 @@ namespace Kernel
 
 		if (inode->mode().ifsock())
 		{
-			iovec iov {
-				.iov_base = const_cast<uint8_t*>(buffer.data()),
-				.iov_len = buffer.size(),
-			};
-
 			msghdr message {
 				.msg_name = nullptr,
 				.msg_namelen = 0,
-				.msg_iov = &iov,
-				.msg_iovlen = 1,
+				.msg_iov = const_cast<iovec*>(iov.data()),
+				.msg_iovlen = static_cast<int>(iov.size()),
 				.msg_control = nullptr,
 				.msg_controllen = 0,
 				.msg_flags = 0,
@@ -765,7 +773,7 @@ namespace Kernel
 			if (is_nonblock && !inode->can_write())
 				return BAN::Error::from_errno(EAGAIN);
 			// FIXME: race condition, pass flags to write
-			nwrite = TRY(inode->write(offset, buffer));
+			nwrite = TRY(inode->writev(offset, iov));
 		}
 
 		LockGuard _(m_mutex);
@@ -853,6 +861,98 @@ namespace Kernel
 		return inode->sendmsg(message, flags | (is_nonblock ? MSG_DONTWAIT : 0));
 	}
 
+	BAN::ErrorOr<size_t> OpenFileDescriptorSet::sendfile(int out_fd, int in_fd, off_t* offset, size_t count)
+	{
+		BAN::RefPtr<Inode> in_inode;
+		BAN::RefPtr<Inode> out_inode;
+		bool is_nonblock;
+		off_t in_offset;
+
+		{
+			LockGuard _(m_mutex);
+			TRY(validate_fd(in_fd));
+			TRY(validate_fd(out_fd));
+			auto& in_file = m_open_files[in_fd];
+			auto& out_file = m_open_files[out_fd];
+			if (!(in_file->status_flags & O_RDONLY) || !(out_file->status_flags & O_WRONLY))
+				return BAN::Error::from_errno(EBADF);
+			if (!in_file->file.inode->mode().ifreg())
+				return BAN::Error::from_errno(EINVAL);
+			in_inode = in_file->file.inode;
+			out_inode = out_file->file.inode;
+			is_nonblock = !!(out_file->status_flags & O_NONBLOCK);
+			in_offset = offset ? *offset : in_file->offset;
+		}
+
+		if (in_offset < 0)
+			return BAN::Error::from_errno(EINVAL);
+		if (in_offset >= in_inode->size())
+			count = 0;
+		else
+			count = BAN::Math::min<uint64_t>(count, in_inode->size() - in_offset);
+
+		// fallback for targets that can't read directly from an inode
+		bool use_bounce_buffer = !out_inode->mode().ifsock();
+		BAN::Vector<uint8_t> bounce_buffer;
+
+		size_t total_sent = 0;
+		while (total_sent < count)
+		{
+			BAN::ErrorOr<size_t> ret { 0 };
+
+			if (!use_bounce_buffer)
+			{
+				if (out_inode->has_hungup())
+				{
+					Thread::current().add_signal(SIGPIPE, {});
+					ret = BAN::Error::from_errno(EPIPE);
+				}
+				else
+				{
+					ret = out_inode->sendfile(*in_inode, in_offset + total_sent, count - total_sent, is_nonblock ? MSG_DONTWAIT : 0);
+					if (ret.is_error() && ret.error().get_error_code() == ENOTSUP)
+					{
+						use_bounce_buffer = true;
+						continue;
+					}
+				}
+			}
+			else
+			{
+				if (bounce_buffer.empty())
+					TRY(bounce_buffer.resize(BAN::Math::min<size_t>(count, 16 * PAGE_SIZE)));
+
+				const size_t to_read = BAN::Math::min(bounce_buffer.size(), count - total_sent);
+				const size_t nread = TRY(in_inode->read(in_offset + total_sent, bounce_buffer.span().slice(0, to_read)));
+				if (nread == 0)
+					break;
+				ret = write(out_fd, bounce_buffer.span().slice(0, nread));
+			}
+
+			if (ret.is_error())
+			{
+				if (total_sent > 0)
+					break;
+				return ret.release_error();
+			}
+			if (ret.value() == 0)
+				break;
+			total_sent += ret.value();
+		}
+
+		if (offset)
+			*offset = in_offset + total_sent;
+		else
+		{
+			LockGuard _(m_mutex);
+			// NOTE: race condition with offset, its UB per POSIX
+			if (!validate_fd(in_fd).is_error())
+				m_open_files[in_fd]->offset = in_offset + total_sent;
+		}
+
+		return total_sent;
+	}
+
 	int OpenFileDescriptorSet::get_max_open_fd() const
 	{
 		LockGuard _(m_mutex);
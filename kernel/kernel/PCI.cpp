@@ -223,6 +223,15 @@ namespace Kernel::PCI
 		return {};
 	}
 
+	void PCIManager::release_msi(uint8_t irq)
+	{
+		SpinLockGuard _(m_reserved_msi_lock);
+
+		const uint8_t index = irq - (IRQ_MSI_BASE - IRQ_VECTOR_BASE);
+		ASSERT(index < m_msi_count);
+		m_reserved_msi_bitmap[index / 8] &= ~(1 << (index % 8));
+	}
+
 	void PCIManager::initialize_devices(bool disable_usb)
 	{
 		for_each_device(
@@ -413,9 +422,12 @@ namespace Kernel::PCI
 		ASSERT_NOT_REACHED();
 	}
 
-	static constexpr uint64_t msi_message_address()
+	static uint64_t msi_message_address(ProcessorID target)
 	{
-		return 0xFEE00000;
+		// xAPIC destination id is 8 bits, anything else goes to the default target
+		if (target == PROCESSOR_NONE || target.as_u32() > 0xFF)
+			return 0xFEE00000;
+		return 0xFEE00000 | (static_cast<uint64_t>(target.as_u32()) << 12);
 	}
 
 	static constexpr uint32_t msi_message_data(uint8_t irq)
@@ -423,7 +435,7 @@ namespace Kernel::PCI
 		return (IRQ_VECTOR_BASE + irq) & 0xFF;
 	}
 
-	void PCI::Device::enable_interrupt(uint8_t index, Interruptable& interruptable)
+	void PCI::Device::enable_interrupt(uint8_t index, Interruptable& interruptable, ProcessorID target)
 	{
 		const uint8_t irq = get_interrupt(index);
 		interruptable.set_irq(irq);
@@ -471,7 +483,7 @@ namespace Kernel::PCI
 				msg_ctrl |= 1u << 0;		// Enable
 				write_word(*m_offset_msi + 0x02, msg_ctrl);
 
-				const uint64_t msg_addr = msi_message_address();
+				const uint64_t msg_addr = msi_message_address(target);
 				const uint32_t msg_data = msi_message_data(irq);
 
 				if (msg_ctrl & (1 << 7))
@@ -501,7 +513,7 @@ namespace Kernel::PCI
 				const uint32_t offset = dword1 & ~7u;
 				const uint8_t  bir    = dword1 &  7u;
 
-				const uint64_t msg_addr = msi_message_address();
+				const uint64_t msg_addr = msi_message_address(target);
 				const uint32_t msg_data = msi_message_data(irq);
 
 				auto bar = MUST(allocate_bar_region(bir));
@@ -805,6 +817,16 @@ namespace Kernel::PCI
 			const auto irq = get_interrupt_func();
 			if (!irq.has_value())
 			{
+				// release already reserved interrupts so caller can retry with a smaller count
+				for (size_t reserved = 0; reserved < sizeof(m_reserved_interrupts) * 8; reserved++)
+				{
+					if (!(m_reserved_interrupts[reserved / 8] & (1 << (reserved % 8))))
+						continue;
+					if (mechanism == InterruptMechanism::MSI || mechanism == InterruptMechanism::MSIX)
+						PCIManager::get().release_msi(reserved);
+				}
+				memset(m_reserved_interrupts, 0, sizeof(m_reserved_interrupts));
+
 				dwarnln("Could not reserve {} interrupts", count);
 				return BAN::Error::from_errno(EFAULT);
 			}
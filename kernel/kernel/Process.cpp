@@ -33,6 +33,7 @@
 #include <sys/banan-os.h>
 #include <sys/eventfd.h>
 #include <sys/futex.h>
+#include <sys/resource.h>
 #include <sys/sysmacros.h>
 #include <sys/wait.h>
 
@@ -42,6 +43,8 @@ namespace Kernel
 {
 
 	static BAN::LinkedList<Process*> s_alarm_processes;
+	// cached front of alarm queue so scheduler can read it without locking
+	static BAN::Atomic<uint64_t> s_next_alarm_wake_time_ns { static_cast<uint64_t>(-1) };
 	static BAN::Vector<Process*> s_processes;
 	static RecursiveSpinLock s_process_lock;
 
@@ -441,6 +444,7 @@ namespace Kernel
 			.cancel_type = 0,
 			.cancel_state = 0,
 			.canceled = 0,
+			.malloc_cache = nullptr,
 			.specific_keys = {},
 			.specific_values = {},
 			.dtv = { 0, region->vaddr() }
@@ -735,6 +739,7 @@ namespace Kernel
 		forked->m_open_file_descriptors = BAN::move(*open_file_descriptors);
 		forked->m_mapped_regions = BAN::move(mapped_regions);
 		forked->m_has_called_exec = false;
+		forked->m_nice = m_nice.load();
 		memcpy(forked->m_signal_handlers, m_signal_handlers, sizeof(m_signal_handlers));
 
 		*child_exit_status = {};
@@ -1137,11 +1142,33 @@ namespace Kernel
 					m_alarm_interval_ns = interval_us * 1000;
 				}
 			}
+
+			const uint64_t old_wake_time_ns = s_next_alarm_wake_time_ns;
+			s_next_alarm_wake_time_ns = s_alarm_processes.empty() ? static_cast<uint64_t>(-1) : s_alarm_processes.front()->m_alarm_wake_time_ns;
+
+			// alarms are handled by the bsp, its timer may have to fire earlier now
+			if (s_next_alarm_wake_time_ns < old_wake_time_ns)
+			{
+				if (Processor::current_is_bsp())
+					Processor::scheduler().update_timer_deadline();
+				else
+				{
+					Processor::send_smp_message(Processor::bsp_id(), {
+						.type = Processor::SMPMessage::Type::RearmTimer,
+						.dummy = 0,
+					});
+				}
+			}
 		}
 
 		return 0;
 	}
 
+	uint64_t Process::next_alarm_wake_time_ns()
+	{
+		return s_next_alarm_wake_time_ns;
+	}
+
 	void Process::update_alarm_queue()
 	{
 		ASSERT(Processor::current_is_bsp());
@@ -1183,6 +1210,8 @@ namespace Kernel
 				it++;
 			MUST(s_alarm_processes.insert(it, process));
 		}
+
+		s_next_alarm_wake_time_ns = s_alarm_processes.empty() ? static_cast<uint64_t>(-1) : s_alarm_processes.front()->m_alarm_wake_time_ns;
 	}
 
 	BAN::ErrorOr<void> Process::create_file(int fd, const char* path, mode_t mode) const
@@ -1493,6 +1522,86 @@ namespace Kernel
 
 		return TRY(inode->write(offset, { reinterpret_cast<const uint8_t*>(buffer), count }));	}
 
+	BAN::ErrorOr<void> Process::read_and_pin_iovec(const iovec* user_iov, int iovcnt, bool needs_write, BAN::Vector<iovec>& iov, BAN::Vector<MemoryRegion*>& regions)
+	{
+		if (iovcnt < 0 || iovcnt > IOV_MAX)
+			return BAN::Error::from_errno(EINVAL);
+
+		TRY(iov.resize(iovcnt));
+		TRY(read_from_user(user_iov, iov.data(), iovcnt * sizeof(iovec)));
+
+		size_t total_len = 0;
+		for (const auto& vec : iov)
+		{
+			if (vec.iov_len > BAN::numeric_limits<ssize_t>::max() - total_len)
+				return BAN::Error::from_errno(EINVAL);
+			total_len += vec.iov_len;
+		}
+
+		TRY(regions.reserve(iovcnt));
+		for (const auto& vec : iov)
+			if (vec.iov_len > 0)
+				TRY(regions.push_back(TRY(validate_and_pin_pointer_access(vec.iov_base, vec.iov_len, needs_write))));
+
+		return {};
+	}
+
+	BAN::ErrorOr<long> Process::sys_readv(int fd, const iovec* user_iov, int iovcnt)
+	{
+		BAN::Vector<iovec> iov;
+		BAN::Vector<MemoryRegion*> regions;
+		BAN::ScopeGuard _([&regions] {
+			for (auto* region : regions)
+				region->unpin();
+		});
+		TRY(read_and_pin_iovec(user_iov, iovcnt, true, iov, regions));
+
+		return TRY(m_open_file_descriptors.readv(fd, iov.span()));
+	}
+
+	BAN::ErrorOr<long> Process::sys_writev(int fd, const iovec* user_iov, int iovcnt)
+	{
+		BAN::Vector<iovec> iov;
+		BAN::Vector<MemoryRegion*> regions;
+		BAN::ScopeGuard _([&regions] {
+			for (auto* region : regions)
+				region->unpin();
+		});
+		TRY(read_and_pin_iovec(user_iov, iovcnt, false, iov, regions));
+
+		return TRY(m_open_file_descriptors.writev(fd, iov.span()));
+	}
+
+	BAN::ErrorOr<long> Process::sys_preadv(int fd, const iovec* user_iov, int iovcnt, off_t offset)
+	{
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+
+		BAN::Vector<iovec> iov;
+		BAN::Vector<MemoryRegion*> regions;
+		BAN::ScopeGuard _([&regions] {
+			for (auto* region : regions)
+				region->unpin();
+		});
+		TRY(read_and_pin_iovec(user_iov, iovcnt, true, iov, regions));
+
+		return TRY(inode->readv(offset, iov.span()));
+	}
+
+	BAN::ErrorOr<long> Process::sys_pwritev(int fd, const iovec* user_iov, int iovcnt, off_t offset)
+	{
+		auto inode = TRY(m_open_file_descriptors.inode_of(fd));
+
+		BAN::Vector<iovec> iov;
+		BAN::Vector<MemoryRegion*> regions;
+		BAN::ScopeGuard _([&regions] {
+			for (auto* region : regions)
+				region->unpin();
+		});
+		TRY(read_and_pin_iovec(user_iov, iovcnt, false, iov, regions));
+
+		return TRY(inode->writev(offset, iov.span()));
+	}
+
 	BAN::ErrorOr<long> Process::sys_fchmodat(int fd, const char* user_path, mode_t mode, int flag)
 	{
 		if (flag & ~AT_SYMLINK_NOFOLLOW)
@@ -1851,6 +1960,20 @@ namespace Kernel
 		return TRY(m_open_file_descriptors.sendmsg(socket, message, flags));
 	}
 
+	BAN::ErrorOr<long> Process::sys_sendfile(int out_fd, int in_fd, off_t* user_offset, size_t count)
+	{
+		off_t offset;
+		if (user_offset)
+			TRY(read_from_user(user_offset, &offset, sizeof(off_t)));
+
+		const size_t nsent = TRY(m_open_file_descriptors.sendfile(out_fd, in_fd, user_offset ? &offset : nullptr, count));
+
+		if (user_offset)
+			TRY(write_to_user(user_offset, &offset, sizeof(off_t)));
+
+		return nsent;
+	}
+
 	BAN::ErrorOr<long> Process::sys_ioctl(int fildes, int request, void* arg)
 	{
 		auto inode = TRY(m_open_file_descriptors.inode_of(fildes));
@@ -2887,6 +3010,166 @@ namespace Kernel
 		return 0;
 	}
 
+	BAN::ErrorOr<long> Process::sys_getpriority(int which, id_t who)
+	{
+		if (which != PRIO_PROCESS && which != PRIO_PGRP && which != PRIO_USER)
+			return BAN::Error::from_errno(EINVAL);
+
+		if (who == 0)
+		{
+			switch (which)
+			{
+				case PRIO_PROCESS: who = m_pid; break;
+				case PRIO_PGRP:    who = m_pgrp; break;
+				case PRIO_USER:    who = m_credentials.ruid(); break;
+			}
+		}
+
+		// most favorable value of all matching processes is reported
+		int result = INT_MAX;
+		for_each_process(
+			[&](Process& process)
+			{
+				const id_t id = (which == PRIO_PROCESS) ? process.pid()
+					: (which == PRIO_PGRP) ? process.pgrp()
+					: process.m_credentials.ruid();
+				if (id == who)
+					result = BAN::Math::min(result, process.nice());
+				return BAN::Iteration::Continue;
+			}
+		);
+
+		if (result == INT_MAX)
+			return BAN::Error::from_errno(ESRCH);
+
+		// nice can be negative, shift it so it is not confused with an error
+		return result + 20;
+	}
+
+	BAN::ErrorOr<long> Process::sys_setpriority(int which, id_t who, int value)
+	{
+		if (which != PRIO_PROCESS && which != PRIO_PGRP && which != PRIO_USER)
+			return BAN::Error::from_errno(EINVAL);
+
+		if (who == 0)
+		{
+			switch (which)
+			{
+				case PRIO_PROCESS: who = m_pid; break;
+				case PRIO_PGRP:    who = m_pgrp; break;
+				case PRIO_USER:    who = m_credentials.ruid(); break;
+			}
+		}
+
+		const int8_t nice = BAN::Math::clamp(value, -20, 19);
+
+		bool found = false;
+		int error = 0;
+		for_each_process(
+			[&](Process& process)
+			{
+				const id_t id = (which == PRIO_PROCESS) ? process.pid()
+					: (which == PRIO_PGRP) ? process.pgrp()
+					: process.m_credentials.ruid();
+				if (id != who)
+					return BAN::Iteration::Continue;
+
+				found = true;
+
+				if (!m_credentials.is_superuser())
+				{
+					const auto& credentials = process.m_credentials;
+					if (credentials.ruid() != m_credentials.euid() && credentials.euid() != m_credentials.euid())
+					{
+						error = EPERM;
+						return BAN::Iteration::Continue;
+					}
+					// only superuser can raise priority
+					if (nice < process.nice())
+					{
+						error = EACCES;
+						return BAN::Iteration::Continue;
+					}
+				}
+
+				process.m_nice = nice;
+				return BAN::Iteration::Continue;
+			}
+		);
+
+		if (!found)
+			return BAN::Error::from_errno(ESRCH);
+		if (error)
+			return BAN::Error::from_errno(error);
+		return 0;
+	}
+
+	BAN::ErrorOr<long> Process::sys_sched_getaffinity(pid_t tid, size_t cpusetsize, cpu_set_t* user_mask)
+	{
+		if (cpusetsize > sizeof(cpu_set_t) || cpusetsize * 8 < Processor::count())
+			return BAN::Error::from_errno(EINVAL);
+
+		cpu_set_t mask;
+
+		{
+			LockGuard _(m_process_lock);
+
+			Thread* target = (tid == 0) ? &Thread::current() : nullptr;
+			for (size_t i = 0; i < m_threads.size() && target == nullptr; i++)
+				if (m_threads[i]->tid() == tid)
+					target = m_threads[i];
+			if (target == nullptr)
+				return BAN::Error::from_errno(ESRCH);
+
+			target->get_affinity(mask);
+		}
+
+		// only report processors that exist
+		for (size_t i = Processor::count(); i < CPU_SETSIZE; i++)
+			CPU_CLR(i, &mask);
+
+		TRY(write_to_user(user_mask, &mask, cpusetsize));
+
+		return 0;
+	}
+
+	BAN::ErrorOr<long> Process::sys_sched_setaffinity(pid_t tid, size_t cpusetsize, const cpu_set_t* user_mask)
+	{
+		cpu_set_t mask;
+		memset(&mask, 0, sizeof(mask));
+		TRY(read_from_user(user_mask, &mask, BAN::Math::min(cpusetsize, sizeof(cpu_set_t))));
+
+		bool has_processor = false;
+		for (size_t i = 0; i < CPU_SETSIZE; i++)
+		{
+			if (i >= Processor::count())
+				CPU_CLR(i, &mask);
+			else if (CPU_ISSET(i, &mask))
+				has_processor = true;
+		}
+		if (!has_processor)
+			return BAN::Error::from_errno(EINVAL);
+
+		{
+			LockGuard _(m_process_lock);
+
+			Thread* target = (tid == 0) ? &Thread::current() : nullptr;
+			for (size_t i = 0; i < m_threads.size() && target == nullptr; i++)
+				if (m_threads[i]->tid() == tid)
+					target = m_threads[i];
+			if (target == nullptr)
+				return BAN::Error::from_errno(ESRCH);
+
+			// other threads move on their next reschedule
+			target->set_affinity(mask);
+		}
+
+		if (!Thread::current().can_run_on_processor(Processor::current_index()))
+			Processor::yield();
+
+		return 0;
+	}
+
 
 	BAN::ErrorOr<long> Process::sys_load_keymap(const char* user_path)
 	{
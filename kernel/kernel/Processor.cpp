@@ -437,6 +437,12 @@ namespace Kernel
 				case SMPMessage::Type::UnblockThread:
 					processor.m_scheduler->unblock_thread(message->unblock_thread);
 					break;
+				case SMPMessage::Type::StealThread:
+					processor.m_scheduler->handle_steal_request(message->steal_thread);
+					break;
+				case SMPMessage::Type::RearmTimer:
+					processor.m_scheduler->update_timer_deadline();
+					break;
 				case SMPMessage::Type::UpdateTSC:
 					update_tsc();
 					break;
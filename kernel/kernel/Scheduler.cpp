@@ -1,5 +1,7 @@
 #include <BAN/Optional.h>
 #include <BAN/Sort.h>
+#include <BAN/Swap.h>
+#include <kernel/APIC.h>
 #include <kernel/InterruptController.h>
 #include <kernel/Lock/Mutex.h>
 #include <kernel/Process.h>
@@ -18,8 +20,37 @@
 namespace Kernel
 {
 
-	static constexpr uint64_t s_reschedule_interval_ns   =    10'000'000;
+	// runnable threads share this period, weighted by their nice values
+	static constexpr uint64_t s_target_latency_ns        =    12'000'000;
+	static constexpr uint64_t s_min_time_slice_ns        =     1'000'000;
+	static constexpr uint64_t s_max_time_slice_ns        =    10'000'000;
+	// woken thread preempts current one if it is behind by this much
+	static constexpr uint64_t s_wakeup_granularity_ns    =     1'000'000;
+	// woken threads are placed this much before the minimum vruntime
+	static constexpr uint64_t s_sleeper_credit_ns        =     6'000'000;
+	static constexpr uint64_t s_steal_retry_interval_ns  =     1'000'000;
 	static constexpr uint64_t s_load_balance_interval_ns = 1'000'000'000;
+	// upper bound for one-shot timer, even a fully idle processor wakes up this often
+	static constexpr uint64_t s_max_timer_interval_ns    = 1'000'000'000;
+
+	static constexpr uint64_t s_nice_0_weight = 1024;
+
+	// every nice level is ~10% cpu time difference to the next one
+	static constexpr uint32_t s_nice_to_weight[40] {
+		/* -20 */ 88761, 71755, 56483, 46273, 36291,
+		/* -15 */ 29154, 23254, 18705, 14949, 11916,
+		/* -10 */  9548,  7620,  6100,  4904,  3906,
+		/*  -5 */  3121,  2501,  1991,  1586,  1277,
+		/*   0 */  1024,   820,   655,   526,   423,
+		/*   5 */   335,   272,   215,   172,   137,
+		/*  10 */   110,    87,    70,    56,    45,
+		/*  15 */    36,    29,    23,    18,    15,
+	};
+
+	static uint64_t nice_to_weight(int nice)
+	{
+		return s_nice_to_weight[BAN::Math::clamp(nice, -20, 19) + 20];
+	}
 
 	static BAN::Atomic<uint8_t> s_schedulers_initialized { 0 };
 
@@ -27,6 +58,11 @@ namespace Kernel
 	{
 		uint64_t idle_time_ns     { s_load_balance_interval_ns };
 		uint32_t max_load_threads { 0 };
+
+		// threads waiting in the run queue, read without locking by idle processors
+		BAN::Atomic<uint32_t> runnable_threads { 0 };
+		// processor has nothing to run and does not take timer ticks
+		BAN::Atomic<bool> is_idle { false };
 	};
 
 	static SpinLock                        s_processor_info_time_lock;
@@ -36,34 +72,33 @@ namespace Kernel
 	static BAN::Atomic<size_t> s_next_processor_index { 0 };
 
 
+	void SchedulerQueue::insert_before(Node* next, Node* node)
+	{
+		Node* prev = next ? next->prev : m_tail;
+		node->next = next;
+		node->prev = prev;
+		(next ? next->prev : m_tail) = node;
+		(prev ? prev->next : m_head) = node;
+		m_size++;
+	}
+
 	void SchedulerQueue::add_thread_to_back(Node* node)
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
-		node->next = nullptr;
-		node->prev = m_tail;
-		(m_tail ? m_tail->next : m_head) = node;
-		m_tail = node;
+		insert_before(nullptr, node);
 	}
 
-	void SchedulerQueue::add_thread_with_wake_time(Node* node)
+	void SchedulerQueue::add_thread_with_vruntime(Node* node)
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
 
-		if (m_tail == nullptr || node->wake_time_ns >= m_tail->wake_time_ns)
-			return add_thread_to_back(node);
+		if (m_tail == nullptr || node->vruntime_ns >= m_tail->vruntime_ns)
+			return insert_before(nullptr, node);
 
 		Node* next = m_head;
-		Node* prev = nullptr;
-		while (next && node->wake_time_ns > next->wake_time_ns)
-		{
-			prev = next;
+		while (next && node->vruntime_ns >= next->vruntime_ns)
 			next = next->next;
-		}
-
-		node->next = next;
-		node->prev = prev;
-		(next ? next->prev : m_tail) = node;
-		(prev ? prev->next : m_head) = node;
+		insert_before(next, node);
 	}
 
 	template<typename F>
@@ -88,6 +123,7 @@ namespace Kernel
 		(node->next ? node->next->prev : m_tail) = node->prev;
 		node->prev = nullptr;
 		node->next = nullptr;
+		m_size--;
 	}
 
 	SchedulerQueue::Node* SchedulerQueue::front()
@@ -97,6 +133,13 @@ namespace Kernel
 		return m_head;
 	}
 
+	SchedulerQueue::Node* SchedulerQueue::back()
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		ASSERT(!empty());
+		return m_tail;
+	}
+
 	SchedulerQueue::Node* SchedulerQueue::pop_front()
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
@@ -106,9 +149,99 @@ namespace Kernel
 		m_head = m_head->next;
 		(m_head ? m_head->prev : m_tail) = nullptr;
 		result->next = nullptr;
+		m_size--;
 		return result;
 	}
 
+	SchedulerSleepQueue::Node* SchedulerSleepQueue::meld(Node* a, Node* b)
+	{
+		if (a == nullptr)
+			return b;
+		if (b == nullptr)
+			return a;
+		if (b->wake_time_ns < a->wake_time_ns)
+			BAN::swap(a, b);
+
+		b->sleep_prev = a;
+		b->sleep_sibling = a->sleep_child;
+		if (a->sleep_child)
+			a->sleep_child->sleep_prev = b;
+		a->sleep_child = b;
+
+		return a;
+	}
+
+	SchedulerSleepQueue::Node* SchedulerSleepQueue::merge_pairs(Node* first)
+	{
+		// meld siblings pairwise from left to right, collecting the results in reverse order
+		Node* pairs = nullptr;
+		while (first)
+		{
+			Node* a = first;
+			Node* b = a->sleep_sibling;
+			first = b ? b->sleep_sibling : nullptr;
+
+			a->sleep_sibling = nullptr;
+			a->sleep_prev = nullptr;
+			if (b)
+			{
+				b->sleep_sibling = nullptr;
+				b->sleep_prev = nullptr;
+			}
+
+			Node* melded = meld(a, b);
+			melded->sleep_sibling = pairs;
+			pairs = melded;
+		}
+
+		// then meld the pairs from right to left
+		Node* result = nullptr;
+		while (pairs)
+		{
+			Node* next = pairs->sleep_sibling;
+			pairs->sleep_sibling = nullptr;
+			result = meld(result, pairs);
+			pairs = next;
+		}
+
+		return result;
+	}
+
+	void SchedulerSleepQueue::add_thread(Node* node)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		ASSERT(!node->in_sleep_queue);
+
+		node->sleep_child = nullptr;
+		node->sleep_sibling = nullptr;
+		node->sleep_prev = nullptr;
+		node->in_sleep_queue = true;
+
+		m_root = meld(m_root, node);
+	}
+
+	void SchedulerSleepQueue::remove_node(Node* node)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		ASSERT(node->in_sleep_queue);
+
+		if (node == m_root)
+			m_root = merge_pairs(node->sleep_child);
+		else
+		{
+			Node* prev = node->sleep_prev;
+			(prev->sleep_child == node ? prev->sleep_child : prev->sleep_sibling) = node->sleep_sibling;
+			if (node->sleep_sibling)
+				node->sleep_sibling->sleep_prev = prev;
+			m_root = meld(m_root, merge_pairs(node->sleep_child));
+		}
+
+		node->sleep_child = nullptr;
+		node->sleep_sibling = nullptr;
+		node->sleep_prev = nullptr;
+		node->in_sleep_queue = false;
+	}
+
 	BAN::ErrorOr<Scheduler*> Scheduler::create()
 	{
 		auto* scheduler = new Scheduler();
@@ -139,7 +272,17 @@ namespace Kernel
 		if (Processor::count() > 1)
 			Processor::set_smp_enabled();
 
-		m_next_reschedule_ns = SystemTimer::get().ns_since_boot();
+		m_slice_start_ns = SystemTimer::get().ns_since_boot();
+
+		// lapic timer is per processor and runs in one-shot mode
+		m_is_tickless = InterruptController::get().is_using_apic();
+		if (m_is_tickless)
+		{
+			auto state = Processor::get_interrupt_state();
+			Processor::set_interrupt_state(InterruptState::Disabled);
+			update_timer_deadline();
+			Processor::set_interrupt_state(state);
+		}
 
 		return {};
 	}
@@ -209,16 +352,117 @@ namespace Kernel
 		m_most_loaded_threads.back().queue = nullptr;
 	}
 
+	void Scheduler::update_current_runtime(uint64_t current_ns)
+	{
+		ASSERT(m_current);
+
+		const uint64_t delta_ns = current_ns - BAN::Math::min(current_ns, m_current->last_start_ns);
+		m_current->time_used_ns += delta_ns;
+		m_current->vruntime_ns  += delta_ns * s_nice_0_weight / nice_to_weight(m_current->thread->nice());
+		m_current->last_start_ns = current_ns;
+	}
+
+	void Scheduler::update_min_vruntime()
+	{
+		uint64_t min_vruntime_ns = m_current ? m_current->vruntime_ns : UINT64_MAX;
+		if (!m_run_queue.empty())
+			min_vruntime_ns = BAN::Math::min(min_vruntime_ns, m_run_queue.front()->vruntime_ns);
+		// minimum only moves forward so newly added threads cannot lag behind forever
+		if (min_vruntime_ns != UINT64_MAX && min_vruntime_ns > m_min_vruntime_ns)
+			m_min_vruntime_ns = min_vruntime_ns;
+	}
+
+	uint64_t Scheduler::current_time_slice_ns() const
+	{
+		ASSERT(m_current);
+		const uint64_t weight = nice_to_weight(m_current->thread->nice());
+		const uint64_t slice_ns = s_target_latency_ns * weight / s_nice_0_weight / (m_run_queue.size() + 1);
+		return BAN::Math::clamp(slice_ns, s_min_time_slice_ns, s_max_time_slice_ns);
+	}
+
+	void Scheduler::add_runnable_thread(SchedulerQueue::Node* node, bool is_wakeup)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+
+		if (is_wakeup)
+		{
+			// sleepers get a small head start, but cannot bank vruntime while sleeping
+			const uint64_t floor_ns = m_min_vruntime_ns - BAN::Math::min(m_min_vruntime_ns, s_sleeper_credit_ns);
+			node->vruntime_ns = BAN::Math::max(node->vruntime_ns, floor_ns);
+
+			if (m_current && node->vruntime_ns + s_wakeup_granularity_ns < m_current->vruntime_ns)
+				m_should_preempt = true;
+		}
+
+		m_run_queue.add_thread_with_vruntime(node);
+	}
+
+	void Scheduler::update_runnable_count()
+	{
+		auto& info = s_processor_infos[Processor::current_id().as_u32()];
+		info.runnable_threads = m_run_queue.size();
+		info.is_idle = (m_current == nullptr && m_run_queue.empty());
+	}
+
+	void Scheduler::add_blocked_thread(SchedulerQueue::Node* node)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		m_block_queue.add_thread_to_back(node);
+		if (node->wake_time_ns != static_cast<uint64_t>(-1))
+			m_sleep_queue.add_thread(node);
+	}
+
+	void Scheduler::remove_blocked_thread(SchedulerQueue::Node* node)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		m_block_queue.remove_node(node);
+		if (node->in_sleep_queue)
+			m_sleep_queue.remove_node(node);
+	}
+
+	void Scheduler::update_timer_deadline()
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+
+		if (!m_is_tickless)
+			return;
+
+		const uint64_t current_ns = SystemTimer::get().ns_since_boot();
+
+		uint64_t deadline_ns = current_ns + s_max_timer_interval_ns;
+		if (!m_sleep_queue.empty())
+			deadline_ns = BAN::Math::min(deadline_ns, m_sleep_queue.front()->wake_time_ns);
+		if (m_current && !m_run_queue.empty())
+			deadline_ns = BAN::Math::min(deadline_ns, m_slice_start_ns + current_time_slice_ns());
+		if (Processor::is_smp_enabled())
+			deadline_ns = BAN::Math::min(deadline_ns, m_last_load_balance_ns + s_load_balance_interval_ns);
+		if (Processor::current_is_bsp())
+			deadline_ns = BAN::Math::min(deadline_ns, Process::next_alarm_wake_time_ns());
+
+		// an earlier deadline than needed only causes a spurious interrupt, no need to push it back
+		if (m_timer_deadline_ns > current_ns && m_timer_deadline_ns <= deadline_ns)
+			return;
+
+		m_timer_deadline_ns = BAN::Math::max(deadline_ns, current_ns);
+		static_cast<APIC&>(InterruptController::get()).set_timer_deadline_ns(m_timer_deadline_ns - current_ns);
+	}
+
 	void Scheduler::reschedule(YieldRegisters* yield_registers)
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
 
 		// If there are no other threads in run queue, reschedule can be no-op :)
-		if (m_run_queue.empty() && (!m_current || !m_current->blocked) && current_thread().state() == Thread::State::Executing)
+		if (m_run_queue.empty() && (!m_current || (!m_current->blocked && m_current->thread->can_run_on_processor(Processor::current_index()))) && current_thread().state() == Thread::State::Executing)
+		{
+			m_should_preempt = false;
+			update_timer_deadline();
 			return;
+		}
+
+		const uint64_t current_ns = SystemTimer::get().ns_since_boot();
 
 		if (m_current == nullptr)
-			m_idle_ns += SystemTimer::get().ns_since_boot() - m_idle_start_ns;
+			m_idle_ns += current_ns - m_idle_start_ns;
 		else
 		{
 			switch (m_current->thread->state())
@@ -233,25 +477,39 @@ namespace Kernel
 					break;
 				case Thread::State::Executing:
 				{
-					const uint64_t current_ns = SystemTimer::get().ns_since_boot();
 					m_current->thread->yield_registers() = *yield_registers;
-					m_current->time_used_ns += current_ns - m_current->last_start_ns;
+					update_current_runtime(current_ns);
 					add_current_to_most_loaded(m_current->blocked ? &m_block_queue : &m_run_queue);
 					if (!m_current->blocked)
-						m_run_queue.add_thread_to_back(m_current);
+						add_runnable_thread(m_current, false);
 					else
-						m_block_queue.add_thread_with_wake_time(m_current);
+						add_blocked_thread(m_current);
+
+					// affinity was changed to exclude this processor
+					if (!m_current->thread->can_run_on_processor(Processor::current_index()))
+					{
+						auto* node = m_current;
+						m_current = nullptr;
+						const auto processor_id = find_least_loaded_processor(node);
+						if (processor_id != PROCESSOR_NONE && processor_id != Processor::current_id())
+						{
+							remove_node_from_most_loaded(node);
+							migrate_thread(node, node->blocked ? m_block_queue : m_run_queue, processor_id);
+						}
+					}
 					break;
 				}
 				case Thread::State::NotStarted:
 					ASSERT(!m_current->blocked);
 					m_current->time_used_ns = 0;
 					remove_node_from_most_loaded(m_current);
-					m_run_queue.add_thread_to_back(m_current);
+					add_runnable_thread(m_current, false);
 					break;
 			}
 		}
 
+		m_should_preempt = false;
+
 		while ((m_current = m_run_queue.pop_front()))
 		{
 			if (m_current->thread->state() != Thread::State::Terminated)
@@ -264,13 +522,18 @@ namespace Kernel
 			m_thread_count--;
 		}
 
+		update_min_vruntime();
+		update_runnable_count();
+
 		if (m_current == nullptr)
 		{
 			if (&PageTable::current() != &PageTable::kernel())
 				PageTable::kernel().load();
 			*yield_registers = m_idle_thread->yield_registers();
 			m_idle_thread->m_state = Thread::State::Executing;
-			m_idle_start_ns        = SystemTimer::get().ns_since_boot();
+			m_idle_start_ns        = current_ns;
+			try_steal_thread(current_ns);
+			update_timer_deadline();
 			return;
 		}
 
@@ -303,6 +566,9 @@ namespace Kernel
 		*yield_registers = thread->yield_registers();
 
 		m_current->last_start_ns = SystemTimer::get().ns_since_boot();
+		m_slice_start_ns = m_current->last_start_ns;
+
+		update_timer_deadline();
 	}
 
 	void Scheduler::wake_up_sleeping_threads()
@@ -310,29 +576,40 @@ namespace Kernel
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
 
 		const uint64_t current_ns = SystemTimer::get().ns_since_boot();
-		while (!m_block_queue.empty() && current_ns >= m_block_queue.front()->wake_time_ns)
+		while (!m_sleep_queue.empty() && current_ns >= m_sleep_queue.front()->wake_time_ns)
 		{
-			auto* node = m_block_queue.pop_front();
+			auto* node = m_sleep_queue.front();
+			remove_blocked_thread(node);
 			if (auto* blocker = node->blocker.load())
 				blocker->remove_thread_from_block_queue(node);
 			node->blocked = false;
 			update_most_loaded_node_queue(node, &m_run_queue);
-			m_run_queue.add_thread_to_back(node);
+			add_runnable_thread(node, true);
 		}
+
+		update_runnable_count();
+		push_to_idle_processor();
 	}
 
-	void Scheduler::reschedule_if_idle()
+	void Scheduler::reschedule_if_needed()
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
 
 		if (m_current != nullptr)
-			return;
+		{
+			if (m_should_preempt)
+				return Processor::yield();
+			return update_timer_deadline();
+		}
 
 		if (m_run_queue.empty())
 			wake_up_sleeping_threads();
 
 		if (!m_run_queue.empty())
-			Processor::yield();
+			return Processor::yield();
+
+		try_steal_thread(SystemTimer::get().ns_since_boot());
+		update_timer_deadline();
 	}
 
 	extern "C" void scheduler_on_yield(YieldRegisters* yield_registers)
@@ -344,16 +621,49 @@ namespace Kernel
 	{
 		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
 
+		// one-shot timer has fired, it gets rearmed below or when switching threads
+		m_timer_deadline_ns = 0;
+
 		if (Processor::is_smp_enabled())
 			do_load_balancing();
 
 		wake_up_sleeping_threads();
 
-		if (SystemTimer::get().ns_since_boot() >= m_next_reschedule_ns)
+		const uint64_t current_ns = SystemTimer::get().ns_since_boot();
+
+		if (m_current != nullptr)
+		{
+			update_current_runtime(current_ns);
+			update_min_vruntime();
+		}
+		else if (m_run_queue.empty())
+			try_steal_thread(current_ns);
+
+		if (should_switch_thread(current_ns))
+			return Processor::yield();
+
+		update_timer_deadline();
+	}
+
+	bool Scheduler::should_switch_thread(uint64_t current_ns)
+	{
+		if (m_run_queue.empty())
+			return false;
+
+		if (m_current == nullptr || m_should_preempt)
+			return true;
+
+		if (current_ns < m_slice_start_ns + current_time_slice_ns())
+			return false;
+
+		// current thread is still the one with least vruntime, let it continue
+		if (m_current->vruntime_ns <= m_run_queue.front()->vruntime_ns)
 		{
-			m_next_reschedule_ns += s_reschedule_interval_ns;
-			Processor::yield();
+			m_slice_start_ns = current_ns;
+			return false;
 		}
+
+		return true;
 	}
 
 	void Scheduler::unblock_thread(SchedulerQueue::Node* node)
@@ -364,15 +674,18 @@ namespace Kernel
 		if (node->processor_id == Processor::current_id())
 		{
 			if (!node->blocked)
-				return;
+				return Processor::set_interrupt_state(state);
 			if (node != m_current)
-				m_block_queue.remove_node(node);
+				remove_blocked_thread(node);
 			if (auto* blocker = node->blocker.load())
 				blocker->remove_thread_from_block_queue(node);
 			node->blocked = false;
 			if (node != m_current)
-				m_run_queue.add_thread_to_back(node);
+				add_runnable_thread(node, true);
 			update_most_loaded_node_queue(node, &m_run_queue);
+			update_runnable_count();
+			push_to_idle_processor();
+			update_timer_deadline();
 		}
 		else
 		{
@@ -392,31 +705,167 @@ namespace Kernel
 
 		ASSERT(node->processor_id == Processor::current_id());
 
+		// vruntime is relative while the thread is not owned by any scheduler
+		node->vruntime_ns += m_min_vruntime_ns;
+
 		if (!node->blocked)
-			m_run_queue.add_thread_to_back(node);
+			add_runnable_thread(node, false);
 		else
-			m_block_queue.add_thread_with_wake_time(node);
+			add_blocked_thread(node);
 
 		if (auto* thread = node->thread; thread->is_userspace() && thread->has_process())
 			thread->update_processor_index_address();
 
 		m_thread_count++;
 
+		update_runnable_count();
+		update_timer_deadline();
+
+		Processor::set_interrupt_state(state);
+	}
+
+	void Scheduler::migrate_thread(SchedulerQueue::Node* node, SchedulerQueue& queue, ProcessorID processor_id)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+		ASSERT(node != m_current);
+
+		if (auto* thread = node->thread; thread == Processor::get_current_sse_thread())
+		{
+			Processor::enable_sse();
+			thread->save_sse();
+			Processor::set_current_sse_thread(nullptr);
+			Processor::disable_sse();
+		}
+
+		node->time_used_ns = 0;
+		node->vruntime_ns -= BAN::Math::min(node->vruntime_ns, m_min_vruntime_ns);
+
+		if (&queue == &m_block_queue)
+			remove_blocked_thread(node);
+		else
+			queue.remove_node(node);
+		m_thread_count--;
+
+		update_runnable_count();
+
+		node->processor_id = processor_id;
+
+		Processor::send_smp_message(processor_id, {
+			.type = Processor::SMPMessage::Type::NewThread,
+			.new_thread = node
+		});
+	}
+
+	void Scheduler::try_steal_thread(uint64_t current_ns)
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+
+		if (!Processor::is_smp_enabled())
+			return;
+		if (current_ns < m_last_steal_request_ns + s_steal_retry_interval_ns)
+			return;
+
+		ProcessorID busiest_id = PROCESSOR_NONE;
+		uint32_t most_runnable = 0;
+		for (uint8_t i = 0; i < Processor::count(); i++)
+		{
+			const auto processor_id = Processor::id_from_index(i);
+			if (processor_id == Processor::current_id())
+				continue;
+			const uint32_t runnable = s_processor_infos[processor_id.as_u32()].runnable_threads;
+			if (runnable <= most_runnable)
+				continue;
+			busiest_id = processor_id;
+			most_runnable = runnable;
+		}
+
+		if (busiest_id == PROCESSOR_NONE)
+			return;
+
+		m_last_steal_request_ns = current_ns;
+
+		dprintln_if(DEBUG_SCHEDULER, "CPU {}: requesting thread from CPU {}", Processor::current_id(), busiest_id);
+
+		Processor::send_smp_message(busiest_id, {
+			.type = Processor::SMPMessage::Type::StealThread,
+			.steal_thread = Processor::current_index(),
+		});
+	}
+
+	void Scheduler::push_to_idle_processor()
+	{
+		ASSERT(Processor::get_interrupt_state() == InterruptState::Disabled);
+
+		// idle processors do not take ticks, so they cannot notice threads waiting here
+		if (m_current == nullptr || m_run_queue.empty() || !Processor::is_smp_enabled())
+			return;
+
+		for (uint8_t i = 0; i < Processor::count(); i++)
+		{
+			const auto processor_id = Processor::id_from_index(i);
+			if (processor_id == Processor::current_id())
+				continue;
+
+			auto& info = s_processor_infos[processor_id.as_u32()];
+			bool expected = true;
+			if (!info.is_idle.compare_exchange(expected, false))
+				continue;
+
+			if (handle_steal_request(i))
+				return;
+			info.is_idle = true;
+		}
+	}
+
+	bool Scheduler::handle_steal_request(uint8_t requester_index)
+	{
+		auto state = Processor::get_interrupt_state();
+		Processor::set_interrupt_state(InterruptState::Disabled);
+
+		bool result = false;
+
+		// give away the thread that would have to wait the longest here
+		for (auto* node = m_run_queue.empty() ? nullptr : m_run_queue.back(); node; node = node->prev)
+		{
+			if (node->thread->state() == Thread::State::Terminated)
+				continue;
+			if (!node->thread->can_run_on_processor(requester_index))
+				continue;
+
+			const auto requester = Processor::id_from_index(requester_index);
+
+			dprintln_if(DEBUG_SCHEDULER, "CPU {}: sending tid {} to idle CPU {}", Processor::current_id(), node->thread->tid(), requester);
+
+			remove_node_from_most_loaded(node);
+			migrate_thread(node, m_run_queue, requester);
+			result = true;
+			break;
+		}
+
 		Processor::set_interrupt_state(state);
+
+		return result;
 	}
 
-	ProcessorID Scheduler::find_least_loaded_processor() const
+	ProcessorID Scheduler::find_least_loaded_processor(const SchedulerQueue::Node* node) const
 	{
-		ProcessorID least_loaded_id        = Processor::current_id();
-		uint64_t    most_idle_ns           = m_idle_ns;
+		ProcessorID least_loaded_id        = PROCESSOR_NONE;
+		uint64_t    most_idle_ns           = 0;
 		uint32_t    least_max_load_threads = static_cast<uint32_t>(-1);
+		if (node->thread->can_run_on_processor(Processor::current_index()))
+		{
+			least_loaded_id = Processor::current_id();
+			most_idle_ns    = m_idle_ns;
+		}
 		for (uint8_t i = 0; i < Processor::count(); i++)
 		{
 			const auto processor_id = Processor::id_from_index(i);
 			if (processor_id == Processor::current_id())
 				continue;
+			if (!node->thread->can_run_on_processor(i))
+				continue;
 			const auto& info = s_processor_infos[processor_id.as_u32()];
-			if (info.idle_time_ns < most_idle_ns || info.max_load_threads > least_max_load_threads)
+			if (least_loaded_id != PROCESSOR_NONE && (info.idle_time_ns < most_idle_ns || info.max_load_threads > least_max_load_threads))
 				continue;
 			least_loaded_id        = processor_id;
 			most_idle_ns           = info.idle_time_ns;
@@ -440,8 +889,7 @@ namespace Kernel
 		}
 		else
 		{
-			m_current->time_used_ns += current_ns - m_current->last_start_ns;
-			m_current->last_start_ns = current_ns;
+			update_current_runtime(current_ns);
 			add_current_to_most_loaded(nullptr);
 		}
 
@@ -516,9 +964,9 @@ namespace Kernel
 			if (thread_info.node == m_current || thread_info.queue == nullptr)
 				continue;
 
-			auto least_loaded_id = find_least_loaded_processor();
-			if (least_loaded_id == Processor::current_id())
-				break;
+			auto least_loaded_id = find_least_loaded_processor(thread_info.node);
+			if (least_loaded_id == Processor::current_id() || least_loaded_id == PROCESSOR_NONE)
+				continue;
 
 			auto& most_idle_info = s_processor_infos[least_loaded_id.as_u32()];
 			auto& my_info = s_processor_infos[Processor::current_id().as_u32()];
@@ -567,28 +1015,8 @@ namespace Kernel
 				dprintln_if(DEBUG_SCHEDULER, "CPU {}: sending tid {} to CPU {}", Processor::current_id(), thread_info.node->thread->tid(), least_loaded_id);
 			}
 
-			if (auto* thread = thread_info.node->thread; thread == Processor::get_current_sse_thread())
-			{
-				Processor::enable_sse();
-				thread->save_sse();
-				Processor::set_current_sse_thread(nullptr);
-				Processor::disable_sse();
-			}
-
-			thread_info.node->time_used_ns = 0;
-
-			{
-				auto& my_queue = (thread_info.queue == &m_run_queue) ? m_run_queue : m_block_queue;
-				my_queue.remove_node(thread_info.node);
-				m_thread_count--;
-			}
-
-			thread_info.node->processor_id = least_loaded_id;
-
-			Processor::send_smp_message(least_loaded_id, {
-				.type = Processor::SMPMessage::Type::NewThread,
-				.new_thread = thread_info.node
-			});
+			auto& my_queue = (thread_info.queue == &m_run_queue) ? m_run_queue : m_block_queue;
+			migrate_thread(thread_info.node, my_queue, least_loaded_id);
 
 			thread_info.node = nullptr;
 			thread_info.queue = nullptr;
@@ -631,7 +1059,10 @@ namespace Kernel
 	{
 		if (thread->m_scheduler_node == nullptr)
 		{
-			const size_t processor_index = s_next_processor_index++ % Processor::count();
+			size_t processor_index = s_next_processor_index++ % Processor::count();
+			for (size_t i = 0; i < Processor::count(); i++, processor_index = (processor_index + 1) % Processor::count())
+				if (thread->can_run_on_processor(processor_index))
+					break;
 			const auto processor_id = Processor::id_from_index(processor_index);
 			TRY(bind_thread_to_processor(thread, processor_id));
 		}
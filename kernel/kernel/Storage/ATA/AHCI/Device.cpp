@@ -1,4 +1,4 @@
-#include <kernel/Lock/LockGuard.h>
+#include <kernel/Lock/SpinLockAsMutex.h>
 #include <kernel/Scheduler.h>
 #include <kernel/Storage/ATA/AHCI/Controller.h>
 #include <kernel/Storage/ATA/AHCI/Device.h>
@@ -44,7 +44,17 @@ namespace Kernel
 		m_port->ie = 0xFFFFFFFF;
 
 		TRY(read_identify_data());
-		TRY(detail::ATABaseDevice::initialize({ (const uint16_t*)m_data_dma_region->vaddr(), m_data_dma_region->size() / sizeof(uint16_t) }));
+
+		const auto* identify_data = reinterpret_cast<const uint16_t*>(command_slot_buffer(0));
+		if (m_controller->supports_ncq() && (identify_data[ATA_IDENTIFY_SATA_CAPABILITIES] & ATA_SATA_CAPABILITIES_NCQ))
+		{
+			const uint32_t device_queue_depth = (identify_data[ATA_IDENTIFY_QUEUE_DEPTH] & 0x1F) + 1;
+			m_queue_depth = BAN::Math::min(device_queue_depth, m_controller->command_slot_count());
+			m_use_ncq = true;
+		}
+		dprintln("AHCI port using {}, queue depth {}", m_use_ncq ? "NCQ" : "DMA", m_queue_depth);
+
+		TRY(detail::ATABaseDevice::initialize({ identify_data, s_slot_buffer_size / sizeof(uint16_t) }));
 
 		return {};
 	}
@@ -57,7 +67,7 @@ namespace Kernel
 		m_dma_region = TRY(DMARegion::create(needed_bytes));
 		memset((void*)m_dma_region->vaddr(), 0x00, m_dma_region->size());
 
-		m_data_dma_region = TRY(DMARegion::create(PAGE_SIZE));
+		m_data_dma_region = TRY(DMARegion::create(command_slot_count * s_slot_buffer_size));
 		memset((void*)m_data_dma_region->vaddr(), 0x00, m_data_dma_region->size());
 
 		return {};
@@ -100,10 +110,10 @@ namespace Kernel
 
 		m_port->is = ~(uint32_t)0;
 
-		auto slot = find_free_command_slot();
-		ASSERT(slot.has_value());
+		const uint32_t slot = reserve_command_slot();
+		ASSERT(slot == 0);
 
-		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot.value()];
+		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot];
 		command_header.cfl = sizeof(FISRegisterH2D) / sizeof(uint32_t);
 		command_header.w = 0;
 		command_header.prdtl = 1;
@@ -121,14 +131,22 @@ namespace Kernel
 
 		const uint64_t timeout_ms = SystemTimer::get().ms_since_boot() + s_ata_timeout_ms;
 		while (m_port->tfd & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
-			if (SystemTimer::get().ms_since_boot() >= timeout_ms)
-				return BAN::Error::from_errno(ETIMEDOUT);
-
-		m_port->ci = 1 << slot.value();
+		{
+			if (SystemTimer::get().ms_since_boot() < timeout_ms)
+				continue;
+			release_command_slot(slot);
+			return BAN::Error::from_errno(ETIMEDOUT);
+		}
 
-		TRY(block_until_command_completed(slot.value()));
+		{
+			SpinLockGuard _(m_slot_lock);
+			m_issued_slots |= 1u << slot;
+			m_port->ci = 1u << slot;
+		}
 
-		return {};
+		auto result = block_until_command_completed(slot);
+		release_command_slot(slot);
+		return result;
 	}
 
 	static void print_error(uint16_t error)
@@ -150,6 +168,8 @@ namespace Kernel
 
 	void AHCIDevice::handle_irq()
 	{
+		SpinLockGuard _(m_slot_lock);
+
 		const uint32_t is = m_port->is;
 		m_port->is = is;
 
@@ -157,78 +177,161 @@ namespace Kernel
 		m_port->serr = serr;
 		if (auto err = serr & 0xFFFF)
 			print_error(err);
+
+		if (is & HBA_PxIS_ERROR_MASK)
+		{
+			// FIXME: with NCQ the failing tag could be read from the NCQ error log
+			//        and the other commands reissued. Now every outstanding command fails.
+			const uint32_t tfd = m_port->tfd;
+			dwarnln("AHCI port error (is {8H}, tfd {8H})", is, tfd);
+			restart_port();
+		}
+
+		const uint32_t active = m_port->ci | m_port->sact;
+		const uint32_t completed = m_issued_slots & ~active;
+		m_issued_slots &= ~completed;
+
+		for (uint32_t slot = 0; slot < 32; slot++)
+			if (completed & (1u << slot))
+				m_slot_blockers[slot].unblock();
+	}
+
+	void AHCIDevice::restart_port()
+	{
+		ASSERT(m_slot_lock.current_processor_has_lock());
+
+		// Restarting the port clears PxCI and PxSACT, so every outstanding command fails
+		m_failed_slots |= m_issued_slots;
+
+		stop_cmd(m_port);
+		m_port->serr = m_port->serr;
+		m_port->is = m_port->is;
+		start_cmd(m_port);
+
+		for (uint32_t slot = 0; slot < 32; slot++)
+			if (m_issued_slots & (1u << slot))
+				m_slot_blockers[slot].unblock();
 	}
 
 	BAN::ErrorOr<void> AHCIDevice::block_until_command_completed(uint32_t command_slot)
 	{
-		static constexpr uint64_t poll_timeout_ms = 10;
+		// Hardware state is checked on every wake up in case an interrupt was missed
+		static constexpr uint64_t poll_interval_ms = 10;
 
-		const auto start_time_ms = SystemTimer::get().ms_since_boot();
+		const uint32_t slot_mask = 1u << command_slot;
+		const uint64_t timeout_ms = SystemTimer::get().ms_since_boot() + s_ata_timeout_ms;
 
-		while (SystemTimer::get().ms_since_boot() < start_time_ms + poll_timeout_ms)
-			if (!(m_port->ci & (1 << command_slot)))
-				return {};
+		SpinLockGuard guard(m_slot_lock);
 
-		// FIXME: This should actually block once ThreadBlocker support blocking with timeout.
-		//        This doesn't allow scheduler to go properly idle.
-		while (SystemTimer::get().ms_since_boot() < start_time_ms + s_ata_timeout_ms)
+		for (;;)
 		{
-			Processor::yield();
-			if (!(m_port->ci & (1 << command_slot)))
+			if (m_failed_slots & slot_mask)
+			{
+				m_failed_slots &= ~slot_mask;
+				m_issued_slots &= ~slot_mask;
+				return BAN::Error::from_errno(EIO);
+			}
+
+			if (!((m_port->ci | m_port->sact) & slot_mask))
+			{
+				m_issued_slots &= ~slot_mask;
 				return {};
+			}
+
+			const uint64_t current_ms = SystemTimer::get().ms_since_boot();
+			if (current_ms >= timeout_ms)
+				break;
+
+			SpinLockGuardAsMutex smutex(guard);
+			m_slot_blockers[command_slot].block_with_wake_time_ms(BAN::Math::min(timeout_ms, current_ms + poll_interval_ms), &smutex);
 		}
 
+		// The command is still owned by the hardware. The port has to be reset
+		// before the slot and its buffers can be reused.
+		dwarnln("AHCI command in slot {} timed out", command_slot);
+		restart_port();
+		m_failed_slots &= ~slot_mask;
+		m_issued_slots &= ~slot_mask;
 		return BAN::Error::from_errno(ETIMEDOUT);
 	}
 
 	BAN::ErrorOr<void> AHCIDevice::read_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ByteSpan buffer)
 	{
-		LockGuard _(m_mutex);
-
 		ASSERT(buffer.size() >= sector_count * sector_size());
-		const size_t sectors_per_page = PAGE_SIZE / sector_size();
-		for (uint64_t sector_off = 0; sector_off < sector_count; sector_off += sectors_per_page)
-		{
-			uint64_t to_read = BAN::Math::min<uint64_t>(sector_count - sector_off, sectors_per_page);
-
-			TRY(send_command_and_block(lba + sector_off, to_read, Command::Read));
-			memcpy(buffer.data() + sector_off * sector_size(), (void*)m_data_dma_region->vaddr(), to_read * sector_size());
-		}
-
-		return {};
+		return send_commands_and_block(lba, sector_count, Command::Read, buffer.data());
 	}
 
 	BAN::ErrorOr<void> AHCIDevice::write_sectors_impl(uint64_t lba, uint64_t sector_count, BAN::ConstByteSpan buffer)
 	{
-		LockGuard _(m_mutex);
-
 		ASSERT(buffer.size() >= sector_count * sector_size());
-		const size_t sectors_per_page = PAGE_SIZE / sector_size();
-		for (uint64_t sector_off = 0; sector_off < sector_count; sector_off += sectors_per_page)
-		{
-			uint64_t to_read = BAN::Math::min<uint64_t>(sector_count - sector_off, sectors_per_page);
-
-			memcpy((void*)m_data_dma_region->vaddr(), buffer.data() + sector_off * sector_size(), to_read * sector_size());
-			TRY(send_command_and_block(lba + sector_off, to_read, Command::Write));
-		}
-
-		return {};
+		return send_commands_and_block(lba, sector_count, Command::Write, const_cast<uint8_t*>(buffer.data()));
 	}
 
-	BAN::ErrorOr<void> AHCIDevice::send_command_and_block(uint64_t lba, uint64_t sector_count, Command command)
+	BAN::ErrorOr<void> AHCIDevice::send_commands_and_block(uint64_t lba, uint64_t sector_count, Command command, uint8_t* buffer)
 	{
 		ASSERT(m_dma_region);
 		ASSERT(m_data_dma_region);
-		ASSERT(0 < sector_count && sector_count <= 0xFFFF + 1);
 
-		ASSERT(sector_count * sector_size() <= m_data_dma_region->size());
+		const uint64_t sectors_per_slot = s_slot_buffer_size / sector_size();
 
-		m_port->is = ~(uint32_t)0;
+		struct Request
+		{
+			uint32_t slot;
+			uint64_t sector_off;
+			uint64_t sector_count;
+		};
+		Request requests[32];
+
+		uint64_t sector_off = 0;
+		while (sector_off < sector_count)
+		{
+			// First slot may block, rest of the batch uses whatever is free
+			size_t request_count = 0;
+			while (sector_off < sector_count && request_count < m_queue_depth)
+			{
+				uint32_t slot;
+				if (request_count == 0)
+					slot = reserve_command_slot();
+				else if (auto free_slot = try_reserve_command_slot(); free_slot.has_value())
+					slot = free_slot.value();
+				else
+					break;
+
+				auto& request = requests[request_count++];
+				request.slot = slot;
+				request.sector_off = sector_off;
+				request.sector_count = BAN::Math::min(sector_count - sector_off, sectors_per_slot);
+
+				if (command == Command::Write)
+					memcpy(command_slot_buffer(slot), buffer + sector_off * sector_size(), request.sector_count * sector_size());
+				issue_command(slot, lba + sector_off, request.sector_count, command);
+
+				sector_off += request.sector_count;
+			}
+
+			BAN::ErrorOr<void> result {};
+			for (size_t i = 0; i < request_count; i++)
+			{
+				const auto& request = requests[i];
+				auto ret = block_until_command_completed(request.slot);
+				if (ret.is_error() && !result.is_error())
+					result = ret.release_error();
+				if (!ret.is_error() && command == Command::Read)
+					memcpy(buffer + request.sector_off * sector_size(), command_slot_buffer(request.slot), request.sector_count * sector_size());
+				release_command_slot(request.slot);
+			}
+			TRY(result);
+		}
 
-		auto slot = find_free_command_slot();
-		ASSERT(slot.has_value());
+		return {};
+	}
 
-		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[slot.value()];
+	void AHCIDevice::issue_command(uint32_t command_slot, uint64_t lba, uint64_t sector_count, Command command)
+	{
+		ASSERT(0 < sector_count && sector_count <= 0xFFFF + 1);
+		ASSERT(sector_count * sector_size() <= s_slot_buffer_size);
+
+		volatile auto& command_header = reinterpret_cast<volatile HBACommandHeader*>(m_dma_region->paddr_to_vaddr(m_port->clb))[command_slot];
 		command_header.cfl = sizeof(FISRegisterH2D) / sizeof(uint32_t);
 		command_header.prdtl = 1;
 		switch (command)
@@ -245,7 +348,7 @@ namespace Kernel
 
 		volatile auto& command_table = *reinterpret_cast<HBACommandTable*>(m_dma_region->paddr_to_vaddr(command_header.ctba));
 		memset(const_cast<HBACommandTable*>(&command_table), 0x00, sizeof(HBACommandTable));
-		uint64_t data_dma_paddr64 = m_data_dma_region->paddr();
+		const uint64_t data_dma_paddr64 = m_data_dma_region->paddr() + command_slot * s_slot_buffer_size;
 		command_table.prdt_entry[0].dba = data_dma_paddr64 & 0xFFFFFFFF;
 		command_table.prdt_entry[0].dbau = data_dma_paddr64 >> 32;
 		command_table.prdt_entry[0].dbc = sector_count * sector_size() - 1;
@@ -256,21 +359,6 @@ namespace Kernel
 		fis_command.fis_type = FIS_TYPE_REGISTER_H2D;
 		fis_command.c = 1;
 
-		const bool needs_extended = lba >= (1 << 24) || sector_count > 0xFF;
-		ASSERT (!needs_extended || (m_command_set & ATA_COMMANDSET_LBA48_SUPPORTED));
-
-		switch (command)
-		{
-			case Command::Read:
-				fis_command.command = needs_extended ? ATA_COMMAND_READ_DMA_EXT : ATA_COMMAND_READ_DMA;
-				break;
-			case Command::Write:
-				fis_command.command = needs_extended ? ATA_COMMAND_WRITE_DMA_EXT : ATA_COMMAND_WRITE_DMA;
-				break;
-			default:
-				ASSERT_NOT_REACHED();
-		}
-
 		fis_command.lba0 = (lba >>  0) & 0xFF;
 		fis_command.lba1 = (lba >>  8) & 0xFF;
 		fis_command.lba2 = (lba >> 16) & 0xFF;
@@ -280,26 +368,98 @@ namespace Kernel
 		fis_command.lba4 = (lba >> 32) & 0xFF;
 		fis_command.lba5 = (lba >> 40) & 0xFF;
 
-		fis_command.count_lo = (sector_count >> 0) & 0xFF;
-		fis_command.count_hi = (sector_count >> 8) & 0xFF;
+		if (m_use_ncq)
+		{
+			switch (command)
+			{
+				case Command::Read:
+					fis_command.command = ATA_COMMAND_READ_FPDMA_QUEUED;
+					break;
+				case Command::Write:
+					fis_command.command = ATA_COMMAND_WRITE_FPDMA_QUEUED;
+					break;
+				default:
+					ASSERT_NOT_REACHED();
+			}
+
+			// FPDMA commands take sector count in features and tag in count
+			fis_command.feature_lo = (sector_count >> 0) & 0xFF;
+			fis_command.feature_hi = (sector_count >> 8) & 0xFF;
+			fis_command.count_lo = command_slot << 3;
+		}
+		else
+		{
+			const bool needs_extended = lba >= (1 << 24) || sector_count > 0xFF;
+			ASSERT (!needs_extended || (m_command_set & ATA_COMMANDSET_LBA48_SUPPORTED));
+
+			switch (command)
+			{
+				case Command::Read:
+					fis_command.command = needs_extended ? ATA_COMMAND_READ_DMA_EXT : ATA_COMMAND_READ_DMA;
+					break;
+				case Command::Write:
+					fis_command.command = needs_extended ? ATA_COMMAND_WRITE_DMA_EXT : ATA_COMMAND_WRITE_DMA;
+					break;
+				default:
+					ASSERT_NOT_REACHED();
+			}
+
+			fis_command.count_lo = (sector_count >> 0) & 0xFF;
+			fis_command.count_hi = (sector_count >> 8) & 0xFF;
+		}
+
+		SpinLockGuard _(m_slot_lock);
+		m_issued_slots |= 1u << command_slot;
+		if (m_use_ncq)
+			m_port->sact = 1u << command_slot;
+		m_port->ci = 1u << command_slot;
+	}
 
-		while (m_port->tfd & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
-			continue;
+	uint32_t AHCIDevice::reserve_command_slot()
+	{
+		SpinLockGuard guard(m_slot_lock);
 
-		m_port->ci = 1 << slot.value();
+		for (;;)
+		{
+			for (uint32_t i = 0; i < m_queue_depth; i++)
+			{
+				if (m_reserved_slots & (1u << i))
+					continue;
+				m_reserved_slots |= 1u << i;
+				return i;
+			}
 
-		TRY(block_until_command_completed(slot.value()));
+			SpinLockGuardAsMutex smutex(guard);
+			m_free_slot_blocker.block_indefinite(&smutex);
+		}
+	}
+
+	BAN::Optional<uint32_t> AHCIDevice::try_reserve_command_slot()
+	{
+		SpinLockGuard _(m_slot_lock);
+
+		for (uint32_t i = 0; i < m_queue_depth; i++)
+		{
+			if (m_reserved_slots & (1u << i))
+				continue;
+			m_reserved_slots |= 1u << i;
+			return i;
+		}
 
 		return {};
 	}
 
-	BAN::Optional<uint32_t> AHCIDevice::find_free_command_slot()
+	void AHCIDevice::release_command_slot(uint32_t command_slot)
 	{
-		uint32_t slots = m_port->sact | m_port->ci;
-		for (uint32_t i = 0; i < m_controller->command_slot_count(); i++)
-			if (!(slots & (1 << i)))
-				return i;
-		return {};
+		SpinLockGuard _(m_slot_lock);
+		ASSERT(m_reserved_slots & (1u << command_slot));
+		m_reserved_slots &= ~(1u << command_slot);
+		m_free_slot_blocker.unblock();
+	}
+
+	void* AHCIDevice::command_slot_buffer(uint32_t command_slot) const
+	{
+		return reinterpret_cast<void*>(m_data_dma_region->vaddr() + command_slot * s_slot_buffer_size);
 	}
 
 }
@@ -1,4 +1,5 @@
 #include <BAN/ScopeGuard.h>
+#include <BAN/Sort.h>
 #include <kernel/BootInfo.h>
 #include <kernel/Lock/LockGuard.h>
 #include <kernel/Memory/Heap.h>
@@ -23,161 +24,275 @@ namespace Kernel
 		release_all_pages();
 	}
 
-	size_t DiskCache::find_sector_cache_index(uint64_t sector) const
+	DiskCache::PageCache* DiskCache::find_page(uint64_t first_sector) const
 	{
-		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
-		const uint64_t page_cache_offset = sector % sectors_per_page;
-		const uint64_t page_cache_start = sector - page_cache_offset;
+		auto it = m_cache.find(first_sector);
+		if (it == m_cache.end())
+			return nullptr;
+		return it->value;
+	}
 
-		size_t l = 0, r = m_cache.size();
+	BAN::ErrorOr<DiskCache::PageCache*> DiskCache::find_or_create_page(uint64_t first_sector)
+	{
+		if (auto* page = find_page(first_sector))
+			return page;
 
-		while (l < r)
-		{
-			const size_t mid = (l + r) / 2;
+		const paddr_t paddr = Heap::get().take_free_page();
+		if (paddr == 0)
+			return BAN::Error::from_errno(ENOMEM);
+		BAN::ScopeGuard paddr_guard([paddr] { Heap::get().release_page(paddr); });
 
-			if (m_cache[mid].first_sector == page_cache_start)
-				return mid;
+		auto* page = new PageCache;
+		if (page == nullptr)
+			return BAN::Error::from_errno(ENOMEM);
+		BAN::ScopeGuard page_guard([page] { delete page; });
 
-			if (m_cache[mid].first_sector < page_cache_start)
-				l = mid + 1;
-			else
-				r = mid;
-		}
+		page->paddr = paddr;
+		page->first_sector = first_sector;
 
-		return l;
+		TRY(m_cache.insert(first_sector, page));
+		reclaim_list_append(page);
+
+		paddr_guard.disable();
+		page_guard.disable();
+
+		return page;
+	}
+
+	void DiskCache::remove_page(PageCache* page)
+	{
+		reclaim_list_remove(page);
+		m_cache.remove(page->first_sector);
+		Heap::get().release_page(page->paddr);
+		delete page;
 	}
 
-	bool DiskCache::read_from_cache(uint64_t sector, BAN::ByteSpan buffer)
+	void DiskCache::reclaim_list_append(PageCache* page)
 	{
-		ASSERT(buffer.size() >= m_sector_size);
+		page->prev = m_reclaim_tail;
+		page->next = nullptr;
+		if (m_reclaim_tail)
+			m_reclaim_tail->next = page;
+		else
+			m_reclaim_head = page;
+		m_reclaim_tail = page;
+	}
+
+	void DiskCache::reclaim_list_remove(PageCache* page)
+	{
+		if (page->prev)
+			page->prev->next = page->next;
+		else
+			m_reclaim_head = page->next;
+		if (page->next)
+			page->next->prev = page->prev;
+		else
+			m_reclaim_tail = page->prev;
+		page->prev = nullptr;
+		page->next = nullptr;
+	}
+
+	uint64_t DiskCache::read_from_cache(uint64_t sector, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(sector_count <= 64);
+		ASSERT(buffer.size() >= sector_count * m_sector_size);
 
 		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
-		const uint64_t page_cache_offset = sector % sectors_per_page;
-		const uint64_t page_cache_start = sector - page_cache_offset;
+
+		uint64_t found_mask = 0;
 
 		RWLockRDGuard _(m_rw_lock);
 
-		const auto index = find_sector_cache_index(sector);
-		if (index >= m_cache.size())
-			return false;
+		for (size_t sectors_done = 0; sectors_done < sector_count;)
+		{
+			const uint64_t page_cache_start = page_first_sector(sector + sectors_done);
+			const uint64_t page_cache_offset = sector + sectors_done - page_cache_start;
+			const size_t page_sector_count = BAN::Math::min<size_t>(sectors_per_page - page_cache_offset, sector_count - sectors_done);
 
-		const auto& cache = m_cache[index];
-		if (cache.first_sector != page_cache_start)
-			return false;
-		if (!(cache.sector_mask & (1 << page_cache_offset)))
-			return false;
+			auto* cache = find_page(page_cache_start);
+			if (cache && (cache->sector_mask >> page_cache_offset))
+			{
+				cache->referenced.store(true, BAN::MemoryOrder::memory_order_relaxed);
+
+				PageTable::with_per_cpu_fast_page(cache->paddr, [&](void* addr) {
+					for (size_t i = 0; i < page_sector_count; i++)
+					{
+						if (!(cache->sector_mask & (1 << (page_cache_offset + i))))
+							continue;
+						memcpy(
+							buffer.data() + (sectors_done + i) * m_sector_size,
+							static_cast<uint8_t*>(addr) + (page_cache_offset + i) * m_sector_size,
+							m_sector_size
+						);
+						found_mask |= static_cast<uint64_t>(1) << (sectors_done + i);
+					}
+				});
+			}
 
-		PageTable::with_per_cpu_fast_page(cache.paddr, [&](void* addr) {
-			memcpy(buffer.data(), static_cast<uint8_t*>(addr) + page_cache_offset * m_sector_size, m_sector_size);
-		});
+			sectors_done += page_sector_count;
+		}
 
-		return true;
+		const size_t hits = __builtin_popcountll(found_mask);
+		m_hits.add_fetch(hits, BAN::MemoryOrder::memory_order_relaxed);
+		m_misses.add_fetch(sector_count - hits, BAN::MemoryOrder::memory_order_relaxed);
+
+		return found_mask;
 	};
 
-	BAN::ErrorOr<void> DiskCache::write_to_cache(uint64_t sector, BAN::ConstByteSpan buffer, bool dirty)
+	BAN::ErrorOr<void> DiskCache::write_to_cache(uint64_t sector, size_t sector_count, BAN::ConstByteSpan buffer, bool dirty)
+	{
+		return write_to_cache_impl(sector, sector_count, buffer, dirty, true);
+	}
+
+	BAN::ErrorOr<void> DiskCache::fill_cache(uint64_t sector, size_t sector_count, BAN::ConstByteSpan buffer)
 	{
-		ASSERT(buffer.size() >= m_sector_size);
+		return write_to_cache_impl(sector, sector_count, buffer, false, false);
+	}
+
+	BAN::ErrorOr<void> DiskCache::write_to_cache_impl(uint64_t sector, size_t sector_count, BAN::ConstByteSpan buffer, bool dirty, bool overwrite)
+	{
+		ASSERT(buffer.size() >= sector_count * m_sector_size);
 
 		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
-		const uint64_t page_cache_offset = sector % sectors_per_page;
-		const uint64_t page_cache_start = sector - page_cache_offset;
 
 		RWLockWRGuard _(m_rw_lock);
 
-		const auto index = find_sector_cache_index(sector);
-
-		if (index >= m_cache.size() || m_cache[index].first_sector != page_cache_start)
+		for (size_t sectors_done = 0; sectors_done < sector_count;)
 		{
-			paddr_t paddr = Heap::get().take_free_page();
-			if (paddr == 0)
-				return BAN::Error::from_errno(ENOMEM);
-
-			PageCache cache {
-				.paddr = paddr,
-				.first_sector = page_cache_start,
-				.sector_mask = 0,
-				.dirty_mask = 0,
-			};
+			const uint64_t page_cache_start = page_first_sector(sector + sectors_done);
+			const uint64_t page_cache_offset = sector + sectors_done - page_cache_start;
+			const size_t page_sector_count = BAN::Math::min<size_t>(sectors_per_page - page_cache_offset, sector_count - sectors_done);
+
+			auto* cache = TRY(find_or_create_page(page_cache_start));
+
+			uint8_t write_mask = ((1u << page_sector_count) - 1) << page_cache_offset;
+			if (!overwrite)
+				write_mask &= ~cache->sector_mask;
 
-			if (auto ret = m_cache.insert(index, cache); ret.is_error())
+			if (write_mask)
 			{
-				Heap::get().release_page(paddr);
-				return ret.error();
+				PageTable::with_per_cpu_fast_page(cache->paddr, [&](void* addr) {
+					for (size_t i = 0; i < page_sector_count; i++)
+					{
+						if (!(write_mask & (1 << (page_cache_offset + i))))
+							continue;
+						memcpy(
+							static_cast<uint8_t*>(addr) + (page_cache_offset + i) * m_sector_size,
+							buffer.data() + (sectors_done + i) * m_sector_size,
+							m_sector_size
+						);
+					}
+				});
 			}
-		}
-
-		auto& cache = m_cache[index];
 
-		PageTable::with_per_cpu_fast_page(cache.paddr, [&](void* addr) {
-			memcpy(static_cast<uint8_t*>(addr) + page_cache_offset * m_sector_size, buffer.data(), m_sector_size);
-		});
+			cache->referenced.store(true, BAN::MemoryOrder::memory_order_relaxed);
+			cache->sector_mask |= write_mask;
+			if (dirty)
+				cache->dirty_mask |= write_mask;
 
-		cache.sector_mask |= 1 << page_cache_offset;
-		if (dirty)
-			cache.dirty_mask |= 1 << page_cache_offset;
+			sectors_done += page_sector_count;
+		}
 
 		return {};
 	}
 
-	BAN::ErrorOr<void> DiskCache::sync_cache_index(size_t index)
+	BAN::ErrorOr<void> DiskCache::sync_page_run(uint64_t first_sector, size_t page_count)
 	{
+		ASSERT(page_count <= max_sync_pages);
+
 		LockGuard _(m_sync_mutex);
 
-		PageCache temp_cache;
+		if (m_sync_buffer.empty())
+			TRY(m_sync_buffer.resize(max_sync_pages * PAGE_SIZE));
+
+		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
+
+		uint8_t dirty_masks[max_sync_pages] {};
 
 		{
 			RWLockWRGuard _(m_rw_lock);
 
-			if (index >= m_cache.size())
-				return {};
-			auto& cache = m_cache[index];
-			if (cache.dirty_mask == 0)
-				return {};
+			for (size_t i = 0; i < page_count; i++)
+			{
+				auto* cache = find_page(first_sector + i * sectors_per_page);
+				if (cache == nullptr || cache->dirty_mask == 0)
+					continue;
 
-			PageTable::with_per_cpu_fast_page(cache.paddr, [&](void* addr) {
-				memcpy(m_sync_cache.data(), addr, PAGE_SIZE);
-			});
+				PageTable::with_per_cpu_fast_page(cache->paddr, [&](void* addr) {
+					memcpy(m_sync_buffer.data() + i * PAGE_SIZE, addr, PAGE_SIZE);
+				});
 
-			temp_cache = cache;
-			cache.dirty_mask = 0;
-			cache.syncing = true;
+				dirty_masks[i] = cache->dirty_mask;
+				cache->dirty_mask = 0;
+				cache->syncing = true;
+			}
 		}
 
-		// restores dirty mask if write to disk fails
+		// restores dirty masks of sectors that could not be written
 		BAN::ScopeGuard dirty_guard([&] {
 			RWLockWRGuard _(m_rw_lock);
-			const auto new_index = find_sector_cache_index(temp_cache.first_sector);
-			ASSERT(new_index < m_cache.size() && m_cache[new_index].first_sector == temp_cache.first_sector);
-			m_cache[new_index].dirty_mask |= temp_cache.dirty_mask;
-			m_cache[new_index].syncing = false;
+			for (size_t i = 0; i < page_count; i++)
+			{
+				auto* cache = find_page(first_sector + i * sectors_per_page);
+				if (cache == nullptr)
+					continue;
+				cache->dirty_mask |= dirty_masks[i];
+				cache->syncing = false;
+			}
 		});
 
-		uint8_t sector_start = 0;
-		uint8_t sector_count = 0;
+		const auto is_dirty =
+			[&](size_t sector) -> bool
+			{
+				return dirty_masks[sector / sectors_per_page] & (1 << (sector % sectors_per_page));
+			};
 
-		while (sector_start + sector_count <= PAGE_SIZE / m_sector_size)
+		// write every contiguous span of dirty sectors with a single command, even across page boundaries
+		const size_t total_sectors = page_count * sectors_per_page;
+		for (size_t sector_start = 0; sector_start < total_sectors;)
 		{
-			if (temp_cache.dirty_mask & (1 << (sector_start + sector_count)))
-				sector_count++;
-			else if (sector_count == 0)
-				sector_start++;
-			else
+			if (!is_dirty(sector_start))
 			{
-				dprintln_if(DEBUG_DISK_SYNC, "syncing {}->{}", temp_cache.first_sector + sector_start, temp_cache.first_sector + sector_start + sector_count);
-				auto data_slice = m_sync_cache.span().slice(sector_start * m_sector_size, sector_count * m_sector_size);
-				TRY(m_device.write_sectors_impl(temp_cache.first_sector + sector_start, sector_count, data_slice));
-				temp_cache.dirty_mask &= ~(((1 << sector_count) - 1) << sector_start);
-				sector_start += sector_count + 1;
-				sector_count = 0;
+				sector_start++;
+				continue;
 			}
+
+			size_t sector_count = 1;
+			while (sector_start + sector_count < total_sectors && is_dirty(sector_start + sector_count))
+				sector_count++;
+
+			dprintln_if(DEBUG_DISK_SYNC, "syncing {}->{}", first_sector + sector_start, first_sector + sector_start + sector_count);
+			auto data_slice = m_sync_buffer.span().slice(sector_start * m_sector_size, sector_count * m_sector_size);
+			TRY(m_device.write_sectors_impl(first_sector + sector_start, sector_count, data_slice));
+
+			for (size_t i = 0; i < sector_count; i++)
+				dirty_masks[(sector_start + i) / sectors_per_page] &= ~(1 << ((sector_start + i) % sectors_per_page));
+
+			sector_start += sector_count;
 		}
 
-		if (sector_count > 0)
+		return {};
+	}
+
+	BAN::ErrorOr<void> DiskCache::sync_pages(BAN::Vector<uint64_t>& first_sectors)
+	{
+		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
+
+		BAN::sort::sort(first_sectors.begin(), first_sectors.end());
+
+		// coalesce runs of adjacent dirty pages
+		for (size_t i = 0; i < first_sectors.size();)
 		{
-			dprintln_if(DEBUG_DISK_SYNC, "syncing {}->{}", temp_cache.first_sector + sector_start, temp_cache.first_sector + sector_start + sector_count);
-			auto data_slice = m_sync_cache.span().slice(sector_start * m_sector_size, sector_count * m_sector_size);
-			TRY(m_device.write_sectors_impl(temp_cache.first_sector + sector_start, sector_count, data_slice));
-			temp_cache.dirty_mask &= ~(((1 << sector_count) - 1) << sector_start);
+			size_t page_count = 1;
+			while (i + page_count < first_sectors.size() && page_count < max_sync_pages)
+			{
+				if (first_sectors[i + page_count] != first_sectors[i] + page_count * sectors_per_page)
+					break;
+				page_count++;
+			}
+
+			TRY(sync_page_run(first_sectors[i], page_count));
+			i += page_count;
 		}
 
 		return {};
@@ -187,9 +302,17 @@ namespace Kernel
 	{
 		if (g_disable_disk_write)
 			return {};
-		for (size_t i = 0; i < m_cache.size(); i++)
-			TRY(sync_cache_index(i));
-		return {};
+
+		BAN::Vector<uint64_t> dirty_pages;
+
+		{
+			RWLockRDGuard _(m_rw_lock);
+			for (auto* page = m_reclaim_head; page; page = page->next)
+				if (page->dirty_mask)
+					TRY(dirty_pages.push_back(page->first_sector));
+		}
+
+		return sync_pages(dirty_pages);
 	}
 
 	BAN::ErrorOr<void> DiskCache::sync(uint64_t sector, size_t block_count)
@@ -197,19 +320,31 @@ namespace Kernel
 		if (g_disable_disk_write)
 			return {};
 
-		m_rw_lock.rd_lock();
-		for (size_t i = find_sector_cache_index(sector); i < m_cache.size(); i++)
+		const uint64_t sectors_per_page = PAGE_SIZE / m_sector_size;
+		const uint64_t first_page = page_first_sector(sector);
+		const uint64_t end_sector = sector + block_count;
+
+		BAN::Vector<uint64_t> dirty_pages;
+
 		{
-			auto& cache = m_cache[i];
-			if (cache.first_sector >= sector + block_count)
-				break;
-			m_rw_lock.rd_unlock();
-			TRY(sync_cache_index(i));
-			m_rw_lock.rd_lock();
+			RWLockRDGuard _(m_rw_lock);
+
+			// probe the index for small ranges, walk all cached pages for large ones
+			if ((end_sector - first_page) / sectors_per_page <= m_cache.size())
+			{
+				for (uint64_t page_sector = first_page; page_sector < end_sector; page_sector += sectors_per_page)
+					if (auto* page = find_page(page_sector); page && page->dirty_mask)
+						TRY(dirty_pages.push_back(page_sector));
+			}
+			else
+			{
+				for (auto* page = m_reclaim_head; page; page = page->next)
+					if (page->dirty_mask && page->first_sector >= first_page && page->first_sector < end_sector)
+						TRY(dirty_pages.push_back(page->first_sector));
+			}
 		}
-		m_rw_lock.rd_unlock();
 
-		return {};
+		return sync_pages(dirty_pages);
 	}
 
 	size_t DiskCache::release_clean_pages(size_t page_count)
@@ -219,20 +354,34 @@ namespace Kernel
 
 		RWLockWRGuard _(m_rw_lock);
 
+		// CLOCK style reclaim, recently referenced pages are given a second chance
 		size_t released = 0;
-		for (size_t i = 0; i < m_cache.size() && released < page_count;)
+		for (size_t pass = 0; pass < 2 && released < page_count; pass++)
 		{
-			if (!m_cache[i].syncing && m_cache[i].dirty_mask == 0)
+			PageCache* page = m_reclaim_head;
+			PageCache* const last = m_reclaim_tail;
+			while (page && released < page_count)
 			{
-				Heap::get().release_page(m_cache[i].paddr);
-				m_cache.remove(i);
-				released++;
-				continue;
+				PageCache* next = (page == last) ? nullptr : page->next;
+
+				if (page->syncing || page->dirty_mask)
+					;
+				else if (page->referenced.exchange(false, BAN::MemoryOrder::memory_order_relaxed))
+				{
+					reclaim_list_remove(page);
+					reclaim_list_append(page);
+				}
+				else
+				{
+					remove_page(page);
+					released++;
+				}
+
+				page = next;
 			}
-			i++;
 		}
 
-		(void)m_cache.shrink_to_fit();
+		m_evictions.add_fetch(released, BAN::MemoryOrder::memory_order_relaxed);
 
 		return released;
 	}
@@ -252,4 +401,22 @@ namespace Kernel
 		release_pages(m_cache.size());
 	}
 
+	DiskCache::Stats DiskCache::stats() const
+	{
+		RWLockRDGuard _(m_rw_lock);
+
+		size_t dirty_pages = 0;
+		for (auto* page = m_reclaim_head; page; page = page->next)
+			if (page->dirty_mask)
+				dirty_pages++;
+
+		return Stats {
+			.pages       = m_cache.size(),
+			.dirty_pages = dirty_pages,
+			.hits        = m_hits.load(BAN::MemoryOrder::memory_order_relaxed),
+			.misses      = m_misses.load(BAN::MemoryOrder::memory_order_relaxed),
+			.evictions   = m_evictions.load(BAN::MemoryOrder::memory_order_relaxed),
+		};
+	}
+
 }
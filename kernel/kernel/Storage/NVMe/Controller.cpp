@@ -2,6 +2,7 @@
 #include <kernel/Device/DeviceNumbers.h>
 #include <kernel/FS/DevFS/FileSystem.h>
 #include <kernel/Memory/DMARegion.h>
+#include <kernel/Processor.h>
 #include <kernel/Storage/NVMe/Controller.h>
 #include <kernel/Timer/Timer.h>
 
@@ -10,6 +11,10 @@
 namespace Kernel
 {
 
+	static constexpr uint32_t s_max_io_queues = 16;
+	static constexpr size_t s_bounce_buffer_count = 4;
+	static constexpr size_t s_bounce_buffer_pages = 16;
+
 	static dev_t get_ctrl_dev_minor()
 	{
 		static dev_t minor = 0;
@@ -81,8 +86,14 @@ namespace Kernel
 			return BAN::Error::from_errno(ECANCELED);
 		}
 
-		// One for aq and one for ioq
-		TRY(m_pci_device.reserve_interrupts(2));
+		// One for aq and one for each ioq, try to get an ioq for every processor
+		uint32_t io_queue_count = BAN::Math::clamp<uint32_t>(Processor::count(), 1, s_max_io_queues);
+		while (m_pci_device.reserve_interrupts(1 + io_queue_count).is_error())
+		{
+			if (io_queue_count == 1)
+				return BAN::Error::from_errno(ENOTSUP);
+			io_queue_count = 1;
+		}
 
 		auto& cc = m_controller_registers->cc;
 
@@ -108,8 +119,14 @@ namespace Kernel
 
 		cc.iocqes = 4; static_assert(1 << 4 == sizeof(NVMe::CompletionQueueEntry));
 		cc.iosqes = 6; static_assert(1 << 6 == sizeof(NVMe::SubmissionQueueEntry));
-		TRY(create_io_queue());
-		dprintln_if(DEBUG_NVMe, " created io queue");
+		io_queue_count = TRY(request_io_queue_count(io_queue_count));
+		TRY(m_io_queues.reserve(io_queue_count));
+		for (uint32_t i = 0; i < io_queue_count; i++)
+		{
+			const auto target = Processor::count() ? Processor::id_from_index(i % Processor::count()) : PROCESSOR_NONE;
+			TRY(create_io_queue(i + 1, target));
+		}
+		dprintln_if(DEBUG_NVMe, " created {} io queues", io_queue_count);
 
 		TRY(identify_namespaces());
 
@@ -160,9 +177,44 @@ namespace Kernel
 
 		dprintln(" model: '{}'", BAN::StringView { (char*)dma_page->vaddr() + 24, 20 });
 
+		// MDTS is a power of two in units of the minimum page size, 0 means no limit
+		const uint8_t mdts = *reinterpret_cast<uint8_t*>(dma_page->vaddr() + 77);
+		m_max_transfer_bytes = s_bounce_buffer_pages * PAGE_SIZE;
+		if (mdts != 0)
+		{
+			const uint64_t min_page_size = 1ull << (12 + m_controller_registers->cap.mpsmin);
+			m_max_transfer_bytes = BAN::Math::min<uint64_t>(m_max_transfer_bytes, min_page_size << mdts);
+		}
+		dprintln_if(DEBUG_NVMe, " max transfer {} bytes", m_max_transfer_bytes);
+
 		return {};
 	}
 
+	BAN::ErrorOr<uint32_t> NVMeController::request_io_queue_count(uint32_t count)
+	{
+		NVMe::SubmissionQueueEntry sqe {};
+		sqe.opc = NVMe::OPC_ADMIN_SET_FEATURES;
+		sqe.generic.cdw10 = NVMe::FID_NUMBER_OF_QUEUES;
+		sqe.generic.cdw11 = ((count - 1) << 16) | (count - 1);
+
+		uint32_t result;
+		if (uint16_t status = m_admin_queue->submit_command(sqe, &result))
+		{
+			dwarnln("NVMe set number of queues failed (status {4H})", status);
+			return BAN::Error::from_errno(EFAULT);
+		}
+
+		const uint32_t sq_count = (result & 0xFFFF) + 1;
+		const uint32_t cq_count = (result >> 16) + 1;
+		return BAN::Math::min(count, BAN::Math::min(sq_count, cq_count));
+	}
+
+	NVMeQueue& NVMeController::io_queue()
+	{
+		ASSERT(!m_io_queues.empty());
+		return *m_io_queues[Processor::current_index() % m_io_queues.size()];
+	}
+
 	BAN::ErrorOr<void> NVMeController::identify_namespaces()
 	{
 		auto dma_page = TRY(DMARegion::create(PAGE_SIZE));
@@ -247,10 +299,13 @@ namespace Kernel
 		return {};
 	}
 
-	BAN::ErrorOr<void> NVMeController::create_io_queue()
+	BAN::ErrorOr<void> NVMeController::create_io_queue(uint16_t qid, ProcessorID target)
 	{
 		constexpr uint32_t queue_size = PAGE_SIZE;
-		constexpr uint32_t queue_elems = queue_size / BAN::Math::max(sizeof(NVMe::CompletionQueueEntry), sizeof(NVMe::SubmissionQueueEntry));
+		const uint32_t queue_elems = BAN::Math::min<uint32_t>(
+			queue_size / BAN::Math::max(sizeof(NVMe::CompletionQueueEntry), sizeof(NVMe::SubmissionQueueEntry)),
+			m_controller_registers->cap.mqes + 1
+		);
 		auto completion_queue = TRY(DMARegion::create(queue_size));
 		memset((void*)completion_queue->vaddr(), 0x00, completion_queue->size());
 
@@ -262,8 +317,8 @@ namespace Kernel
 			sqe.opc = NVMe::OPC_ADMIN_CREATE_CQ;
 			sqe.create_cq.dptr.prp1 = completion_queue->paddr();
 			sqe.create_cq.qsize = queue_elems - 1;
-			sqe.create_cq.qid = 1;
-			sqe.create_cq.iv = 1;
+			sqe.create_cq.qid = qid;
+			sqe.create_cq.iv = qid;
 			sqe.create_cq.ien = 1;
 			sqe.create_cq.pc = 1;
 			if (uint16_t status = m_admin_queue->submit_command(sqe))
@@ -278,8 +333,8 @@ namespace Kernel
 			sqe.opc = NVMe::OPC_ADMIN_CREATE_SQ;
 			sqe.create_sq.dptr.prp1 = submission_queue->paddr();
 			sqe.create_sq.qsize = queue_elems - 1;
-			sqe.create_sq.qid = 1;
-			sqe.create_sq.cqid = 1;
+			sqe.create_sq.qid = qid;
+			sqe.create_sq.cqid = qid;
 			sqe.create_sq.qprio = 0;
 			sqe.create_sq.pc = 1;
 			sqe.create_sq.nvmsetid = 0;
@@ -290,14 +345,16 @@ namespace Kernel
 			}
 		}
 
-		dprintln_if(DEBUG_NVMe, " io queue using irq {}", m_pci_device.get_interrupt(1));
+		dprintln_if(DEBUG_NVMe, " io queue {} using irq {} on processor {}", qid, m_pci_device.get_interrupt(qid), target);
 
 		const uint32_t doorbell_stride = 1 << (2 + m_controller_registers->cap.dstrd);
-		const uint32_t doorbell_offset = 2 * doorbell_stride;
+		const uint32_t doorbell_offset = 2 * doorbell_stride * qid;
 		auto& doorbell = *reinterpret_cast<volatile NVMe::DoorbellRegisters*>(m_bar0->vaddr() + NVMe::ControllerRegisters::SQ0TDBL + doorbell_offset);
 
-		m_io_queue = TRY(BAN::UniqPtr<NVMeQueue>::create(BAN::move(completion_queue), BAN::move(submission_queue), doorbell, queue_elems));
-		m_pci_device.enable_interrupt(1, *m_io_queue);
+		auto queue = TRY(BAN::UniqPtr<NVMeQueue>::create(BAN::move(completion_queue), BAN::move(submission_queue), doorbell, queue_elems));
+		TRY(queue->initialize_bounce_buffers(s_bounce_buffer_count, s_bounce_buffer_pages));
+		TRY(m_io_queues.push_back(BAN::move(queue)));
+		m_pci_device.enable_interrupt(qid, *m_io_queues.back(), target);
 
 		return {};
 	}
@@ -45,8 +45,6 @@ namespace Kernel
 		TRY(name_prefix.append(m_name));
 		TRY(name_prefix.push_back('p'));
 
-		m_dma_region = TRY(DMARegion::create(PAGE_SIZE));
-
 		add_disk_cache();
 
 		DevFileSystem::get().add_device(this);
@@ -61,26 +59,33 @@ namespace Kernel
 	{
 		ASSERT(buffer.size() >= sector_count * m_block_size);
 
+		auto& queue = m_controller.io_queue();
+		const size_t bounce_index = queue.reserve_bounce_buffer();
+		void* bounce_buffer = queue.bounce_buffer(bounce_index);
+		const uint64_t max_count = BAN::Math::min(queue.bounce_buffer_size(), m_controller.max_transfer_bytes()) / m_block_size;
+
 		for (uint64_t i = 0; i < sector_count;)
 		{
-			uint16_t count = BAN::Math::min<uint64_t>(sector_count - i, m_dma_region->size() / m_block_size);
+			uint16_t count = BAN::Math::min<uint64_t>(sector_count - i, max_count);
 
 			NVMe::SubmissionQueueEntry sqe {};
 			sqe.opc = NVMe::OPC_IO_READ;
 			sqe.read.nsid = m_nsid;
-			sqe.read.dptr.prp1 = m_dma_region->paddr();
+			sqe.read.dptr = queue.data_pointer(bounce_index, count * m_block_size);
 			sqe.read.slba = lba + i;
 			sqe.read.nlb = count - 1;
-			if (uint16_t status = m_controller.io_queue().submit_command(sqe))
+			if (uint16_t status = queue.submit_command(sqe))
 			{
+				queue.release_bounce_buffer(bounce_index);
 				dwarnln("NVMe read failed (status {4H})", status);
 				return BAN::Error::from_errno(EIO);
 			}
-			memcpy(buffer.data() + i * m_block_size, reinterpret_cast<void*>(m_dma_region->vaddr()), count * m_block_size);
+			memcpy(buffer.data() + i * m_block_size, bounce_buffer, count * m_block_size);
 
 			i += count;
 		}
 
+		queue.release_bounce_buffer(bounce_index);
 		return {};
 	}
 
@@ -88,20 +93,26 @@ namespace Kernel
 	{
 		ASSERT(buffer.size() >= sector_count * m_block_size);
 
+		auto& queue = m_controller.io_queue();
+		const size_t bounce_index = queue.reserve_bounce_buffer();
+		void* bounce_buffer = queue.bounce_buffer(bounce_index);
+		const uint64_t max_count = BAN::Math::min(queue.bounce_buffer_size(), m_controller.max_transfer_bytes()) / m_block_size;
+
 		for (uint64_t i = 0; i < sector_count;)
 		{
-			uint16_t count = BAN::Math::min<uint16_t>(sector_count - i, m_dma_region->size() / m_block_size);
+			uint16_t count = BAN::Math::min<uint64_t>(sector_count - i, max_count);
 
-			memcpy(reinterpret_cast<void*>(m_dma_region->vaddr()), buffer.data() + i * m_block_size, count * m_block_size);
+			memcpy(bounce_buffer, buffer.data() + i * m_block_size, count * m_block_size);
 
 			NVMe::SubmissionQueueEntry sqe {};
 			sqe.opc = NVMe::OPC_IO_WRITE;
 			sqe.read.nsid = m_nsid;
-			sqe.read.dptr.prp1 = m_dma_region->paddr();
+			sqe.read.dptr = queue.data_pointer(bounce_index, count * m_block_size);
 			sqe.read.slba = lba + i;
 			sqe.read.nlb = count - 1;
-			if (uint16_t status = m_controller.io_queue().submit_command(sqe))
+			if (uint16_t status = queue.submit_command(sqe))
 			{
+				queue.release_bounce_buffer(bounce_index);
 				dwarnln("NVMe write failed (status {4H})", status);
 				return BAN::Error::from_errno(EIO);
 			}
@@ -109,6 +120,7 @@ namespace Kernel
 			i += count;
 		}
 
+		queue.release_bounce_buffer(bounce_index);
 		return {};
 	}
 
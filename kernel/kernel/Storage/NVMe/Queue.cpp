@@ -15,7 +15,8 @@ namespace Kernel
 		, m_doorbell(db)
 		, m_qdepth(qdepth)
 	{
-		for (uint32_t i = qdepth; i < m_mask_bits; i++)
+		// a full submission queue holds qdepth - 1 commands
+		for (uint32_t i = qdepth - 1; i < m_mask_bits; i++)
 			m_used_mask |= (size_t)1 << i;
 	}
 
@@ -33,6 +34,7 @@ namespace Kernel
 			ASSERT((m_done_mask & cid_mask) == 0);
 
 			m_status_codes[cid] = sts;
+			m_results[cid] = cq_ptr[m_cq_head].dw0;
 			m_done_mask |= cid_mask;
 
 			m_cq_head = (m_cq_head + 1) % m_qdepth;
@@ -45,7 +47,7 @@ namespace Kernel
 		m_thread_blocker.unblock();
 	}
 
-	uint16_t NVMeQueue::submit_command(NVMe::SubmissionQueueEntry& sqe)
+	uint16_t NVMeQueue::submit_command(NVMe::SubmissionQueueEntry& sqe, uint32_t* result)
 	{
 		uint16_t cid = reserve_cid();
 		size_t cid_mask = (size_t)1 << cid;
@@ -77,6 +79,8 @@ namespace Kernel
 		if (m_done_mask & cid_mask)
 		{
 			uint16_t status = m_status_codes[cid];
+			if (result)
+				*result = m_results[cid];
 			m_used_mask &= ~cid_mask;
 			return status;
 		}
@@ -85,6 +89,85 @@ namespace Kernel
 		return 0xFFFF;
 	}
 
+	BAN::ErrorOr<void> NVMeQueue::initialize_bounce_buffers(size_t count, size_t pages)
+	{
+		ASSERT(m_bounce_buffer_count == 0);
+		ASSERT(count > 0 && count <= sizeof(m_bounce_used_mask) * 8);
+		// one prp list page per buffer, first page goes to prp1
+		ASSERT(pages > 0 && pages - 1 <= PAGE_SIZE / sizeof(uint64_t));
+
+		m_bounce_buffers = TRY(DMARegion::create(count * pages * PAGE_SIZE));
+		m_prp_lists = TRY(DMARegion::create(count * PAGE_SIZE));
+
+		for (size_t i = 0; i < count; i++)
+		{
+			auto* prp_list = reinterpret_cast<uint64_t*>(m_prp_lists->vaddr() + i * PAGE_SIZE);
+			const paddr_t buffer_paddr = m_bounce_buffers->paddr() + i * pages * PAGE_SIZE;
+			for (size_t j = 1; j < pages; j++)
+				prp_list[j - 1] = buffer_paddr + j * PAGE_SIZE;
+		}
+
+		m_bounce_buffer_pages = pages;
+		m_bounce_buffer_count = count;
+
+		return {};
+	}
+
+	size_t NVMeQueue::reserve_bounce_buffer()
+	{
+		ASSERT(m_bounce_buffer_count > 0);
+
+		SpinLockGuard guard(m_bounce_lock);
+
+		for (;;)
+		{
+			for (size_t i = 0; i < m_bounce_buffer_count; i++)
+			{
+				if (m_bounce_used_mask & ((size_t)1 << i))
+					continue;
+				m_bounce_used_mask |= (size_t)1 << i;
+				return i;
+			}
+
+			SpinLockGuardAsMutex smutex(guard);
+			m_bounce_blocker.block_indefinite(&smutex);
+		}
+	}
+
+	void NVMeQueue::release_bounce_buffer(size_t index)
+	{
+		ASSERT(index < m_bounce_buffer_count);
+
+		SpinLockGuard _(m_bounce_lock);
+		ASSERT(m_bounce_used_mask & ((size_t)1 << index));
+		m_bounce_used_mask &= ~((size_t)1 << index);
+		m_bounce_blocker.unblock();
+	}
+
+	void* NVMeQueue::bounce_buffer(size_t index) const
+	{
+		ASSERT(index < m_bounce_buffer_count);
+		return reinterpret_cast<void*>(m_bounce_buffers->vaddr() + index * bounce_buffer_size());
+	}
+
+	NVMe::DataPtr NVMeQueue::data_pointer(size_t index, size_t bytes) const
+	{
+		ASSERT(index < m_bounce_buffer_count);
+		ASSERT(bytes > 0 && bytes <= bounce_buffer_size());
+
+		const paddr_t buffer_paddr = m_bounce_buffers->paddr() + index * bounce_buffer_size();
+
+		NVMe::DataPtr dptr {};
+		dptr.prp1 = buffer_paddr;
+		if (bytes <= PAGE_SIZE)
+			dptr.prp2 = 0;
+		else if (bytes <= 2 * PAGE_SIZE)
+			dptr.prp2 = buffer_paddr + PAGE_SIZE;
+		else
+			dptr.prp2 = m_prp_lists->paddr() + index * PAGE_SIZE;
+		return dptr;
+	}
+
 	uint16_t NVMeQueue::reserve_cid()
 	{
 		SpinLockGuard guard(m_lock);
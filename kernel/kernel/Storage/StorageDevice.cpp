@@ -1,3 +1,4 @@
+#include <BAN/CircularQueue.h>
 #include <BAN/Endianness.h>
 #include <BAN/ScopeGuard.h>
 #include <BAN/StringView.h>
@@ -6,6 +7,7 @@
 #include <kernel/FS/DevFS/FileSystem.h>
 #include <kernel/FS/VirtualFileSystem.h>
 #include <kernel/Lock/LockGuard.h>
+#include <kernel/Lock/SpinLockAsMutex.h>
 #include <kernel/PCI.h>
 #include <kernel/Storage/StorageDevice.h>
 #include <kernel/Thread.h>
@@ -229,34 +231,42 @@ namespace Kernel
 		return {};
 	}
 
-	BAN::ErrorOr<void> StorageDevice::read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	BAN::Optional<DiskCache::Stats> StorageDevice::disk_cache_stats() const
 	{
-		ASSERT(buffer.size() >= sector_count * sector_size());
+		if (m_disk_cache.has_value())
+			return m_disk_cache->stats();
+		return {};
+	}
 
-		if (!m_disk_cache.has_value())
-			return read_sectors_impl(lba, sector_count, buffer);
+	BAN::ErrorOr<void> StorageDevice::read_sectors_cached(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(m_disk_cache.has_value());
 
 		uint64_t sectors_done = 0;
 		while (sectors_done < sector_count)
 		{
-			const uint32_t segment_sector_count = BAN::Math::min<uint32_t>(sector_count - sectors_done, 64);
-			uint64_t needed_sector_bitmask = (static_cast<uint64_t>(1) << segment_sector_count) - 1;
-			for (uint32_t i = 0; i < segment_sector_count; i++)
-				if (m_disk_cache->read_from_cache(lba + sectors_done + i, buffer.slice((sectors_done + i) * sector_size(), sector_size())))
-					needed_sector_bitmask &= ~(static_cast<uint64_t>(1) << i);
+			const uint32_t segment_sector_count = BAN::Math::min<uint64_t>(sector_count - sectors_done, 64);
+			const uint64_t segment_mask = (segment_sector_count == 64) ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << segment_sector_count) - 1;
+
+			auto segment_buffer = buffer.slice(sectors_done * sector_size(), segment_sector_count * sector_size());
+			const uint64_t needed_sector_bitmask = segment_mask & ~m_disk_cache->read_from_cache(lba + sectors_done, segment_sector_count, segment_buffer);
 
-			for (uint32_t i = 0; i < segment_sector_count && needed_sector_bitmask; i++)
+			for (uint32_t i = 0; i < segment_sector_count;)
 			{
 				if (!(needed_sector_bitmask & (static_cast<uint64_t>(1) << i)))
+				{
+					i++;
 					continue;
+				}
+
 				uint32_t len = 1;
-				while (needed_sector_bitmask & (static_cast<uint64_t>(1) << (i + len)))
+				while (i + len < segment_sector_count && (needed_sector_bitmask & (static_cast<uint64_t>(1) << (i + len))))
 					len++;
-				auto segment_buffer = buffer.slice((sectors_done + i) * sector_size(), len * sector_size());
-				TRY(read_sectors_impl(lba + sectors_done + i, len, segment_buffer));
-				for (uint32_t j = 0; j < len; j++)
-					(void)m_disk_cache->write_to_cache(lba + sectors_done + i + j, segment_buffer.slice(j * sector_size(), sector_size()), false);
-				needed_sector_bitmask &= ~(((static_cast<uint64_t>(1) << len) - 1) << i);
+
+				auto read_buffer = segment_buffer.slice(i * sector_size(), len * sector_size());
+				TRY(read_sectors_impl(lba + sectors_done + i, len, read_buffer));
+				(void)m_disk_cache->fill_cache(lba + sectors_done + i, len, read_buffer);
+
 				i += len;
 			}
 
@@ -266,6 +276,19 @@ namespace Kernel
 		return {};
 	}
 
+	BAN::ErrorOr<void> StorageDevice::read_sectors(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(buffer.size() >= sector_count * sector_size());
+
+		if (!m_disk_cache.has_value())
+			return read_sectors_impl(lba, sector_count, buffer);
+
+		TRY(read_sectors_cached(lba, sector_count, buffer));
+		update_readahead(lba, sector_count);
+
+		return {};
+	}
+
 	BAN::ErrorOr<void> StorageDevice::write_sectors(uint64_t lba, size_t sector_count, BAN::ConstByteSpan buffer)
 	{
 		ASSERT(buffer.size() >= sector_count * sector_size());
@@ -274,22 +297,136 @@ namespace Kernel
 		{
 			if (!m_disk_cache.has_value())
 				return BAN::Error::from_errno(EIO);
-			for (size_t i = 0; i < sector_count; i++)
-				TRY(m_disk_cache->write_to_cache(lba + i, buffer.slice(i * sector_size(), sector_size()), true));
+			TRY(m_disk_cache->write_to_cache(lba, sector_count, buffer, true));
 			return {};
 		}
 
 		if (!m_disk_cache.has_value())
 			return write_sectors_impl(lba, sector_count, buffer);
 
-		for (uint8_t offset = 0; offset < sector_count; offset++)
+		if (m_disk_cache->write_to_cache(lba, sector_count, buffer, true).is_error())
+			TRY(write_sectors_impl(lba, sector_count, buffer));
+
+		return {};
+	}
+
+	static constexpr size_t s_readahead_min_pages = 4;
+	static constexpr size_t s_readahead_max_pages = 32;
+
+	struct ReadaheadRequest
+	{
+		BAN::RefPtr<StorageDevice> device;
+		uint64_t lba;
+		size_t sector_count;
+	};
+
+	static SpinLock                                 s_readahead_queue_lock;
+	static ThreadBlocker                            s_readahead_thread_blocker;
+	static BAN::CircularQueue<ReadaheadRequest, 32> s_readahead_queue;
+	static BAN::Atomic<bool>                        s_readahead_thread_started { false };
+
+	void StorageDevice::update_readahead(uint64_t lba, size_t sector_count)
+	{
+		const uint64_t sectors_per_page = PAGE_SIZE / sector_size();
+		const uint64_t total_sectors = total_size() / sector_size();
+		const uint64_t end_lba = lba + sector_count;
+
+		uint64_t readahead_lba;
+		uint64_t readahead_end_lba;
+
 		{
-			auto sector_buffer = buffer.slice(offset * sector_size(), sector_size());
-			if (m_disk_cache->write_to_cache(lba + offset, sector_buffer, true).is_error())
-				TRY(write_sectors_impl(lba + offset, 1, sector_buffer));
+			SpinLockGuard _(m_readahead_lock);
+
+			// only sequential access triggers readahead
+			if (lba != m_sequential_next_lba)
+			{
+				m_sequential_next_lba = end_lba;
+				m_readahead_end_lba = 0;
+				m_readahead_pages = 0;
+				return;
+			}
+			m_sequential_next_lba = end_lba;
+
+			// wait until the reader has consumed half of the previous window
+			const uint64_t window_sectors = BAN::Math::max<size_t>(m_readahead_pages, s_readahead_min_pages) * sectors_per_page;
+			if (m_readahead_end_lba >= end_lba + window_sectors / 2)
+				return;
+
+			m_readahead_pages = BAN::Math::clamp<size_t>(m_readahead_pages * 2, s_readahead_min_pages, s_readahead_max_pages);
+
+			readahead_lba = BAN::Math::max(end_lba, m_readahead_end_lba);
+			readahead_end_lba = BAN::Math::min(end_lba + m_readahead_pages * sectors_per_page, total_sectors);
+			if (readahead_lba >= readahead_end_lba)
+				return;
+
+			m_readahead_end_lba = readahead_end_lba;
 		}
 
-		return {};
+		bool expected = false;
+		if (s_readahead_thread_started.compare_exchange(expected, true))
+		{
+			auto thread_or_error = Thread::create_kernel(&StorageDevice::readahead_thread, nullptr);
+			if (thread_or_error.is_error())
+			{
+				dwarnln("could not create readahead thread: {}", thread_or_error.error());
+				s_readahead_thread_started = false;
+				return;
+			}
+			if (auto ret = Processor::scheduler().add_thread(thread_or_error.value()); ret.is_error())
+			{
+				dwarnln("could not start readahead thread: {}", ret.error());
+				delete thread_or_error.value();
+				s_readahead_thread_started = false;
+				return;
+			}
+		}
+
+		SpinLockGuard _(s_readahead_queue_lock);
+		if (s_readahead_queue.full())
+			return;
+		s_readahead_queue.push({ this, readahead_lba, static_cast<size_t>(readahead_end_lba - readahead_lba) });
+		s_readahead_thread_blocker.unblock();
+	}
+
+	void StorageDevice::do_readahead(uint64_t lba, size_t sector_count, BAN::ByteSpan buffer)
+	{
+		ASSERT(m_disk_cache.has_value());
+
+		const size_t buffer_sectors = buffer.size() / sector_size();
+		for (size_t sectors_done = 0; sectors_done < sector_count;)
+		{
+			const size_t count = BAN::Math::min(sector_count - sectors_done, buffer_sectors);
+			if (auto ret = read_sectors_cached(lba + sectors_done, count, buffer); ret.is_error())
+			{
+				dprintln_if(DEBUG_DISK_SYNC, "readahead failed: {}", ret.error());
+				return;
+			}
+			sectors_done += count;
+		}
+	}
+
+	void StorageDevice::readahead_thread(void*)
+	{
+		BAN::Vector<uint8_t> buffer;
+		MUST(buffer.resize(s_readahead_max_pages * PAGE_SIZE));
+
+		while (true)
+		{
+			ReadaheadRequest request;
+
+			{
+				SpinLockGuard guard(s_readahead_queue_lock);
+				while (s_readahead_queue.empty())
+				{
+					SpinLockGuardAsMutex smutex(guard);
+					s_readahead_thread_blocker.block_indefinite(&smutex);
+				}
+				request = BAN::move(s_readahead_queue.front());
+				s_readahead_queue.pop();
+			}
+
+			request.device->do_readahead(request.lba, request.sector_count, buffer.span());
+		}
 	}
 
 	BAN::ErrorOr<void> StorageDevice::sync_blocks(uint64_t block, size_t block_count)
@@ -116,6 +116,8 @@ namespace Kernel
 		{
 			case SYS_READ:
 			case SYS_WRITE:
+			case SYS_READV:
+			case SYS_WRITEV:
 			case SYS_IOCTL:
 			case SYS_OPENAT:
 			case SYS_WAIT:
@@ -240,6 +240,7 @@ namespace Kernel
 		if (!s_default_sse_storage_initialized)
 			initialize_default_sse_storage();
 		memcpy(m_sse_storage, s_default_sse_storage, sizeof(m_sse_storage));
+		memset(m_affinity, 0xFF, sizeof(m_affinity));
 	}
 
 	Thread& Thread::current()
@@ -266,6 +267,33 @@ namespace Kernel
 		return *m_process;
 	}
 
+	int Thread::nice() const
+	{
+		if (m_process)
+			return m_process->nice();
+		return m_nice;
+	}
+
+	bool Thread::can_run_on_processor(uint8_t processor_index) const
+	{
+		constexpr size_t bits_per_word = 8 * sizeof(unsigned long);
+		const auto word = BAN::atomic_load(m_affinity[processor_index / bits_per_word], BAN::MemoryOrder::memory_order_relaxed);
+		return word & (1ul << (processor_index % bits_per_word));
+	}
+
+	void Thread::get_affinity(cpu_set_t& cpu_set) const
+	{
+		for (size_t i = 0; i < sizeof(m_affinity) / sizeof(*m_affinity); i++)
+			cpu_set.__bits[i] = BAN::atomic_load(m_affinity[i], BAN::MemoryOrder::memory_order_relaxed);
+	}
+
+	void Thread::set_affinity(const cpu_set_t& cpu_set)
+	{
+		// NOTE: words are updated separately, scheduler may briefly see a mix of old and new mask
+		for (size_t i = 0; i < sizeof(m_affinity) / sizeof(*m_affinity); i++)
+			BAN::atomic_store(m_affinity[i], cpu_set.__bits[i], BAN::MemoryOrder::memory_order_relaxed);
+	}
+
 	Thread::~Thread()
 	{
 		if (Processor::get_current_sse_thread() == this)
@@ -319,6 +347,10 @@ namespace Kernel
 			save_sse();
 		memcpy(thread->m_sse_storage, m_sse_storage, sizeof(m_sse_storage));
 
+		cpu_set_t affinity;
+		get_affinity(affinity);
+		thread->set_affinity(affinity);
+
 		TRY(thread->userspace_stack().copy_data_to_region(
 			thread->m_userspace_stack->size() - sizeof(void*),
 			reinterpret_cast<const uint8_t*>(&arg),
@@ -369,6 +401,10 @@ namespace Kernel
 		thread->m_fsbase = m_fsbase;
 		thread->m_gsbase = m_gsbase;
 
+		cpu_set_t affinity;
+		get_affinity(affinity);
+		thread->set_affinity(affinity);
+
 		thread->m_state = State::NotStarted;
 
 		if (Processor::get_current_sse_thread() == this)
@@ -897,7 +933,7 @@ namespace Kernel
 		thread_blocker.block_with_wake_time_ns(wake_time_ns, mutex);
 		if (is_interrupted_by_signal(true))
 			return BAN::Error::from_errno(EINTR);
-		if (etimedout && SystemTimer::get().ms_since_boot() >= wake_time_ns)
+		if (etimedout && SystemTimer::get().ns_since_boot() >= wake_time_ns)
 			return BAN::Error::from_errno(ETIMEDOUT);
 		return {};
 	}
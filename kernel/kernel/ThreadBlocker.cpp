@@ -44,6 +44,30 @@ namespace Kernel
 		m_block_chain = nullptr;
 	}
 
+	bool ThreadBlocker::unblock_one()
+	{
+		SpinLockGuard _(m_lock);
+
+		auto* node = m_block_chain;
+		if (node == nullptr)
+			return false;
+
+		ASSERT(node->blocked);
+		ASSERT(node->blocker == this);
+
+		m_block_chain = node->block_chain_next;
+		if (m_block_chain)
+			m_block_chain->block_chain_prev = nullptr;
+
+		node->blocker.store(nullptr);
+		node->block_chain_prev = nullptr;
+		node->block_chain_next = nullptr;
+
+		Processor::scheduler().unblock_thread(node);
+
+		return true;
+	}
+
 	void ThreadBlocker::add_thread_to_block_queue(SchedulerQueue::Node* node)
 	{
 		SpinLockGuard _(m_lock);
@@ -278,6 +278,40 @@ namespace Kernel
 			Processor::scheduler().timer_interrupt();
 	}
 
+	uint32_t HPET::reduce_tick_rate()
+	{
+		// main counter still has to be sampled before 32 bit counter wraps around
+		constexpr uint32_t tick_interval_ms = 100;
+
+		auto& regs = registers();
+		auto& timer0 = regs.timers[0];
+
+		const uint64_t period_ticks = static_cast<uint64_t>(m_ticks_per_s) * tick_interval_ms / 1000;
+		if (!(timer0.configuration & Tn_SIZE_CAP) && period_ticks > 0xFFFFFFFF)
+			return 1;
+
+		SpinLockGuard _(m_lock);
+
+		// with Tn_VAL_SET_CNF, first write sets the next comparator value and second one the period
+		const uint64_t next_ticks = (m_is_64bit ? regs.main_counter.full : regs.main_counter.low) + period_ticks;
+
+		timer0.configuration = timer0.configuration | Tn_VAL_SET_CNF;
+		timer0.comparator.low = next_ticks;
+		if (timer0.configuration & Tn_SIZE_CAP)
+		{
+			timer0.configuration = timer0.configuration | Tn_VAL_SET_CNF;
+			timer0.comparator.high = next_ticks >> 32;
+		}
+
+		timer0.comparator.low = period_ticks;
+		if (timer0.configuration & Tn_SIZE_CAP)
+			timer0.comparator.high = period_ticks >> 32;
+
+		dprintln("HPET tick interval set to {} ms", tick_interval_ms);
+
+		return tick_interval_ms;
+	}
+
 	uint64_t HPET::ms_since_boot() const
 	{
 		auto current = time_since_boot();
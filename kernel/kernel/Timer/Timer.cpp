@@ -112,7 +112,7 @@ namespace Kernel
 			return;
 
 		// only update every 100 ms
-		if (++m_timer_ticks < 100)
+		if (++m_timer_ticks < m_ticks_per_tsc_update)
 			return;
 		m_timer_ticks = 0;
 
@@ -123,6 +123,15 @@ namespace Kernel
 		});
 	}
 
+	void SystemTimer::dont_invoke_scheduler()
+	{
+		m_timer->m_should_invoke_scheduler = false;
+
+		const uint32_t tick_interval_ms = m_timer->reduce_tick_rate();
+		m_ticks_per_tsc_update = BAN::Math::max<uint32_t>(100 / tick_interval_ms, 1);
+		m_timer_ticks = 0;
+	}
+
 	uint64_t SystemTimer::ns_since_boot_no_tsc() const
 	{
 		return m_timer->ns_since_boot();
@@ -46,6 +46,7 @@ struct uthread
 	int cancel_type;
 	int cancel_state;
 	volatile int canceled;
+	void* malloc_cache;
 	pthread_key_t specific_keys[PTHREAD_KEYS_MAX];
 	void* specific_values[PTHREAD_KEYS_MAX];
 	// FIXME: make this dynamic
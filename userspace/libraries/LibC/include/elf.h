@@ -145,6 +145,7 @@ __BEGIN_DECLS
 #define DT_INIT_ARRAYSZ 27
 #define DT_FINI_ARRAYSZ 28
 #define DT_LOOS         0x60000000
+#define DT_GNU_HASH     0x6FFFFEF5
 #define DT_HIOS         0x6FFFFFFF
 #define DT_LOPROC       0x70000000
 #define DT_HIPROC       0x7FFFFFFF
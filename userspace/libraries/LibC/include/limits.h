@@ -75,7 +75,7 @@ __BEGIN_DECLS
 #define CHILD_MAX                     _POSIX_CHILD_MAX
 #define DELAYTIMER_MAX                _POSIX_DELAYTIMER_MAX
 #define HOST_NAME_MAX                 255
-#define IOV_MAX                       _XOPEN_IOV_MAX
+#define IOV_MAX                       1024
 #define LOGIN_NAME_MAX                256
 #define MQ_OPEN_MAX                   _POSIX_MQ_OPEN_MAX
 #define MQ_PRIO_MAX                   _POSIX_MQ_PRIO_MAX
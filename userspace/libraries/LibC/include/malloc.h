@@ -0,0 +1,36 @@
+#ifndef _MALLOC_H
+#define _MALLOC_H 1
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#define __need_size_t
+#include <sys/types.h>
+
+#include <stdlib.h>
+
+struct mallinfo2
+{
+	size_t arena;    /* bytes mapped for small allocations */
+	size_t ordblks;  /* number of completely free cached spans */
+	size_t smblks;   /* unused */
+	size_t hblks;    /* number of separately mapped large allocations */
+	size_t hblkhd;   /* bytes mapped for large allocations */
+	size_t usmblks;  /* unused */
+	size_t fsmblks;  /* bytes sitting in thread caches */
+	size_t uordblks; /* bytes in use by the application */
+	size_t fordblks; /* free bytes within arena */
+	size_t keepcost; /* bytes malloc_trim() could return to the system */
+};
+
+struct mallinfo2 mallinfo2(void);
+int malloc_trim(size_t pad);
+void malloc_stats(void);
+size_t malloc_usable_size(void* ptr);
+
+void _malloc_thread_exit(void);
+
+__END_DECLS
+
+#endif
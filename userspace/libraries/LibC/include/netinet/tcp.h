@@ -7,8 +7,77 @@
 
 __BEGIN_DECLS
 
+#include <stdint.h>
+
 #define TCP_NODELAY 1
 #define TCP_MAXSEG  2
+#define TCP_INFO    3
+
+// values of tcp_info.tcpi_state
+#define TCP_ESTABLISHED  1
+#define TCP_SYN_SENT     2
+#define TCP_SYN_RECV     3
+#define TCP_FIN_WAIT1    4
+#define TCP_FIN_WAIT2    5
+#define TCP_TIME_WAIT    6
+#define TCP_CLOSE        7
+#define TCP_CLOSE_WAIT   8
+#define TCP_LAST_ACK     9
+#define TCP_LISTEN      10
+#define TCP_CLOSING     11
+
+// values of tcp_info.tcpi_ca_state
+#define TCP_CA_Open     0
+#define TCP_CA_Recovery 3
+#define TCP_CA_Loss     4
+
+// bits of tcp_info.tcpi_options
+#define TCPI_OPT_SACK   0x02
+#define TCPI_OPT_WSCALE 0x04
+
+// layout and units match the beginning of linux's struct tcp_info,
+// times are in microseconds, windows and in flight data are in segments
+struct tcp_info
+{
+	uint8_t  tcpi_state;
+	uint8_t  tcpi_ca_state;
+	uint8_t  tcpi_retransmits;
+	uint8_t  tcpi_probes;
+	uint8_t  tcpi_backoff;
+	uint8_t  tcpi_options;
+	uint8_t  tcpi_snd_wscale : 4, tcpi_rcv_wscale : 4;
+	uint8_t  __reserved;
+
+	uint32_t tcpi_rto;
+	uint32_t tcpi_ato;
+	uint32_t tcpi_snd_mss;
+	uint32_t tcpi_rcv_mss;
+
+	uint32_t tcpi_unacked;
+	uint32_t tcpi_sacked;
+	uint32_t tcpi_lost;
+	uint32_t tcpi_retrans;
+	uint32_t tcpi_fackets;
+
+	uint32_t tcpi_last_data_sent;
+	uint32_t tcpi_last_ack_sent;
+	uint32_t tcpi_last_data_recv;
+	uint32_t tcpi_last_ack_recv;
+
+	uint32_t tcpi_pmtu;
+	uint32_t tcpi_rcv_ssthresh;
+	uint32_t tcpi_rtt;
+	uint32_t tcpi_rttvar;
+	uint32_t tcpi_snd_ssthresh;
+	uint32_t tcpi_snd_cwnd;
+	uint32_t tcpi_advmss;
+	uint32_t tcpi_reordering;
+
+	uint32_t tcpi_rcv_rtt;
+	uint32_t tcpi_rcv_space;
+
+	uint32_t tcpi_total_retrans;
+};
 
 __END_DECLS
 
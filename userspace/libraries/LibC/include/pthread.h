@@ -166,6 +166,9 @@ int			pthread_spin_trylock(pthread_spinlock_t* lock);
 int			pthread_spin_unlock(pthread_spinlock_t* lock);
 void		pthread_testcancel(void);
 
+int			pthread_getaffinity_np(pthread_t thread, size_t cpusetsize, cpu_set_t* cpuset);
+int			pthread_setaffinity_np(pthread_t thread, size_t cpusetsize, const cpu_set_t* cpuset);
+
 void		pthread_cleanup_pop(int execute);
 void		pthread_cleanup_push(void (*routine)(void*), void* arg);
 
@@ -10,6 +10,7 @@ __BEGIN_DECLS
 #include <time.h>
 
 #define __need_pid_t
+#define __need_size_t
 #include <sys/types.h>
 
 #include <bits/types/sched_param.h>
@@ -19,6 +20,22 @@ __BEGIN_DECLS
 #define SCHED_SPORADIC	3
 #define SCHED_OTHER		4
 
+#define CPU_SETSIZE 256
+
+typedef struct
+{
+	unsigned long __bits[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+} cpu_set_t;
+
+#define __CPU_ELEM(cpu)		((cpu) / (8 * sizeof(unsigned long)))
+#define __CPU_MASK(cpu)		(1UL << ((cpu) % (8 * sizeof(unsigned long))))
+
+#define CPU_ZERO(set)		__builtin_memset((set), 0, sizeof(cpu_set_t))
+#define CPU_SET(cpu, set)	((void)((size_t)(cpu) < CPU_SETSIZE && ((set)->__bits[__CPU_ELEM(cpu)] |= __CPU_MASK(cpu))))
+#define CPU_CLR(cpu, set)	((void)((size_t)(cpu) < CPU_SETSIZE && ((set)->__bits[__CPU_ELEM(cpu)] &= ~__CPU_MASK(cpu))))
+#define CPU_ISSET(cpu, set)	((size_t)(cpu) < CPU_SETSIZE && ((set)->__bits[__CPU_ELEM(cpu)] & __CPU_MASK(cpu)) != 0)
+#define CPU_COUNT(set)		__cpu_count(sizeof(cpu_set_t), (set))
+
 int sched_get_priority_max(int policy);
 int sched_get_priority_min(int policy);
 int sched_getparam(pid_t pid, struct sched_param* param);
@@ -30,6 +47,11 @@ int sched_yield(void);
 
 int sched_getcpu(void);
 
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t* mask);
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t* mask);
+
+int __cpu_count(size_t cpusetsize, const cpu_set_t* set);
+
 __END_DECLS
 
 #endif
@@ -27,13 +27,14 @@ struct epoll_event
 #define EPOLL_CTL_MOD 1
 #define EPOLL_CTL_DEL 2
 
-#define EPOLLIN      0x01
-#define EPOLLOUT     0x02
-#define EPOLLERR     0x04
-#define EPOLLHUP     0x08
-#define EPOLLPRI     0x10
-#define EPOLLET      0x20
-#define EPOLLONESHOT 0x40
+#define EPOLLIN        0x01
+#define EPOLLOUT       0x02
+#define EPOLLERR       0x04
+#define EPOLLHUP       0x08
+#define EPOLLPRI       0x10
+#define EPOLLET        0x20
+#define EPOLLONESHOT   0x40
+#define EPOLLEXCLUSIVE 0x80
 
 #define EPOLL_CLOEXEC 1
 
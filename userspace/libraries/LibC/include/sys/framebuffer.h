@@ -9,10 +9,17 @@ __BEGIN_DECLS
 
 #define BANAN_FB_BPP 32
 
+/* mmap offset that maps video memory directly instead of the shadow buffer */
+#define BANAN_FB_DIRECT_OFFSET 0x40000000
+
+#define FB_FLAG_DIRECT_MAP 0x01 /* video memory can be mapped with BANAN_FB_DIRECT_OFFSET */
+
 struct framebuffer_info_t
 {
 	uint32_t width;
 	uint32_t height;
+	uint32_t pitch; /* bytes per row in the direct mapping */
+	uint32_t flags;
 };
 
 __END_DECLS
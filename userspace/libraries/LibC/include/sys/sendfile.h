@@ -0,0 +1,17 @@
+#ifndef _SYS_SENDFILE_H
+#define _SYS_SENDFILE_H 1
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+#define __need_off_t
+#define __need_size_t
+#define __need_ssize_t
+#include <sys/types.h>
+
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count);
+
+__END_DECLS
+
+#endif
@@ -118,6 +118,15 @@ __BEGIN_DECLS
 	O(SYS_CHROOT,			chroot)			\
 	O(SYS_EVENTFD,			eventfd)		\
     O(SYS_BANOS_INSTALL,    banos_install)  \
+	O(SYS_READV,			readv)			\
+	O(SYS_WRITEV,			writev)			\
+	O(SYS_PREADV,			preadv)			\
+	O(SYS_PWRITEV,			pwritev)		\
+	O(SYS_SENDFILE,			sendfile)		\
+	O(SYS_GETPRIORITY,		getpriority)	\
+	O(SYS_SETPRIORITY,		setpriority)	\
+	O(SYS_SCHED_GETAFFINITY,	sched_getaffinity)	\
+	O(SYS_SCHED_SETAFFINITY,	sched_setaffinity)	\
 
 enum Syscall
 {
@@ -1,278 +1,463 @@
+#include <BAN/Atomic.h>
 #include <BAN/Math.h>
 
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <malloc.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 
-static constexpr size_t s_allocator_chunk_size { 64 };
-static constexpr size_t s_allocator_size       { 1024 * 1024 };
-static constexpr size_t s_mmap_threshold       {   64 * 1024 };
+// Small allocations are carved from size class spans and handed out through
+// per thread caches, so the common path takes no locks. Every allocation,
+// small or large, starts at most one span size after its span header. This
+// allows finding the owning span in O(1) by masking the pointer.
 
-struct alignas(max_align_t) MmapAllocationHeader
+static constexpr size_t s_span_size         { 64 * 1024 };
+static constexpr size_t s_spans_per_mapping { 16 };
+static constexpr size_t s_max_free_spans    { 16 };
+static constexpr size_t s_max_small_size    { 16 * 1024 };
+static constexpr size_t s_size_class_count  { 36 };
+static constexpr size_t s_large_size_class  { SIZE_MAX };
+
+// 16 byte steps up to 128, after that four classes per power of two
+static constexpr size_t size_class_to_size(size_t size_class)
+{
+	if (size_class < 8)
+		return (size_class + 1) * 16;
+	const size_t shift = 7 + (size_class - 8) / 4;
+	const size_t base = static_cast<size_t>(1) << shift;
+	return base + (base / 4) * ((size_class - 8) % 4 + 1);
+}
+
+static constexpr size_t size_to_size_class(size_t size)
+{
+	if (size <= 128)
+		return (size > 0) ? (size - 1) / 16 : 0;
+	const size_t shift = (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(size - 1);
+	const size_t base = static_cast<size_t>(1) << shift;
+	return 8 + (shift - 7) * 4 + (size - 1 - base) / (base / 4);
+}
+
+static_assert(size_class_to_size(s_size_class_count - 1) == s_max_small_size);
+static_assert(size_to_size_class(s_max_small_size) == s_size_class_count - 1);
+static_assert(size_to_size_class(size_class_to_size(12) + 1) == 13);
+
+// number of objects moved between a thread cache and the central lists at once
+static constexpr size_t size_class_batch(size_t size_class)
+{
+	return BAN::Math::clamp<size_t>(s_span_size / 8 / size_class_to_size(size_class), 2, 32);
+}
+
+struct FreeObject
 {
-	size_t mmap_size;
-	size_t offset;
+	FreeObject* next;
 };
 
-struct BitmapAllocator
+struct alignas(max_align_t) Span
 {
-	struct alignas(max_align_t) Header
+	size_t size_class;
+	size_t mapping_size;
+
+	// following fields are only used by small spans
+	Span* prev;
+	Span* next;
+	FreeObject* free_list;
+	uint32_t used_objects;
+	uint32_t total_objects;
+	uint32_t carved_objects;
+
+	uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+
+struct SizeClass
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	// spans that have free objects left
+	Span* partial_spans { nullptr };
+	size_t span_count { 0 };
+	// objects given out to thread caches
+	size_t objects_out { 0 };
+};
+
+struct ThreadCache
+{
+	struct Bin
 	{
-		size_t chunks { 0 };
+		FreeObject* head;
+		uint32_t count;
 	};
 
-	uint32_t bitmap_chunks { 0 };
-	uint32_t total_chunks  { 0 };
-	uint32_t free_chunks   { 0 };
-	uint32_t allocations   { 0 };
-	uint8_t* base          { nullptr };
+	Bin bins[s_size_class_count];
+	ThreadCache* next;
+	bool in_use;
+};
 
-	static size_t needed_chunks(size_t size)
-	{
-		return BAN::Math::div_round_up(sizeof(BitmapAllocator::Header) + size, s_allocator_chunk_size);
-	}
+static SizeClass s_size_classes[s_size_class_count];
 
-	bool initialize()
-	{
-		void* base = mmap(nullptr, s_allocator_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-		if (base == MAP_FAILED)
-			return false;
+static Span* s_free_spans { nullptr };
+static size_t s_free_span_count { 0 };
+static size_t s_small_mapped_bytes { 0 };
+static pthread_mutex_t s_span_lock = PTHREAD_MUTEX_INITIALIZER;
 
-		constexpr size_t bitmap_bytes  = BAN::Math::div_round_up(s_allocator_size, s_allocator_chunk_size * 8);
-		constexpr size_t bitmap_chunks = BAN::Math::div_round_up(bitmap_bytes, s_allocator_chunk_size);
-		constexpr size_t usable_chunks = s_allocator_size / s_allocator_chunk_size - bitmap_chunks;
+static ThreadCache* s_thread_caches { nullptr };
+static pthread_mutex_t s_thread_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-		this->bitmap_chunks = bitmap_chunks;
-		this->total_chunks  = usable_chunks;
-		this->free_chunks   = usable_chunks;
-		this->base          = static_cast<uint8_t*>(base);
+static size_t s_large_count { 0 };
+static size_t s_large_bytes { 0 };
 
-		return true;
-	}
+static Span* span_from_pointer(void* ptr)
+{
+	return reinterpret_cast<Span*>((reinterpret_cast<uintptr_t>(ptr) - 1) & ~(s_span_size - 1));
+}
 
-	uint8_t* data_start() { return base + bitmap_chunks * s_allocator_chunk_size; }
-	const uint8_t* data_start() const { return base + bitmap_chunks * s_allocator_chunk_size; }
+// maps `size` bytes at an address for which (address + skew) is aligned to `alignment`
+static void* map_aligned(size_t size, size_t alignment, size_t skew)
+{
+	if (size > SIZE_MAX - alignment)
+		return nullptr;
 
-	size_t get_first_chunk(void* ptr) const
-	{
-		return (static_cast<uint8_t*>(ptr) - sizeof(Header) - data_start()) / s_allocator_chunk_size;
-	}
+	const size_t map_size = size + alignment;
+	void* mapping = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	const uintptr_t base = reinterpret_cast<uintptr_t>(mapping);
+	const uintptr_t start = BAN::Math::div_round_up<uintptr_t>(base + skew, alignment) * alignment - skew;
+	if (start > base)
+		munmap(mapping, start - base);
+	if (base + map_size > start + size)
+		munmap(reinterpret_cast<void*>(start + size), base + map_size - start - size);
 
-	bool contains(void* ptr) const
+	return reinterpret_cast<void*>(start);
+}
+
+// s_span_lock has to be held
+static size_t trim_free_spans(size_t keep)
+{
+	size_t released = 0;
+	while (s_free_span_count > keep)
 	{
-		if (ptr < data_start() + sizeof(Header))
-			return false;
-		return get_first_chunk(ptr) < total_chunks;
+		Span* span = s_free_spans;
+		s_free_spans = span->next;
+		s_free_span_count--;
+
+		munmap(span, s_span_size);
+		released += s_span_size;
 	}
 
-	bool get_bit(size_t index) const
+	s_small_mapped_bytes -= released;
+	return released;
+}
+
+static Span* allocate_span()
+{
+	pthread_mutex_lock(&s_span_lock);
+
+	if (s_free_spans == nullptr)
 	{
-		assert(index < total_chunks);
-		const size_t byte = index / 8;
-		const size_t bit = index % 8;
-		return (base[byte] >> bit) & 1;
+		if (auto* mapping = static_cast<uint8_t*>(map_aligned(s_spans_per_mapping * s_span_size, s_span_size, 0)))
+		{
+			for (size_t i = 0; i < s_spans_per_mapping; i++)
+			{
+				auto* span = reinterpret_cast<Span*>(mapping + i * s_span_size);
+				span->next = s_free_spans;
+				s_free_spans = span;
+			}
+			s_free_span_count += s_spans_per_mapping;
+			s_small_mapped_bytes += s_spans_per_mapping * s_span_size;
+		}
 	}
 
-	void set_bit(size_t index, bool value)
+	Span* span = s_free_spans;
+	if (span != nullptr)
 	{
-		assert(index < total_chunks);
-		const size_t byte = index / 8;
-		const size_t bit = index % 8;
-		if (value)
-			base[byte] |= 1 << bit;
-		else
-			base[byte] &= ~(1 << bit);
+		s_free_spans = span->next;
+		s_free_span_count--;
 	}
 
-	size_t find_unset_bit(size_t index) const
-	{
-		// NOTE: We could optimize other bitmap functions than this
-		//       but this one is the bottle neck so it doesn't matter
+	pthread_mutex_unlock(&s_span_lock);
+
+	return span;
+}
 
-		static_assert(sizeof(unsigned long long) == sizeof(uint64_t));
+static void release_span(Span* span)
+{
+	pthread_mutex_lock(&s_span_lock);
 
-		if (index >= total_chunks)
-			return index;
+	span->next = s_free_spans;
+	s_free_spans = span;
+	s_free_span_count++;
 
-		if (const auto rem = index % 64)
-		{
-			const uint64_t qword = *reinterpret_cast<const uint64_t*>(base + (index - rem) / 8) >> rem;
-			if (qword != UINT64_MAX >> rem)
-				return index + __builtin_ctzll(~qword);
-			index += 64 - rem;
-		}
+	if (s_free_span_count > s_max_free_spans)
+		trim_free_spans(s_max_free_spans);
 
-		while (index < total_chunks)
-		{
-			const uint64_t qword = *reinterpret_cast<const uint64_t*>(base + index / 8);
-			if (qword != UINT64_MAX)
-				return index + __builtin_ctzll(~qword);
-			index += 64;
-		}
+	pthread_mutex_unlock(&s_span_lock);
+}
 
-		return index;
-	}
+// size class lock has to be held
+static void link_partial_span(SizeClass& size_class, Span* span)
+{
+	span->prev = nullptr;
+	span->next = size_class.partial_spans;
+	if (span->next)
+		span->next->prev = span;
+	size_class.partial_spans = span;
+}
 
-	size_t count_unset_bits(size_t index, size_t wanted) const
-	{
-		size_t count = 0;
-		for (; index + count < total_chunks && count < wanted; count++)
-			if (get_bit(index + count))
-				break;
-		return count;
-	}
+// size class lock has to be held
+static void unlink_partial_span(SizeClass& size_class, Span* span)
+{
+	if (span->prev)
+		span->prev->next = span->next;
+	else
+		size_class.partial_spans = span->next;
+	if (span->next)
+		span->next->prev = span->prev;
+	span->prev = nullptr;
+	span->next = nullptr;
+}
 
-	Header& header_from_chunk(size_t index)
-	{
-		return *reinterpret_cast<Header*>(data_start() + index * s_allocator_chunk_size);
-	}
+// moves up to `count` objects to the front of `list`, returns the number of objects moved
+static size_t central_allocate(size_t class_index, FreeObject*& list, size_t count)
+{
+	auto& size_class = s_size_classes[class_index];
+	const size_t object_size = size_class_to_size(class_index);
+
+	pthread_mutex_lock(&size_class.lock);
 
-	void* allocate(size_t size)
+	size_t moved = 0;
+	while (moved < count)
 	{
-		const size_t needed_chunks = this->needed_chunks(size);
-		if (needed_chunks > free_chunks)
-			return nullptr;
+		Span* span = size_class.partial_spans;
+		if (span == nullptr)
+		{
+			if ((span = allocate_span()) == nullptr)
+				break;
+			*span = {
+				.size_class = class_index,
+				.mapping_size = s_span_size,
+				.prev = nullptr,
+				.next = nullptr,
+				.free_list = nullptr,
+				.used_objects = 0,
+				.total_objects = static_cast<uint32_t>((s_span_size - sizeof(Span)) / object_size),
+				.carved_objects = 0,
+			};
+			link_partial_span(size_class, span);
+			size_class.span_count++;
+		}
 
-		for (size_t i = find_unset_bit(0); i <= total_chunks - needed_chunks; i = find_unset_bit(i))
+		for (; moved < count && span->used_objects < span->total_objects; moved++)
 		{
-			if (const size_t count = count_unset_bits(i, needed_chunks); count < needed_chunks)
+			FreeObject* object;
+			if (span->free_list)
+			{
+				object = span->free_list;
+				span->free_list = object->next;
+			}
+			else
 			{
-				i += count + 1;
-				continue;
+				// untouched tail of the span, pages are only faulted in when used
+				object = reinterpret_cast<FreeObject*>(span->data() + span->carved_objects * object_size);
+				span->carved_objects++;
 			}
 
-			for (size_t j = 0; j < needed_chunks; j++)
-				set_bit(i + j, true);
+			object->next = list;
+			list = object;
+			span->used_objects++;
+		}
 
-			auto& header = header_from_chunk(i);
-			header = {
-				.chunks = needed_chunks,
-			};
+		if (span->used_objects == span->total_objects)
+			unlink_partial_span(size_class, span);
+	}
 
-			free_chunks -= header.chunks;
-			allocations++;
+	size_class.objects_out += moved;
 
-			return &header + 1;
-		}
+	pthread_mutex_unlock(&size_class.lock);
 
-		return nullptr;
-	}
+	return moved;
+}
 
-	bool resize(void* ptr, size_t size)
+static void central_deallocate(size_t class_index, FreeObject* list, size_t count)
+{
+	auto& size_class = s_size_classes[class_index];
+
+	pthread_mutex_lock(&size_class.lock);
+
+	while (list)
 	{
-		assert(contains(ptr));
+		FreeObject* object = list;
+		list = list->next;
 
-		const size_t first_chunk = get_first_chunk(ptr);
-		auto& header = header_from_chunk(first_chunk);
+		Span* span = span_from_pointer(object);
+		assert(span->size_class == class_index);
 
-		const size_t needed_chunks = this->needed_chunks(size);
-		if (needed_chunks <= header.chunks)
-		{
-			for (size_t i = needed_chunks; i < header.chunks; i++)
-				set_bit(first_chunk + i, false);
-			free_chunks += header.chunks - needed_chunks;
-		}
-		else
+		if (span->used_objects == span->total_objects)
+			link_partial_span(size_class, span);
+
+		object->next = span->free_list;
+		span->free_list = object;
+		span->used_objects--;
+
+		// keep the last span of a size class around to avoid thrashing
+		if (span->used_objects == 0 && (span->prev || span->next))
 		{
-			const size_t extra_chunks = header.chunks - needed_chunks;
-			if (count_unset_bits(first_chunk + header.chunks, extra_chunks) < extra_chunks)
-				return false;
-			for (size_t i = header.chunks; i < needed_chunks; i++)
-				set_bit(first_chunk + i, true);
-			free_chunks -= needed_chunks - header.chunks;
+			unlink_partial_span(size_class, span);
+			size_class.span_count--;
+			release_span(span);
 		}
-
-		header = {
-			.chunks = needed_chunks,
-		};
-		return true;
 	}
 
-	void free(void* ptr)
-	{
-		assert(contains(ptr));
+	size_class.objects_out -= count;
+
+	pthread_mutex_unlock(&size_class.lock);
+}
 
-		const size_t first_chunk = get_first_chunk(ptr);
+static ThreadCache* get_thread_cache()
+{
+	auto* uthread = _get_uthread();
+	if (uthread->malloc_cache) [[likely]]
+		return static_cast<ThreadCache*>(uthread->malloc_cache);
 
-		auto& header = header_from_chunk(first_chunk);
-		for (size_t i = 0; i < header.chunks; i++)
-			set_bit(first_chunk + i, false);
+	pthread_mutex_lock(&s_thread_cache_lock);
 
-		free_chunks += header.chunks;
-		allocations--;
-	}
+	// reuse caches of exited threads
+	ThreadCache* cache = s_thread_caches;
+	while (cache && cache->in_use)
+		cache = cache->next;
 
-	size_t allocation_size(void* ptr)
+	if (cache == nullptr)
 	{
-		assert(contains(ptr));
-		return header_from_chunk(get_first_chunk(ptr)).chunks * s_allocator_chunk_size - sizeof(Header);
+		void* mapping = mmap(nullptr, sizeof(ThreadCache), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (mapping != MAP_FAILED)
+		{
+			cache = static_cast<ThreadCache*>(mapping);
+			memset(cache, 0, sizeof(ThreadCache));
+			cache->next = s_thread_caches;
+			s_thread_caches = cache;
+		}
 	}
-};
 
-static size_t s_allocator_count { 0 };
-static size_t s_allocator_capacity { 0 };
+	if (cache != nullptr)
+		cache->in_use = true;
 
-static BitmapAllocator* s_allocators { nullptr };
-static pthread_mutex_t s_allocator_lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_mutex_unlock(&s_thread_cache_lock);
 
-void* malloc(size_t total_size)
+	uthread->malloc_cache = cache;
+	return cache;
+}
+
+static void flush_thread_cache_bin(ThreadCache& cache, size_t class_index, size_t count)
 {
-	if (total_size >= s_mmap_threshold)
-	{
-		const size_t mmap_size = sizeof(MmapAllocationHeader) + total_size;
+	auto& bin = cache.bins[class_index];
+	count = BAN::Math::min<size_t>(count, bin.count);
+	if (count == 0)
+		return;
 
-		void* address = mmap(nullptr, mmap_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-		if (address == MAP_FAILED)
-			return nullptr;
+	FreeObject* list = bin.head;
+	FreeObject* last = list;
+	for (size_t i = 1; i < count; i++)
+		last = last->next;
 
-		auto& header = static_cast<MmapAllocationHeader*>(address)[0];
-		header = {
-			.mmap_size = mmap_size,
-			.offset = sizeof(MmapAllocationHeader),
-		};
-		return &header + 1;
-	}
+	bin.head = last->next;
+	bin.count -= count;
+	last->next = nullptr;
 
-	constexpr size_t allocators_per_page = PAGE_SIZE / sizeof(BitmapAllocator);
+	central_deallocate(class_index, list, count);
+}
 
-	void* result = nullptr;
+void _malloc_thread_exit(void)
+{
+	auto* uthread = _get_uthread();
 
-	pthread_mutex_lock(&s_allocator_lock);
+	auto* cache = static_cast<ThreadCache*>(uthread->malloc_cache);
+	if (cache == nullptr)
+		return;
+	uthread->malloc_cache = nullptr;
 
-	for (size_t i = 0; i < s_allocator_count; i++)
-		if ((result = s_allocators[i].allocate(total_size)))
-			goto malloc_return;
+	for (size_t i = 0; i < s_size_class_count; i++)
+		flush_thread_cache_bin(*cache, i, cache->bins[i].count);
 
-	if (s_allocator_capacity % allocators_per_page == 0)
-	{
-		void* new_allocators = mmap(nullptr, (s_allocator_capacity + allocators_per_page) * sizeof(BitmapAllocator), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-		if (new_allocators == MAP_FAILED)
-			goto malloc_return;
+	pthread_mutex_lock(&s_thread_cache_lock);
+	cache->in_use = false;
+	pthread_mutex_unlock(&s_thread_cache_lock);
+}
 
-		static_assert(BAN::is_trivially_copyable_v<BitmapAllocator>);
-		memcpy(new_allocators, s_allocators, s_allocator_count * sizeof(BitmapAllocator));
+static void* allocate_large(size_t size, size_t alignment)
+{
+	// data has to start at most one span size after the header, so
+	// for big alignments the header is placed right before a span boundary
+	const size_t data_offset = (alignment < s_span_size)
+		? BAN::Math::div_round_up(sizeof(Span), alignment) * alignment
+		: s_span_size;
+	const size_t map_alignment = BAN::Math::max(alignment, s_span_size);
+
+	if (size > SIZE_MAX - data_offset - map_alignment - PAGE_SIZE)
+	{
+		errno = ENOMEM;
+		return nullptr;
+	}
 
-		munmap(s_allocators, s_allocator_capacity * sizeof(BitmapAllocator));
+	const size_t mapping_size = BAN::Math::div_round_up<size_t>(data_offset + size, PAGE_SIZE) * PAGE_SIZE;
 
-		s_allocators = static_cast<BitmapAllocator*>(new_allocators);
-		s_allocator_capacity = s_allocator_capacity + allocators_per_page;
+	void* mapping = map_aligned(mapping_size, map_alignment, (alignment > s_span_size) ? data_offset : 0);
+	if (mapping == nullptr)
+	{
+		errno = ENOMEM;
+		return nullptr;
 	}
 
-	if (!s_allocators[s_allocator_count].initialize())
-		goto malloc_return;
-	result = s_allocators[s_allocator_count++].allocate(total_size);
+	auto* span = static_cast<Span*>(mapping);
+	*span = {
+		.size_class = s_large_size_class,
+		.mapping_size = mapping_size,
+		.prev = nullptr,
+		.next = nullptr,
+		.free_list = nullptr,
+		.used_objects = 0,
+		.total_objects = 0,
+		.carved_objects = 0,
+	};
 
-malloc_return:
-	pthread_mutex_unlock(&s_allocator_lock);
+	BAN::atomic_add_fetch(s_large_count, 1);
+	BAN::atomic_add_fetch(s_large_bytes, mapping_size);
 
-	if (result == nullptr)
+	return static_cast<uint8_t*>(mapping) + data_offset;
+}
+
+void* malloc(size_t size)
+{
+	if (size > s_max_small_size)
+		return allocate_large(size, alignof(max_align_t));
+
+	const size_t class_index = size_to_size_class(size);
+
+	auto* cache = get_thread_cache();
+	if (cache == nullptr)
+	{
 		errno = ENOMEM;
-	return result;
+		return nullptr;
+	}
+
+	auto& bin = cache->bins[class_index];
+	if (bin.head == nullptr)
+	{
+		bin.count += central_allocate(class_index, bin.head, size_class_batch(class_index));
+		if (bin.head == nullptr)
+		{
+			errno = ENOMEM;
+			return nullptr;
+		}
+	}
+
+	FreeObject* object = bin.head;
+	bin.head = object->next;
+	bin.count--;
+	return object;
 }
 
 void free(void* ptr)
@@ -280,36 +465,45 @@ void free(void* ptr)
 	if (ptr == nullptr)
 		return;
 
-	pthread_mutex_lock(&s_allocator_lock);
-	for (size_t i = 0; i < s_allocator_count; i++)
+	Span* span = span_from_pointer(ptr);
+	if (span->size_class == s_large_size_class)
 	{
-		if (!s_allocators[i].contains(ptr))
-			continue;
-		s_allocators[i].free(ptr);
-		pthread_mutex_unlock(&s_allocator_lock);
+		BAN::atomic_sub_fetch(s_large_count, 1);
+		BAN::atomic_sub_fetch(s_large_bytes, span->mapping_size);
+		munmap(span, span->mapping_size);
 		return;
 	}
-	pthread_mutex_unlock(&s_allocator_lock);
 
-	const auto& header = static_cast<MmapAllocationHeader*>(ptr)[-1];
-	munmap(static_cast<uint8_t*>(ptr) - header.offset, header.mmap_size);
-}
+	const size_t class_index = span->size_class;
+	auto* object = static_cast<FreeObject*>(ptr);
 
-static size_t allocation_size(void* ptr)
-{
-	pthread_mutex_lock(&s_allocator_lock);
-	for (size_t i = 0; i < s_allocator_count; i++)
+	auto* cache = get_thread_cache();
+	if (cache == nullptr)
 	{
-		if (!s_allocators[i].contains(ptr))
-			continue;
-		const size_t size = s_allocators[i].allocation_size(ptr);
-		pthread_mutex_unlock(&s_allocator_lock);
-		return size;
+		object->next = nullptr;
+		central_deallocate(class_index, object, 1);
+		return;
 	}
-	pthread_mutex_unlock(&s_allocator_lock);
 
-	const auto& header = static_cast<MmapAllocationHeader*>(ptr)[-1];
-	return header.mmap_size - sizeof(MmapAllocationHeader);
+	auto& bin = cache->bins[class_index];
+	object->next = bin.head;
+	bin.head = object;
+	bin.count++;
+
+	const size_t batch = size_class_batch(class_index);
+	if (bin.count > 2 * batch)
+		flush_thread_cache_bin(*cache, class_index, batch);
+}
+
+size_t malloc_usable_size(void* ptr)
+{
+	if (ptr == nullptr)
+		return 0;
+
+	Span* span = span_from_pointer(ptr);
+	if (span->size_class == s_large_size_class)
+		return span->mapping_size - (static_cast<uint8_t*>(ptr) - reinterpret_cast<uint8_t*>(span));
+	return size_class_to_size(span->size_class);
 }
 
 void* realloc(void* ptr, size_t size)
@@ -317,25 +511,16 @@ void* realloc(void* ptr, size_t size)
 	if (ptr == nullptr)
 		return malloc(size);
 
-	pthread_mutex_lock(&s_allocator_lock);
-	for (size_t i = 0; i < s_allocator_count; i++)
-	{
-		if (!s_allocators[i].contains(ptr))
-			continue;
-		if (!s_allocators[i].resize(ptr, size))
-			break;
-		pthread_mutex_unlock(&s_allocator_lock);
+	// shrinking that would not free up much is done in place
+	const size_t old_size = malloc_usable_size(ptr);
+	if (size <= old_size && size >= old_size / 2)
 		return ptr;
-	}
-	pthread_mutex_unlock(&s_allocator_lock);
-
-	// TODO: maybe an in-place realloc for mmap-backed allocations?
 
 	void* new_ptr = malloc(size);
 	if (new_ptr == nullptr)
 		return nullptr;
 
-	memcpy(new_ptr, ptr, BAN::Math::min(allocation_size(ptr), size));
+	memcpy(new_ptr, ptr, BAN::Math::min(old_size, size));
 
 	free(ptr);
 
@@ -370,26 +555,7 @@ void* aligned_alloc(size_t alignment, size_t size)
 	if (alignment <= alignof(max_align_t))
 		return malloc(size);
 
-	static_assert(sizeof(MmapAllocationHeader) <= alignof(max_align_t));
-
-	const size_t mmap_size = alignment + size;
-
-	void* address = mmap(nullptr, mmap_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-	if (address == MAP_FAILED)
-		return nullptr;
-
-	uintptr_t data = reinterpret_cast<uintptr_t>(address) + sizeof(MmapAllocationHeader);
-	if (auto rem = data % alignment)
-		data += alignment - rem;
-
-	// TODO: unmap possible unused pages in alignment, they are only allocated when accessed so doesn't really matter :^)
-
-	auto& header = reinterpret_cast<MmapAllocationHeader*>(data)[-1];
-	header = {
-		.mmap_size = mmap_size,
-		.offset = data - reinterpret_cast<uintptr_t>(address),
-	};
-	return &header + 1;
+	return allocate_large(size, alignment);
 }
 
 int posix_memalign(void** memptr, size_t alignment, size_t size)
@@ -402,3 +568,105 @@ int posix_memalign(void** memptr, size_t alignment, size_t size)
 
 	return (*memptr = aligned_alloc(alignment, size)) ? 0 : -1;
 }
+
+int malloc_trim(size_t pad)
+{
+	// objects cached by this thread may be keeping spans alive
+	if (auto* cache = static_cast<ThreadCache*>(_get_uthread()->malloc_cache))
+		for (size_t i = 0; i < s_size_class_count; i++)
+			flush_thread_cache_bin(*cache, i, cache->bins[i].count);
+
+	for (auto& size_class : s_size_classes)
+	{
+		pthread_mutex_lock(&size_class.lock);
+		Span* span = size_class.partial_spans;
+		if (span && span->used_objects == 0 && span->next == nullptr)
+		{
+			unlink_partial_span(size_class, span);
+			size_class.span_count--;
+			release_span(span);
+		}
+		pthread_mutex_unlock(&size_class.lock);
+	}
+
+	pthread_mutex_lock(&s_span_lock);
+	const size_t released = trim_free_spans(pad / s_span_size);
+	pthread_mutex_unlock(&s_span_lock);
+
+	return released > 0;
+}
+
+struct mallinfo2 mallinfo2(void)
+{
+	struct mallinfo2 info {};
+
+	size_t small_in_use = 0;
+	for (size_t i = 0; i < s_size_class_count; i++)
+	{
+		auto& size_class = s_size_classes[i];
+		pthread_mutex_lock(&size_class.lock);
+		small_in_use += size_class.objects_out * size_class_to_size(i);
+		pthread_mutex_unlock(&size_class.lock);
+	}
+
+	// other threads' bins are read without synchronization, so this is only an estimate
+	size_t thread_cached = 0;
+	pthread_mutex_lock(&s_thread_cache_lock);
+	for (auto* cache = s_thread_caches; cache; cache = cache->next)
+		if (cache->in_use)
+			for (size_t i = 0; i < s_size_class_count; i++)
+				thread_cached += BAN::atomic_load(cache->bins[i].count, BAN::MemoryOrder::memory_order_relaxed) * size_class_to_size(i);
+	pthread_mutex_unlock(&s_thread_cache_lock);
+
+	pthread_mutex_lock(&s_span_lock);
+	info.arena = s_small_mapped_bytes;
+	info.ordblks = s_free_span_count;
+	info.keepcost = s_free_span_count * s_span_size;
+	pthread_mutex_unlock(&s_span_lock);
+
+	small_in_use = BAN::Math::min(small_in_use, info.arena);
+	thread_cached = BAN::Math::min(thread_cached, small_in_use);
+
+	info.hblks = BAN::atomic_load(s_large_count);
+	info.hblkhd = BAN::atomic_load(s_large_bytes);
+	info.fsmblks = thread_cached;
+	info.uordblks = small_in_use - thread_cached;
+	info.fordblks = info.arena - small_in_use;
+
+	return info;
+}
+
+void malloc_stats(void)
+{
+	struct class_stats_t
+	{
+		size_t spans;
+		size_t objects_out;
+	};
+
+	// collect everything first, stdio may allocate
+	class_stats_t class_stats[s_size_class_count];
+	for (size_t i = 0; i < s_size_class_count; i++)
+	{
+		auto& size_class = s_size_classes[i];
+		pthread_mutex_lock(&size_class.lock);
+		class_stats[i] = {
+			.spans = size_class.span_count,
+			.objects_out = size_class.objects_out,
+		};
+		pthread_mutex_unlock(&size_class.lock);
+	}
+
+	const auto info = mallinfo2();
+
+	fprintf(stderr, "size class  spans  objects out\n");
+	for (size_t i = 0; i < s_size_class_count; i++)
+		if (class_stats[i].spans)
+			fprintf(stderr, "%10zu  %5zu  %11zu\n", size_class_to_size(i), class_stats[i].spans, class_stats[i].objects_out);
+	fprintf(stderr, "small mapped bytes:  %zu\n", info.arena);
+	fprintf(stderr, "small in use bytes:  %zu\n", info.uordblks);
+	fprintf(stderr, "thread cached bytes: %zu\n", info.fsmblks);
+	fprintf(stderr, "free span bytes:     %zu\n", info.keepcost);
+	fprintf(stderr, "large allocations:   %zu\n", info.hblks);
+	fprintf(stderr, "large mapped bytes:  %zu\n", info.hblkhd);
+}
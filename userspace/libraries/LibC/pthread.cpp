@@ -7,6 +7,7 @@
 #include <kernel/Thread.h>
 
 #include <errno.h>
+#include <malloc.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -419,6 +420,7 @@ int pthread_create(pthread_t* __restrict thread_id, const pthread_attr_t* __rest
 			.cancel_type = PTHREAD_CANCEL_DEFERRED,
 			.cancel_state = PTHREAD_CANCEL_ENABLE,
 			.canceled = 0,
+			.malloc_cache = nullptr,
 			.specific_keys = {},
 			.specific_values = {},
 			.dtv = { self->dtv[0] }
@@ -485,6 +487,8 @@ void pthread_exit(void* value_ptr)
 			break;
 	}
 
+	_malloc_thread_exit();
+
 	free_uthread(uthread);
 	syscall(SYS_PTHREAD_EXIT, value_ptr);
 	ASSERT_NOT_REACHED();
@@ -692,6 +696,20 @@ int pthread_setschedparam(pthread_t thread, int policy, const struct sched_param
 	return ENOTSUP;
 }
 
+int pthread_getaffinity_np(pthread_t thread, size_t cpusetsize, cpu_set_t* cpuset)
+{
+	if (sched_getaffinity(thread, cpusetsize, cpuset) == -1)
+		return errno;
+	return 0;
+}
+
+int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize, const cpu_set_t* cpuset)
+{
+	if (sched_setaffinity(thread, cpusetsize, cpuset) == -1)
+		return errno;
+	return 0;
+}
+
 int pthread_spin_destroy(pthread_spinlock_t* lock)
 {
 	(void)lock;
@@ -1,4 +1,6 @@
+#include <errno.h>
 #include <sched.h>
+#include <string.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
@@ -31,3 +33,28 @@ int sched_getcpu(void)
 	asm volatile("lsl %1, %0" : "=r"(limit) : "r"(g_shared_page->gdt_cpu_offset));
 	return limit;
 }
+
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t* mask)
+{
+	if (cpusetsize > sizeof(cpu_set_t))
+	{
+		memset(reinterpret_cast<char*>(mask) + sizeof(cpu_set_t), 0, cpusetsize - sizeof(cpu_set_t));
+		cpusetsize = sizeof(cpu_set_t);
+	}
+	if (syscall(SYS_SCHED_GETAFFINITY, pid, cpusetsize, mask) == -1)
+		return -1;
+	return 0;
+}
+
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t* mask)
+{
+	return syscall(SYS_SCHED_SETAFFINITY, pid, cpusetsize, mask);
+}
+
+int __cpu_count(size_t cpusetsize, const cpu_set_t* set)
+{
+	int count = 0;
+	for (size_t i = 0; i < cpusetsize / sizeof(unsigned long); i++)
+		count += __builtin_popcountl(set->__bits[i]);
+	return count;
+}
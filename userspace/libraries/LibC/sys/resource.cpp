@@ -6,6 +6,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 int getrlimit(int resource, struct rlimit* rlp)
 {
@@ -71,14 +73,14 @@ int setrlimit(int resource, const struct rlimit* rlp)
 
 int getpriority(int which, id_t who)
 {
-	dwarnln("TODO: getpriority({}, {}, {})", which, who);
-	errno = ENOTSUP;
-	return -1;
+	// kernel returns nice + 20, so valid values are never negative
+	const long ret = syscall(SYS_GETPRIORITY, which, who);
+	if (ret == -1)
+		return -1;
+	return ret - 20;
 }
 
 int setpriority(int which, id_t who, int value)
 {
-	dwarnln("TODO: setpriority({}, {}, {})", which, who, value);
-	errno = ENOTSUP;
-	return -1;
+	return syscall(SYS_SETPRIORITY, which, who, value);
 }
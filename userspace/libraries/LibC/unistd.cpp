@@ -21,6 +21,7 @@
 #include <string.h>
 #include <sys/banan-os.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -112,6 +113,7 @@ extern "C" void _init_libc(char** environ, init_funcs_t init_funcs, init_funcs_t
 			.cancel_type = PTHREAD_CANCEL_DEFERRED,
 			.cancel_state = PTHREAD_CANCEL_ENABLE,
 			.canceled = false,
+			.malloc_cache = nullptr,
 			.specific_keys = {},
 			.specific_values = {},
 			.dtv = { 0 },
@@ -736,9 +738,19 @@ int lockf(int fildes, int function, off_t size)
 
 int nice(int incr)
 {
-	dwarnln("TODO: nice({})", incr);
-	errno = EPERM;
-	return -1;
+	errno = 0;
+	const int current = getpriority(PRIO_PROCESS, 0);
+	if (current == -1 && errno)
+		return -1;
+
+	if (setpriority(PRIO_PROCESS, 0, current + incr) == -1)
+	{
+		if (errno == EACCES)
+			errno = EPERM;
+		return -1;
+	}
+
+	return getpriority(PRIO_PROCESS, 0);
 }
 
 char* crypt(const char* key, const char* salt)
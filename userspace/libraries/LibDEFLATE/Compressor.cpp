@@ -4,8 +4,10 @@
 #include <BAN/Array.h>
 #include <BAN/Heap.h>
 #include <BAN/Optional.h>
+#include <BAN/ScopeGuard.h>
 #include <BAN/Sort.h>
 
+#include <string.h>
 #include <time.h>
 
 namespace LibDEFLATE
@@ -17,13 +19,96 @@ namespace LibDEFLATE
 	constexpr size_t s_max_symbols = 288;
 	constexpr uint8_t s_max_bits = 15;
 
+	constexpr uint32_t s_min_length = 3;
+	constexpr uint32_t s_window_size = 32768;
+	constexpr uint32_t s_window_mask = s_window_size - 1;
+
+	// enough lookahead for a maximum length match and the next hash
+	constexpr uint32_t s_min_lookahead = s_max_length + s_min_length + 1;
+	constexpr uint32_t s_max_window_distance = s_window_size - s_min_lookahead;
+
+	// length 3 matches farther than this are not worth it
+	constexpr uint32_t s_too_far = 4096;
+
+	constexpr uint32_t s_hash_bits = 15;
+	constexpr uint32_t s_hash_size = 1 << s_hash_bits;
+
+	constexpr size_t s_max_block_entries = 16 * 1024;
+	constexpr size_t s_max_stored_block_size = 65535;
+
+	struct LevelConfig
+	{
+		uint16_t good_length; // reduce lazy search above this match length
+		uint16_t max_lazy;    // do not perform lazy search above this match length
+		uint16_t nice_length; // quit search above this match length
+		uint16_t max_chain;
+	};
+
+	// same tuning as zlib
+	static constexpr LevelConfig s_level_configs[] {
+		{  0,   0,   0,    0 },
+		{  4,   4,   8,    4 },
+		{  4,   5,  16,    8 },
+		{  4,   6,  32,   32 },
+		{  4,   4,  16,   16 },
+		{  8,  16,  32,   32 },
+		{  8,  16, 128,  128 },
+		{  8,  32, 128,  256 },
+		{ 32, 128, 258, 1024 },
+		{ 32, 258, 258, 4096 },
+	};
+
 	struct Leaf
 	{
 		uint16_t code;
 		uint8_t length;
 	};
 
-	static BAN::ErrorOr<void> create_huffman_tree(BAN::Span<const size_t> freq, BAN::Span<Leaf> output)
+	// assigns canonical codes to leaves with lengths set, codes are stored bit reversed
+	static constexpr void assign_codes(Leaf* leaves, size_t count)
+	{
+		uint16_t bl_count[s_max_bits + 1] {};
+		for (size_t sym = 0; sym < count; sym++)
+			if (leaves[sym].length)
+				bl_count[leaves[sym].length]++;
+
+		uint16_t next_code[s_max_bits + 1] {};
+		uint16_t code = 0;
+		for (uint8_t bits = 1; bits <= s_max_bits; bits++)
+		{
+			code = (code + bl_count[bits - 1]) << 1;
+			next_code[bits] = code;
+		}
+
+		for (size_t sym = 0; sym < count; sym++)
+			if (const uint16_t len = leaves[sym].length)
+				leaves[sym].code = reverse_bits(next_code[len]++, len);
+	}
+
+	struct fixed_trees_t
+	{
+		consteval fixed_trees_t()
+		{
+			for (size_t sym = 0; sym < 288; sym++)
+			{
+				uint8_t length = 8;
+				if (144 <= sym && sym < 256)
+					length = 9;
+				else if (256 <= sym && sym < 280)
+					length = 7;
+				lit_len[sym] = { .code = 0, .length = length };
+			}
+			for (size_t sym = 0; sym < 30; sym++)
+				dist[sym] = { .code = 0, .length = 5 };
+			assign_codes(lit_len, 288);
+			assign_codes(dist, 30);
+		}
+		Leaf lit_len[288];
+		Leaf dist[30];
+	};
+	static constexpr fixed_trees_t s_fixed_trees;
+
+	static BAN::ErrorOr<void> create_huffman_tree(BAN::Span<const size_t> freq, BAN::Span<Leaf> output, uint8_t max_bits = s_max_bits)
 	{
 		ASSERT(freq.size() <= s_max_symbols);
 		ASSERT(freq.size() == output.size());
@@ -72,6 +157,14 @@ namespace LibDEFLATE
 			return {};
 		}
 
+		if (node_count == 1)
+		{
+			// a single symbol still needs a one bit code
+			output[nodes[0]->symbol] = { .code = 0, .length = 1 };
+			BAN::deallocator(nodes[0]);
+			return {};
+		}
+
 		static void (*free_tree)(node_t*) =
 			[](node_t* root) -> void {
 				if (root == nullptr)
@@ -118,22 +211,22 @@ namespace LibDEFLATE
 			BAN::push_heap(nodes.begin(), end_it, comp);
 		}
 
-		static uint16_t (*gather_lengths)(const node_t*, BAN::Span<Leaf>, uint16_t) =
-			[](const node_t* node, BAN::Span<Leaf> symbols, uint16_t depth) -> uint16_t {
+		static uint16_t (*gather_lengths)(const node_t*, BAN::Span<Leaf>, uint16_t, uint8_t) =
+			[](const node_t* node, BAN::Span<Leaf> symbols, uint16_t depth, uint8_t max_bits) -> uint16_t {
 				if (node == nullptr)
 					return 0;
-				uint16_t count = (depth > s_max_bits);
+				uint16_t count = (depth > max_bits);
 				if (node->left == nullptr && node->right == nullptr)
-					symbols[node->symbol].length = BAN::Math::min<uint16_t>(depth, s_max_bits);
+					symbols[node->symbol].length = BAN::Math::min<uint16_t>(depth, max_bits);
 				else
 				{
-					count += gather_lengths(node->left,  symbols, depth + 1);
-					count += gather_lengths(node->right, symbols, depth + 1);
+					count += gather_lengths(node->left,  symbols, depth + 1, max_bits);
+					count += gather_lengths(node->right, symbols, depth + 1, max_bits);
 				}
 				return count;
 			};
 
-		const auto too_long_count = gather_lengths(nodes[0], output, 0);
+		const auto too_long_count = gather_lengths(nodes[0], output, 0, max_bits);
 		free_tree(nodes[0]);
 
 		uint16_t bl_count[s_max_bits + 1] {};
@@ -145,12 +238,12 @@ namespace LibDEFLATE
 		{
 			for (size_t i = 0; i < too_long_count / 2; i++)
 			{
-				uint16_t bits = s_max_bits - 1;
+				uint16_t bits = max_bits - 1;
 				while (bl_count[bits] == 0)
 					bits--;
 				bl_count[bits + 0]--;
 				bl_count[bits + 1] += 2;
-				bl_count[s_max_bits]--;
+				bl_count[max_bits]--;
 			}
 
 			struct SymFreq
@@ -169,23 +262,13 @@ namespace LibDEFLATE
 			);
 
 			size_t index = 0;
-			for (uint16_t bits = s_max_bits; bits > 0; bits--)
+			for (uint16_t bits = max_bits; bits > 0; bits--)
 				for (size_t i = 0; i < bl_count[bits]; i++)
 					output[sym_freq[index++].symbol].length = bits;
 			ASSERT(index == sym_freq.size());
 		}
 
-		uint16_t next_code[s_max_bits + 1] {};
-		uint16_t code = 0;
-		for (uint8_t bits = 1; bits <= s_max_bits; bits++)
-		{
-			code = (code + bl_count[bits - 1]) << 1;
-			next_code[bits] = code;
-		}
-
-		for (size_t sym = 0; sym < freq.size(); sym++)
-			if (const uint16_t len = output[sym].length)
-				output[sym].code = next_code[len]++;
+		assign_codes(output.data(), output.size());
 
 		return {};
 	}
@@ -201,48 +284,37 @@ namespace LibDEFLATE
 	{
 		ASSERT(3 <= length && length <= s_max_length);
 
-		constexpr uint16_t base[] {
-			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
-		};
-		constexpr uint8_t extra_bits[] {
-			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
-		};
-		constexpr size_t count = sizeof(base) / sizeof(*base);
+		if (length == s_max_length)
+			return { .symbol = 285 };
 
-		for (size_t i = 0;; i++)
-		{
-			if (i + 1 < count && length >= base[i + 1])
-				continue;
-			return {
-				.symbol = static_cast<uint16_t>(257 + i),
-				.extra_data = static_cast<uint16_t>(length - base[i]),
-				.extra_len = extra_bits[i],
-			};
-		}
+		// codes 257-264 have no extra bits, after that every four codes add one extra bit
+		const uint16_t value = length - 3;
+		if (value < 8)
+			return { .symbol = static_cast<uint16_t>(257 + value) };
+
+		const uint8_t extra_len = BAN::Math::ilog2<uint32_t>(value) - 2;
+		return {
+			.symbol = static_cast<uint16_t>(257 + 4 * (extra_len + 1) + ((value >> extra_len) & 3)),
+			.extra_data = static_cast<uint16_t>(value & ((1 << extra_len) - 1)),
+			.extra_len = extra_len,
+		};
 	}
 
 	static constexpr Encoding get_dist_encoding(uint16_t distance)
 	{
 		ASSERT(1 <= distance && distance <= s_max_distance);
 
-		constexpr uint16_t base[] {
-			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
-		};
-		constexpr uint8_t extra_bits[] {
-			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
-		};
-		constexpr size_t count = sizeof(base) / sizeof(*base);
+		// codes 0-3 have no extra bits, after that every two codes add one extra bit
+		const uint16_t value = distance - 1;
+		if (value < 4)
+			return { .symbol = value };
 
-		for (size_t i = 0;; i++)
-		{
-			if (i + 1 < count && distance >= base[i + 1])
-				continue;
-			return {
-				.symbol = static_cast<uint16_t>(i),
-				.extra_data = static_cast<uint16_t>(distance - base[i]),
-				.extra_len = extra_bits[i],
-			};
-		}
+		const uint8_t extra_len = BAN::Math::ilog2<uint32_t>(value) - 1;
+		return {
+			.symbol = static_cast<uint16_t>(2 * (extra_len + 1) + ((value >> extra_len) & 1)),
+			.extra_data = static_cast<uint16_t>(value & ((1 << extra_len) - 1)),
+			.extra_len = extra_len,
+		};
 	}
 
 	static void get_frequencies(BAN::Span<const Compressor::LZ77Entry> entries, BAN::Span<size_t> lit_len_freq, BAN::Span<size_t> dist_freq)
@@ -354,7 +426,8 @@ namespace LibDEFLATE
 		BAN::Array<size_t, 19> code_len_freq(0);
 		for (auto entry : result.encoding)
 			code_len_freq[entry.symbol]++;
-		TRY(create_huffman_tree(code_len_freq.span(), result.code_length_tree.span()));
+		// code length code lengths are written with 3 bits
+		TRY(create_huffman_tree(code_len_freq.span(), result.code_length_tree.span(), 7));
 
 		constexpr uint8_t code_length_order[] {
 			16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
@@ -368,286 +441,617 @@ namespace LibDEFLATE
 		return BAN::move(result);
 	}
 
-	uint32_t Compressor::get_hash_key(BAN::ConstByteSpan needle) const
+	static BAN::ErrorOr<void> write_symbol(BitOutputStream& stream, Leaf symbol)
 	{
-		ASSERT(needle.size() >= 3);
-		return (needle[2] << 16) | (needle[1] << 8) | needle[0];
+		return stream.write_bits(symbol.code, symbol.length);
 	}
 
-	BAN::ErrorOr<void> Compressor::update_hash_chain(size_t count)
+	static BAN::ErrorOr<void> write_entries(BitOutputStream& stream, BAN::Span<const Compressor::LZ77Entry> entries, BAN::Span<const Leaf> lit_len_tree, BAN::Span<const Leaf> dist_tree)
 	{
-		if (m_hash_chain.size() >= s_max_distance * 2)
+		for (const auto entry : entries)
 		{
-			const uint8_t* current = m_data.data() + m_hash_chain_index + count;
-			for (auto& [_, chain] : m_hash_chain)
+			switch (entry.type)
 			{
-				for (auto it = chain.begin(); it != chain.end(); it++)
+				case Compressor::LZ77Entry::Type::Literal:
+					TRY(write_symbol(stream, lit_len_tree[entry.as.literal]));
+					break;
+				case Compressor::LZ77Entry::Type::DistLength:
 				{
-					const size_t distance = current - it->data();
-					if (distance < s_max_distance)
-						continue;
+					const auto len_encoding = get_len_encoding(entry.as.dist_length.length);
+					TRY(write_symbol(stream, lit_len_tree[len_encoding.symbol]));
+					TRY(stream.write_bits(len_encoding.extra_data, len_encoding.extra_len));
+
+					const auto dist_encoding = get_dist_encoding(entry.as.dist_length.distance);
+					TRY(write_symbol(stream, dist_tree[dist_encoding.symbol]));
+					TRY(stream.write_bits(dist_encoding.extra_data, dist_encoding.extra_len));
 
-					while (it != chain.end())
-						it = chain.remove(it);
 					break;
 				}
 			}
 		}
 
-		for (size_t i = 0; i < count; i++)
+		TRY(write_symbol(stream, lit_len_tree[256]));
+
+		return {};
+	}
+
+	static size_t get_tree_cost(BAN::Span<const size_t> freq, BAN::Span<const Leaf> tree)
+	{
+		size_t cost = 0;
+		for (size_t sym = 0; sym < freq.size(); sym++)
+			cost += freq[sym] * tree[sym].length;
+		return cost;
+	}
+
+	static size_t get_extra_bits_cost(BAN::Span<const size_t> lit_len_freq, BAN::Span<const size_t> dist_freq)
+	{
+		constexpr uint8_t len_extra_bits[] {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+
+		size_t cost = 0;
+		for (size_t sym = 257; sym < 286; sym++)
+			cost += lit_len_freq[sym] * len_extra_bits[sym - 257];
+		for (size_t sym = 4; sym < 30; sym++)
+			cost += dist_freq[sym] * (sym / 2 - 1);
+		return cost;
+	}
+
+	BAN::ErrorOr<void> Compressor::initialize()
+	{
+		TRY(m_window.resize(2 * s_window_size, 0));
+		TRY(m_head.resize(s_hash_size, 0));
+		TRY(m_prev.resize(s_window_size, 0));
+		TRY(m_entries.reserve(s_max_block_entries));
+
+		m_strstart = 0;
+		m_lookahead = 0;
+		m_match_start = 0;
+		m_match_length = s_min_length - 1;
+		m_match_available = false;
+		m_block_start = 0;
+		m_block_bytes = 0;
+		m_total_in = 0;
+
+		switch (m_type)
 		{
-			auto slice = m_data.slice(m_hash_chain_index + i);
-			if (slice.size() < 3)
+			case StreamType::Raw:
+				m_checksum = 0;
 				break;
+			case StreamType::Zlib:
+				m_checksum = 1;
+				break;
+			case StreamType::GZip:
+				m_checksum = 0;
+				break;
+		}
 
-			const uint32_t key = get_hash_key(slice);
+		return {};
+	}
 
-			auto it = m_hash_chain.find(key);
-			if (it != m_hash_chain.end())
-				TRY(it->value.insert(it->value.begin(), slice));
-			else
+	BAN::ErrorOr<void> Compressor::write_header()
+	{
+		switch (m_type)
+		{
+			case StreamType::Raw:
+				break;
+			case StreamType::Zlib:
 			{
-				HashChain new_chain;
-				TRY(new_chain.push_back(slice));
-				TRY(m_hash_chain.insert(key, BAN::move(new_chain)));
+				uint8_t flevel = 2;
+				if (m_level <= 1)
+					flevel = 0;
+				else if (m_level <= 5)
+					flevel = 1;
+				else if (m_level >= 7)
+					flevel = 3;
+
+				const uint8_t cmf = 0x78; // deflate with 32k window
+				uint8_t flg = flevel << 6;
+				flg += 31 - ((cmf << 8) | flg) % 31;
+
+				TRY(m_stream.write_bits(cmf, 8));
+				TRY(m_stream.write_bits(flg, 8));
+				break;
+			}
+			case StreamType::GZip:
+			{
+#if __is_kernel
+				const time_t current_time = 0;
+#else
+				const time_t current_time = time(nullptr);
+#endif
+				uint8_t xfl = 0;
+				if (m_level == max_level)
+					xfl = 2;
+				else if (m_level <= 1)
+					xfl = 4;
+
+				TRY(m_stream.write_bits(0x1F, 8)); // ID1
+				TRY(m_stream.write_bits(0x8B, 8)); // ID2
+				TRY(m_stream.write_bits(8,    8)); // CM (deflate)
+				TRY(m_stream.write_bits(0,    8)); // FLG
+				TRY(m_stream.write_bits(current_time >>  0, 8)); // MTIME
+				TRY(m_stream.write_bits(current_time >>  8, 8));
+				TRY(m_stream.write_bits(current_time >> 16, 8));
+				TRY(m_stream.write_bits(current_time >> 24, 8));
+				TRY(m_stream.write_bits(xfl,  8)); // XFL
+				TRY(m_stream.write_bits(3,    8)); // OS (Unix)
+				break;
 			}
 		}
 
-		m_hash_chain_index += count;
+		return {};
+	}
+
+	BAN::ErrorOr<void> Compressor::write_footer()
+	{
+		TRY(m_stream.pad_to_byte_boundary());
+
+		switch (m_type)
+		{
+			case StreamType::Raw:
+				break;
+			case StreamType::Zlib:
+				TRY(m_stream.write_bits(m_checksum >> 24, 8));
+				TRY(m_stream.write_bits(m_checksum >> 16, 8));
+				TRY(m_stream.write_bits(m_checksum >>  8, 8));
+				TRY(m_stream.write_bits(m_checksum >>  0, 8));
+				break;
+			case StreamType::GZip:
+				TRY(m_stream.write_bits(m_checksum >>  0, 8));
+				TRY(m_stream.write_bits(m_checksum >>  8, 8));
+				TRY(m_stream.write_bits(m_checksum >> 16, 8));
+				TRY(m_stream.write_bits(m_checksum >> 24, 8));
+				TRY(m_stream.write_bits(m_total_in >>  0, 8));
+				TRY(m_stream.write_bits(m_total_in >>  8, 8));
+				TRY(m_stream.write_bits(m_total_in >> 16, 8));
+				TRY(m_stream.write_bits(m_total_in >> 24, 8));
+				break;
+		}
 
 		return {};
 	}
 
-	BAN::ErrorOr<Compressor::LZ77Entry> Compressor::find_longest_match(BAN::ConstByteSpan needle) const
+	void Compressor::update_checksum(BAN::ConstByteSpan data)
 	{
-		LZ77Entry result = {
-			.type = LZ77Entry::Type::Literal,
-			.as = { .literal = needle[0] }
-		};
+		switch (m_type)
+		{
+			case StreamType::Raw:
+				break;
+			case StreamType::Zlib:
+				m_checksum = calculate_adler32(data, m_checksum);
+				break;
+			case StreamType::GZip:
+				m_checksum = calculate_crc32(data, m_checksum);
+				break;
+		}
+	}
+
+	BAN::ErrorOr<size_t> Compressor::fill_window(BAN::ConstByteSpan input)
+	{
+		if (m_strstart >= s_window_size + s_max_window_distance)
+		{
+			// current block has to be written before its data is slid out of the window
+			if (m_block_start < s_window_size)
+				TRY(flush_block(false));
+			slide_window();
+		}
+
+		const uint32_t window_end = m_strstart + m_lookahead;
+		const size_t count = BAN::Math::min<size_t>(input.size(), m_window.size() - window_end);
+		if (count == 0)
+			return 0;
+
+		memcpy(m_window.data() + window_end, input.data(), count);
+		update_checksum(input.slice(0, count));
+		m_total_in += count;
+		m_lookahead += count;
 
-		if (needle.size() < 3)
-			return result;
+		return count;
+	}
+
+	void Compressor::slide_window()
+	{
+		ASSERT(m_block_start >= s_window_size);
 
-		const uint32_t key = get_hash_key(needle);
+		memcpy(m_window.data(), m_window.data() + s_window_size, s_window_size);
+		m_match_start -= s_window_size;
+		m_strstart -= s_window_size;
+		m_block_start -= s_window_size;
+
+		for (auto& pos : m_head)
+			pos = (pos >= s_window_size) ? pos - s_window_size : 0;
+		for (auto& pos : m_prev)
+			pos = (pos >= s_window_size) ? pos - s_window_size : 0;
+	}
 
-		auto it = m_hash_chain.find(key);
-		if (it == m_hash_chain.end())
-			return result;
+	uint32_t Compressor::insert_string(uint32_t position)
+	{
+		const uint32_t key = (m_window[position] << 16) | (m_window[position + 1] << 8) | m_window[position + 2];
+		const uint32_t hash = (key * 0x9E3779B1) >> (32 - s_hash_bits);
+
+		const uint32_t head = m_head[hash];
+		m_prev[position & s_window_mask] = head;
+		m_head[hash] = position;
+
+		return head;
+	}
 
-		auto& chain = it->value;
-		for (const auto node : chain)
+	static uint32_t get_common_length(const uint8_t* lhs, const uint8_t* rhs, uint32_t length, uint32_t max_length)
+	{
+		// compare 8 bytes at a time, first differing byte is the lowest set byte of xor
+		while (length + sizeof(uint64_t) <= max_length)
 		{
-			const size_t distance = needle.data() - node.data();
-			if (distance > s_max_distance)
-				break;
+			uint64_t lhs_word, rhs_word;
+			memcpy(&lhs_word, lhs + length, sizeof(uint64_t));
+			memcpy(&rhs_word, rhs + length, sizeof(uint64_t));
+			if (lhs_word != rhs_word)
+				return length + __builtin_ctzll(lhs_word ^ rhs_word) / 8;
+			length += sizeof(uint64_t);
+		}
+
+		while (length < max_length && lhs[length] == rhs[length])
+			length++;
+
+		return length;
+	}
+
+	uint32_t Compressor::longest_match(uint32_t cur_match, uint32_t prev_length)
+	{
+		const auto& config = s_level_configs[m_level];
+
+		const uint32_t max_length = BAN::Math::min<uint32_t>(m_lookahead, s_max_length);
+		if (prev_length >= max_length)
+			return prev_length;
 
-			size_t length = 3;
-			const size_t max_length = BAN::Math::min(needle.size(), s_max_length);
-			while (length < max_length && needle[length] == node[length])
-				length++;
+		uint32_t chain_length = config.max_chain;
+		if (prev_length >= config.good_length)
+			chain_length >>= 2;
 
-			if (result.type != LZ77Entry::Type::DistLength || length > result.as.dist_length.length)
+		const uint32_t nice_length = BAN::Math::min<uint32_t>(config.nice_length, max_length);
+		const uint32_t limit = (m_strstart > s_max_window_distance) ? m_strstart - s_max_window_distance : 0;
+
+		const uint8_t* window = m_window.data();
+		const uint8_t* scan = window + m_strstart;
+
+		uint32_t best_length = prev_length;
+
+		do
+		{
+			const uint8_t* match = window + cur_match;
+			if (match[best_length] != scan[best_length] || match[0] != scan[0] || match[1] != scan[1])
+				continue;
+
+			const uint32_t length = get_common_length(scan, match, 2, max_length);
+			if (length > best_length)
 			{
-				result = LZ77Entry {
-					.type = LZ77Entry::Type::DistLength,
-					.as = {
-						.dist_length = {
-							.length = static_cast<uint16_t>(length),
-							.distance = static_cast<uint16_t>(distance),
-						}
-					}
-				};
+				m_match_start = cur_match;
+				best_length = length;
+				if (length >= nice_length)
+					break;
 			}
-		}
+		} while ((cur_match = m_prev[cur_match & s_window_mask]) > limit && --chain_length != 0);
+
+		return best_length;
+	}
+
+	BAN::ErrorOr<bool> Compressor::tally_literal(uint8_t literal)
+	{
+		TRY(m_entries.push_back({
+			.type = LZ77Entry::Type::Literal,
+			.as = { .literal = literal }
+		}));
+		m_block_bytes++;
+		return m_entries.size() >= s_max_block_entries;
+	}
+
+	BAN::ErrorOr<bool> Compressor::tally_match(uint32_t distance, uint32_t length)
+	{
+		TRY(m_entries.push_back({
+			.type = LZ77Entry::Type::DistLength,
+			.as = {
+				.dist_length = {
+					.length = static_cast<uint16_t>(length),
+					.distance = static_cast<uint16_t>(distance),
+				}
+			}
+		}));
+		m_block_bytes += length;
+		return m_entries.size() >= s_max_block_entries;
+	}
 
-		return result;
+	BAN::ErrorOr<bool> Compressor::deflate_stored(bool)
+	{
+		// data is written straight from the window when the block is flushed
+		m_strstart += m_lookahead;
+		m_block_bytes += m_lookahead;
+		m_lookahead = 0;
+		return false;
 	}
 
-	BAN::ErrorOr<BAN::Vector<Compressor::LZ77Entry>> Compressor::lz77_compress(BAN::ConstByteSpan data)
+	BAN::ErrorOr<bool> Compressor::deflate_lazy(bool finishing)
 	{
-		BAN::Vector<LZ77Entry> result;
+		const auto& config = s_level_configs[m_level];
 
-		size_t advance = 0;
-		for (size_t i = 0; i < data.size(); i += advance)
+		for (;;)
 		{
-			TRY(update_hash_chain(advance));
+			if (m_lookahead < s_min_lookahead && !finishing)
+				return false;
+			if (m_lookahead == 0)
+				break;
 
-			auto match = TRY(find_longest_match(data.slice(i)));
-			if (match.type == LZ77Entry::Type::Literal)
+			uint32_t hash_head = 0;
+			if (m_lookahead >= s_min_length)
+				hash_head = insert_string(m_strstart);
+
+			const uint32_t prev_length = m_match_length;
+			const uint32_t prev_match = m_match_start;
+			m_match_length = s_min_length - 1;
+
+			if (hash_head != 0 && prev_length < config.max_lazy && m_strstart - hash_head <= s_max_window_distance)
 			{
-				TRY(result.push_back(match));
-				advance = 1;
-				continue;
+				m_match_length = longest_match(hash_head, prev_length);
+				if (m_match_length == s_min_length && m_strstart - m_match_start > s_too_far)
+					m_match_length = s_min_length - 1;
 			}
 
-			ASSERT(match.type == LZ77Entry::Type::DistLength);
+			// previous match was at least as good as the current one, emit it
+			if (prev_length >= s_min_length && m_match_length <= prev_length)
+			{
+				const uint32_t max_insert = m_strstart + m_lookahead - s_min_length;
+				const bool flush = TRY(tally_match(m_strstart - 1 - prev_match, prev_length));
 
-			auto lazy_match = TRY(find_longest_match(data.slice(i + 1)));
-			if (lazy_match.type == LZ77Entry::Type::DistLength && lazy_match.as.dist_length.length > match.as.dist_length.length)
+				m_lookahead -= prev_length - 1;
+				for (uint32_t i = 0; i < prev_length - 2; i++)
+					if (++m_strstart <= max_insert)
+						insert_string(m_strstart);
+				m_strstart++;
+
+				m_match_available = false;
+				m_match_length = s_min_length - 1;
+
+				if (flush)
+				{
+					TRY(flush_block(false));
+					return true;
+				}
+			}
+			else if (m_match_available)
 			{
-				TRY(result.push_back({ .type = LZ77Entry::Type::Literal, .as = { .literal = data[i] }}));
-				TRY(result.push_back(lazy_match));
-				advance = 1 + lazy_match.as.dist_length.length;
+				const bool flush = TRY(tally_literal(m_window[m_strstart - 1]));
+				m_strstart++;
+				m_lookahead--;
+
+				if (flush)
+				{
+					TRY(flush_block(false));
+					return true;
+				}
 			}
 			else
 			{
-				TRY(result.push_back(match));
-				advance = match.as.dist_length.length;
+				m_match_available = true;
+				m_strstart++;
+				m_lookahead--;
 			}
 		}
 
-		return result;
+		if (m_match_available)
+		{
+			m_match_available = false;
+			if (TRY(tally_literal(m_window[m_strstart - 1])))
+			{
+				TRY(flush_block(false));
+				return true;
+			}
+		}
+
+		return false;
 	}
 
-	BAN::ErrorOr<void> Compressor::compress_block(BAN::ConstByteSpan data, bool final)
+	BAN::ErrorOr<void> Compressor::write_stored_block(BAN::ConstByteSpan data, bool final)
 	{
-		// FIXME: use fixed trees or uncompressed blocks
+		do
+		{
+			const uint16_t length = BAN::Math::min(data.size(), s_max_stored_block_size);
+			const bool last = (length == data.size());
+
+			TRY(m_stream.write_bits(final && last, 1));
+			TRY(m_stream.write_bits(0, 2));
+			TRY(m_stream.pad_to_byte_boundary());
+			TRY(m_stream.write_bits( length, 16));
+			TRY(m_stream.write_bits(~length, 16));
+			TRY(m_stream.write_bytes(data.slice(0, length)));
+
+			data = data.slice(length);
+		} while (!data.empty());
+
+		return {};
+	}
 
-		auto lz77_entries = TRY(lz77_compress(data));
+	BAN::ErrorOr<void> Compressor::flush_block(bool final)
+	{
+		const auto data = BAN::ConstByteSpan(m_window.data() + m_block_start, m_block_bytes);
 
+		if (m_level == 0)
+			TRY(write_stored_block(data, final));
+		else
+		{
 #if LIBDEFLATE_AVOID_STACK
-		BAN::Vector<size_t> lit_len_freq, dist_freq;
-		TRY(lit_len_freq.resize(286, 0));
-		TRY(dist_freq.resize(30, 0));
+			BAN::Vector<size_t> lit_len_freq, dist_freq;
+			TRY(lit_len_freq.resize(286, 0));
+			TRY(dist_freq.resize(30, 0));
 #else
-		BAN::Array<size_t, 286> lit_len_freq(0);
-		BAN::Array<size_t, 30> dist_freq(0);
+			BAN::Array<size_t, 286> lit_len_freq(0);
+			BAN::Array<size_t, 30> dist_freq(0);
 #endif
 
-		get_frequencies(lz77_entries.span(), lit_len_freq.span(), dist_freq.span());
+			get_frequencies(m_entries.span(), lit_len_freq.span(), dist_freq.span());
 
 #if LIBDEFLATE_AVOID_STACK
-		BAN::Vector<Leaf> lit_len_tree, dist_tree;
-		TRY(lit_len_tree.resize(286));
-		TRY(dist_tree.resize(30));
+			BAN::Vector<Leaf> lit_len_tree, dist_tree;
+			TRY(lit_len_tree.resize(286));
+			TRY(dist_tree.resize(30));
 #else
-		BAN::Array<Leaf, 286> lit_len_tree;
-		BAN::Array<Leaf, 30> dist_tree;
+			BAN::Array<Leaf, 286> lit_len_tree;
+			BAN::Array<Leaf, 30> dist_tree;
 #endif
 
-		TRY(create_huffman_tree(lit_len_freq.span(), lit_len_tree.span()));
-		TRY(create_huffman_tree(dist_freq.span(), dist_tree.span()));
+			TRY(create_huffman_tree(lit_len_freq.span(), lit_len_tree.span()));
+			TRY(create_huffman_tree(dist_freq.span(), dist_tree.span()));
 
-		auto info = TRY(build_code_length_info(lit_len_tree.span(), dist_tree.span()));
+			auto info = TRY(build_code_length_info(lit_len_tree.span(), dist_tree.span()));
 
-		TRY(m_stream.write_bits(final, 1));
-		TRY(m_stream.write_bits(2, 2));
+			const auto fixed_lit_len_tree = BAN::Span<const Leaf>(s_fixed_trees.lit_len, 288);
+			const auto fixed_dist_tree = BAN::Span<const Leaf>(s_fixed_trees.dist, 30);
 
-		TRY(m_stream.write_bits(info.hlit - 257, 5));
-		TRY(m_stream.write_bits(info.hdist - 1,  5));
-		TRY(m_stream.write_bits(info.hclen - 4,  4));
+			// sizes in bits, block headers included
+			const size_t extra_bits = get_extra_bits_cost(lit_len_freq.span(), dist_freq.span());
 
-		for (size_t i = 0; i < info.hclen; i++)
-			TRY(m_stream.write_bits(info.code_length[i], 3));
+			size_t dynamic_cost = 3 + 5 + 5 + 4 + info.hclen * 3 + extra_bits;
+			for (const auto entry : info.encoding)
+				dynamic_cost += info.code_length_tree[entry.symbol].length + entry.extra_len;
+			dynamic_cost += get_tree_cost(lit_len_freq.span(), lit_len_tree.span());
+			dynamic_cost += get_tree_cost(dist_freq.span(), dist_tree.span());
 
-		for (const auto entry : info.encoding)
-		{
-			const auto symbol = info.code_length_tree[entry.symbol];
-			TRY(m_stream.write_bits(reverse_bits(symbol.code, symbol.length), symbol.length));
-			TRY(m_stream.write_bits(entry.extra_data, entry.extra_len));
-		}
+			size_t fixed_cost = 3 + extra_bits;
+			fixed_cost += get_tree_cost(lit_len_freq.span(), fixed_lit_len_tree.slice(0, 286));
+			fixed_cost += get_tree_cost(dist_freq.span(), fixed_dist_tree);
 
-		for (const auto entry : lz77_entries)
-		{
-			switch (entry.type)
+			const size_t stored_blocks = BAN::Math::max<size_t>(1, BAN::Math::div_round_up<size_t>(data.size(), s_max_stored_block_size));
+			const size_t stored_cost = data.size() * 8 + stored_blocks * (3 + 7 + 32);
+
+			if (stored_cost <= fixed_cost && stored_cost <= dynamic_cost)
+				TRY(write_stored_block(data, final));
+			else if (fixed_cost <= dynamic_cost)
 			{
-				case LZ77Entry::Type::Literal:
-				{
-					const auto symbol = lit_len_tree[entry.as.literal];
-					TRY(m_stream.write_bits(reverse_bits(symbol.code, symbol.length), symbol.length));
-					break;
-				}
-				case LZ77Entry::Type::DistLength:
-				{
-					const auto len_encoding = get_len_encoding(entry.as.dist_length.length);
-					const auto len_code = lit_len_tree[len_encoding.symbol];
-					TRY(m_stream.write_bits(reverse_bits(len_code.code, len_code.length), len_code.length));
-					TRY(m_stream.write_bits(len_encoding.extra_data, len_encoding.extra_len));
+				TRY(m_stream.write_bits(final, 1));
+				TRY(m_stream.write_bits(1, 2));
+				TRY(write_entries(m_stream, m_entries.span(), fixed_lit_len_tree, fixed_dist_tree));
+			}
+			else
+			{
+				TRY(m_stream.write_bits(final, 1));
+				TRY(m_stream.write_bits(2, 2));
 
-					const auto dist_encoding = get_dist_encoding(entry.as.dist_length.distance);
-					const auto dist_code = dist_tree[dist_encoding.symbol];
-					TRY(m_stream.write_bits(reverse_bits(dist_code.code, dist_code.length), dist_code.length));
-					TRY(m_stream.write_bits(dist_encoding.extra_data, dist_encoding.extra_len));
+				TRY(m_stream.write_bits(info.hlit - 257, 5));
+				TRY(m_stream.write_bits(info.hdist - 1,  5));
+				TRY(m_stream.write_bits(info.hclen - 4,  4));
 
-					break;
+				for (size_t i = 0; i < info.hclen; i++)
+					TRY(m_stream.write_bits(info.code_length[i], 3));
+
+				for (const auto entry : info.encoding)
+				{
+					TRY(write_symbol(m_stream, info.code_length_tree[entry.symbol]));
+					TRY(m_stream.write_bits(entry.extra_data, entry.extra_len));
 				}
+
+				TRY(write_entries(m_stream, m_entries.span(), lit_len_tree.span(), dist_tree.span()));
 			}
 		}
 
-		const auto end_code = lit_len_tree[256];
-		TRY(m_stream.write_bits(reverse_bits(end_code.code, end_code.length), end_code.length));
+		MUST(m_entries.resize(0));
+		m_block_start += m_block_bytes;
+		m_block_bytes = 0;
 
 		return {};
 	}
 
-	BAN::ErrorOr<BAN::Vector<uint8_t>> Compressor::compress()
+	void Compressor::drain_output(BAN::ByteSpan& output)
 	{
-		const uint32_t data_size = m_data.size();
+		const auto written = m_stream.written_bytes();
+		const size_t count = BAN::Math::min(written.size() - m_output_offset, output.size());
+		if (count == 0)
+			return;
 
-		uint32_t checksum = 0;
-		switch (m_type)
+		memcpy(output.data(), written.data() + m_output_offset, count);
+		output = output.slice(count);
+		m_output_offset += count;
+
+		if (m_output_offset == written.size())
 		{
-			case StreamType::Raw:
-				break;
-			case StreamType::Zlib:
-				TRY(m_stream.write_bits(0x78, 8)); // deflate with 32k window
-				TRY(m_stream.write_bits(0x9C, 8)); // default compression
-				checksum = calculate_adler32(m_data);
-				break;
-			case StreamType::GZip:
-			{
-#if __is_kernel
-				const time_t current_time = 0;
-#else
-				const time_t current_time = time(nullptr);
-#endif
-				TRY(m_stream.write_bits(0x1F, 8)); // ID1
-				TRY(m_stream.write_bits(0x8B, 8)); // ID2
-				TRY(m_stream.write_bits(8,    8)); // CM (deflate)
-				TRY(m_stream.write_bits(0,    8)); // FLG
-				TRY(m_stream.write_bits(current_time >>  0, 8)); // MTIME
-				TRY(m_stream.write_bits(current_time >>  8, 8));
-				TRY(m_stream.write_bits(current_time >> 16, 8));
-				TRY(m_stream.write_bits(current_time >> 24, 8));
-				TRY(m_stream.write_bits(0,    8)); // XFL
-				TRY(m_stream.write_bits(3,    8)); // OS (Unix)
-				checksum = calculate_crc32(m_data);
-			}
+			m_stream.clear_written_bytes();
+			m_output_offset = 0;
 		}
+	}
 
-		constexpr size_t max_block_size = 16 * 1024;
-		while (!m_data.empty())
+	BAN::ErrorOr<Compressor::Status> Compressor::compress(BAN::ConstByteSpan input, size_t& input_consumed, BAN::ByteSpan output, size_t& output_produced, bool finish)
+	{
+		const size_t original_input_size = input.size();
+		const size_t original_output_size = output.size();
+		BAN::ScopeGuard _([&] {
+			input_consumed = original_input_size - input.size();
+			output_produced = original_output_size - output.size();
+		});
+
+		for (;;)
 		{
-			const size_t block_size = BAN::Math::min<size_t>(m_data.size(), max_block_size);
-			TRY(compress_block(m_data.slice(0, block_size), block_size == m_data.size()));
-			m_data = m_data.slice(block_size);
+			drain_output(output);
+			if (!m_stream.written_bytes().empty())
+				return Status::NeedMoreOutput;
+
+			switch (m_state)
+			{
+				case State::Header:
+					TRY(initialize());
+					TRY(write_header());
+					m_state = State::Data;
+					break;
+				case State::Data:
+				{
+					if (const size_t count = TRY(fill_window(input)))
+						input = input.slice(count);
+
+					// at most one block is generated before it is drained to the output
+					const bool finishing = finish && input.empty();
+					const bool flushed = (m_level == 0)
+						? TRY(deflate_stored(finishing))
+						: TRY(deflate_lazy(finishing));
+					if (flushed || !input.empty() || !m_stream.written_bytes().empty())
+						break;
+
+					if (!finishing)
+						return Status::NeedMoreInput;
+
+					TRY(flush_block(true));
+					TRY(write_footer());
+					m_state = State::Done;
+					break;
+				}
+				case State::Done:
+					return Status::Done;
+			}
 		}
+	}
 
-		TRY(m_stream.pad_to_byte_boundary());
+	BAN::ErrorOr<BAN::Vector<uint8_t>> Compressor::compress()
+	{
+		BAN::Vector<uint8_t> result;
+		TRY(result.resize(BAN::Math::max<size_t>(m_data.size() / 2, 64)));
 
-		switch (m_type)
+		size_t total_output_size = 0;
+		for (;;)
 		{
-			case StreamType::Raw:
-				break;
-			case StreamType::Zlib:
-				TRY(m_stream.write_bits(checksum >> 24, 8));
-				TRY(m_stream.write_bits(checksum >> 16, 8));
-				TRY(m_stream.write_bits(checksum >>  8, 8));
-				TRY(m_stream.write_bits(checksum >>  0, 8));
-				break;
-			case StreamType::GZip:
-				TRY(m_stream.write_bits(checksum >>  0, 8));
-				TRY(m_stream.write_bits(checksum >>  8, 8));
-				TRY(m_stream.write_bits(checksum >> 16, 8));
-				TRY(m_stream.write_bits(checksum >> 24, 8));
-				TRY(m_stream.write_bits(data_size >>  0, 8));
-				TRY(m_stream.write_bits(data_size >>  8, 8));
-				TRY(m_stream.write_bits(data_size >> 16, 8));
-				TRY(m_stream.write_bits(data_size >> 24, 8));
-				break;
-		}
+			size_t input_consumed, output_produced;
+			const auto status = TRY(compress(m_data, input_consumed, result.span().slice(total_output_size), output_produced, true));
+			if (input_consumed)
+				m_data = m_data.slice(input_consumed);
+			total_output_size += output_produced;
 
-		return m_stream.take_buffer();
+			switch (status)
+			{
+				case Status::Done:
+					TRY(result.resize(total_output_size));
+					(void)result.shrink_to_fit();
+					return result;
+				case Status::NeedMoreOutput:
+					TRY(result.resize(result.size() * 2));
+					break;
+				case Status::NeedMoreInput:
+					ASSERT_NOT_REACHED();
+			}
+		}
 	}
 
 }
@@ -22,26 +22,6 @@ namespace LibDEFLATE
 		};
 	};
 
-	struct crc32_table_t
-	{
-		consteval crc32_table_t()
-		{
-			for (uint32_t i = 0; i < 256; i++)
-			{
-				uint32_t crc32 = i;
-				for (size_t j = 0; j < 8; j++) {
-					if (crc32 & 1)
-						crc32 = (crc32 >> 1) ^ 0xEDB88320;
-					else
-						crc32 >>= 1;
-				}
-				table[i] = crc32;
-			}
-		}
-		uint32_t table[256];
-	};
-	static constexpr crc32_table_t s_crc32_table;
-
 	BAN::ErrorOr<uint16_t> Decompressor::read_symbol(const HuffmanTree& tree)
 	{
 		const uint8_t instant_bits = tree.instant_bits();
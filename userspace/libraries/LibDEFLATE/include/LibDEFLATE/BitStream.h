@@ -133,6 +133,26 @@ namespace LibDEFLATE
 			return {};
 		}
 
+		BAN::ErrorOr<void> write_bytes(BAN::ConstByteSpan data)
+		{
+			ASSERT(m_bit_buffer_len == 0);
+			const size_t old_size = m_data.size();
+			TRY(m_data.resize(old_size + data.size()));
+			memcpy(m_data.data() + old_size, data.data(), data.size());
+			return {};
+		}
+
+		// bytes that are complete, bits of a partial byte are kept in the bit buffer
+		BAN::ConstByteSpan written_bytes() const
+		{
+			return BAN::ConstByteSpan(m_data.data(), m_data.size());
+		}
+
+		void clear_written_bytes()
+		{
+			MUST(m_data.resize(0));
+		}
+
 		BAN::Vector<uint8_t> take_buffer()
 		{
 			ASSERT(m_bit_buffer_len == 0);
@@ -1,8 +1,7 @@
 #pragma once
 
 #include <BAN/ByteSpan.h>
-#include <BAN/HashMap.h>
-#include <BAN/LinkedList.h>
+#include <BAN/Math.h>
 #include <BAN/NoCopyMove.h>
 #include <BAN/Vector.h>
 
@@ -18,7 +17,12 @@ namespace LibDEFLATE
 		BAN_NON_MOVABLE(Compressor);
 
 	public:
-		using HashChain = BAN::LinkedList<BAN::ConstByteSpan>;
+		enum class Status
+		{
+			Done,
+			NeedMoreInput,
+			NeedMoreOutput,
+		};
 
 		struct LZ77Entry
 		{
@@ -38,30 +42,93 @@ namespace LibDEFLATE
 			} as;
 		};
 
+		// 0 only emits stored blocks, 9 gives the best compression
+		static constexpr int min_level = 0;
+		static constexpr int max_level = 9;
+		static constexpr int default_level = 6;
+
 	public:
-		Compressor(BAN::ConstByteSpan data, StreamType type)
+		Compressor(StreamType type, int level = default_level)
+			: m_type(type)
+			, m_level(BAN::Math::clamp(level, min_level, max_level))
+		{ }
+
+		Compressor(BAN::ConstByteSpan data, StreamType type, int level = default_level)
 			: m_type(type)
+			, m_level(BAN::Math::clamp(level, min_level, max_level))
 			, m_data(data)
 		{ }
 
+		// compress all of the data given in the constructor
 		BAN::ErrorOr<BAN::Vector<uint8_t>> compress();
 
+		// Compress as much of `input` into `output` as possible. Set `finish`
+		// once there is no more input after this call. After that `finish` has
+		// to stay set and any unconsumed input has to be passed again until
+		// Status::Done is returned.
+		BAN::ErrorOr<Status> compress(BAN::ConstByteSpan input, size_t& input_consumed, BAN::ByteSpan output, size_t& output_produced, bool finish);
+
 	private:
-		BAN::ErrorOr<void> compress_block(BAN::ConstByteSpan, bool final);
+		BAN::ErrorOr<void> initialize();
+
+		BAN::ErrorOr<void> write_header();
+		BAN::ErrorOr<void> write_footer();
+		void update_checksum(BAN::ConstByteSpan);
+
+		BAN::ErrorOr<size_t> fill_window(BAN::ConstByteSpan input);
+		void slide_window();
+
+		uint32_t insert_string(uint32_t position);
+		uint32_t longest_match(uint32_t cur_match, uint32_t prev_length);
 
-		uint32_t get_hash_key(BAN::ConstByteSpan needle) const;
-		BAN::ErrorOr<void> update_hash_chain(size_t count);
+		// these return true if a block was flushed
+		BAN::ErrorOr<bool> deflate_stored(bool finishing);
+		BAN::ErrorOr<bool> deflate_lazy(bool finishing);
+		BAN::ErrorOr<bool> tally_literal(uint8_t literal);
+		BAN::ErrorOr<bool> tally_match(uint32_t distance, uint32_t length);
 
-		BAN::ErrorOr<LZ77Entry> find_longest_match(BAN::ConstByteSpan needle) const;
-		BAN::ErrorOr<BAN::Vector<LZ77Entry>> lz77_compress(BAN::ConstByteSpan data);
+		BAN::ErrorOr<void> flush_block(bool final);
+		BAN::ErrorOr<void> write_stored_block(BAN::ConstByteSpan data, bool final);
+
+		void drain_output(BAN::ByteSpan& output);
+
+	private:
+		enum class State
+		{
+			Header,
+			Data,
+			Done,
+		};
 
 	private:
 		const StreamType m_type;
+		const int m_level;
 		BAN::ConstByteSpan m_data;
 		BitOutputStream m_stream;
+		size_t m_output_offset { 0 };
+
+		State m_state { State::Header };
+
+		// two windows worth of data, slid down when the upper one is reached
+		BAN::Vector<uint8_t> m_window;
+		uint32_t m_strstart { 0 };
+		uint32_t m_lookahead { 0 };
+
+		// heads of hash chains and links to previous positions with the same hash, 0 terminates a chain
+		BAN::Vector<uint16_t> m_head;
+		BAN::Vector<uint16_t> m_prev;
+
+		uint32_t m_match_start { 0 };
+		uint32_t m_match_length { 0 };
+		bool m_match_available { false };
+
+		// current block, m_block_bytes bytes starting from m_block_start in the window
+		BAN::Vector<LZ77Entry> m_entries;
+		uint32_t m_block_start { 0 };
+		uint32_t m_block_bytes { 0 };
 
-		size_t m_hash_chain_index { 0 };
-		BAN::HashMap<uint32_t, HashChain> m_hash_chain;
+		uint32_t m_checksum { 0 };
+		uint32_t m_total_in { 0 };
 	};
 
 }
@@ -1,40 +1,62 @@
 #pragma once
 
 #include <BAN/ByteSpan.h>
+#include <BAN/Math.h>
 
 namespace LibDEFLATE
 {
 
-	inline uint32_t calculate_adler32(BAN::ConstByteSpan data)
+	struct crc32_table_t
 	{
-		uint32_t s1 = 1;
-		uint32_t s2 = 0;
-
-		for (size_t i = 0; i < data.size(); i++)
+		consteval crc32_table_t()
 		{
-			s1 = (s1 + data[i]) % 65521;
-			s2 = (s2 + s1)      % 65521;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc32 = i;
+				for (size_t j = 0; j < 8; j++) {
+					if (crc32 & 1)
+						crc32 = (crc32 >> 1) ^ 0xEDB88320;
+					else
+						crc32 >>= 1;
+				}
+				table[i] = crc32;
+			}
 		}
+		uint32_t table[256];
+	};
+	inline constexpr crc32_table_t s_crc32_table;
 
-		return (s2 << 16) | s1;
-	}
-
-	inline uint32_t calculate_crc32(BAN::ConstByteSpan data)
+	// pass previous return value as `adler32` to continue a checksum
+	inline uint32_t calculate_adler32(BAN::ConstByteSpan data, uint32_t adler32 = 1)
 	{
-		uint32_t crc32 = 0xFFFFFFFF;
-		uint32_t polynomial = 0xEDB88320;
+		uint32_t s1 = adler32 & 0xFFFF;
+		uint32_t s2 = adler32 >> 16;
 
-		for (size_t i = 0; i < data.size(); i++) {
-			crc32 ^= data[i];
+		// largest n such that sums can't overflow before taking the modulo
+		constexpr size_t max_run = 5552;
 
-			for (size_t j = 0; j < 8; j++) {
-				if (crc32 & 1)
-					crc32 = (crc32 >> 1) ^ polynomial;
-				else
-					crc32 >>= 1;
+		while (!data.empty())
+		{
+			const size_t count = BAN::Math::min(data.size(), max_run);
+			for (size_t i = 0; i < count; i++)
+			{
+				s1 += data[i];
+				s2 += s1;
 			}
+			s1 %= 65521;
+			s2 %= 65521;
+			data = data.slice(count);
 		}
 
+		return (s2 << 16) | s1;
+	}
+
+	// pass previous return value as `crc32` to continue a checksum
+	inline uint32_t calculate_crc32(BAN::ConstByteSpan data, uint32_t crc32 = 0)
+	{
+		crc32 = ~crc32;
+		for (size_t i = 0; i < data.size(); i++)
+			crc32 = (crc32 >> 8) ^ s_crc32_table.table[(crc32 ^ data[i]) & 0xFF];
 		return ~crc32;
 	}
 
@@ -176,6 +176,7 @@ namespace LibELF
 		DT_INIT_ARRAYSZ	= 27,
 		DT_FINI_ARRAYSZ	= 28,
 		DT_LOOS			= 0x60000000,
+		DT_GNU_HASH		= 0x6FFFFEF5,
 		DT_HIOS			= 0x6FFFFFFF,
 		DT_LOPROC		= 0x70000000,
 		DT_HIPROC		= 0x7FFFFFFF,
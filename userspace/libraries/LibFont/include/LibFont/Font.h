@@ -1,5 +1,6 @@
 #pragma once
 
+#include <BAN/Array.h>
 #include <BAN/ByteSpan.h>
 #include <BAN/HashMap.h>
 #include <BAN/StringView.h>
@@ -18,7 +19,11 @@ namespace LibFont
 			, m_width(width)
 			, m_height(height)
 			, m_pitch(pitch)
-		{ }
+		{
+			for (const auto& [codepoint, offset] : m_glyph_offsets)
+				if (codepoint < m_dense_glyph_offsets.size())
+					m_dense_glyph_offsets[codepoint] = offset;
+		}
 
 		static BAN::ErrorOr<Font> load(BAN::StringView path);
 		static BAN::ErrorOr<Font> load(BAN::ConstByteSpan font_data);
@@ -33,6 +38,14 @@ namespace LibFont
 		bool has_glyph(uint32_t codepoint) const { return glyph(codepoint) != nullptr; }
 		const uint8_t* glyph(uint32_t codepoint) const
 		{
+			if (codepoint < m_dense_glyph_offsets.size())
+			{
+				const uint32_t offset = m_dense_glyph_offsets[codepoint];
+				if (offset == s_no_glyph)
+					return nullptr;
+				return m_glyph_data.data() + offset;
+			}
+
 			auto it = m_glyph_offsets.find(codepoint);
 			if (it == m_glyph_offsets.end())
 				return nullptr;
@@ -40,6 +53,10 @@ namespace LibFont
 		}
 
 	private:
+		static constexpr uint32_t s_no_glyph = UINT32_MAX;
+
+		// ASCII and Latin-1 glyphs are looked up without hashing
+		BAN::Array<uint32_t, 256> m_dense_glyph_offsets { s_no_glyph };
 		BAN::HashMap<uint32_t, uint32_t> m_glyph_offsets;
 		BAN::Vector<uint8_t> m_glyph_data;
 		uint32_t m_width = 0;
@@ -71,9 +71,13 @@ namespace LibGUI
 	{
 		if (!clamp_to_texture(x, y, width, height))
 			return;
+		// NOTE: clamp_to_texture already clamps to the clip area
 		for (uint32_t y_off = 0; y_off < height; y_off++)
+		{
+			uint32_t* row = &m_pixels[(y + y_off) * m_width + x];
 			for (uint32_t x_off = 0; x_off < width; x_off++)
-				set_pixel(x + x_off, y + y_off, color);
+				row[x_off] = color;
+		}
 	}
 
 	void Texture::copy_texture(const Texture& texture, int32_t x, int32_t y, uint32_t sub_x, uint32_t sub_y, uint32_t width, uint32_t height)
@@ -11,6 +11,7 @@
 #include <limits.h>
 #include <pthread.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
@@ -161,6 +162,7 @@ struct LoadedElf
 	uintptr_t base;
 
 	uintptr_t hash;
+	uintptr_t gnu_hash;
 
 	uintptr_t strtab;
 
@@ -205,6 +207,16 @@ struct LoadedElf
 	size_t real_symtab_entsize;
 	const uint8_t* real_symtab_addr;
 	const uint8_t* real_strtab_addr;
+
+	// page aligned part of PT_GNU_RELRO
+	uintptr_t relro_start;
+	uintptr_t relro_end;
+
+	uint64_t file_id;
+	uint64_t relocation_cache_key;
+	bool prelinked;
+	bool has_textrel;
+	bool relro_cached;
 };
 
 static constexpr size_t s_max_loaded_files = sizeof(uthread::dtv) / sizeof(*uthread::dtv) - 1;
@@ -221,6 +233,9 @@ static uint32_t s_global_lock_depth = 0;
 
 constexpr uintptr_t SYM_NOT_FOUND = -1;
 
+static int s_prelink_dirfd = -1;
+static uint64_t s_prelink_seed = 0;
+
 static void lock_global_lock()
 {
 	const pthread_t tid = syscall(SYS_PTHREAD_SELF);
@@ -244,6 +259,22 @@ static void unlock_global_lock()
 		s_global_locker.store(false);
 }
 
+static bool is_in_relro(const LoadedElf& elf, uintptr_t offset)
+{
+	const uintptr_t addr = elf.base + offset;
+	return elf.relro_start <= addr && addr < elf.relro_end;
+}
+
+static uint64_t fnv1a_hash(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001B3;
+	return hash;
+}
+
+static constexpr uint64_t s_fnv1a_offset = 0xCBF29CE484222325;
+
 static uint32_t elf_hash(const char* name)
 {
 	uint32_t h = 0, g;
@@ -257,18 +288,99 @@ static uint32_t elf_hash(const char* name)
 	return h;
 }
 
-static ElfNativeSymbol* find_symbol(const LoadedElf& elf, const char* name)
+static uint32_t gnu_hash(const char* name)
+{
+	uint32_t h = 5381;
+	while (*name)
+		h = (h << 5) + h + static_cast<uint8_t>(*name++);
+	return h;
+}
+
+struct SymbolName
+{
+	SymbolName(const char* name)
+		: name(name)
+		, gnu_hash(::gnu_hash(name))
+	{}
+
+	uint32_t elf_hash()
+	{
+		// elf_hash never sets the top nibble
+		if (m_elf_hash == 0xFFFFFFFF)
+			m_elf_hash = ::elf_hash(name);
+		return m_elf_hash;
+	}
+
+	const char* const name;
+	const uint32_t gnu_hash;
+
+private:
+	uint32_t m_elf_hash { 0xFFFFFFFF };
+};
+
+static ElfNativeSymbol* find_symbol_gnu_hash(const LoadedElf& elf, const SymbolName& name)
+{
+	constexpr uint32_t bloom_word_bits = sizeof(uintptr_t) * 8;
+
+	const uint32_t* hash_table = reinterpret_cast<uint32_t*>(elf.gnu_hash);
+	const uint32_t nbucket     = hash_table[0];
+	const uint32_t symoffset   = hash_table[1];
+	const uint32_t bloom_size  = hash_table[2];
+	const uint32_t bloom_shift = hash_table[3];
+	if (nbucket == 0 || bloom_size == 0)
+		return nullptr;
+
+	const uintptr_t* bloom = reinterpret_cast<const uintptr_t*>(hash_table + 4);
+	const uint32_t* buckets = reinterpret_cast<const uint32_t*>(bloom + bloom_size);
+	const uint32_t* chain = buckets + nbucket;
+
+	const uint32_t hash = name.gnu_hash;
+
+	// bloom filter rejects most of the lookups without touching the symbol table
+	const uintptr_t bloom_word = bloom[(hash / bloom_word_bits) % bloom_size];
+	const uintptr_t bloom_mask = (static_cast<uintptr_t>(1) << (hash % bloom_word_bits))
+	                           | (static_cast<uintptr_t>(1) << ((hash >> bloom_shift) % bloom_word_bits));
+	if ((bloom_word & bloom_mask) != bloom_mask)
+		return nullptr;
+
+	uint32_t entry = buckets[hash % nbucket];
+	if (entry < symoffset)
+		return nullptr;
+
+	for (;; entry++)
+	{
+		const uint32_t chain_hash = chain[entry - symoffset];
+
+		if ((hash | 1) == (chain_hash | 1))
+		{
+			auto& symbol = *reinterpret_cast<ElfNativeSymbol*>(elf.symtab + entry * elf.syment);
+			const char* symbol_name = reinterpret_cast<const char*>(elf.strtab + symbol.st_name);
+			if (symbol.st_shndx != 0 && strcmp(name.name, symbol_name) == 0)
+				return &symbol;
+		}
+
+		// lowest bit marks the end of the chain
+		if (chain_hash & 1)
+			break;
+	}
+
+	return nullptr;
+}
+
+static ElfNativeSymbol* find_symbol_sysv_hash(const LoadedElf& elf, SymbolName& name)
 {
 	const uint32_t* hash_table = reinterpret_cast<uint32_t*>(elf.hash);
 	const uint32_t nbucket = hash_table[0];
+	if (nbucket == 0)
+		return nullptr;
 
-	for (uint32_t entry = hash_table[2 + (elf_hash(name) % nbucket)]; entry; entry = hash_table[2 + nbucket + entry])
+	for (uint32_t entry = hash_table[2 + (name.elf_hash() % nbucket)]; entry; entry = hash_table[2 + nbucket + entry])
 	{
 		auto& symbol = *reinterpret_cast<ElfNativeSymbol*>(elf.symtab + entry * elf.syment);
 		if (symbol.st_shndx == 0)
 			continue;
 		const char* symbol_name = reinterpret_cast<const char*>(elf.strtab + symbol.st_name);
-		if (strcmp(name, symbol_name))
+		if (strcmp(name.name, symbol_name))
 			continue;
 		return &symbol;
 	}
@@ -276,6 +388,150 @@ static ElfNativeSymbol* find_symbol(const LoadedElf& elf, const char* name)
 	return nullptr;
 }
 
+static ElfNativeSymbol* find_symbol(const LoadedElf& elf, SymbolName& name)
+{
+	if (elf.gnu_hash)
+		return find_symbol_gnu_hash(elf, name);
+	if (elf.hash)
+		return find_symbol_sysv_hash(elf, name);
+	return nullptr;
+}
+
+static ElfNativeSymbol* find_symbol(const LoadedElf& elf, const char* name)
+{
+	SymbolName symbol_name(name);
+	return find_symbol(elf, symbol_name);
+}
+
+// Cache of symbols resolved through the global lookup scope. Only
+// strong definitions are cached: loading more objects can't override
+// them as new objects are always appended to the end of the scope.
+struct SymbolCacheEntry
+{
+	const char* name;
+	uint32_t hash;
+	const LoadedElf* elf;
+	const ElfNativeSymbol* symbol;
+};
+
+static SymbolCacheEntry* s_symbol_cache = nullptr;
+static size_t s_symbol_cache_capacity = 0;
+static size_t s_symbol_cache_size = 0;
+
+static const SymbolCacheEntry* symbol_cache_find(const SymbolName& name)
+{
+	if (s_symbol_cache_capacity == 0)
+		return nullptr;
+
+	const size_t mask = s_symbol_cache_capacity - 1;
+	for (size_t i = name.gnu_hash & mask;; i = (i + 1) & mask)
+	{
+		const auto& entry = s_symbol_cache[i];
+		if (entry.name == nullptr)
+			return nullptr;
+		if (entry.hash == name.gnu_hash && strcmp(entry.name, name.name) == 0)
+			return &entry;
+	}
+}
+
+static void symbol_cache_insert_no_grow(const SymbolCacheEntry& new_entry)
+{
+	const size_t mask = s_symbol_cache_capacity - 1;
+	for (size_t i = new_entry.hash & mask;; i = (i + 1) & mask)
+	{
+		if (s_symbol_cache[i].name != nullptr)
+			continue;
+		s_symbol_cache[i] = new_entry;
+		s_symbol_cache_size++;
+		return;
+	}
+}
+
+static void symbol_cache_insert(const SymbolName& name, const LoadedElf* elf, const ElfNativeSymbol* symbol)
+{
+	// keep load factor under 1/2
+	if ((s_symbol_cache_size + 1) * 2 > s_symbol_cache_capacity)
+	{
+		const size_t new_capacity = s_symbol_cache_capacity ? s_symbol_cache_capacity * 2 : 1024;
+
+		sys_mmap_t mmap_args;
+		mmap_args.addr = nullptr;
+		mmap_args.fildes = -1;
+		mmap_args.flags = MAP_ANONYMOUS | MAP_PRIVATE;
+		mmap_args.len = new_capacity * sizeof(SymbolCacheEntry);
+		mmap_args.off = 0;
+		mmap_args.prot = PROT_READ | PROT_WRITE;
+
+		// cache is only an optimization, just don't cache on failure
+		const auto uaddr = syscall(SYS_MMAP, &mmap_args);
+		if (uaddr < 0)
+			return;
+
+		auto* old_cache = s_symbol_cache;
+		const size_t old_capacity = s_symbol_cache_capacity;
+
+		s_symbol_cache = reinterpret_cast<SymbolCacheEntry*>(uaddr);
+		s_symbol_cache_capacity = new_capacity;
+		s_symbol_cache_size = 0;
+
+		for (size_t i = 0; i < old_capacity; i++)
+			if (old_cache[i].name != nullptr)
+				symbol_cache_insert_no_grow(old_cache[i]);
+
+		if (old_cache != nullptr)
+			syscall(SYS_MUNMAP, old_cache, old_capacity * sizeof(SymbolCacheEntry));
+	}
+
+	symbol_cache_insert_no_grow({
+		.name = name.name,
+		.hash = name.gnu_hash,
+		.elf = elf,
+		.symbol = symbol,
+	});
+}
+
+// finds definition of a symbol referenced by `elf` in the global scope
+static const ElfNativeSymbol* find_global_symbol(const LoadedElf& elf, const char* symbol_name, const LoadedElf** out_elf)
+{
+	SymbolName name(symbol_name);
+
+	if (const auto* entry = symbol_cache_find(name))
+	{
+		*out_elf = entry->elf;
+		return entry->symbol;
+	}
+
+	const ElfNativeSymbol* result = nullptr;
+	const LoadedElf* result_elf = nullptr;
+	bool skipped_local = false;
+
+	for (size_t i = 0; i < s_loaded_file_count; i++)
+	{
+		const auto* match = find_symbol(s_loaded_files[i], name);
+		if (match == nullptr)
+			continue;
+		if (ELF_ST_BIND(match->st_info) == STB_LOCAL && &s_loaded_files[i] != &elf)
+		{
+			skipped_local = true;
+			continue;
+		}
+		if (result == nullptr || ELF_ST_BIND(match->st_info) != STB_WEAK)
+		{
+			result = match;
+			result_elf = &s_loaded_files[i];
+		}
+		if (ELF_ST_BIND(match->st_info) != STB_WEAK)
+			break;
+	}
+
+	// result depends on the referencing object if locals were involved
+	if (result != nullptr && ELF_ST_BIND(result->st_info) == STB_GLOBAL && !skipped_local)
+		symbol_cache_insert(name, result_elf, result);
+
+	*out_elf = result_elf;
+	return result;
+}
+
 template<typename RelocT> requires BAN::is_same_v<RelocT, ElfNativeRelocation> || BAN::is_same_v<RelocT, ElfNativeRelocationA>
 static bool is_tls_relocation(const RelocT& reloc)
 {
@@ -341,6 +597,9 @@ static void handle_copy_relocation(const LoadedElf& elf, const RelocT& reloc)
 	if (!is_copy_relocation(reloc))
 		return;
 
+	if (elf.relro_cached && is_in_relro(elf, reloc.r_offset))
+		return;
+
 	const uint32_t symbol_index = ELF_R_SYM(reloc.r_info);
 	if (symbol_index == 0)
 		print_error_and_exit("copy relocation without a symbol", 0);
@@ -385,6 +644,9 @@ static void handle_tls_relocation(const LoadedElf& elf, const RelocT& reloc)
 	if (!is_tls_relocation(reloc))
 		return;
 
+	if (elf.relro_cached && is_in_relro(elf, reloc.r_offset))
+		return;
+
 	const LoadedElf* symbol_elf = &elf;
 	uintptr_t symbol_offset = 0;
 
@@ -397,22 +659,8 @@ static void handle_tls_relocation(const LoadedElf& elf, const RelocT& reloc)
 			symbol_offset = symbol.st_value;
 		else
 		{
-			symbol_elf = nullptr;
-			for (size_t i = 0; i < s_loaded_file_count; i++)
-			{
-				const auto* match = find_symbol(s_loaded_files[i], symbol_name);
-				if (match == nullptr)
-					continue;
-				if (ELF_ST_BIND(match->st_info) == STB_LOCAL && &s_loaded_files[i] != &elf)
-					continue;
-				if (symbol_elf == nullptr || ELF_ST_BIND(match->st_info) != STB_WEAK)
-				{
-					symbol_elf = &s_loaded_files[i];
-					symbol_offset = match->st_value;
-				}
-				if (ELF_ST_BIND(match->st_info) != STB_WEAK)
-					break;
-			}
+			if (const auto* match = find_global_symbol(elf, symbol_name, &symbol_elf))
+				symbol_offset = match->st_value;
 
 			if (symbol_elf == nullptr && ELF_ST_BIND(symbol.st_info) != STB_WEAK)
 			{
@@ -492,6 +740,10 @@ static uintptr_t handle_relocation(const LoadedElf& elf, const RelocT& reloc, bo
 	if (resolve_symbols == !symbol_index)
 		return 0;
 
+	// contents were mapped from relocation cache
+	if (elf.relro_cached && is_in_relro(elf, reloc.r_offset))
+		return 0;
+
 	uintptr_t symbol_address = 0;
 	if (symbol_index)
 	{
@@ -513,18 +765,9 @@ static uintptr_t handle_relocation(const LoadedElf& elf, const RelocT& reloc, bo
 		else
 		{
 			symbol_address = SYM_NOT_FOUND;
-			for (size_t i = 0; i < s_loaded_file_count; i++)
-			{
-				const auto* match = find_symbol(s_loaded_files[i], symbol_name);
-				if (match == nullptr)
-					continue;
-				if (ELF_ST_BIND(match->st_info) == STB_LOCAL && &s_loaded_files[i] != &elf)
-					continue;
-				if (symbol_address == SYM_NOT_FOUND || ELF_ST_BIND(match->st_info) != STB_WEAK)
-					symbol_address = s_loaded_files[i].base + match->st_value;
-				if (ELF_ST_BIND(match->st_info) != STB_WEAK)
-					break;
-			}
+			const LoadedElf* symbol_elf;
+			if (const auto* match = find_global_symbol(elf, symbol_name, &symbol_elf))
+				symbol_address = symbol_elf->base + match->st_value;
 
 			if (symbol_address == SYM_NOT_FOUND)
 			{
@@ -645,6 +888,258 @@ static uintptr_t handle_relocation(const LoadedElf& elf, const RelocT& reloc, bo
 	return value;
 }
 
+// Relocated RELRO pages of prelinked objects are stored in a per user
+// cache directory. Other processes that end up with the same objects
+// at the same addresses map the cached pages shared instead of doing
+// the relocations again.
+struct RelocationCacheHeader
+{
+	uint64_t magic;
+	uint64_t key;
+	uintptr_t base;
+	uintptr_t size;
+};
+
+static constexpr uint64_t s_relocation_cache_magic = 0x65686361636F6C72;
+
+static int open_prelink_directory()
+{
+	// setuid and setgid programs must not trust a cache writable by the invoking user
+	const long uid = syscall(SYS_GET_UID);
+	if (uid != syscall(SYS_GET_EUID))
+		return -1;
+	if (syscall(SYS_GET_GID) != syscall(SYS_GET_EGID))
+		return -1;
+
+	char path[32] = "/tmp/ld-cache-";
+	{
+		char* ptr = path + strlen(path);
+		char buffer[16];
+		size_t len = 0;
+		for (long val = uid; len == 0 || val; val /= 10)
+			buffer[len++] = '0' + val % 10;
+		while (len)
+			*ptr++ = buffer[--len];
+		*ptr = '\0';
+	}
+
+	if (auto ret = syscall(SYS_MKDIRAT, AT_FDCWD, path, 0700); ret < 0 && ret != -EEXIST)
+		return -1;
+
+	const int dirfd = syscall(SYS_OPENAT, AT_FDCWD, path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC, 0);
+	if (dirfd < 0)
+		return -1;
+
+	// anyone able to write here could inject code into our processes
+	struct stat st;
+	if (syscall(SYS_FSTATAT, dirfd, nullptr, &st, 0) < 0 || !S_ISDIR(st.st_mode) || st.st_uid != uid || (st.st_mode & 077))
+	{
+		syscall(SYS_CLOSE, dirfd);
+		return -1;
+	}
+
+	return dirfd;
+}
+
+static void init_prelink()
+{
+	const int dirfd = open_prelink_directory();
+	if (dirfd < 0)
+		return;
+
+	// seed is generated once per boot as /tmp lives in memory
+	int seed_fd = syscall(SYS_OPENAT, dirfd, "seed", O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (seed_fd >= 0)
+	{
+		const uint64_t seed = static_cast<uint64_t>(get_random_uptr()) | 1;
+		syscall(SYS_WRITE, seed_fd, &seed, sizeof(seed));
+		syscall(SYS_CLOSE, seed_fd);
+	}
+
+	seed_fd = syscall(SYS_OPENAT, dirfd, "seed", O_RDONLY | O_CLOEXEC, 0);
+	if (seed_fd >= 0)
+	{
+		if (syscall(SYS_READ, seed_fd, &s_prelink_seed, sizeof(s_prelink_seed)) != sizeof(s_prelink_seed))
+			s_prelink_seed = 0;
+		syscall(SYS_CLOSE, seed_fd);
+	}
+
+	if (s_prelink_seed == 0)
+	{
+		syscall(SYS_CLOSE, dirfd);
+		return;
+	}
+
+	s_prelink_dirfd = dirfd;
+}
+
+// cache directory is only kept open while loading, the program may reuse the fd number
+static bool reopen_prelink()
+{
+	if (s_prelink_seed == 0 || s_prelink_dirfd != -1)
+		return false;
+	s_prelink_dirfd = open_prelink_directory();
+	return s_prelink_dirfd != -1;
+}
+
+static void close_prelink()
+{
+	if (s_prelink_dirfd == -1)
+		return;
+	syscall(SYS_CLOSE, s_prelink_dirfd);
+	s_prelink_dirfd = -1;
+}
+
+static uintptr_t get_prelink_base(const char* path, uint64_t attempt)
+{
+	uint64_t hash = s_fnv1a_offset;
+	hash = fnv1a_hash(hash, &s_prelink_seed, sizeof(s_prelink_seed));
+	hash = fnv1a_hash(hash, &attempt, sizeof(attempt));
+	hash = fnv1a_hash(hash, path, strlen(path));
+	return hash;
+}
+
+static uint64_t get_relocation_cache_key(const LoadedElf& elf)
+{
+	if (s_prelink_dirfd == -1)
+		return 0;
+	if (elf.has_textrel || elf.relro_start >= elf.relro_end)
+		return 0;
+
+	// relocated values depend on addresses of everything in the global scope
+	uint64_t key = s_fnv1a_offset;
+	key = fnv1a_hash(key, &s_prelink_seed, sizeof(s_prelink_seed));
+	key = fnv1a_hash(key, &elf.file_id, sizeof(elf.file_id));
+	key = fnv1a_hash(key, &elf.base, sizeof(elf.base));
+
+	const uintptr_t loader_address = reinterpret_cast<uintptr_t>(&__dlopen);
+	key = fnv1a_hash(key, &loader_address, sizeof(loader_address));
+
+	for (size_t i = 0; i < s_loaded_file_count; i++)
+	{
+		const auto& loaded = s_loaded_files[i];
+		if (!loaded.prelinked)
+			return 0;
+		key = fnv1a_hash(key, &loaded.file_id, sizeof(loaded.file_id));
+		key = fnv1a_hash(key, &loaded.base, sizeof(loaded.base));
+		key = fnv1a_hash(key, &loaded.tls_module, sizeof(loaded.tls_module));
+		key = fnv1a_hash(key, &loaded.tls_offset, sizeof(loaded.tls_offset));
+	}
+
+	return key ? key : 1;
+}
+
+static void relocation_cache_name(uint64_t key, char out[17])
+{
+	for (size_t i = 0; i < 16; i++)
+		out[i] = "0123456789abcdef"[(key >> (60 - i * 4)) & 0xF];
+	out[16] = '\0';
+}
+
+static bool map_relocation_cache(const LoadedElf& elf)
+{
+	char name[17];
+	relocation_cache_name(elf.relocation_cache_key, name);
+
+	const int fd = syscall(SYS_OPENAT, s_prelink_dirfd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC, 0);
+	if (fd < 0)
+		return false;
+
+	const size_t size = elf.relro_end - elf.relro_start;
+
+	RelocationCacheHeader header;
+	struct stat st;
+	const bool valid =
+		syscall(SYS_PREAD, fd, &header, sizeof(header), 0) == sizeof(header) &&
+		syscall(SYS_FSTATAT, fd, nullptr, &st, 0) == 0 &&
+		header.magic == s_relocation_cache_magic &&
+		header.key == elf.relocation_cache_key &&
+		header.base == elf.base &&
+		header.size == size &&
+		static_cast<size_t>(st.st_size) >= PAGE_SIZE + size;
+
+	if (!valid)
+	{
+		syscall(SYS_CLOSE, fd);
+		return false;
+	}
+
+	sys_mmap_t mmap_args;
+	mmap_args.addr = reinterpret_cast<void*>(elf.relro_start);
+	mmap_args.fildes = fd;
+	mmap_args.flags = MAP_SHARED | MAP_FIXED;
+	mmap_args.len = size;
+	mmap_args.off = PAGE_SIZE;
+	mmap_args.prot = PROT_READ;
+
+	const auto ret = syscall(SYS_MMAP, &mmap_args);
+	syscall(SYS_CLOSE, fd);
+
+	// MAP_FIXED already dropped the old mapping
+	if (ret != static_cast<long>(elf.relro_start))
+		print_error_and_exit("could not map relocation cache", ret);
+
+	return true;
+}
+
+static void write_relocation_cache(const LoadedElf& elf)
+{
+	char name[17];
+	relocation_cache_name(elf.relocation_cache_key, name);
+
+	char temp_name[40];
+	strcpy(temp_name, name);
+	temp_name[16] = '.';
+	{
+		char* ptr = temp_name + 17;
+		char buffer[16];
+		size_t len = 0;
+		for (long val = syscall(SYS_GET_PID); len == 0 || val; val /= 10)
+			buffer[len++] = '0' + val % 10;
+		while (len)
+			*ptr++ = buffer[--len];
+		*ptr = '\0';
+	}
+
+	const int fd = syscall(SYS_OPENAT, s_prelink_dirfd, temp_name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return;
+
+	const size_t size = elf.relro_end - elf.relro_start;
+
+	const RelocationCacheHeader header {
+		.magic = s_relocation_cache_magic,
+		.key = elf.relocation_cache_key,
+		.base = elf.base,
+		.size = size,
+	};
+
+	const bool success =
+		syscall(SYS_PWRITE, fd, &header, sizeof(header), 0) == sizeof(header) &&
+		syscall(SYS_PWRITE, fd, elf.relro_start, size, PAGE_SIZE) == static_cast<long>(size);
+	syscall(SYS_CLOSE, fd);
+
+	if (!success || syscall(SYS_RENAMEAT, s_prelink_dirfd, temp_name, s_prelink_dirfd, name) < 0)
+		syscall(SYS_UNLINKAT, s_prelink_dirfd, temp_name, 0);
+}
+
+static void finalize_relro(LoadedElf& elf)
+{
+	if (elf.relro_start >= elf.relro_end || elf.relro_cached)
+		return;
+
+	if (elf.relocation_cache_key)
+	{
+		write_relocation_cache(elf);
+		// replace our private pages with the shared ones
+		elf.relro_cached = map_relocation_cache(elf);
+	}
+
+	if (!elf.relro_cached)
+		if (auto ret = syscall(SYS_MPROTECT, elf.relro_start, elf.relro_end - elf.relro_start, PROT_READ))
+			print_error_and_exit("could not mprotect RELRO", ret);
+}
+
 static void relocate_elf(LoadedElf& elf, bool lazy_load)
 {
 	if (elf.is_relocating)
@@ -662,6 +1157,13 @@ static void relocate_elf(LoadedElf& elf, bool lazy_load)
 		relocate_elf(*reinterpret_cast<LoadedElf*>(dynamic.d_un.d_ptr), lazy_load);
 	}
 
+	// PLT GOT is part of RELRO with BIND_NOW linking, it can't be patched lazily
+	const bool lazy_plt = lazy_load && !(elf.jmprel && elf.pltrelsz && is_in_relro(elf, reinterpret_cast<ElfNativeRelocation*>(elf.jmprel)->r_offset));
+
+	elf.relocation_cache_key = get_relocation_cache_key(elf);
+	if (elf.relocation_cache_key)
+		elf.relro_cached = map_relocation_cache(elf);
+
 	// do "normal" relocations
 	if (elf.rel && elf.relent)
 		for (size_t i = 0; i < elf.relsz / elf.relent; i++)
@@ -684,7 +1186,7 @@ static void relocate_elf(LoadedElf& elf, bool lazy_load)
 		if (elf.pltrel != DT_REL && elf.pltrel != DT_RELA)
 			print_error_and_exit("invalid value for DT_PLTREL", 0);
 
-		if (!lazy_load)
+		if (!lazy_plt)
 		{
 			switch (elf.pltrel)
 			{
@@ -713,6 +1215,10 @@ static void relocate_elf(LoadedElf& elf, bool lazy_load)
 			}
 		}
 	}
+
+	// main executable still has to do copy relocations
+	if (&elf != &s_loaded_files[0])
+		finalize_relro(elf);
 }
 
 extern "C"
@@ -800,6 +1306,7 @@ static void handle_dynamic(LoadedElf& elf)
 		{
 			case DT_PLTGOT:
 			case DT_HASH:
+			case DT_GNU_HASH:
 			case DT_STRTAB:
 			case DT_SYMTAB:
 			case DT_RELA:
@@ -818,6 +1325,7 @@ static void handle_dynamic(LoadedElf& elf)
 			case DT_PLTRELSZ:     elf.pltrelsz     = dynamic.d_un.d_val; break;
 			case DT_PLTGOT:       pltgot           = dynamic.d_un.d_ptr; break;
 			case DT_HASH:         elf.hash         = dynamic.d_un.d_ptr; break;
+			case DT_GNU_HASH:     elf.gnu_hash     = dynamic.d_un.d_ptr; break;
 			case DT_STRTAB:       elf.strtab       = dynamic.d_un.d_ptr; break;
 			case DT_SYMTAB:       elf.symtab       = dynamic.d_un.d_ptr; break;
 			case DT_RELA:         elf.rela         = dynamic.d_un.d_ptr; break;
@@ -1075,6 +1583,7 @@ static LoadedElf& load_elf(const char* path, int fd)
 	validate_program_header(file_header);
 
 	uintptr_t base = 0;
+	bool prelinked = false;
 	if (file_header.e_type == ET_DYN)
 	{
 #if defined(__x86_64__)
@@ -1085,10 +1594,27 @@ static LoadedElf& load_elf(const char* path, int fd)
 		#error "unsupported architecture"
 #endif
 
+		// same object gets the same address in every process during this boot
+		if (s_prelink_dirfd != -1)
+		{
+			for (uint64_t attempt = 0; attempt < 8 && !prelinked; attempt++)
+			{
+				base = (get_prelink_base(path, attempt) & base_mask) + 0x100000;
+				prelinked = can_load_elf(fd, file_header, base);
+			}
+		}
+
 		// FIXME: This is very hacky :D
-		do
-			base = (get_random_uptr() & base_mask) + 0x100000;
-		while (!can_load_elf(fd, file_header, base));
+		if (!prelinked)
+		{
+			do
+				base = (get_random_uptr() & base_mask) + 0x100000;
+			while (!can_load_elf(fd, file_header, base));
+		}
+	}
+	else
+	{
+		prelinked = (s_prelink_dirfd != -1);
 	}
 
 	bool needs_writable = false;
@@ -1138,9 +1664,25 @@ static LoadedElf& load_elf(const char* path, int fd)
 	elf.base = base;
 	elf.fd = fd;
 	elf.dynamics = nullptr;
+	elf.prelinked = prelinked;
+	elf.has_textrel = needs_writable;
 	memcpy(&elf.file_header, &file_header, sizeof(file_header));
 	strcpy(elf.path, path);
 
+	if (prelinked)
+	{
+		struct stat st;
+		if (auto ret = syscall(SYS_FSTATAT, fd, nullptr, &st, 0); ret < 0)
+			print_error_and_exit("could not stat file", ret);
+
+		uint64_t file_id = s_fnv1a_offset;
+		file_id = fnv1a_hash(file_id, &st.st_dev, sizeof(st.st_dev));
+		file_id = fnv1a_hash(file_id, &st.st_ino, sizeof(st.st_ino));
+		file_id = fnv1a_hash(file_id, &st.st_size, sizeof(st.st_size));
+		file_id = fnv1a_hash(file_id, &st.st_mtim, sizeof(st.st_mtim));
+		elf.file_id = file_id;
+	}
+
 	for (size_t i = 0; i < file_header.e_phnum; i++)
 	{
 		ElfNativeProgramHeader program_header;
@@ -1157,7 +1699,10 @@ static LoadedElf& load_elf(const char* path, int fd)
 				break;
 			case PT_GNU_EH_FRAME:
 			case PT_GNU_STACK:
+				break;
 			case PT_GNU_RELRO:
+				elf.relro_start = (base + program_header.p_vaddr) & ~(uintptr_t)0xFFF;
+				elf.relro_end = (base + program_header.p_vaddr + program_header.p_memsz) & ~(uintptr_t)0xFFF;
 				break;
 			case PT_TLS:
 				elf.tls_header = program_header;
@@ -1364,6 +1909,7 @@ static void initialize_tls(MasterTLS master_tls)
 		.cancel_type = PTHREAD_CANCEL_DEFERRED,
 		.cancel_state = PTHREAD_CANCEL_ENABLE,
 		.canceled = false,
+		.malloc_cache = nullptr,
 		.specific_keys = {},
 		.specific_values = {},
 		.dtv = {},
@@ -1596,6 +2142,9 @@ void* __dlopen(const char* file, int mode)
 
 	const size_t old_loaded_count = s_loaded_file_count;
 
+	// directory is closed again before any code of the loaded objects runs
+	const bool opened_prelink = reopen_prelink();
+
 	init_random();
 	auto& elf = load_elf(path_buffer, -1);
 	fini_random();
@@ -1607,11 +2156,16 @@ void* __dlopen(const char* file, int mode)
 
 
 		relocate_elf(elf, lazy);
+		if (opened_prelink)
+			close_prelink();
 		call_init_funcs(elf, false);
 		register_fini_funcs(elf, false);
 		syscall(SYS_CLOSE, elf.fd);
 	}
 
+	if (opened_prelink)
+		close_prelink();
+
 #if DEBUG_DLOPEN
 	print(STDERR_FILENO, "\e[31m-> success\e[m\n");
 #endif
@@ -1782,6 +2336,7 @@ uintptr_t _entry(int argc, char* argv[], char* envp[])
 	}
 
 	init_random();
+	init_prelink();
 	auto& elf = load_elf(canonical, execfd);
 	fini_random();
 
@@ -1796,6 +2351,9 @@ uintptr_t _entry(int argc, char* argv[], char* envp[])
 		for (size_t i = 0; i < elf.relasz / elf.relaent; i++)
 			handle_copy_relocation(elf, *reinterpret_cast<ElfNativeRelocationA*>(elf.rela + i * elf.relaent));
 
+	finalize_relro(elf);
+	close_prelink();
+
 	initialize_tls(master_tls);
 	initialize_environ(envp);
 	call_init_funcs(elf, true);
@@ -9,6 +9,7 @@
 #include <fcntl.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/select.h>
 #include <termios.h>
 #include <time.h>
@@ -129,6 +130,9 @@ void Terminal::run()
 
 	m_font = MUST(LibFont::Font::load("/usr/share/fonts/lat0-16.psfu"_sv));
 
+	MUST(m_glyph_cache_keys.resize(m_glyph_cache_size, { .valid = false }));
+	MUST(m_glyph_cache_pixels.resize(m_glyph_cache_size * m_font.width() * m_font.height()));
+
 	m_window->set_min_size(m_font.width() * 8, m_font.height() * 2);
 
 	MUST(m_cells.resize(rows() * cols(), {
@@ -400,8 +404,11 @@ void Terminal::update_selection(bool show)
 			const auto cell = m_cells[row * cols() + col];
 			if (selected && cell.codepoint == 0)
 				return;
-			m_window->texture().fill_rect(x, y, m_font.width(), m_font.height(), selected ? s_default_fg_color : cell.bg_color);
-			m_window->texture().draw_character(cell.codepoint, m_font, x, y, selected ? s_default_bg_color : cell.fg_color);
+			draw_glyph(x, y, cell.codepoint,
+				selected ? s_default_bg_color : cell.fg_color,
+				selected ? s_default_fg_color : cell.bg_color,
+				cell.bold
+			);
 			invalidate = invalidate.get_bounding_box({ x, y, m_font.width(), m_font.height() });
 		};
 
@@ -478,7 +485,7 @@ void Terminal::show_cursor()
 
 bool Terminal::read_shell()
 {
-	char buffer[512];
+	char buffer[4096];
 	ssize_t nread = read(m_shell_info.pts_master, buffer, sizeof(buffer));
 	if (nread < 0)
 		dwarnln("read: {}", strerror(errno));
@@ -520,9 +527,24 @@ bool Terminal::read_shell()
 		if (m_cursor.y + newline_count >= rows())
 			should_invalidate = scroll(m_cursor.y + newline_count - rows() + 1);
 
+		const auto is_printable_ascii = [](char ch) { return ch >= 0x20 && ch < 0x7F; };
+
 		i = start;
-		for (i = start; i < non_ansi_end; i++)
-			should_invalidate = should_invalidate.get_bounding_box(putchar(buffer[i]));
+		while (i < non_ansi_end)
+		{
+			// plain ascii runs can be drawn without going through the utf8 decoder
+			if (m_state == State::Normal && m_utf8_index == 0 && is_printable_ascii(buffer[i]))
+			{
+				ssize_t run_end = i + 1;
+				while (run_end < non_ansi_end && is_printable_ascii(buffer[run_end]))
+					run_end++;
+				should_invalidate = should_invalidate.get_bounding_box(putascii(&buffer[i], run_end - i));
+				i = run_end;
+				continue;
+			}
+
+			should_invalidate = should_invalidate.get_bounding_box(putchar(buffer[i++]));
+		}
 	}
 
 	if (should_invalidate.height && should_invalidate.width)
@@ -1080,7 +1102,6 @@ Rectangle Terminal::putcodepoint(uint32_t codepoint)
 {
 	Rectangle should_invalidate;
 
-	auto& texture = m_window->texture();
 	switch (codepoint)
 	{
 		case 0x00: // null
@@ -1145,10 +1166,7 @@ Rectangle Terminal::putcodepoint(uint32_t codepoint)
 				.bold = m_is_bold,
 			};
 
-			texture.fill_rect(cell_x, cell_y, cell_w, cell_h, bg_color);
-			texture.draw_character(codepoint, m_font, cell_x, cell_y, fg_color);
-			if (m_is_bold)
-				texture.draw_character(codepoint, m_font, cell_x + 1, cell_y, fg_color);
+			draw_glyph(cell_x, cell_y, codepoint, fg_color, bg_color, m_is_bold);
 			m_last_graphic_char = codepoint;
 			should_invalidate = { cell_x, cell_y, cell_w, cell_h };
 			m_cursor.x++;
@@ -1162,6 +1180,134 @@ Rectangle Terminal::putcodepoint(uint32_t codepoint)
 	return should_invalidate;
 }
 
+Rectangle Terminal::putascii(const char* ascii, size_t count)
+{
+	Rectangle should_invalidate;
+
+	const uint32_t cell_w = m_font.width();
+	const uint32_t cell_h = m_font.height();
+
+	const auto fg_color = m_colors_inverted ? m_bg_color : m_fg_color;
+	const auto bg_color = m_colors_inverted ? m_fg_color : m_bg_color;
+
+	// invalidate every line once instead of every character
+	uint32_t line_start_x = m_cursor.x;
+	const auto invalidate_line =
+		[&]
+		{
+			if (m_cursor.x <= line_start_x)
+				return;
+			should_invalidate = should_invalidate.get_bounding_box({
+				line_start_x * cell_w,
+				m_cursor.y * cell_h,
+				(m_cursor.x - line_start_x) * cell_w,
+				cell_h
+			});
+		};
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (m_cursor.x >= cols())
+		{
+			invalidate_line();
+			m_cursor.x = 0;
+			m_cursor.y++;
+			line_start_x = 0;
+		}
+
+		if (m_cursor.y >= rows())
+			should_invalidate = scroll(m_cursor.y - rows() + 1);
+
+		const uint32_t codepoint = ascii[i];
+
+		m_cells[m_cursor.y * cols() + m_cursor.x] = {
+			.codepoint = codepoint,
+			.fg_color = fg_color,
+			.bg_color = bg_color,
+			.bold = m_is_bold,
+		};
+
+		draw_glyph(m_cursor.x * cell_w, m_cursor.y * cell_h, codepoint, fg_color, bg_color, m_is_bold);
+		m_cursor.x++;
+	}
+
+	invalidate_line();
+
+	if (count > 0)
+		m_last_graphic_char = ascii[count - 1];
+
+	return should_invalidate;
+}
+
+const uint32_t* Terminal::get_glyph_pixels(uint32_t codepoint, uint32_t fg_color, uint32_t bg_color, bool bold)
+{
+	const uint32_t glyph_w = m_font.width();
+	const uint32_t glyph_h = m_font.height();
+
+	uint32_t hash = codepoint * 0x9E3779B1;
+	hash ^= fg_color * 0x85EBCA77;
+	hash ^= bg_color * 0xC2B2AE3D;
+	hash ^= bold;
+	hash ^= hash >> 16;
+
+	const size_t index = hash % m_glyph_cache_size;
+	uint32_t* pixels = &m_glyph_cache_pixels[index * glyph_w * glyph_h];
+
+	auto& key = m_glyph_cache_keys[index];
+	if (key.valid && key.codepoint == codepoint && key.fg_color == fg_color && key.bg_color == bg_color && key.bold == bold)
+		return pixels;
+
+	key = {
+		.codepoint = codepoint,
+		.fg_color = fg_color,
+		.bg_color = bg_color,
+		.bold = bold,
+		.valid = true,
+	};
+
+	const uint8_t* glyph = m_font.glyph(codepoint);
+	const auto is_bit_set =
+		[&](uint32_t x, uint32_t y) -> bool
+		{
+			return glyph[y * m_font.pitch() + x / 8] & (0x80 >> (x % 8));
+		};
+
+	for (uint32_t y = 0; y < glyph_h; y++)
+	{
+		for (uint32_t x = 0; x < glyph_w; x++)
+		{
+			bool set = false;
+			if (glyph != nullptr)
+				set = is_bit_set(x, y) || (bold && x > 0 && is_bit_set(x - 1, y));
+			pixels[y * glyph_w + x] = set ? fg_color : bg_color;
+		}
+	}
+
+	return pixels;
+}
+
+void Terminal::draw_glyph(uint32_t x, uint32_t y, uint32_t codepoint, uint32_t fg_color, uint32_t bg_color, bool bold)
+{
+	auto& texture = m_window->texture();
+
+	const uint32_t glyph_w = m_font.width();
+	const uint32_t glyph_h = m_font.height();
+	ASSERT(x + glyph_w <= texture.width());
+	ASSERT(y + glyph_h <= texture.height());
+
+	const uint32_t* glyph_pixels = get_glyph_pixels(codepoint, fg_color, bg_color, bold);
+	uint32_t* texture_pixels = texture.pixels().data();
+
+	for (uint32_t row = 0; row < glyph_h; row++)
+	{
+		memcpy(
+			&texture_pixels[(y + row) * texture.width() + x],
+			&glyph_pixels[row * glyph_w],
+			glyph_w * sizeof(uint32_t)
+		);
+	}
+}
+
 Rectangle Terminal::putchar(uint8_t ch)
 {
 	if (m_state == State::ESC)
@@ -40,8 +40,12 @@ private:
 	Rectangle handle_csi(char ch);
 	Rectangle putcodepoint(uint32_t codepoint);
 	Rectangle putchar(uint8_t ch);
+	Rectangle putascii(const char* ascii, size_t count);
 	bool read_shell();
 
+	void draw_glyph(uint32_t x, uint32_t y, uint32_t codepoint, uint32_t fg_color, uint32_t bg_color, bool bold);
+	const uint32_t* get_glyph_pixels(uint32_t codepoint, uint32_t fg_color, uint32_t bg_color, bool bold);
+
 	void update_selection(bool show = true);
 
 	BAN::Optional<uint32_t> get_8bit_color();
@@ -90,9 +94,24 @@ private:
 		bool bold;
 	};
 
+	struct GlyphCacheKey
+	{
+		uint32_t codepoint;
+		uint32_t fg_color;
+		uint32_t bg_color;
+		bool bold;
+		bool valid;
+	};
+
 private:
 	BAN::UniqPtr<LibGUI::Window> m_window;
 	LibFont::Font m_font;
+
+	// direct mapped cache of rasterized glyphs, every slot holds one
+	// glyph drawn with its foreground and background colors
+	static constexpr size_t m_glyph_cache_size = 1024;
+	BAN::Vector<GlyphCacheKey> m_glyph_cache_keys;
+	BAN::Vector<uint32_t> m_glyph_cache_pixels;
 	ShellInfo m_shell_info;
 	State m_state { State::Normal };
 	CSIInfo m_csi_info;
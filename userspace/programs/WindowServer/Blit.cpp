@@ -0,0 +1,347 @@
+#include "Blit.h"
+
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+struct BlitImplementation
+{
+	const char* name;
+	void (*fill)(uint32_t*, uint32_t, size_t);
+	void (*alpha_blend)(uint32_t*, const uint32_t*, const uint32_t*, size_t);
+	void (*alpha_blend_color)(uint32_t*, uint32_t, size_t);
+	void (*scale_row)(uint32_t*, const uint32_t*, const uint32_t*, size_t);
+};
+
+// NOTE: alpha is scaled to 0-256 so fully opaque and fully transparent
+//       pixels are exact. All implementations give identical results.
+uint32_t alpha_blend(uint32_t color_a, uint32_t color_b)
+{
+	const uint32_t a_a = color_a >> 24;
+	const uint32_t mul_a = a_a + (a_a >> 7);
+	const uint32_t mul_b = 256 - mul_a;
+
+	const uint32_t rb = ((mul_a * (color_a & 0xFF00FF) + mul_b * (color_b & 0xFF00FF)) >> 8) & 0xFF00FF;
+	const uint32_t g  = ((mul_a * (color_a & 0x00FF00) + mul_b * (color_b & 0x00FF00)) >> 8) & 0x00FF00;
+
+	const uint32_t a = a_a + (((color_b >> 24) * mul_b) >> 8);
+	return (a << 24) | rb | g;
+}
+
+static void fill_sse2(uint32_t* dst, uint32_t color, size_t count)
+{
+	const __m128i color4 = _mm_set1_epi32(color);
+	for (; count >= 4; count -= 4, dst += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), color4);
+	for (; count; count--)
+		*dst++ = color;
+}
+
+static void alpha_blend_sse2(uint32_t* dst, const uint32_t* src, const uint32_t* bg, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max_alpha16 = _mm_set1_epi16(256);
+	const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+
+	for (; count >= 4; count -= 4, dst += 4, src += 4, bg += 4)
+	{
+		// load colors
+		const __m128i ca = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		const __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bg));
+
+		// most of the pixels are either fully opaque or fully transparent
+		const __m128i aa = _mm_and_si128(ca, alpha_mask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(aa, alpha_mask)) == 0xFFFF)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), ca);
+			continue;
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(aa, zero)) == 0xFFFF)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), cb);
+			continue;
+		}
+
+		// unpack colors to 16 bit words
+		const __m128i ca_lo = _mm_unpacklo_epi8(ca, zero);
+		const __m128i ca_hi = _mm_unpackhi_epi8(ca, zero);
+		const __m128i cb_lo = _mm_unpacklo_epi8(cb, zero);
+		const __m128i cb_hi = _mm_unpackhi_epi8(cb, zero);
+
+		// extract alpha channel from color_a
+		const __m128i a1_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ca_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m128i a1_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ca_hi, 0b11'11'11'11), 0b11'11'11'11);
+
+		// scale alpha to 0-256 and calculate inverse alpha
+		const __m128i m1_lo = _mm_add_epi16(a1_lo, _mm_srli_epi16(a1_lo, 7));
+		const __m128i m1_hi = _mm_add_epi16(a1_hi, _mm_srli_epi16(a1_hi, 7));
+		const __m128i a2_lo = _mm_sub_epi16(max_alpha16, m1_lo);
+		const __m128i a2_hi = _mm_sub_epi16(max_alpha16, m1_hi);
+
+		// blend and pack rgb (a*c1 + c2*(256-a)) / 256
+		const __m128i rgb_lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(ca_lo, m1_lo), _mm_mullo_epi16(cb_lo, a2_lo)), 8);
+		const __m128i rgb_hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(ca_hi, m1_hi), _mm_mullo_epi16(cb_hi, a2_hi)), 8);
+		const __m128i rgb = _mm_and_si128(rgb_mask, _mm_packus_epi16(rgb_lo, rgb_hi));
+
+		// extract alpha channel from color_b
+		const __m128i ab_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m128i ab_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_hi, 0b11'11'11'11), 0b11'11'11'11);
+
+		// blend and pack alpha a + ab*(256-a) / 256
+		const __m128i alpha_lo = _mm_add_epi16(a1_lo, _mm_srli_epi16(_mm_mullo_epi16(ab_lo, a2_lo), 8));
+		const __m128i alpha_hi = _mm_add_epi16(a1_hi, _mm_srli_epi16(_mm_mullo_epi16(ab_hi, a2_hi), 8));
+		const __m128i alpha = _mm_slli_epi32(_mm_packus_epi16(alpha_lo, alpha_hi), 24);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(alpha, rgb));
+	}
+
+	for (; count; count--)
+		*dst++ = alpha_blend(*src++, *bg++);
+}
+
+static void alpha_blend_color_sse2(uint32_t* dst, uint32_t color, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	// color's contribution is the same for every pixel
+	const __m128i ca = _mm_unpacklo_epi8(_mm_set1_epi32(color), zero);
+	const __m128i a1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ca, 0b11'11'11'11), 0b11'11'11'11);
+	const __m128i m1 = _mm_add_epi16(a1, _mm_srli_epi16(a1, 7));
+	const __m128i a2 = _mm_sub_epi16(_mm_set1_epi16(256), m1);
+	const __m128i ca_a1 = _mm_mullo_epi16(ca, m1);
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+
+	for (; count >= 4; count -= 4, dst += 4)
+	{
+		const __m128i cb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+		const __m128i cb_lo = _mm_unpacklo_epi8(cb, zero);
+		const __m128i cb_hi = _mm_unpackhi_epi8(cb, zero);
+
+		const __m128i rgb_lo = _mm_srli_epi16(_mm_add_epi16(ca_a1, _mm_mullo_epi16(cb_lo, a2)), 8);
+		const __m128i rgb_hi = _mm_srli_epi16(_mm_add_epi16(ca_a1, _mm_mullo_epi16(cb_hi, a2)), 8);
+		const __m128i rgb = _mm_and_si128(rgb_mask, _mm_packus_epi16(rgb_lo, rgb_hi));
+
+		const __m128i ab_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m128i ab_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_hi, 0b11'11'11'11), 0b11'11'11'11);
+		const __m128i alpha_lo = _mm_add_epi16(a1, _mm_srli_epi16(_mm_mullo_epi16(ab_lo, a2), 8));
+		const __m128i alpha_hi = _mm_add_epi16(a1, _mm_srli_epi16(_mm_mullo_epi16(ab_hi, a2), 8));
+		const __m128i alpha = _mm_slli_epi32(_mm_packus_epi16(alpha_lo, alpha_hi), 24);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(alpha, rgb));
+	}
+
+	for (; count; count--, dst++)
+		*dst = alpha_blend(color, *dst);
+}
+
+static void scale_row_generic(uint32_t* dst, const uint32_t* src_row, const uint32_t* x_table, size_t count)
+{
+	for (; count >= 4; count -= 4, dst += 4, x_table += 4)
+	{
+		dst[0] = src_row[x_table[0]];
+		dst[1] = src_row[x_table[1]];
+		dst[2] = src_row[x_table[2]];
+		dst[3] = src_row[x_table[3]];
+	}
+	for (; count; count--)
+		*dst++ = src_row[*x_table++];
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(uint32_t* dst, uint32_t color, size_t count)
+{
+	const __m256i color8 = _mm256_set1_epi32(color);
+	for (; count >= 8; count -= 8, dst += 8)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), color8);
+	for (; count; count--)
+		*dst++ = color;
+}
+
+__attribute__((target("avx2")))
+static void alpha_blend_avx2(uint32_t* dst, const uint32_t* src, const uint32_t* bg, size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i max_alpha16 = _mm256_set1_epi16(256);
+	const __m256i alpha_mask = _mm256_set1_epi32(0xFF000000);
+	const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+
+	// NOTE: unpack and pack work within 128 bit lanes so pixel order is preserved
+	for (; count >= 8; count -= 8, dst += 8, src += 8, bg += 8)
+	{
+		const __m256i ca = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		const __m256i cb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bg));
+
+		const __m256i aa = _mm256_and_si256(ca, alpha_mask);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(aa, alpha_mask)) == -1)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), ca);
+			continue;
+		}
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(aa, zero)) == -1)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), cb);
+			continue;
+		}
+
+		const __m256i ca_lo = _mm256_unpacklo_epi8(ca, zero);
+		const __m256i ca_hi = _mm256_unpackhi_epi8(ca, zero);
+		const __m256i cb_lo = _mm256_unpacklo_epi8(cb, zero);
+		const __m256i cb_hi = _mm256_unpackhi_epi8(cb, zero);
+
+		const __m256i a1_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(ca_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m256i a1_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(ca_hi, 0b11'11'11'11), 0b11'11'11'11);
+
+		const __m256i m1_lo = _mm256_add_epi16(a1_lo, _mm256_srli_epi16(a1_lo, 7));
+		const __m256i m1_hi = _mm256_add_epi16(a1_hi, _mm256_srli_epi16(a1_hi, 7));
+		const __m256i a2_lo = _mm256_sub_epi16(max_alpha16, m1_lo);
+		const __m256i a2_hi = _mm256_sub_epi16(max_alpha16, m1_hi);
+
+		const __m256i rgb_lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(ca_lo, m1_lo), _mm256_mullo_epi16(cb_lo, a2_lo)), 8);
+		const __m256i rgb_hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(ca_hi, m1_hi), _mm256_mullo_epi16(cb_hi, a2_hi)), 8);
+		const __m256i rgb = _mm256_and_si256(rgb_mask, _mm256_packus_epi16(rgb_lo, rgb_hi));
+
+		const __m256i ab_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(cb_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m256i ab_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(cb_hi, 0b11'11'11'11), 0b11'11'11'11);
+
+		const __m256i alpha_lo = _mm256_add_epi16(a1_lo, _mm256_srli_epi16(_mm256_mullo_epi16(ab_lo, a2_lo), 8));
+		const __m256i alpha_hi = _mm256_add_epi16(a1_hi, _mm256_srli_epi16(_mm256_mullo_epi16(ab_hi, a2_hi), 8));
+		const __m256i alpha = _mm256_slli_epi32(_mm256_packus_epi16(alpha_lo, alpha_hi), 24);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(alpha, rgb));
+	}
+
+	alpha_blend_sse2(dst, src, bg, count);
+}
+
+__attribute__((target("avx2")))
+static void alpha_blend_color_avx2(uint32_t* dst, uint32_t color, size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+
+	const __m256i ca = _mm256_unpacklo_epi8(_mm256_set1_epi32(color), zero);
+	const __m256i a1 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(ca, 0b11'11'11'11), 0b11'11'11'11);
+	const __m256i m1 = _mm256_add_epi16(a1, _mm256_srli_epi16(a1, 7));
+	const __m256i a2 = _mm256_sub_epi16(_mm256_set1_epi16(256), m1);
+	const __m256i ca_a1 = _mm256_mullo_epi16(ca, m1);
+	const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+
+	for (; count >= 8; count -= 8, dst += 8)
+	{
+		const __m256i cb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst));
+		const __m256i cb_lo = _mm256_unpacklo_epi8(cb, zero);
+		const __m256i cb_hi = _mm256_unpackhi_epi8(cb, zero);
+
+		const __m256i rgb_lo = _mm256_srli_epi16(_mm256_add_epi16(ca_a1, _mm256_mullo_epi16(cb_lo, a2)), 8);
+		const __m256i rgb_hi = _mm256_srli_epi16(_mm256_add_epi16(ca_a1, _mm256_mullo_epi16(cb_hi, a2)), 8);
+		const __m256i rgb = _mm256_and_si256(rgb_mask, _mm256_packus_epi16(rgb_lo, rgb_hi));
+
+		const __m256i ab_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(cb_lo, 0b11'11'11'11), 0b11'11'11'11);
+		const __m256i ab_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(cb_hi, 0b11'11'11'11), 0b11'11'11'11);
+		const __m256i alpha_lo = _mm256_add_epi16(a1, _mm256_srli_epi16(_mm256_mullo_epi16(ab_lo, a2), 8));
+		const __m256i alpha_hi = _mm256_add_epi16(a1, _mm256_srli_epi16(_mm256_mullo_epi16(ab_hi, a2), 8));
+		const __m256i alpha = _mm256_slli_epi32(_mm256_packus_epi16(alpha_lo, alpha_hi), 24);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_or_si256(alpha, rgb));
+	}
+
+	alpha_blend_color_sse2(dst, color, count);
+}
+
+__attribute__((target("avx2")))
+static void scale_row_avx2(uint32_t* dst, const uint32_t* src_row, const uint32_t* x_table, size_t count)
+{
+	for (; count >= 8; count -= 8, dst += 8, x_table += 8)
+	{
+		const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x_table));
+		const __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src_row), indices, 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), pixels);
+	}
+
+	scale_row_generic(dst, src_row, x_table, count);
+}
+
+static constexpr BlitImplementation s_sse2_implementation {
+	.name = "sse2",
+	.fill = fill_sse2,
+	.alpha_blend = alpha_blend_sse2,
+	.alpha_blend_color = alpha_blend_color_sse2,
+	.scale_row = scale_row_generic,
+};
+
+static constexpr BlitImplementation s_avx2_implementation {
+	.name = "avx2",
+	.fill = fill_avx2,
+	.alpha_blend = alpha_blend_avx2,
+	.alpha_blend_color = alpha_blend_color_avx2,
+	.scale_row = scale_row_avx2,
+};
+
+static const BlitImplementation* s_implementation = &s_sse2_implementation;
+
+static bool is_avx2_usable()
+{
+	unsigned eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+		return false;
+
+	// kernel has to preserve ymm registers across context switches
+	uint32_t xcr0_lo, xcr0_hi;
+	asm volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	if ((xcr0_lo & 0b110) != 0b110)
+		return false;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return ebx & bit_AVX2;
+}
+
+void initialize_blit()
+{
+	if (is_avx2_usable())
+		s_implementation = &s_avx2_implementation;
+}
+
+const char* blit_implementation_name()
+{
+	return s_implementation->name;
+}
+
+void blit_fill(uint32_t* dst, uint32_t color, size_t count)
+{
+	s_implementation->fill(dst, color, count);
+}
+
+void blit_alpha_blend(uint32_t* dst, const uint32_t* src, const uint32_t* bg, size_t count)
+{
+	s_implementation->alpha_blend(dst, src, bg, count);
+}
+
+void blit_alpha_blend_color(uint32_t* dst, uint32_t color, size_t count)
+{
+	s_implementation->alpha_blend_color(dst, color, count);
+}
+
+void blit_scale_row(uint32_t* dst, const uint32_t* src_row, const uint32_t* x_table, size_t count)
+{
+	s_implementation->scale_row(dst, src_row, x_table, count);
+}
+
+void blit_stream_copy(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	// streaming stores have to be aligned
+	for (; count && (reinterpret_cast<uintptr_t>(dst) & 15); count--)
+		_mm_stream_si32(reinterpret_cast<int*>(dst++), *src++);
+	for (; count >= 4; count -= 4, dst += 4, src += 4)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	for (; count; count--)
+		_mm_stream_si32(reinterpret_cast<int*>(dst++), *src++);
+}
+
+void blit_stream_fence()
+{
+	_mm_sfence();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pixel loops used by the compositor. Vectorized versions are selected
+// at runtime based on what the cpu (and kernel) supports.
+
+void initialize_blit();
+const char* blit_implementation_name();
+
+uint32_t alpha_blend(uint32_t color_a, uint32_t color_b);
+
+// dst[i] = color
+void blit_fill(uint32_t* dst, uint32_t color, size_t count);
+
+// dst[i] = alpha_blend(src[i], bg[i]), dst may be the same as bg
+void blit_alpha_blend(uint32_t* dst, const uint32_t* src, const uint32_t* bg, size_t count);
+
+// dst[i] = alpha_blend(color, dst[i])
+void blit_alpha_blend_color(uint32_t* dst, uint32_t color, size_t count);
+
+// dst[i] = src_row[x_table[i]]
+void blit_scale_row(uint32_t* dst, const uint32_t* src_row, const uint32_t* x_table, size_t count);
+
+// dst[i] = src[i] with non-temporal stores, meant for write-combining
+// video memory. blit_stream_fence() has to be called before the data
+// is expected to be visible.
+void blit_stream_copy(uint32_t* dst, const uint32_t* src, size_t count);
+void blit_stream_fence();
@@ -0,0 +1,164 @@
+#include "DamageRegion.h"
+
+#include <string.h>
+
+bool DamageRegion::try_add(const RectArray& rects, size_t rect_count, Rectangle rect, RectArray& out, size_t& out_count) const
+{
+	// every band edge and edges of the new rectangle, sorted and unique
+	int32_t edges[m_max_rects * 2 + 2];
+	size_t edge_count = 0;
+
+	const auto add_edge =
+		[&](int32_t y)
+		{
+			size_t index = edge_count;
+			while (index > 0 && edges[index - 1] > y)
+				index--;
+			if (index > 0 && edges[index - 1] == y)
+				return;
+			memmove(&edges[index + 1], &edges[index], (edge_count - index) * sizeof(int32_t));
+			edges[index] = y;
+			edge_count++;
+		};
+
+	for (size_t i = 0; i < rect_count; i++)
+	{
+		if (i > 0 && rects[i].min_y == rects[i - 1].min_y)
+			continue;
+		add_edge(rects[i].min_y);
+		add_edge(rects[i].max_y);
+	}
+	add_edge(rect.min_y);
+	add_edge(rect.max_y);
+
+	out_count = 0;
+
+	size_t band_start = 0;
+	size_t prev_band_start = 0;
+	size_t prev_band_count = 0;
+
+	for (size_t i = 0; i + 1 < edge_count; i++)
+	{
+		const int32_t y0 = edges[i];
+		const int32_t y1 = edges[i + 1];
+
+		// bands can't cross edges, so a band either covers [y0, y1) fully or not at all
+		while (band_start < rect_count && rects[band_start].max_y <= y0)
+			band_start++;
+		size_t band_end = band_start;
+		if (band_start < rect_count && rects[band_start].min_y <= y0)
+			while (band_end < rect_count && rects[band_end].min_y == rects[band_start].min_y)
+				band_end++;
+
+		const size_t this_band_start = out_count;
+
+		const auto push_span =
+			[&](int32_t min_x, int32_t max_x) -> bool
+			{
+				if (out_count > this_band_start && out[out_count - 1].max_x >= min_x)
+				{
+					out[out_count - 1].max_x = BAN::Math::max(out[out_count - 1].max_x, max_x);
+					return true;
+				}
+				if (out_count >= m_max_rects)
+					return false;
+				out[out_count++] = { min_x, y0, max_x, y1 };
+				return true;
+			};
+
+		bool rect_pushed = !(rect.min_y <= y0 && y1 <= rect.max_y);
+		for (size_t j = band_start; j < band_end; j++)
+		{
+			if (!rect_pushed && rect.min_x <= rects[j].min_x)
+			{
+				if (!push_span(rect.min_x, rect.max_x))
+					return false;
+				rect_pushed = true;
+			}
+			if (!push_span(rects[j].min_x, rects[j].max_x))
+				return false;
+		}
+		if (!rect_pushed && !push_span(rect.min_x, rect.max_x))
+			return false;
+
+		const size_t this_band_count = out_count - this_band_start;
+		if (this_band_count == 0)
+			continue;
+
+		// coalesce with the band above if it has the same spans
+		bool can_coalesce = (prev_band_count == this_band_count && out[prev_band_start].max_y == y0);
+		for (size_t j = 0; j < this_band_count && can_coalesce; j++)
+		{
+			const auto& prev = out[prev_band_start + j];
+			const auto& curr = out[this_band_start + j];
+			can_coalesce = (prev.min_x == curr.min_x && prev.max_x == curr.max_x);
+		}
+
+		if (can_coalesce)
+		{
+			for (size_t j = 0; j < prev_band_count; j++)
+				out[prev_band_start + j].max_y = y1;
+			out_count = this_band_start;
+			continue;
+		}
+
+		prev_band_start = this_band_start;
+		prev_band_count = this_band_count;
+	}
+
+	return true;
+}
+
+size_t DamageRegion::simplify(RectArray& rects, size_t rect_count) const
+{
+	// replace every band with its bounding box and coalesce again
+	size_t new_count = 0;
+	for (size_t i = 0; i < rect_count;)
+	{
+		size_t band_end = i + 1;
+		while (band_end < rect_count && rects[band_end].min_y == rects[i].min_y)
+			band_end++;
+
+		const Rectangle band {
+			.min_x = rects[i].min_x,
+			.min_y = rects[i].min_y,
+			.max_x = rects[band_end - 1].max_x,
+			.max_y = rects[i].max_y,
+		};
+
+		auto* prev = new_count ? &rects[new_count - 1] : nullptr;
+		if (prev && prev->max_y == band.min_y && prev->min_x == band.min_x && prev->max_x == band.max_x)
+			prev->max_y = band.max_y;
+		else
+			rects[new_count++] = band;
+
+		i = band_end;
+	}
+	return new_count;
+}
+
+void DamageRegion::add(Rectangle rect)
+{
+	if (rect.width() <= 0 || rect.height() <= 0)
+		return;
+
+	RectArray result;
+	size_t result_count;
+
+	if (!try_add(m_rects, m_rect_count, rect, result, result_count))
+	{
+		// too many rectangles, trade some accuracy for size
+		m_rect_count = simplify(m_rects, m_rect_count);
+		if (!try_add(m_rects, m_rect_count, rect, result, result_count))
+		{
+			for (size_t i = 0; i < m_rect_count; i++)
+				rect = rect.get_bounding_box(m_rects[i]);
+			m_rects[0] = rect;
+			m_rect_count = 1;
+			return;
+		}
+	}
+
+	memcpy(m_rects.data(), result.data(), result_count * sizeof(Rectangle));
+	m_rect_count = result_count;
+}
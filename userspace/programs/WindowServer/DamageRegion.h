@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Utils.h"
+
+#include <BAN/Array.h>
+
+#include <stddef.h>
+
+// Exact union of damaged rectangles stored as y-x banded rectangles.
+// Rectangles are sorted by y and then by x, rectangles in the same band
+// have the same y range and bands never overlap. Vertically adjacent
+// bands with identical spans are coalesced.
+class DamageRegion
+{
+public:
+	void add(Rectangle rect);
+	void clear() { m_rect_count = 0; }
+
+	bool empty() const { return m_rect_count == 0; }
+	size_t size() const { return m_rect_count; }
+
+	const Rectangle* begin() const { return m_rects.data(); }
+	const Rectangle* end() const { return m_rects.data() + m_rect_count; }
+
+private:
+	static constexpr size_t m_max_rects = 128;
+	using RectArray = BAN::Array<Rectangle, m_max_rects>;
+
+	bool try_add(const RectArray& rects, size_t rect_count, Rectangle rect, RectArray& out, size_t& out_count) const;
+	size_t simplify(RectArray& rects, size_t rect_count) const;
+
+private:
+	RectArray m_rects;
+	size_t m_rect_count { 0 };
+};
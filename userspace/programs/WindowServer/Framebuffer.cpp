@@ -25,6 +25,36 @@ Framebuffer open_framebuffer()
 
 	const size_t framebuffer_bytes = framebuffer_info.width * framebuffer_info.height * (BANAN_FB_BPP / 8);
 
+	Framebuffer framebuffer;
+	framebuffer.fd = framebuffer_fd;
+	framebuffer.width = framebuffer_info.width;
+	framebuffer.height = framebuffer_info.height;
+	framebuffer.bpp = BANAN_FB_BPP;
+
+	if ((framebuffer_info.flags & FB_FLAG_DIRECT_MAP) && framebuffer_info.pitch % (BANAN_FB_BPP / 8) == 0)
+	{
+		const size_t video_bytes = framebuffer_info.pitch * framebuffer_info.height;
+
+		void* video_mmap = mmap(NULL, video_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, framebuffer_fd, BANAN_FB_DIRECT_OFFSET);
+		void* back_buffer = mmap(NULL, framebuffer_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (video_mmap != MAP_FAILED && back_buffer != MAP_FAILED)
+		{
+			framebuffer.mmap = static_cast<uint32_t*>(back_buffer);
+			framebuffer.video = static_cast<uint32_t*>(video_mmap);
+			framebuffer.video_pitch = framebuffer_info.pitch / (BANAN_FB_BPP / 8);
+
+			for (int32_t y = 0; y < framebuffer.height; y++)
+				memset(&framebuffer.video[y * framebuffer.video_pitch], 0, framebuffer.width * (BANAN_FB_BPP / 8));
+
+			return framebuffer;
+		}
+
+		if (video_mmap != MAP_FAILED)
+			munmap(video_mmap, video_bytes);
+		if (back_buffer != MAP_FAILED)
+			munmap(back_buffer, framebuffer_bytes);
+	}
+
 	uint32_t* framebuffer_mmap = (uint32_t*)mmap(NULL, framebuffer_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, framebuffer_fd, 0);
 	if (framebuffer_mmap == MAP_FAILED)
 	{
@@ -35,11 +65,6 @@ Framebuffer open_framebuffer()
 	memset(framebuffer_mmap, 0, framebuffer_bytes);
 	msync(framebuffer_mmap, framebuffer_bytes, MS_SYNC);
 
-	Framebuffer framebuffer;
-	framebuffer.fd = framebuffer_fd;
 	framebuffer.mmap = framebuffer_mmap;
-	framebuffer.width = framebuffer_info.width;
-	framebuffer.height = framebuffer_info.height;
-	framebuffer.bpp = BANAN_FB_BPP;
 	return framebuffer;
 }
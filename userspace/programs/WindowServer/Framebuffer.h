@@ -10,6 +10,11 @@ struct Framebuffer
 	int32_t height;
 	uint8_t bpp;
 
+	// If video memory is mapped directly, mmap is a private back buffer
+	// and damaged areas are copied here instead of msyncing mmap
+	uint32_t* video { nullptr };
+	int32_t video_pitch { 0 }; // in pixels
+
 	Rectangle area() const { return { 0, 0, width, height }; }
 };
 
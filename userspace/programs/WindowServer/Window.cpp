@@ -1,3 +1,4 @@
+#include "Blit.h"
 #include "Window.h"
 
 #include <BAN/Debug.h>
@@ -94,8 +95,7 @@ BAN::ErrorOr<void> Window::prepare_title_bar()
 	const uint32_t font_p = m_font.pitch();
 
 	TRY(m_title_bar_data.resize(title_bar_width() * title_bar_height()));
-	for (auto& pixel : m_title_bar_data)
-		pixel = 0xFFFFFFFF;
+	blit_fill(m_title_bar_data.data(), 0xFFFFFFFF, m_title_bar_data.size());
 
 	const auto text_area = title_text_area();
 
@@ -1,3 +1,4 @@
+#include "Blit.h"
 #include "Cursor.h"
 #include "WindowServer.h"
 
@@ -14,8 +15,6 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
-#include <emmintrin.h>
-
 WindowServer::WindowServer(Framebuffer& framebuffer, int32_t corner_radius)
 	: m_framebuffer(framebuffer)
 	, m_corner_radius(corner_radius)
@@ -885,61 +884,7 @@ void WindowServer::set_focused_window(BAN::RefPtr<Window> window)
 	}
 }
 
-static uint32_t alpha_blend(uint32_t color_a, uint32_t color_b)
-{
-	const uint32_t a_a = color_a >> 24;
-	const uint32_t a_b = 0xFF - a_a;
-
-	const uint32_t rb1 = (a_a * (color_a & 0xFF00FF)) >> 8;
-	const uint32_t rb2 = (a_b * (color_b & 0xFF00FF)) >> 8;
-
-	const uint32_t g1  = (a_a * (color_a & 0x00FF00)) >> 8;
-	const uint32_t g2  = (a_b * (color_b & 0x00FF00)) >> 8;
-
-    const uint32_t a = a_a + (((color_b >> 24) * a_b) >> 8);
-	return (a << 24) | ((rb1 + rb2) & 0xFF00FF) | ((g1 + g2) & 0x00FF00);
-}
-
-static void alpha_blend4(const uint32_t color_a[4], const uint32_t color_b[4], uint32_t color_out[4])
-{
-	// load colors
-	const __m128i ca = _mm_loadu_si128((const __m128i*)color_a);
-	const __m128i cb = _mm_loadu_si128((const __m128i*)color_b);
-
-	// unpack colors to 16 bit words
-	const __m128i zero = _mm_setzero_si128();
-	const __m128i ca_lo = _mm_unpacklo_epi8(ca, zero);
-	const __m128i ca_hi = _mm_unpackhi_epi8(ca, zero);
-	const __m128i cb_lo = _mm_unpacklo_epi8(cb, zero);
-	const __m128i cb_hi = _mm_unpackhi_epi8(cb, zero);
-
-	// extract alpha channel from color_a
-	const __m128i a1_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ca_lo, 0b11'11'11'11), 0b11'11'11'11);
-	const __m128i a1_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(ca_hi, 0b11'11'11'11), 0b11'11'11'11);
-
-	// calculate inverse alpha
-	const __m128i low_byte16 = _mm_set1_epi16(0xFF);
-	const __m128i a2_lo = _mm_sub_epi16(low_byte16, a1_lo);
-	const __m128i a2_hi = _mm_sub_epi16(low_byte16, a1_hi);
-
-	// blend and pack rgb (a*c1 + c2*(255-a)) / 256
-	const __m128i rgb_lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(ca_lo, a1_lo), _mm_mullo_epi16(cb_lo, a2_lo)), 8);
-	const __m128i rgb_hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(ca_hi, a1_hi), _mm_mullo_epi16(cb_hi, a2_hi)), 8);
-	const __m128i rgb = _mm_and_si128(_mm_set1_epi32(0x00FFFFFF), _mm_packus_epi16(rgb_lo, rgb_hi));
-
-	// extract alpha channel from color_b
-	const __m128i ab_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_lo, 0b11'11'11'11), 0b11'11'11'11);
-	const __m128i ab_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(cb_hi, 0b11'11'11'11), 0b11'11'11'11);
-
-	// blend and pack alpha (a + ab*(255-a)) / 256
-	const __m128i alpha_lo = _mm_add_epi16(a1_lo, _mm_srli_epi16(_mm_mullo_epi16(ab_lo, a2_lo), 8));
-	const __m128i alpha_hi = _mm_add_epi16(a1_hi, _mm_srli_epi16(_mm_mullo_epi16(ab_hi, a2_hi), 8));
-	const __m128i alpha = _mm_slli_epi32(_mm_packus_epi16(alpha_lo, alpha_hi), 24);
-
-	_mm_storeu_si128((__m128i*)color_out, _mm_or_si128(alpha, rgb));
-}
-
-void WindowServer::invalidate(Rectangle area)
+Rectangle WindowServer::invalidate(Rectangle area)
 {
 	const Window::Cursor* window_cursor = nullptr;
 	if (auto window = this->find_hovered_window(); window && window->has_cursor())
@@ -983,11 +928,13 @@ void WindowServer::invalidate(Rectangle area)
 
 		auto focused_overlap = area.get_overlap(client_area);
 		if (!focused_overlap.has_value())
-			return;
+			return {};
 		area = focused_overlap.release_value();
 
 		const bool should_alpha_blend = m_focused_window->get_attributes().alpha_channel;
 
+		Rectangle updated_area = area;
+
 		if (client_area == m_framebuffer.area())
 		{
 			const uint32_t* client_ptr = m_focused_window->framebuffer();
@@ -1008,53 +955,73 @@ void WindowServer::invalidate(Rectangle area)
 			{
 				for (int32_t y = area.min_y; y < area.max_y; y++)
 				{
-					const uint32_t* window_row = &client_ptr[y * client_width + area.min_x];
-					const uint32_t* image_row  = &m_background_image[y * m_framebuffer.width + area.min_x];
-					uint32_t* frameb_row = &m_framebuffer.mmap[y * m_framebuffer.width + area.min_x];
-
-					int32_t pixels = area.width();
-					for (; pixels >= 4; pixels -= 4)
-					{
-						alpha_blend4(window_row, image_row, frameb_row);
-						frameb_row += 4;
-						window_row += 4;
-						image_row += 4;
-					}
-					for (; pixels > 0; pixels--)
-					{
-						*frameb_row = alpha_blend(*window_row, *image_row);
-						frameb_row++;
-						window_row++;
-						image_row++;
-					}
+					blit_alpha_blend(
+						&m_framebuffer.mmap[y * m_framebuffer.width + area.min_x],
+						&client_ptr[y * client_width + area.min_x],
+						&m_background_image[y * m_framebuffer.width + area.min_x],
+						area.width()
+					);
 				}
 			}
 		}
 		else
 		{
+			const int32_t client_width  = m_focused_window->client_width();
+			const int32_t client_height = m_focused_window->client_height();
+
 			auto opt_dst_area = Rectangle {
-				.min_x = area.min_x * m_framebuffer.width  / m_focused_window->client_width(),
-				.min_y = area.min_y * m_framebuffer.height / m_focused_window->client_height(),
-				.max_x = BAN::Math::div_round_up(area.max_x * m_framebuffer.width,  m_focused_window->client_width()),
-				.max_y = BAN::Math::div_round_up(area.max_y * m_framebuffer.height, m_focused_window->client_height())
+				.min_x = area.min_x * m_framebuffer.width  / client_width,
+				.min_y = area.min_y * m_framebuffer.height / client_height,
+				.max_x = BAN::Math::div_round_up(area.max_x * m_framebuffer.width,  client_width),
+				.max_y = BAN::Math::div_round_up(area.max_y * m_framebuffer.height, client_height)
 			}.get_overlap(m_framebuffer.area());
 			if (!opt_dst_area.has_value())
-				return;
+				return {};
 
 			const auto dst_area = opt_dst_area.release_value();
-			for (int32_t dst_y = dst_area.min_y; dst_y < dst_area.max_y; dst_y++)
+			updated_area = dst_area;
+			const size_t dst_width = dst_area.width();
+
+			if (m_scale_x_table.size() < dst_width)
+				MUST(m_scale_x_table.resize(dst_width));
+			if (should_alpha_blend && m_scale_row_buffer.size() < dst_width)
+				MUST(m_scale_row_buffer.resize(dst_width));
+
+			// source column of every destination column is the same on every row
+			for (size_t i = 0; i < dst_width; i++)
 			{
-				for (int32_t dst_x = dst_area.min_x; dst_x < dst_area.max_x; dst_x++)
-				{
-					const int32_t src_x = BAN::Math::clamp<int32_t>(dst_x * m_focused_window->client_width()  / m_framebuffer.width,  0, m_focused_window->client_width());
-					const int32_t src_y = BAN::Math::clamp<int32_t>(dst_y * m_focused_window->client_height() / m_framebuffer.height, 0, m_focused_window->client_height());
+				const int32_t dst_x = dst_area.min_x + i;
+				m_scale_x_table[i] = BAN::Math::min<int32_t>(dst_x * client_width / m_framebuffer.width, client_width - 1);
+			}
 
-					const uint32_t src_pixel = m_focused_window->framebuffer()[src_y * m_focused_window->client_width() + src_x];
-					const uint32_t bg_pixel = m_background_image[dst_y * m_framebuffer.width + dst_x];
+			int32_t prev_src_y = -1;
+			for (int32_t dst_y = dst_area.min_y; dst_y < dst_area.max_y; dst_y++)
+			{
+				const int32_t src_y = BAN::Math::min<int32_t>(dst_y * client_height / m_framebuffer.height, client_height - 1);
+				const uint32_t* src_row = &m_focused_window->framebuffer()[src_y * client_width];
+				uint32_t* frameb_row = &m_framebuffer.mmap[dst_y * m_framebuffer.width + dst_area.min_x];
 
-					uint32_t& dst_pixel = m_framebuffer.mmap[dst_y * m_framebuffer.width + dst_x];
-					dst_pixel = should_alpha_blend ? alpha_blend(src_pixel, bg_pixel) : src_pixel;
+				if (!should_alpha_blend)
+				{
+					// upscaled rows repeat, copy the row we already scaled
+					if (src_y == prev_src_y)
+						memcpy(frameb_row, frameb_row - m_framebuffer.width, dst_width * sizeof(uint32_t));
+					else
+						blit_scale_row(frameb_row, src_row, m_scale_x_table.data(), dst_width);
 				}
+				else
+				{
+					if (src_y != prev_src_y)
+						blit_scale_row(m_scale_row_buffer.data(), src_row, m_scale_x_table.data(), dst_width);
+					blit_alpha_blend(
+						frameb_row,
+						m_scale_row_buffer.data(),
+						&m_background_image[dst_y * m_framebuffer.width + dst_area.min_x],
+						dst_width
+					);
+				}
+
+				prev_src_y = src_y;
 			}
 		}
 
@@ -1066,11 +1033,20 @@ void WindowServer::invalidate(Rectangle area)
 			cursor_area.min_y -= m_focused_window->client_y();
 			cursor_area.max_y -= m_focused_window->client_y();
 			if (!area.get_overlap(cursor_area).has_value())
-				return;
+				return updated_area;
 
 			const int32_t cursor_tl_dst_x = cursor_area.min_x * m_framebuffer.width  / m_focused_window->client_width();
 			const int32_t cursor_tl_dst_y = cursor_area.min_y * m_framebuffer.height / m_focused_window->client_height();
 
+			const Rectangle cursor_dst_area {
+				.min_x = cursor_tl_dst_x,
+				.min_y = cursor_tl_dst_y,
+				.max_x = cursor_tl_dst_x + cursor_area.width(),
+				.max_y = cursor_tl_dst_y + cursor_area.height(),
+			};
+			if (auto opt_overlap = cursor_dst_area.get_overlap(m_framebuffer.area()); opt_overlap.has_value())
+				updated_area = updated_area.get_bounding_box(opt_overlap.release_value());
+
 			for (int32_t rel_y = 0; rel_y < cursor_area.height(); rel_y++)
 			{
 				for (int32_t rel_x = 0; rel_x < cursor_area.width(); rel_x++)
@@ -1091,12 +1067,12 @@ void WindowServer::invalidate(Rectangle area)
 			}
 		}
 
-		return;
+		return updated_area;
 	}
 
 	auto fb_overlap = area.get_overlap(m_framebuffer.area());
 	if (!fb_overlap.has_value())
-		return;
+		return {};
 	area = fb_overlap.release_value();
 
 	for (int32_t y = area.min_y; y < area.max_y; y++)
@@ -1239,21 +1215,7 @@ void WindowServer::invalidate(Rectangle area)
 					if (!should_alpha_blend)
 						memcpy(frameb_row, window_row, fast_overlap.width() * sizeof(uint32_t));
 					else
-					{
-						int32_t pixels = fast_overlap.width();
-						for (; pixels >= 4; pixels -= 4)
-						{
-							alpha_blend4(window_row, frameb_row, frameb_row);
-							window_row += 4;
-							frameb_row += 4;
-						}
-						for (; pixels; pixels--)
-						{
-							*frameb_row = alpha_blend(*window_row, *frameb_row);
-							window_row++;
-							frameb_row++;
-						}
-					}
+						blit_alpha_blend(frameb_row, window_row, frameb_row, fast_overlap.width());
 				}
 			}
 
@@ -1295,22 +1257,7 @@ void WindowServer::invalidate(Rectangle area)
 
 			const auto overlap = opt_overlap.release_value();
 			for (int32_t y = overlap.min_y; y < overlap.max_y; y++)
-			{
-				uint32_t* frameb_row = &m_framebuffer.mmap[y * m_framebuffer.width + overlap.min_x];
-
-				int32_t pixels = overlap.width();
-				for (; pixels >= 4; pixels -= 4)
-				{
-					const uint32_t blend_colors[] { blend_color, blend_color, blend_color, blend_color };
-					alpha_blend4(blend_colors, frameb_row, frameb_row);
-					frameb_row += 4;
-				}
-				for (; pixels > 0; pixels--)
-				{
-					*frameb_row = alpha_blend(blend_color, *frameb_row);
-					frameb_row++;
-				}
-			}
+				blit_alpha_blend_color(&m_framebuffer.mmap[y * m_framebuffer.width + overlap.min_x], blend_color, overlap.width());
 		}
 	}
 
@@ -1334,246 +1281,8 @@ void WindowServer::invalidate(Rectangle area)
 			}
 		}
 	}
-}
-
-void WindowServer::merge_damaged_areas()
-{
-	constexpr size_t max_unique_coords = m_max_damaged_areas * 2;
-
-	BAN::Array<int32_t, max_unique_coords> collapsed_x, collapsed_y;
-	uint32_t bitmap[(max_unique_coords * max_unique_coords + 31) / 32];
-
-	static constexpr auto get_collapsed_index =
-		[](const BAN::Array<int32_t, max_unique_coords>& container, size_t container_size, int32_t value) -> size_t
-		{
-			int32_t l = 0, r = container_size - 1;
-			while (l <= r)
-			{
-				const int32_t mid = l + (r - l) / 2;
-				if (container[mid] == value)
-					return mid;
-				(container[mid] < value)
-					? l = mid + 1
-					: r = mid - 1;
-			}
-			return l;
-		};
-
-	static constexpr auto collapse_value =
-		[](BAN::Array<int32_t, max_unique_coords>& container, size_t& container_size, int32_t value) -> void
-		{
-			const size_t index = get_collapsed_index(container, container_size, value);
-			if (index < container_size && container[index] == value)
-				return;
-			for (size_t i = container_size; i > index; i--)
-				container[i] = container[i - 1];
-			container[index] = value;
-			container_size++;
-		};
-
-	size_t collapsed_x_size = 0, collapsed_y_size = 0;
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-	{
-		collapse_value(collapsed_x, collapsed_x_size, m_damaged_areas[i].min_x);
-		collapse_value(collapsed_x, collapsed_x_size, m_damaged_areas[i].max_x);
-		collapse_value(collapsed_y, collapsed_y_size, m_damaged_areas[i].min_y);
-		collapse_value(collapsed_y, collapsed_y_size, m_damaged_areas[i].max_y);
-	}
-
-	const auto is_bitmap_bit_set =
-		[&](size_t x, size_t y) -> bool
-		{
-			const size_t index = y * max_unique_coords + x;
-			return (bitmap[index / 32] >> (index % 32)) & 1;
-		};
-
-	const auto set_bitmap_bit =
-		[&](size_t x, size_t y, bool set) -> void
-		{
-			const size_t index = y * max_unique_coords + x;
-			const uint32_t mask = static_cast<uint32_t>(1) << (index % 32);
-			set ? bitmap[index / 32] |=  mask
-				: bitmap[index / 32] &= ~mask;
-		};
-
-	memset(bitmap, 0, sizeof(bitmap));
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-	{
-		const size_t cmin_x = get_collapsed_index(collapsed_x, collapsed_x_size, m_damaged_areas[i].min_x);
-		const size_t cmax_x = get_collapsed_index(collapsed_x, collapsed_x_size, m_damaged_areas[i].max_x);
-		const size_t cmin_y = get_collapsed_index(collapsed_y, collapsed_y_size, m_damaged_areas[i].min_y);
-		const size_t cmax_y = get_collapsed_index(collapsed_y, collapsed_y_size, m_damaged_areas[i].max_y);
-		for (size_t y = cmin_y; y < cmax_y; y++)
-			for (size_t x = cmin_x; x < cmax_x; x++)
-				set_bitmap_bit(x, y, true);
-	}
-
-	BAN::Array<Rectangle, m_max_damaged_areas> new_rectangles;
-	size_t new_rectangle_count = 0;
 
-	for (size_t min_y = 0; min_y < collapsed_y_size; min_y++)
-	{
-		for (size_t min_x = 0; min_x < collapsed_x_size; min_x++)
-		{
-			const size_t index = min_y * max_unique_coords + min_x;
-			if (index % 32 == 0 && bitmap[index / 32] == 0)
-			{
-				min_x += 31;
-				continue;
-			}
-
-			if (!is_bitmap_bit_set(min_x, min_y))
-				continue;
-
-			size_t max_x = min_x + 1;
-			while (max_x < collapsed_x_size && is_bitmap_bit_set(max_x, min_y))
-				max_x++;
-
-			size_t max_y = min_y + 1;
-			while (max_y < collapsed_y_size)
-			{
-				bool all_bits_set = true;
-				for (size_t x = min_x; x < max_x && all_bits_set; x++)
-					all_bits_set = is_bitmap_bit_set(x, max_y);
-				if (!all_bits_set)
-					break;
-				max_y++;
-			}
-
-			new_rectangles[new_rectangle_count++] = {
-				.min_x = collapsed_x[min_x],
-				.min_y = collapsed_y[min_y],
-				.max_x = collapsed_x[max_x],
-				.max_y = collapsed_y[max_y],
-			};
-			if (new_rectangle_count >= m_damaged_area_count)
-				return;
-
-			for (size_t y = min_y; y < max_y; y++)
-				for (size_t x = min_x; x < max_x; x++)
-					set_bitmap_bit(x, y, false);
-		}
-	}
-
-	memcpy(
-		m_damaged_areas.data(),
-		new_rectangles.data(),
-		new_rectangle_count * sizeof(Rectangle)
-	);
-	m_damaged_area_count = new_rectangle_count;
-}
-
-void WindowServer::add_damaged_area_impl(Rectangle new_rect)
-{
-	if (new_rect.area() == 0)
-		return;
-
-	const auto remove_rectangle =
-		[this](size_t index)
-		{
-			memmove(
-				m_damaged_areas.data() + index,
-				m_damaged_areas.data() + index + 1,
-				(m_damaged_area_count - index - 1) * sizeof(Rectangle)
-			);
-			m_damaged_area_count--;
-		};
-
-	// handle trivial cases where `new_rect` contains or is contained by another rectangle
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-	{
-		auto opt_overlap = m_damaged_areas[i].get_overlap(new_rect);
-		if (!opt_overlap.has_value())
-			continue;
-		const auto overlap = opt_overlap.value();
-		if (overlap == new_rect)
-			return;
-		if (overlap == m_damaged_areas[i])
-			remove_rectangle(i--);
-	}
-
-	// split `new_rect` into smaller pieces if there are overlapping rectangles
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-	{
-		auto opt_overlap = m_damaged_areas[i].get_overlap(new_rect);
-		if (!opt_overlap.has_value())
-			continue;
-		const auto overlap = opt_overlap.value();
-
-		Rectangle splitted[9];
-
-		size_t count = new_rect.split_along_edges_of(m_damaged_areas[i], splitted);
-		if (count == 6)
-		{
-			count = m_damaged_areas[i].split_along_edges_of(new_rect, splitted);
-			remove_rectangle(i);
-			add_damaged_area_impl(new_rect);
-		}
-
-		for (size_t j = 0; j < count; j++)
-			if (splitted[j] != overlap)
-				add_damaged_area_impl(splitted[j]);
-		return;
-	}
-
-	// combine existing rectangles if needed
-	if (m_damaged_area_count >= m_damaged_areas.size())
-		merge_damaged_areas();
-
-	// insert `new_rect` to the set of rectangles
-	if (m_damaged_area_count < m_damaged_areas.size())
-	{
-		m_damaged_areas[m_damaged_area_count++] = new_rect;
-		return;
-	}
-
-	const auto get_bounding_box_without_overlap =
-		[this](const Rectangle& a, const Rectangle& b) -> Rectangle
-		{
-			auto bounding_box = a.get_bounding_box(b);
-
-			for (;;)
-			{
-				bool did_update = false;
-				for (size_t i = 0; i < m_damaged_area_count; i++)
-				{
-					const auto opt_overlap = m_damaged_areas[i].get_overlap(bounding_box);
-					if (!opt_overlap.has_value() || opt_overlap.value() == m_damaged_areas[i])
-						continue;
-					bounding_box = bounding_box.get_bounding_box(m_damaged_areas[i]);
-					did_update = true;
-				}
-
-				if (!did_update)
-					return bounding_box;
-			}
-		};
-
-	// find the rectangles whose bounding box with this adds least area and does not overlap with other rectangles
-
-	int32_t min_overflow = BAN::numeric_limits<int32_t>::max();
-	Rectangle min_overflow_bb = {};
-
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-	{
-		for (size_t j = i + 1; j < m_damaged_area_count; j++)
-		{
-			const auto bounding_box = get_bounding_box_without_overlap(m_damaged_areas[i], m_damaged_areas[j]);
-
-			int32_t overflow = bounding_box.area();
-			for (size_t k = 0; k < m_damaged_area_count; k++)
-				overflow -= bounding_box.get_overlap(m_damaged_areas[k]).value_or({}).area();
-			overflow -= bounding_box.get_overlap(new_rect).value_or({}).area();
-
-			if (overflow >= min_overflow)
-				continue;
-			min_overflow = overflow;
-			min_overflow_bb = bounding_box;
-		}
-	}
-
-	add_damaged_area_impl(min_overflow_bb);
-	add_damaged_area_impl(new_rect);
+	return area;
 }
 
 void WindowServer::add_damaged_area(Rectangle new_rect)
@@ -1581,8 +1290,7 @@ void WindowServer::add_damaged_area(Rectangle new_rect)
 	auto opt_fb_overlap = new_rect.get_overlap(m_framebuffer.area());
 	if (!opt_fb_overlap.has_value())
 		return;
-	add_damaged_area_impl(opt_fb_overlap.release_value());
-	merge_damaged_areas();
+	m_damage.add(opt_fb_overlap.release_value());
 }
 
 void WindowServer::sync()
@@ -1609,21 +1317,55 @@ void WindowServer::sync()
 			dir_y = -dir_y;
 	}
 
-	for (size_t i = 0; i < m_damaged_area_count; i++)
-		invalidate(m_damaged_areas[i]);
+	if (m_framebuffer.video)
+	{
+		// compose in strips small enough to stay in cache and stream every
+		// strip to video memory while it is still hot, so back buffer is
+		// written once and never read back from memory
+		for (const auto& area : m_damage)
+		{
+			const int32_t strip_rows = BAN::Math::max<int32_t>(1, m_max_strip_bytes / (area.width() * sizeof(uint32_t)));
+			for (int32_t y = area.min_y; y < area.max_y; y += strip_rows)
+			{
+				const auto updated = invalidate({
+					.min_x = area.min_x,
+					.min_y = y,
+					.max_x = area.max_x,
+					.max_y = BAN::Math::min(y + strip_rows, area.max_y),
+				});
+
+				for (int32_t row = updated.min_y; row < updated.max_y; row++)
+				{
+					blit_stream_copy(
+						&m_framebuffer.video[row * m_framebuffer.video_pitch + updated.min_x],
+						&m_framebuffer.mmap[row * m_framebuffer.width + updated.min_x],
+						updated.width()
+					);
+				}
+			}
+		}
 
-	for (size_t i = 0; i < m_damaged_area_count; i++)
+		blit_stream_fence();
+	}
+	else
 	{
-		const fb_msync_region region {
-			.min_x = static_cast<uint32_t>(m_damaged_areas[i].min_x),
-			.min_y = static_cast<uint32_t>(m_damaged_areas[i].min_y),
-			.max_x = static_cast<uint32_t>(m_damaged_areas[i].max_x),
-			.max_y = static_cast<uint32_t>(m_damaged_areas[i].max_y),
-		};
-		ioctl(m_framebuffer.fd, FB_MSYNC_RECTANGLE, &region);
+		for (const auto& area : m_damage)
+		{
+			const auto updated = invalidate(area);
+			if (updated.area() == 0)
+				continue;
+
+			const fb_msync_region region {
+				.min_x = static_cast<uint32_t>(updated.min_x),
+				.min_y = static_cast<uint32_t>(updated.min_y),
+				.max_x = static_cast<uint32_t>(updated.max_x),
+				.max_y = static_cast<uint32_t>(updated.max_y),
+			};
+			ioctl(m_framebuffer.fd, FB_MSYNC_RECTANGLE, &region);
+		}
 	}
 
-	m_damaged_area_count = 0;
+	m_damage.clear();
 }
 
 Rectangle WindowServer::cursor_area() const
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "DamageRegion.h"
 #include "Framebuffer.h"
 #include "Window.h"
 
@@ -52,7 +53,8 @@ public:
 	void on_mouse_scroll(LibInput::MouseScrollEvent event);
 
 	void set_focused_window(BAN::RefPtr<Window> window);
-	void invalidate(Rectangle area);
+	// returns the area of the framebuffer that was updated
+	Rectangle invalidate(Rectangle area);
 	void sync();
 
 	Rectangle cursor_area() const;
@@ -62,15 +64,13 @@ public:
 	void remove_client_fd(int fd);
 	ClientData& get_client_data(int fd);
 
-	bool is_damaged() const { return m_damaged_area_count > 0 || m_is_bouncing_window; }
+	bool is_damaged() const { return !m_damage.empty() || m_is_bouncing_window; }
 	bool is_stopped() const { return m_is_stopped; }
 
 private:
 	void on_mouse_move_impl(int32_t new_x, int32_t new_y);
 
-	void merge_damaged_areas();
 	void add_damaged_area(Rectangle area);
-	void add_damaged_area_impl(Rectangle area);
 
 	bool resize_window(BAN::RefPtr<Window> window, uint32_t width, uint32_t height);
 	void move_window(BAN::RefPtr<Window> window, int32_t x, int32_t y);
@@ -98,13 +98,18 @@ private:
 
 	const int32_t m_corner_radius;
 
-	static constexpr size_t m_max_damaged_areas = 32;
-	size_t m_damaged_area_count { 0 };
-	BAN::Array<Rectangle, m_max_damaged_areas> m_damaged_areas;
+	DamageRegion m_damage;
+
+	// composition strip size when writing directly to video memory
+	static constexpr int32_t m_max_strip_bytes = 64 * 1024;
 
 	// NOTE: same size as framebuffer
 	BAN::Vector<uint32_t> m_background_image;
 
+	// scratch buffers for scaling fullscreen windows
+	BAN::Vector<uint32_t> m_scale_x_table;
+	BAN::Vector<uint32_t> m_scale_row_buffer;
+
 	State m_state { State::Normal };
 	bool m_is_mod_key_held { false };
 	BAN::RefPtr<Window> m_focused_window;
@@ -1,3 +1,4 @@
+#include "Blit.h"
 #include "WindowServer.h"
 
 #include <BAN/Debug.h>
@@ -207,6 +208,9 @@ int main()
 	for (int sig : ignored_signals)
 		signal(sig, SIG_IGN);
 
+	initialize_blit();
+	dprintln("Using {} blit routines", blit_implementation_name());
+
 	MUST(LibInput::KeyboardLayout::initialize());
 	MUST(LibInput::KeyboardLayout::get().load_from_file("/usr/share/keymaps/us.keymap"_sv));
 
@@ -7,21 +7,60 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <netinet/in.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+// requests whose header and body do not fit in this are rejected
+static constexpr size_t s_max_request_size = 64 * 1024;
+// upper bound on bytes sent to one client before serving others
+static constexpr size_t s_max_flush_size = 1024 * 1024;
+
+// filled before worker threads are started, only read afterwards
+static BAN::HashMap<unsigned, BAN::StringView> s_status_to_brief;
+static BAN::HashMap<BAN::StringView, BAN::StringView> s_extension_to_mime;
+
+static void initialize_status_to_brief();
+static void initialize_extension_to_mime();
 static BAN::StringView status_to_brief(unsigned);
 static BAN::StringView extension_to_mime(BAN::StringView);
 
+static bool equals_case_insensitive(BAN::StringView a, BAN::StringView b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (tolower(a[i]) != tolower(b[i]))
+			return false;
+	return true;
+}
+
 HTTPServer::HTTPServer() = default;
 
 HTTPServer::~HTTPServer()
 {
+	for (auto& worker : m_workers)
+	{
+		for (auto& [fd, client] : worker->clients)
+		{
+			if (client.file_fd != -1)
+				close(client.file_fd);
+			close(fd);
+		}
+		if (worker->epoll_fd != -1)
+			close(worker->epoll_fd);
+		for (int fd : worker->pipe_fds)
+			if (fd != -1)
+				close(fd);
+	}
+
 	if (m_listen_socket != -1)
 		close(m_listen_socket);
 }
 
-BAN::ErrorOr<void> HTTPServer::initialize(BAN::StringView root, BAN::IPv4Address ip, int port)
+BAN::ErrorOr<void> HTTPServer::initialize(BAN::StringView root, BAN::IPv4Address ip, int port, size_t worker_count)
 {
 	{
 		char path_buffer[PATH_MAX];
@@ -36,12 +75,41 @@ BAN::ErrorOr<void> HTTPServer::initialize(BAN::StringView root, BAN::IPv4Address
 		TRY(m_web_root.append(canonical_buffer));
 	}
 
+	if (s_status_to_brief.empty())
+		initialize_status_to_brief();
+	if (s_extension_to_mime.empty())
+		initialize_extension_to_mime();
+
+	if (worker_count == 0)
+		worker_count = 1;
+
+	TRY(m_workers.reserve(worker_count));
+	for (size_t i = 0; i < worker_count; i++)
+	{
+		auto worker = TRY(BAN::UniqPtr<Worker>::create());
+		worker->server = this;
+
+		worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (worker->epoll_fd == -1)
+			return BAN::Error::from_errno(errno);
+
+		// accepted connections are handed to the worker through this pipe
+		if (pipe(worker->pipe_fds) == -1)
+			return BAN::Error::from_errno(errno);
+
+		epoll_event event { .events = EPOLLIN, .data = { .fd = worker->pipe_fds[0] } };
+		if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->pipe_fds[0], &event) == -1)
+			return BAN::Error::from_errno(errno);
+
+		TRY(m_workers.push_back(BAN::move(worker)));
+	}
+
 	sockaddr_in addr;
 	addr.sin_family = AF_INET;
 	addr.sin_port = htons(port);
 	addr.sin_addr.s_addr = ip.raw;
 
-	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
 	if (sock == -1)
 		return BAN::Error::from_errno(errno);
 	BAN::ScopeGuard socket_guard([sock] { close(sock); });
@@ -61,78 +129,205 @@ BAN::ErrorOr<void> HTTPServer::initialize(BAN::StringView root, BAN::IPv4Address
 void HTTPServer::start()
 {
 	ASSERT(m_listen_socket != -1);
+	ASSERT(!m_workers.empty());
+
+	for (auto& worker : m_workers)
+	{
+		if (int ret = pthread_create(&worker->thread, nullptr, &HTTPServer::worker_entry, worker.ptr()))
+		{
+			dwarnln("pthread_create: {}", strerror(ret));
+			return;
+		}
+	}
 
+	// main thread only accepts connections and distributes them round robin
 	while (true)
 	{
-		fd_set fds;
-		FD_ZERO(&fds);
+		int client_fd = accept4(m_listen_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (client_fd == -1)
+		{
+			if (errno != EINTR)
+				perror("accept");
+			continue;
+		}
 
-		FD_SET(m_listen_socket, &fds);
-		int max_fd = m_listen_socket;
+		auto& worker = *m_workers[m_next_worker];
+		m_next_worker = (m_next_worker + 1) % m_workers.size();
 
-		for (const auto& [fd, _] : m_client_data)
+		if (write(worker.pipe_fds[1], &client_fd, sizeof(client_fd)) != sizeof(client_fd))
 		{
-			FD_SET(fd, &fds);
-			max_fd = BAN::Math::max(max_fd, fd);
+			perror("write");
+			close(client_fd);
 		}
+	}
+}
+
+void* HTTPServer::worker_entry(void* arg)
+{
+	auto& worker = *static_cast<Worker*>(arg);
+	worker.server->worker_loop(worker);
+	return nullptr;
+}
+
+void HTTPServer::worker_loop(Worker& worker)
+{
+	epoll_event events[64];
 
-		if (select(max_fd + 1, &fds, nullptr, nullptr, nullptr) == -1)
+	while (true)
+	{
+		int event_count = epoll_pwait2(worker.epoll_fd, events, sizeof(events) / sizeof(*events), nullptr, nullptr);
+		if (event_count == -1)
 		{
-			perror("select");
+			if (errno == EINTR)
+				continue;
+			perror("epoll_pwait2");
 			break;
 		}
 
-		if (FD_ISSET(m_listen_socket, &fds))
+		for (int i = 0; i < event_count; i++)
 		{
-			int new_fd = accept(m_listen_socket, nullptr, nullptr);
-			if (new_fd == -1)
+			const int fd = events[i].data.fd;
+
+			if (fd == worker.pipe_fds[0])
 			{
-				perror("accept");
+				int client_fds[32];
+				ssize_t nread = read(fd, client_fds, sizeof(client_fds));
+				if (nread == -1)
+				{
+					perror("read");
+					continue;
+				}
+				for (size_t j = 0; j < nread / sizeof(int); j++)
+					add_client(worker, client_fds[j]);
 				continue;
 			}
-			MUST(m_client_data.emplace(new_fd));
-		}
 
-		for (auto& [fd, data] : m_client_data)
-		{
-			if (!FD_ISSET(fd, &fds))
+			auto it = worker.clients.find(fd);
+			if (it == worker.clients.end())
 				continue;
+			auto& client = it->value;
 
-			char buffer[1024];
-			int nrecv = recv(fd, buffer, sizeof(buffer), 0);
-			if (nrecv < 0)
-				perror("recv");
-			if (nrecv <= 0)
-			{
-				close(fd);
-				m_client_data.remove(fd);
-				break;
-			}
+			bool keep_open = true;
+			if (events[i].events & EPOLLIN)
+				keep_open = receive_client_data(fd, client);
+			else if (!(events[i].events & EPOLLOUT))
+				keep_open = false;
 
-			size_t old_size = data.size();
-			if (data.resize(old_size + nrecv).is_error())
-			{
-				close(fd);
-				m_client_data.remove(fd);
-				break;
-			}
+			if (keep_open)
+				keep_open = process_client(worker, fd, client);
 
-			memcpy(data.data() + old_size, buffer, nrecv);
+			if (!keep_open)
+				remove_client(worker, fd);
+		}
+	}
+}
 
-			if (!handle_all_requests(fd, data))
-			{
-				close(fd);
-				m_client_data.remove(fd);
-				break;
-			}
+void HTTPServer::add_client(Worker& worker, int fd)
+{
+	auto it_or_error = worker.clients.emplace(fd);
+	if (it_or_error.is_error())
+	{
+		close(fd);
+		return;
+	}
+
+	auto& client = it_or_error.value()->value;
+	client.epoll_events = EPOLLIN;
+
+	epoll_event event { .events = client.epoll_events, .data = { .fd = fd } };
+	if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+	{
+		perror("epoll_ctl");
+		worker.clients.remove(fd);
+		close(fd);
+	}
+}
+
+void HTTPServer::remove_client(Worker& worker, int fd)
+{
+	auto it = worker.clients.find(fd);
+	ASSERT(it != worker.clients.end());
+
+	if (it->value.file_fd != -1)
+		close(it->value.file_fd);
+	worker.clients.remove(it);
+
+	epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+}
+
+bool HTTPServer::set_client_events(Worker& worker, int fd, Client& client, uint32_t events)
+{
+	if (client.epoll_events == events)
+		return true;
+
+	epoll_event event { .events = events, .data = { .fd = fd } };
+	if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)
+	{
+		perror("epoll_ctl");
+		return false;
+	}
+
+	client.epoll_events = events;
+	return true;
+}
+
+bool HTTPServer::receive_client_data(int fd, Client& client)
+{
+	while (client.input.size() <= s_max_request_size)
+	{
+		const size_t old_size = client.input.size();
+		if (client.input.resize(old_size + 4096).is_error())
+			return false;
+
+		ssize_t nrecv = recv(fd, client.input.data() + old_size, 4096, 0);
+		MUST(client.input.resize(old_size + BAN::Math::max<ssize_t>(nrecv, 0)));
+
+		if (nrecv == 0)
+			return false;
+		if (nrecv == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return true;
+			if (errno == EINTR)
+				continue;
+			perror("recv");
+			return false;
 		}
 	}
+
+	return true;
 }
 
-BAN::ErrorOr<HTTPRequest> HTTPServer::get_http_request(BAN::Vector<uint8_t>& data_vec)
+bool HTTPServer::process_client(Worker& worker, int fd, Client& client)
 {
-	auto data = BAN::ConstByteSpan(data_vec.span());
+	while (true)
+	{
+		if (client.has_response())
+		{
+			auto result = flush_response(fd, client);
+			if (result.is_error())
+				return false;
+			// wait until the socket is writable before sending more or looking at further requests
+			if (!result.value())
+				return set_client_events(worker, fd, client, EPOLLOUT);
+			if (!client.keep_alive)
+				return false;
+		}
+
+		if (auto ret = prepare_response(client); ret.is_error())
+		{
+			if (ret.error().get_error_code() != ENODATA)
+				return false;
+			if (client.input.size() > s_max_request_size)
+				return false;
+			return set_client_events(worker, fd, client, EPOLLIN);
+		}
+	}
+}
 
+BAN::ErrorOr<HTTPRequest> HTTPServer::get_http_request(BAN::ConstByteSpan data)
+{
 	if (data.size() < 4)
 		return BAN::Error::from_errno(ENODATA);
 	size_t len = 0;
@@ -193,100 +388,152 @@ BAN::ErrorOr<HTTPRequest> HTTPServer::get_http_request(BAN::Vector<uint8_t>& dat
 
 		TRY(request.headers.emplace_back(name, value));
 
-		if (name.size() == "Content-Length"_sv.size())
-		{
-			bool is_content_length = true;
-			for (size_t i = 0; i < name.size() && is_content_length; i++)
-				if (tolower(name[i]) != tolower("Content-Length"_sv[i]))
-					is_content_length = false;
-			if (is_content_length)
-				content_length = strtoul(value.data(), nullptr, 10);
-		}
+		if (equals_case_insensitive(name, "Content-Length"_sv))
+			content_length = strtoul(value.data(), nullptr, 10);
 	}
 
+	if (content_length > s_max_request_size)
+		return BAN::Error::from_errno(EINVAL);
 	if (data.size() < len + 4 + content_length)
 		return BAN::Error::from_errno(ENODATA);
 
 	request.body = data.slice(len + 4, content_length);
-
-	{
-		size_t request_size = len + 4 + content_length;
-		size_t new_size = data.size() - request_size;
-		memmove(data_vec.data(), data_vec.data() + request_size, new_size);
-		MUST(data_vec.resize(new_size));
-	}
+	request.size = len + 4 + content_length;
 
 	return request;
 }
 
-BAN::ErrorOr<void> HTTPServer::send_http_response(int fd, unsigned status, BAN::ConstByteSpan data, BAN::StringView mime)
+BAN::ErrorOr<void> HTTPServer::prepare_response(Client& client)
 {
+	ASSERT(!client.has_response());
+
+	auto request = TRY(get_http_request(client.input.span()));
+
+	dprintln("{} {} {}", request.method, request.path, request.version);
+
+	// HTTP/1.1 defaults to persistent connections, older versions have to ask for it
+	client.keep_alive = (request.version == "HTTP/1.1"_sv);
+	for (const auto& header : request.headers)
+	{
+		if (!equals_case_insensitive(header.name, "Connection"_sv))
+			continue;
+		if (equals_case_insensitive(header.value, "close"_sv))
+			client.keep_alive = false;
+		else if (equals_case_insensitive(header.value, "keep-alive"_sv))
+			client.keep_alive = true;
+	}
+
+	BAN::StringView mime;
+	auto status_or_error = handle_request(request, client, mime);
+
+	// request points into the input buffer, so it can only be dropped now
+	const size_t new_size = client.input.size() - request.size;
+	memmove(client.input.data(), client.input.data() + request.size, new_size);
+	MUST(client.input.resize(new_size));
+
+	if (status_or_error.is_error())
+		return status_or_error.release_error();
+	const unsigned status = status_or_error.value();
+
 	dprintln("HTTP/1.1 {} {}", status, status_to_brief(status));
 
-	BAN::String output;
-	TRY(output.append(MUST(BAN::String::formatted("HTTP/1.1 {} {}\r\n", status, status_to_brief(status)))));
+	TRY(client.output.append(TRY(BAN::String::formatted("HTTP/1.1 {} {}\r\n", status, status_to_brief(status)))));
 	if (!mime.empty())
-		TRY(output.append(MUST(BAN::String::formatted("Content-Type: {}\r\n", mime))));
-	TRY(output.append(MUST(BAN::String::formatted("Content-Length: {}\r\n", data.size()))));
-	TRY(output.append("\r\n"));
+		TRY(client.output.append(TRY(BAN::String::formatted("Content-Type: {}\r\n", mime))));
+	TRY(client.output.append(TRY(BAN::String::formatted("Content-Length: {}\r\n", client.file_size))));
+	TRY(client.output.append(client.keep_alive ? "Connection: keep-alive\r\n"_sv : "Connection: close\r\n"_sv));
+	TRY(client.output.append("\r\n"_sv));
 
+	return {};
+}
+
+BAN::ErrorOr<bool> HTTPServer::flush_response(int fd, Client& client)
+{
 	size_t total_sent = 0;
-	while (total_sent < output.size())
+
+	while (client.output_sent < client.output.size())
 	{
-		ssize_t nsend = send(fd, output.data() + total_sent, output.size() - total_sent, 0);
+		ssize_t nsend = send(fd, client.output.data() + client.output_sent, client.output.size() - client.output_sent, MSG_NOSIGNAL);
 		if (nsend == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			if (errno == EINTR)
+				continue;
 			return BAN::Error::from_errno(errno);
+		}
 		if (nsend == 0)
 			return BAN::Error::from_errno(ECONNRESET);
+		client.output_sent += nsend;
 		total_sent += nsend;
 	}
 
-	total_sent = 0;
-	while (total_sent < data.size())
+	// file contents are copied by the kernel straight into the socket, as much as fits at a time
+	while (client.file_fd != -1 && client.file_offset < client.file_size)
 	{
-		ssize_t nsend = send(fd, data.data() + total_sent, data.size() - total_sent, 0);
+		if (total_sent >= s_max_flush_size)
+			return false;
+
+		ssize_t nsend = sendfile(fd, client.file_fd, &client.file_offset, client.file_size - client.file_offset);
 		if (nsend == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			if (errno == EINTR)
+				continue;
 			return BAN::Error::from_errno(errno);
+		}
 		if (nsend == 0)
 			return BAN::Error::from_errno(ECONNRESET);
 		total_sent += nsend;
 	}
 
-	return {};
+	if (client.file_fd != -1)
+		close(client.file_fd);
+	client.file_fd = -1;
+	client.file_offset = 0;
+	client.file_size = 0;
+	client.output.clear();
+	client.output_sent = 0;
+
+	return true;
 }
 
-BAN::ErrorOr<unsigned> HTTPServer::handle_request(int fd, BAN::Vector<uint8_t>& data)
+BAN::ErrorOr<unsigned> HTTPServer::handle_request(const HTTPRequest& request, Client& client, BAN::StringView& mime)
 {
-	auto request_or_error = get_http_request(data);
-	if (request_or_error.is_error())
-		return request_or_error.release_error();
-	auto request = request_or_error.release_value();
+	ASSERT(client.file_fd == -1);
 
-	dprintln("{} {} {}", request.method, request.path, request.version);
+	auto path = request.path;
 
 	// remove query string
-	if (auto idx = request.path.find('?'); idx.has_value())
-		request.path = request.path.substring(0, idx.value());
+	if (auto idx = path.find('?'); idx.has_value())
+		path = path.substring(0, idx.value());
 
 	// illegal path
-	if (request.path.empty() || request.path.front() != '/')
+	if (path.empty() || path.front() != '/')
 		return 400;
 
 	BAN::StringView path_suffix;
-	if (request.path.back() == '/')
+	if (path.back() == '/')
 		path_suffix = "index.html"_sv;
 	else
 	{
-		auto file = request.path.substring(request.path.rfind('/').value());
+		auto file = path.substring(path.rfind('/').value());
 		if (!file.contains('.'))
-			path_suffix = ".html"_sv;
+		{
+			// directory without the trailing slash is served its index
+			auto dir_path = TRY(BAN::String::formatted("{}{}", m_web_root, path));
+			struct stat dir_st;
+			if (stat(dir_path.data(), &dir_st) == 0 && S_ISDIR(dir_st.st_mode))
+				path_suffix = "/index.html"_sv;
+			else
+				path_suffix = ".html"_sv;
+		}
 	}
 
-	auto target_path = TRY(BAN::String::formatted("{}{}{}", m_web_root, request.path, path_suffix));
+	auto target_path = TRY(BAN::String::formatted("{}{}{}", m_web_root, path, path_suffix));
 	auto extension = target_path.sv().substring(target_path.sv().rfind('.').value());
 
-	dprintln("looking for '{}'", target_path);
-
 	char canonical_buffer[PATH_MAX];
 	if (realpath(target_path.data(), canonical_buffer) == NULL)
 	{
@@ -304,213 +551,199 @@ BAN::ErrorOr<unsigned> HTTPServer::handle_request(int fd, BAN::Vector<uint8_t>&
 				return BAN::Error::from_errno(errno);
 		}
 	}
-	dprintln("validating '{}'", canonical_buffer);
 	if (strncmp(canonical_buffer, m_web_root.data(), m_web_root.size()))
-		return BAN::Error::from_errno(403);
+		return 403;
 
-	int file_fd = open(canonical_buffer, O_RDONLY);
+	int file_fd = open(canonical_buffer, O_RDONLY | O_CLOEXEC);
 	if (file_fd == -1)
 		return (errno == EACCES) ? 403 : 404;
-	BAN::ScopeGuard _([file_fd] { close(file_fd); });
 
 	struct stat file_st;
 	if (fstat(file_fd, &file_st) == -1)
+	{
+		close(file_fd);
 		return 500;
+	}
 
-	BAN::Vector<uint8_t> file_data;
-	if (file_data.resize(file_st.st_size).is_error())
-		return 500;
-
-	if (read(file_fd, file_data.data(), file_data.size()) == -1)
-		return 500;
+	// only regular files can be sent, this has to be known before any headers are sent
+	if (!S_ISREG(file_st.st_mode))
+	{
+		close(file_fd);
+		return S_ISDIR(file_st.st_mode) ? 403 : 404;
+	}
 
-	TRY(send_http_response(fd, 200, BAN::ConstByteSpan(file_data.span()), extension_to_mime(extension)));
+	client.file_fd = file_fd;
+	client.file_offset = 0;
+	client.file_size = file_st.st_size;
+	mime = extension_to_mime(extension);
 
 	return 200;
 }
 
-bool HTTPServer::handle_all_requests(int fd, BAN::Vector<uint8_t>& data)
+static void initialize_status_to_brief()
 {
-	while (true)
-	{
-		auto result = handle_request(fd, data);
-		if (result.is_error() && result.error().get_error_code() == ENODATA)
-			return true;
-		if (result.is_error())
-			return false;
-		if (result.value() == 200)
-			continue;
-		if (send_http_response(fd, result.value(), {}, {}).is_error())
-			return false;
-	}
+	MUST(s_status_to_brief.emplace(100, "Continue"_sv));
+	MUST(s_status_to_brief.emplace(101, "Switching Protocols"_sv));
+	MUST(s_status_to_brief.emplace(102, "Processing"_sv));
+	MUST(s_status_to_brief.emplace(103, "Early Hints"_sv));
+
+	MUST(s_status_to_brief.emplace(200, "OK"_sv));
+	MUST(s_status_to_brief.emplace(201, "Created"_sv));
+	MUST(s_status_to_brief.emplace(202, "Accepted"_sv));
+	MUST(s_status_to_brief.emplace(203, "Non-Authoritative Information"_sv));
+	MUST(s_status_to_brief.emplace(204, "No Content"_sv));
+	MUST(s_status_to_brief.emplace(205, "Reset Content"_sv));
+	MUST(s_status_to_brief.emplace(206, "Partial Content"_sv));
+	MUST(s_status_to_brief.emplace(207, "Multi-Status"_sv));
+	MUST(s_status_to_brief.emplace(208, "Already Reported"_sv));
+	MUST(s_status_to_brief.emplace(226, "IM Used"_sv));
+
+	MUST(s_status_to_brief.emplace(300, "Multiple Choices"_sv));
+	MUST(s_status_to_brief.emplace(301, "Moved Permanently"_sv));
+	MUST(s_status_to_brief.emplace(302, "Found"_sv));
+	MUST(s_status_to_brief.emplace(303, "See Other"_sv));
+	MUST(s_status_to_brief.emplace(304, "Not Modified"_sv));
+	MUST(s_status_to_brief.emplace(305, "Use Proxy"_sv));
+	MUST(s_status_to_brief.emplace(306, "Switch Proxy"_sv));
+	MUST(s_status_to_brief.emplace(307, "Temporary Redirect"_sv));
+	MUST(s_status_to_brief.emplace(308, "Permanent Redirect"_sv));
+
+	MUST(s_status_to_brief.emplace(400, "Bad Request"_sv));
+	MUST(s_status_to_brief.emplace(401, "Unauthorized"_sv));
+	MUST(s_status_to_brief.emplace(402, "Payment Required Experimental"_sv));
+	MUST(s_status_to_brief.emplace(403, "Forbidden"_sv));
+	MUST(s_status_to_brief.emplace(404, "Not Found"_sv));
+	MUST(s_status_to_brief.emplace(405, "Method Not Allowed"_sv));
+	MUST(s_status_to_brief.emplace(406, "Not Acceptable"_sv));
+	MUST(s_status_to_brief.emplace(407, "Proxy Authentication Required"_sv));
+	MUST(s_status_to_brief.emplace(408, "Request Timeout"_sv));
+	MUST(s_status_to_brief.emplace(409, "Conflict"_sv));
+	MUST(s_status_to_brief.emplace(410, "Gone"_sv));
+	MUST(s_status_to_brief.emplace(411, "Length Required"_sv));
+	MUST(s_status_to_brief.emplace(412, "Precondition Failed"_sv));
+	MUST(s_status_to_brief.emplace(413, "Payload Too Large"_sv));
+	MUST(s_status_to_brief.emplace(414, "URI Too Long"_sv));
+	MUST(s_status_to_brief.emplace(415, "Unsupported Media Type"_sv));
+	MUST(s_status_to_brief.emplace(416, "Range Not Satisfiable"_sv));
+	MUST(s_status_to_brief.emplace(417, "Expectation Failed"_sv));
+	MUST(s_status_to_brief.emplace(418, "I'm a teapot"_sv));
+	MUST(s_status_to_brief.emplace(421, "Misdirected Request"_sv));
+	MUST(s_status_to_brief.emplace(422, "Unprocessable Content (WebDAV)"_sv));
+	MUST(s_status_to_brief.emplace(423, "Locked (WebDAV)"_sv));
+	MUST(s_status_to_brief.emplace(424, "Failed Dependency (WebDAV)"_sv));
+	MUST(s_status_to_brief.emplace(425, "Too Early Experimental"_sv));
+	MUST(s_status_to_brief.emplace(426, "Upgrade Required"_sv));
+	MUST(s_status_to_brief.emplace(428, "Precondition Required"_sv));
+	MUST(s_status_to_brief.emplace(429, "Too Many Requests"_sv));
+	MUST(s_status_to_brief.emplace(431, "Request Header Fields Too Large"_sv));
+	MUST(s_status_to_brief.emplace(451, "Unavailable For Legal Reasons"_sv));
+
+	MUST(s_status_to_brief.emplace(500, "Internal Server Error"_sv));
+	MUST(s_status_to_brief.emplace(501, "Not Implemented"_sv));
+	MUST(s_status_to_brief.emplace(502, "Bad Gateway"_sv));
+	MUST(s_status_to_brief.emplace(503, "Service Unavailable"_sv));
+	MUST(s_status_to_brief.emplace(504, "Gateway Timeout"_sv));
+	MUST(s_status_to_brief.emplace(505, "HTTP Version Not Supported"_sv));
+	MUST(s_status_to_brief.emplace(506, "Variant Also Negotiates"_sv));
+	MUST(s_status_to_brief.emplace(507, "Insufficient Storage (WebDAV)"_sv));
+	MUST(s_status_to_brief.emplace(508, "Loop Detected (WebDAV)"_sv));
+	MUST(s_status_to_brief.emplace(510, "Not Extended"_sv));
+	MUST(s_status_to_brief.emplace(511, "Network Authentication Required"_sv));
 }
 
 static BAN::StringView status_to_brief(unsigned status)
 {
-	static BAN::HashMap<unsigned, BAN::StringView> status_to_brief;
-	if (status_to_brief.empty())
-	{
-		MUST(status_to_brief.emplace(100, "Continue"_sv));
-		MUST(status_to_brief.emplace(101, "Switching Protocols"_sv));
-		MUST(status_to_brief.emplace(102, "Processing"_sv));
-		MUST(status_to_brief.emplace(103, "Early Hints"_sv));
-
-		MUST(status_to_brief.emplace(200, "OK"_sv));
-		MUST(status_to_brief.emplace(201, "Created"_sv));
-		MUST(status_to_brief.emplace(202, "Accepted"_sv));
-		MUST(status_to_brief.emplace(203, "Non-Authoritative Information"_sv));
-		MUST(status_to_brief.emplace(204, "No Content"_sv));
-		MUST(status_to_brief.emplace(205, "Reset Content"_sv));
-		MUST(status_to_brief.emplace(206, "Partial Content"_sv));
-		MUST(status_to_brief.emplace(207, "Multi-Status"_sv));
-		MUST(status_to_brief.emplace(208, "Already Reported"_sv));
-		MUST(status_to_brief.emplace(226, "IM Used"_sv));
-
-		MUST(status_to_brief.emplace(300, "Multiple Choices"_sv));
-		MUST(status_to_brief.emplace(301, "Moved Permanently"_sv));
-		MUST(status_to_brief.emplace(302, "Found"_sv));
-		MUST(status_to_brief.emplace(303, "See Other"_sv));
-		MUST(status_to_brief.emplace(304, "Not Modified"_sv));
-		MUST(status_to_brief.emplace(305, "Use Proxy"_sv));
-		MUST(status_to_brief.emplace(306, "Switch Proxy"_sv));
-		MUST(status_to_brief.emplace(307, "Temporary Redirect"_sv));
-		MUST(status_to_brief.emplace(308, "Permanent Redirect"_sv));
-
-		MUST(status_to_brief.emplace(400, "Bad Request"_sv));
-		MUST(status_to_brief.emplace(401, "Unauthorized"_sv));
-		MUST(status_to_brief.emplace(402, "Payment Required Experimental"_sv));
-		MUST(status_to_brief.emplace(403, "Forbidden"_sv));
-		MUST(status_to_brief.emplace(404, "Not Found"_sv));
-		MUST(status_to_brief.emplace(405, "Method Not Allowed"_sv));
-		MUST(status_to_brief.emplace(406, "Not Acceptable"_sv));
-		MUST(status_to_brief.emplace(407, "Proxy Authentication Required"_sv));
-		MUST(status_to_brief.emplace(408, "Request Timeout"_sv));
-		MUST(status_to_brief.emplace(409, "Conflict"_sv));
-		MUST(status_to_brief.emplace(410, "Gone"_sv));
-		MUST(status_to_brief.emplace(411, "Length Required"_sv));
-		MUST(status_to_brief.emplace(412, "Precondition Failed"_sv));
-		MUST(status_to_brief.emplace(413, "Payload Too Large"_sv));
-		MUST(status_to_brief.emplace(414, "URI Too Long"_sv));
-		MUST(status_to_brief.emplace(415, "Unsupported Media Type"_sv));
-		MUST(status_to_brief.emplace(416, "Range Not Satisfiable"_sv));
-		MUST(status_to_brief.emplace(417, "Expectation Failed"_sv));
-		MUST(status_to_brief.emplace(418, "I'm a teapot"_sv));
-		MUST(status_to_brief.emplace(421, "Misdirected Request"_sv));
-		MUST(status_to_brief.emplace(422, "Unprocessable Content (WebDAV)"_sv));
-		MUST(status_to_brief.emplace(423, "Locked (WebDAV)"_sv));
-		MUST(status_to_brief.emplace(424, "Failed Dependency (WebDAV)"_sv));
-		MUST(status_to_brief.emplace(425, "Too Early Experimental"_sv));
-		MUST(status_to_brief.emplace(426, "Upgrade Required"_sv));
-		MUST(status_to_brief.emplace(428, "Precondition Required"_sv));
-		MUST(status_to_brief.emplace(429, "Too Many Requests"_sv));
-		MUST(status_to_brief.emplace(431, "Request Header Fields Too Large"_sv));
-		MUST(status_to_brief.emplace(451, "Unavailable For Legal Reasons"_sv));
-
-		MUST(status_to_brief.emplace(500, "Internal Server Error"_sv));
-		MUST(status_to_brief.emplace(501, "Not Implemented"_sv));
-		MUST(status_to_brief.emplace(502, "Bad Gateway"_sv));
-		MUST(status_to_brief.emplace(503, "Service Unavailable"_sv));
-		MUST(status_to_brief.emplace(504, "Gateway Timeout"_sv));
-		MUST(status_to_brief.emplace(505, "HTTP Version Not Supported"_sv));
-		MUST(status_to_brief.emplace(506, "Variant Also Negotiates"_sv));
-		MUST(status_to_brief.emplace(507, "Insufficient Storage (WebDAV)"_sv));
-		MUST(status_to_brief.emplace(508, "Loop Detected (WebDAV)"_sv));
-		MUST(status_to_brief.emplace(510, "Not Extended"_sv));
-		MUST(status_to_brief.emplace(511, "Network Authentication Required"_sv));
-	}
-
-	auto it = status_to_brief.find(status);
-	if (it == status_to_brief.end())
+	auto it = s_status_to_brief.find(status);
+	if (it == s_status_to_brief.end())
 		return "unknown"_sv;
 	return it->value;
 }
 
-static BAN::StringView extension_to_mime(BAN::StringView extension)
+static void initialize_extension_to_mime()
 {
-	static BAN::HashMap<BAN::StringView, BAN::StringView> extension_to_mime;
-	if (extension_to_mime.empty())
-	{
-		MUST(extension_to_mime.emplace(".aac"_sv, "audio/aac"_sv));
-		MUST(extension_to_mime.emplace(".abw"_sv, "application/x-abiword"_sv));
-		MUST(extension_to_mime.emplace(".apng"_sv, "image/apng"_sv));
-		MUST(extension_to_mime.emplace(".arc"_sv, "application/x-freearc"_sv));
-		MUST(extension_to_mime.emplace(".avif"_sv, "image/avif"_sv));
-		MUST(extension_to_mime.emplace(".avi"_sv, "video/x-msvideo"_sv));
-		MUST(extension_to_mime.emplace(".azw"_sv, "application/vnd.amazon.ebook"_sv));
-		MUST(extension_to_mime.emplace(".bin"_sv, "application/octet-stream"_sv));
-		MUST(extension_to_mime.emplace(".bmp"_sv, "image/bmp"_sv));
-		MUST(extension_to_mime.emplace(".bz"_sv, "application/x-bzip"_sv));
-		MUST(extension_to_mime.emplace(".bz2"_sv, "application/x-bzip2"_sv));
-		MUST(extension_to_mime.emplace(".cda"_sv, "application/x-cdf"_sv));
-		MUST(extension_to_mime.emplace(".csh"_sv, "application/x-csh"_sv));
-		MUST(extension_to_mime.emplace(".css"_sv, "text/css"_sv));
-		MUST(extension_to_mime.emplace(".csv"_sv, "text/csv"_sv));
-		MUST(extension_to_mime.emplace(".doc"_sv, "application/msword"_sv));
-		MUST(extension_to_mime.emplace(".docx"_sv, "application/vnd.openxmlformats-officedocument.wordprocessingml.document"_sv));
-		MUST(extension_to_mime.emplace(".eot"_sv, "application/vnd.ms-fontobject"_sv));
-		MUST(extension_to_mime.emplace(".epub"_sv, "application/epub+zip"_sv));
-		MUST(extension_to_mime.emplace(".gz"_sv, "application/gzip"_sv));
-		MUST(extension_to_mime.emplace(".gif"_sv, "image/gif"_sv));
-		MUST(extension_to_mime.emplace(".htm"_sv, "text/html"_sv));
-		MUST(extension_to_mime.emplace(".html"_sv, "text/html"_sv));
-		MUST(extension_to_mime.emplace(".ico"_sv, "image/vnd.microsoft.icon"_sv));
-		MUST(extension_to_mime.emplace(".ics"_sv, "text/calendar"_sv));
-		MUST(extension_to_mime.emplace(".jar"_sv, "application/java-archive"_sv));
-		MUST(extension_to_mime.emplace(".jpeg"_sv, "image/jpeg"_sv));
-		MUST(extension_to_mime.emplace(".jpg"_sv, "image/jpeg"_sv));
-		MUST(extension_to_mime.emplace(".js"_sv, "text/javascript"_sv));
-		MUST(extension_to_mime.emplace(".json"_sv, "application/json"_sv));
-		MUST(extension_to_mime.emplace(".jsonld"_sv, "application/ld+json"_sv));
-		MUST(extension_to_mime.emplace(".mid"_sv, "audio/midi, audio/x-midi"_sv));
-		MUST(extension_to_mime.emplace(".midi"_sv, "audio/midi, audio/x-midi"_sv));
-		MUST(extension_to_mime.emplace(".mjs"_sv, "text/javascript"_sv));
-		MUST(extension_to_mime.emplace(".mp3"_sv, "audio/mpeg"_sv));
-		MUST(extension_to_mime.emplace(".mp4"_sv, "video/mp4"_sv));
-		MUST(extension_to_mime.emplace(".mpeg"_sv, "video/mpeg"_sv));
-		MUST(extension_to_mime.emplace(".mpkg"_sv, "application/vnd.apple.installer+xml"_sv));
-		MUST(extension_to_mime.emplace(".odp"_sv, "application/vnd.oasis.opendocument.presentation"_sv));
-		MUST(extension_to_mime.emplace(".ods"_sv, "application/vnd.oasis.opendocument.spreadsheet"_sv));
-		MUST(extension_to_mime.emplace(".odt"_sv, "application/vnd.oasis.opendocument.text"_sv));
-		MUST(extension_to_mime.emplace(".oga"_sv, "audio/ogg"_sv));
-		MUST(extension_to_mime.emplace(".ogv"_sv, "video/ogg"_sv));
-		MUST(extension_to_mime.emplace(".ogx"_sv, "application/ogg"_sv));
-		MUST(extension_to_mime.emplace(".opus"_sv, "audio/ogg"_sv));
-		MUST(extension_to_mime.emplace(".otf"_sv, "font/otf"_sv));
-		MUST(extension_to_mime.emplace(".png"_sv, "image/png"_sv));
-		MUST(extension_to_mime.emplace(".pdf"_sv, "application/pdf"_sv));
-		MUST(extension_to_mime.emplace(".php"_sv, "application/x-httpd-php"_sv));
-		MUST(extension_to_mime.emplace(".ppt"_sv, "application/vnd.ms-powerpoint"_sv));
-		MUST(extension_to_mime.emplace(".pptx"_sv, "application/vnd.openxmlformats-officedocument.presentationml.presentation"_sv));
-		MUST(extension_to_mime.emplace(".rar"_sv, "application/vnd.rar"_sv));
-		MUST(extension_to_mime.emplace(".rtf"_sv, "application/rtf"_sv));
-		MUST(extension_to_mime.emplace(".sh"_sv, "application/x-sh"_sv));
-		MUST(extension_to_mime.emplace(".svg"_sv, "image/svg+xml"_sv));
-		MUST(extension_to_mime.emplace(".tar"_sv, "application/x-tar"_sv));
-		MUST(extension_to_mime.emplace(".tif"_sv, "image/tiff"_sv));
-		MUST(extension_to_mime.emplace(".tiff"_sv, "image/tiff"_sv));
-		MUST(extension_to_mime.emplace(".ts"_sv, "video/mp2t"_sv));
-		MUST(extension_to_mime.emplace(".ttf"_sv, "font/ttf"_sv));
-		MUST(extension_to_mime.emplace(".txt"_sv, "text/plain"_sv));
-		MUST(extension_to_mime.emplace(".vsd"_sv, "application/vnd.visio"_sv));
-		MUST(extension_to_mime.emplace(".wav"_sv, "audio/wav"_sv));
-		MUST(extension_to_mime.emplace(".weba"_sv, "audio/webm"_sv));
-		MUST(extension_to_mime.emplace(".webm"_sv, "video/webm"_sv));
-		MUST(extension_to_mime.emplace(".webp"_sv, "image/webp"_sv));
-		MUST(extension_to_mime.emplace(".woff"_sv, "font/woff"_sv));
-		MUST(extension_to_mime.emplace(".woff2"_sv, "font/woff2"_sv));
-		MUST(extension_to_mime.emplace(".xhtml"_sv, "application/xhtml+xml"_sv));
-		MUST(extension_to_mime.emplace(".xls"_sv, "application/vnd.ms-excel"_sv));
-		MUST(extension_to_mime.emplace(".xlsx"_sv, "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"_sv));
-		MUST(extension_to_mime.emplace(".xml"_sv, "application/xml"_sv));
-		MUST(extension_to_mime.emplace(".xul"_sv, "application/vnd.mozilla.xul+xml"_sv));
-		MUST(extension_to_mime.emplace(".zip"_sv, "application/zip"_sv));
-		MUST(extension_to_mime.emplace(".3gp"_sv, "video/3gpp"_sv));
-		MUST(extension_to_mime.emplace(".3g2"_sv, "video/3gpp2"_sv));
-		MUST(extension_to_mime.emplace(".7z"_sv, "application/x-7z-compressed"_sv));
-	}
+	MUST(s_extension_to_mime.emplace(".aac"_sv, "audio/aac"_sv));
+	MUST(s_extension_to_mime.emplace(".abw"_sv, "application/x-abiword"_sv));
+	MUST(s_extension_to_mime.emplace(".apng"_sv, "image/apng"_sv));
+	MUST(s_extension_to_mime.emplace(".arc"_sv, "application/x-freearc"_sv));
+	MUST(s_extension_to_mime.emplace(".avif"_sv, "image/avif"_sv));
+	MUST(s_extension_to_mime.emplace(".avi"_sv, "video/x-msvideo"_sv));
+	MUST(s_extension_to_mime.emplace(".azw"_sv, "application/vnd.amazon.ebook"_sv));
+	MUST(s_extension_to_mime.emplace(".bin"_sv, "application/octet-stream"_sv));
+	MUST(s_extension_to_mime.emplace(".bmp"_sv, "image/bmp"_sv));
+	MUST(s_extension_to_mime.emplace(".bz"_sv, "application/x-bzip"_sv));
+	MUST(s_extension_to_mime.emplace(".bz2"_sv, "application/x-bzip2"_sv));
+	MUST(s_extension_to_mime.emplace(".cda"_sv, "application/x-cdf"_sv));
+	MUST(s_extension_to_mime.emplace(".csh"_sv, "application/x-csh"_sv));
+	MUST(s_extension_to_mime.emplace(".css"_sv, "text/css"_sv));
+	MUST(s_extension_to_mime.emplace(".csv"_sv, "text/csv"_sv));
+	MUST(s_extension_to_mime.emplace(".doc"_sv, "application/msword"_sv));
+	MUST(s_extension_to_mime.emplace(".docx"_sv, "application/vnd.openxmlformats-officedocument.wordprocessingml.document"_sv));
+	MUST(s_extension_to_mime.emplace(".eot"_sv, "application/vnd.ms-fontobject"_sv));
+	MUST(s_extension_to_mime.emplace(".epub"_sv, "application/epub+zip"_sv));
+	MUST(s_extension_to_mime.emplace(".gz"_sv, "application/gzip"_sv));
+	MUST(s_extension_to_mime.emplace(".gif"_sv, "image/gif"_sv));
+	MUST(s_extension_to_mime.emplace(".htm"_sv, "text/html"_sv));
+	MUST(s_extension_to_mime.emplace(".html"_sv, "text/html"_sv));
+	MUST(s_extension_to_mime.emplace(".ico"_sv, "image/vnd.microsoft.icon"_sv));
+	MUST(s_extension_to_mime.emplace(".ics"_sv, "text/calendar"_sv));
+	MUST(s_extension_to_mime.emplace(".jar"_sv, "application/java-archive"_sv));
+	MUST(s_extension_to_mime.emplace(".jpeg"_sv, "image/jpeg"_sv));
+	MUST(s_extension_to_mime.emplace(".jpg"_sv, "image/jpeg"_sv));
+	MUST(s_extension_to_mime.emplace(".js"_sv, "text/javascript"_sv));
+	MUST(s_extension_to_mime.emplace(".json"_sv, "application/json"_sv));
+	MUST(s_extension_to_mime.emplace(".jsonld"_sv, "application/ld+json"_sv));
+	MUST(s_extension_to_mime.emplace(".mid"_sv, "audio/midi, audio/x-midi"_sv));
+	MUST(s_extension_to_mime.emplace(".midi"_sv, "audio/midi, audio/x-midi"_sv));
+	MUST(s_extension_to_mime.emplace(".mjs"_sv, "text/javascript"_sv));
+	MUST(s_extension_to_mime.emplace(".mp3"_sv, "audio/mpeg"_sv));
+	MUST(s_extension_to_mime.emplace(".mp4"_sv, "video/mp4"_sv));
+	MUST(s_extension_to_mime.emplace(".mpeg"_sv, "video/mpeg"_sv));
+	MUST(s_extension_to_mime.emplace(".mpkg"_sv, "application/vnd.apple.installer+xml"_sv));
+	MUST(s_extension_to_mime.emplace(".odp"_sv, "application/vnd.oasis.opendocument.presentation"_sv));
+	MUST(s_extension_to_mime.emplace(".ods"_sv, "application/vnd.oasis.opendocument.spreadsheet"_sv));
+	MUST(s_extension_to_mime.emplace(".odt"_sv, "application/vnd.oasis.opendocument.text"_sv));
+	MUST(s_extension_to_mime.emplace(".oga"_sv, "audio/ogg"_sv));
+	MUST(s_extension_to_mime.emplace(".ogv"_sv, "video/ogg"_sv));
+	MUST(s_extension_to_mime.emplace(".ogx"_sv, "application/ogg"_sv));
+	MUST(s_extension_to_mime.emplace(".opus"_sv, "audio/ogg"_sv));
+	MUST(s_extension_to_mime.emplace(".otf"_sv, "font/otf"_sv));
+	MUST(s_extension_to_mime.emplace(".png"_sv, "image/png"_sv));
+	MUST(s_extension_to_mime.emplace(".pdf"_sv, "application/pdf"_sv));
+	MUST(s_extension_to_mime.emplace(".php"_sv, "application/x-httpd-php"_sv));
+	MUST(s_extension_to_mime.emplace(".ppt"_sv, "application/vnd.ms-powerpoint"_sv));
+	MUST(s_extension_to_mime.emplace(".pptx"_sv, "application/vnd.openxmlformats-officedocument.presentationml.presentation"_sv));
+	MUST(s_extension_to_mime.emplace(".rar"_sv, "application/vnd.rar"_sv));
+	MUST(s_extension_to_mime.emplace(".rtf"_sv, "application/rtf"_sv));
+	MUST(s_extension_to_mime.emplace(".sh"_sv, "application/x-sh"_sv));
+	MUST(s_extension_to_mime.emplace(".svg"_sv, "image/svg+xml"_sv));
+	MUST(s_extension_to_mime.emplace(".tar"_sv, "application/x-tar"_sv));
+	MUST(s_extension_to_mime.emplace(".tif"_sv, "image/tiff"_sv));
+	MUST(s_extension_to_mime.emplace(".tiff"_sv, "image/tiff"_sv));
+	MUST(s_extension_to_mime.emplace(".ts"_sv, "video/mp2t"_sv));
+	MUST(s_extension_to_mime.emplace(".ttf"_sv, "font/ttf"_sv));
+	MUST(s_extension_to_mime.emplace(".txt"_sv, "text/plain"_sv));
+	MUST(s_extension_to_mime.emplace(".vsd"_sv, "application/vnd.visio"_sv));
+	MUST(s_extension_to_mime.emplace(".wav"_sv, "audio/wav"_sv));
+	MUST(s_extension_to_mime.emplace(".weba"_sv, "audio/webm"_sv));
+	MUST(s_extension_to_mime.emplace(".webm"_sv, "video/webm"_sv));
+	MUST(s_extension_to_mime.emplace(".webp"_sv, "image/webp"_sv));
+	MUST(s_extension_to_mime.emplace(".woff"_sv, "font/woff"_sv));
+	MUST(s_extension_to_mime.emplace(".woff2"_sv, "font/woff2"_sv));
+	MUST(s_extension_to_mime.emplace(".xhtml"_sv, "application/xhtml+xml"_sv));
+	MUST(s_extension_to_mime.emplace(".xls"_sv, "application/vnd.ms-excel"_sv));
+	MUST(s_extension_to_mime.emplace(".xlsx"_sv, "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"_sv));
+	MUST(s_extension_to_mime.emplace(".xml"_sv, "application/xml"_sv));
+	MUST(s_extension_to_mime.emplace(".xul"_sv, "application/vnd.mozilla.xul+xml"_sv));
+	MUST(s_extension_to_mime.emplace(".zip"_sv, "application/zip"_sv));
+	MUST(s_extension_to_mime.emplace(".3gp"_sv, "video/3gpp"_sv));
+	MUST(s_extension_to_mime.emplace(".3g2"_sv, "video/3gpp2"_sv));
+	MUST(s_extension_to_mime.emplace(".7z"_sv, "application/x-7z-compressed"_sv));
+}
 
-	auto it = extension_to_mime.find(extension);
-	if (it == extension_to_mime.end())
+static BAN::StringView extension_to_mime(BAN::StringView extension)
+{
+	auto it = s_extension_to_mime.find(extension);
+	if (it == s_extension_to_mime.end())
 		return "application/octet-stream"_sv;
 	return it->value;
 }
@@ -5,8 +5,11 @@
 #include <BAN/IPv4.h>
 #include <BAN/String.h>
 #include <BAN/StringView.h>
+#include <BAN/UniqPtr.h>
 #include <BAN/Vector.h>
 
+#include <pthread.h>
+
 struct HTTPHeader
 {
 	BAN::StringView name;
@@ -21,6 +24,9 @@ struct HTTPRequest
 
 	BAN::Vector<HTTPHeader> headers;
 	BAN::ConstByteSpan body;
+
+	// number of bytes this request takes from the start of the client buffer
+	size_t size { 0 };
 };
 
 class HTTPServer
@@ -29,21 +35,61 @@ public:
 	HTTPServer();
 	~HTTPServer();
 
-	BAN::ErrorOr<void> initialize(BAN::StringView root, BAN::IPv4Address ip, int port);
+	BAN::ErrorOr<void> initialize(BAN::StringView root, BAN::IPv4Address ip, int port, size_t worker_count);
 	void start();
 
 	BAN::StringView web_root() const { return m_web_root.sv(); }
+	size_t worker_count() const { return m_workers.size(); }
 
 private:
-	BAN::ErrorOr<HTTPRequest> get_http_request(BAN::Vector<uint8_t>& data);
-	BAN::ErrorOr<void> send_http_response(int fd, unsigned status, BAN::ConstByteSpan, BAN::StringView mime);
-	BAN::ErrorOr<unsigned> handle_request(int fd, BAN::Vector<uint8_t>& data);
+	struct Client
+	{
+		BAN::Vector<uint8_t> input;
+
+		// response currently being sent, header first then file contents
+		BAN::String output;
+		size_t output_sent { 0 };
+		int file_fd { -1 };
+		off_t file_offset { 0 };
+		off_t file_size { 0 };
+
+		bool keep_alive { true };
+		uint32_t epoll_events { 0 };
+
+		bool has_response() const { return output_sent < output.size() || file_fd != -1; }
+	};
+
+	struct Worker
+	{
+		HTTPServer* server { nullptr };
+		pthread_t thread {};
+		int epoll_fd { -1 };
+		int pipe_fds[2] { -1, -1 };
+		BAN::HashMap<int, Client> clients;
+	};
+
+	static void* worker_entry(void*);
+	void worker_loop(Worker&);
+
+	void add_client(Worker&, int fd);
+	void remove_client(Worker&, int fd);
+	bool set_client_events(Worker&, int fd, Client&, uint32_t events);
+
 	// Returns false if the connection should be closed
-	bool handle_all_requests(int fd, BAN::Vector<uint8_t>& data);
+	bool receive_client_data(int fd, Client&);
+	// Returns false if the connection should be closed
+	bool process_client(Worker&, int fd, Client&);
+
+	BAN::ErrorOr<HTTPRequest> get_http_request(BAN::ConstByteSpan data);
+	BAN::ErrorOr<void> prepare_response(Client&);
+	// Returns true when the whole response has been sent
+	BAN::ErrorOr<bool> flush_response(int fd, Client&);
+	BAN::ErrorOr<unsigned> handle_request(const HTTPRequest&, Client&, BAN::StringView& mime);
 
 private:
 	BAN::String m_web_root;
 
 	int m_listen_socket { -1 };
-	BAN::HashMap<int, BAN::Vector<uint8_t>> m_client_data;
+	BAN::Vector<BAN::UniqPtr<Worker>> m_workers;
+	size_t m_next_worker { 0 };
 };
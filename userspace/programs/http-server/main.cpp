@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stdio.h>
+#include <unistd.h>
 
 int usage(const char* argv0, int ret)
 {
@@ -12,6 +13,7 @@ int usage(const char* argv0, int ret)
 	fprintf(fout, "  -r, --root <PATH>   web root directory\n");
 	fprintf(fout, "  -b, --bind <IPv4>   local address to bind\n");
 	fprintf(fout, "  -p, --port <PORT>   local port to bind\n");
+	fprintf(fout, "  -t, --threads <N>   number of worker threads (default: one per processor)\n");
 	return ret;
 }
 
@@ -20,6 +22,7 @@ int main(int argc, char** argv)
 	BAN::StringView root = "/var/www"_sv;
 	BAN::IPv4Address bind = INADDR_ANY;
 	uint16_t port = 80;
+	size_t threads = 0;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -51,6 +54,18 @@ int main(int argc, char** argv)
 			port = value;
 			i++;
 		}
+		else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0)
+		{
+			if (i + 1 >= argc)
+				return usage(argv[0], 1);
+			char* end = NULL;
+			errno = 0;
+			unsigned long value = strtoul(argv[i + 1], &end, 10);
+			if (*end || value == 0 || errno)
+				return usage(argv[0], 1);
+			threads = value;
+			i++;
+		}
 		else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
 		{
 			return usage(argv[0], 0);
@@ -61,13 +76,19 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (threads == 0)
+	{
+		long nprocessors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (nprocessors > 0) ? nprocessors : 1;
+	}
+
 	HTTPServer server;
-	if (auto ret = server.initialize(root, bind, port); ret.is_error())
+	if (auto ret = server.initialize(root, bind, port, threads); ret.is_error())
 	{
 		fprintf(stderr, "Could not initialize server: %s\n", strerror(ret.error().get_error_code()));
 		return 1;
 	}
 
-	BAN::Formatter::println(putchar, "Server started on {}:{} at {}", bind, port, server.web_root());
+	BAN::Formatter::println(putchar, "Server started on {}:{} at {} with {} workers", bind, port, server.web_root(), server.worker_count());
 	server.start();
 }